@@ -0,0 +1,56 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Shared by the programs under bench/: each times one numeric core on
+// synthetic input, checks its results against a plain reference, prints
+// both, and exits non-zero when a check failed. Built by "make bench",
+// without raylib.
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+static int bench_failures;
+
+// Count and report a failed check; the program goes on
+#define CHECK(cond, ...)                                                   \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            bench_failures++;                                              \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                    \
+            printf(__VA_ARGS__);                                           \
+            printf("\n");                                                  \
+        }                                                                  \
+    } while (0)
+
+// Results are summed into this so timed loops are not optimized away
+static volatile double bench_sink;
+
+static inline double bench_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+typedef void (*BenchFn)(void *ctx);
+
+// Shortest of runs calls of fn(ctx), in seconds. fn leaves its result in
+// ctx; it must undo anything a run allocates if it is to be run again.
+static inline double bench_best(BenchFn fn, void *ctx, int runs) {
+    double best = INFINITY;
+    for (int r = 0; r < runs; r++) {
+        double t0 = bench_now();
+        fn(ctx);
+        best = fmin(best, bench_now() - t0);
+    }
+    return best;
+}
+
+// Exit status for main: the number of failed checks, capped
+static inline int bench_done(void) {
+    if (bench_failures) printf("%d check(s) failed\n", bench_failures);
+    else printf("all checks passed\n");
+    return bench_failures > 125 ? 125 : bench_failures;
+}
+
+#endif
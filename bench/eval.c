@@ -0,0 +1,232 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// Compiled bytecode, one sample and a block at a time, against the tree
+// walker it replaced, and the tree-walk fallback for expressions too deep
+// for the stack.
+#include "bench.h"
+#include "modules/cas/bytecode.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 1000000
+#define RUNS    5
+
+static const char *const EXPRS[] = {
+    "sgn(x)*floor(x)+log2(x^2+1)",
+    "exp(-x^2/2)*cos(5x)",
+    "(x+1)*(x-2)*(x+3)/(x^2+4)",
+    "cosh(x)+atanh(x/20)+abs(x)",
+    "sin(x)*cos(x)+tanh(x/3)",
+    "sin(x)",
+};
+
+// Eight trig-heavy curves, as one dashboard draws them
+static const char *const DASHBOARD[] = {
+    "sin(x)",
+    "cos(2x)+sin(3x)",
+    "sin(x)*cos(x)+tanh(x/3)",
+    "tan(x/4)*cos(x)",
+    "sin(x)^2-cos(x)^2",
+    "exp(-x^2/8)*sin(4x)",
+    "sec(x/5)+csc(x/5+1)",
+    "atan(sin(x))+cot(x/3+0.5)",
+};
+
+static double xs[SAMPLES], ys[SAMPLES], out[SAMPLES];
+
+// eval_ast_xy before expressions were compiled: a strcmp chain on every
+// function node, every sample. What the compiled paths are measured against.
+static double walk_names(const ASTNode *node, double x, double y) {
+    if (!node) return NAN;
+
+    switch (node->type) {
+    case NODE_NUMBER:
+        return node->number;
+
+    case NODE_VAR:
+        if (node->var == 'y') return y;
+        return x;
+
+    case NODE_UNARY_NEG:
+        return -walk_names(node->unary.operand, x, y);
+
+    case NODE_BINOP: {
+        double l = walk_names(node->binop.left, x, y);
+        double r = walk_names(node->binop.right, x, y);
+        switch (node->binop.op) {
+            case '+': return l + r;
+            case '-': return l - r;
+            case '*': return l * r;
+            case '/': return r != 0.0 ? l / r : NAN;
+            case '^': return pow(l, r);
+            case '%': return r != 0.0 ? fmod(l, r) : NAN;
+            default:  return NAN;
+        }
+    }
+
+    case NODE_FUNC: {
+        double a = walk_names(node->func.arg, x, y);
+        const char *n = node->func.name;
+        if (strcmp(n, "sin")  == 0) return sin(a);
+        if (strcmp(n, "cos")  == 0) return cos(a);
+        if (strcmp(n, "tan")  == 0) return tan(a);
+        if (strcmp(n, "asin") == 0) return asin(a);
+        if (strcmp(n, "acos") == 0) return acos(a);
+        if (strcmp(n, "atan") == 0) return atan(a);
+        if (strcmp(n, "cot")  == 0) { double s = sin(a); return s != 0.0 ? cos(a) / s : NAN; }
+        if (strcmp(n, "sec")  == 0) { double c = cos(a); return c != 0.0 ? 1.0 / c : NAN; }
+        if (strcmp(n, "csc")  == 0) { double s = sin(a); return s != 0.0 ? 1.0 / s : NAN; }
+        if (strcmp(n, "sinh") == 0) return sinh(a);
+        if (strcmp(n, "cosh") == 0) return cosh(a);
+        if (strcmp(n, "tanh") == 0) return tanh(a);
+        if (strcmp(n, "asinh")== 0) return asinh(a);
+        if (strcmp(n, "acosh")== 0) return acosh(a);
+        if (strcmp(n, "atanh")== 0) return atanh(a);
+        if (strcmp(n, "sqrt") == 0) return sqrt(a);
+        if (strcmp(n, "cbrt") == 0) return cbrt(a);
+        if (strcmp(n, "log")  == 0) return log10(a);
+        if (strcmp(n, "ln")   == 0) return log(a);
+        if (strcmp(n, "log2") == 0) return log2(a);
+        if (strcmp(n, "exp")  == 0) return exp(a);
+        if (strcmp(n, "abs")  == 0) return fabs(a);
+        if (strcmp(n, "floor")== 0) return floor(a);
+        if (strcmp(n, "ceil") == 0) return ceil(a);
+        if (strcmp(n, "round")== 0) return round(a);
+        if (strcmp(n, "sign") == 0) return (a > 0.0) ? 1.0 : (a < 0.0) ? -1.0 : 0.0;
+        if (strcmp(n, "sgn")  == 0) return (a > 0.0) ? 1.0 : (a < 0.0) ? -1.0 : 0.0;
+        return NAN;
+    }
+    }
+    return NAN;
+}
+
+// Equal, or both NaN, or within tol of each other relative to their size
+// (or to 1, where terms of about 1 cancel)
+static bool close_to(double a, double b, double tol) {
+    if (isnan(a) || isnan(b)) return isnan(a) && isnan(b);
+    return a == b || fabs(a - b) <= tol * fmax(fmax(fabs(a), fabs(b)), 1.0);
+}
+
+typedef enum { NAMES, TREE, SCALAR, BATCH } Mode;
+
+typedef struct {
+    Mode            mode;
+    const ASTNode  *ast;
+    const Bytecode *bc;
+} Run;
+
+static void run_eval(void *ctx) {
+    const Run *r = ctx;
+    double sum = 0.0;
+    switch (r->mode) {
+    case NAMES:
+        for (int i = 0; i < SAMPLES; i++) sum += walk_names(r->ast, xs[i], 0.0);
+        break;
+    case TREE:
+        for (int i = 0; i < SAMPLES; i++) sum += eval_ast(r->ast, xs[i]);
+        break;
+    case SCALAR:
+        for (int i = 0; i < SAMPLES; i++) sum += bytecode_eval(r->bc, xs[i], 0.0);
+        break;
+    case BATCH:
+        bytecode_eval_batch(r->bc, xs, NULL, out, SAMPLES);
+        sum = out[SAMPLES / 2];
+        break;
+    }
+    bench_sink += sum;
+}
+
+// ns per sample in each mode, in Mode order
+static void bench_expr(const char *text, Arena *arena, double ns[4]) {
+    arena_reset(arena);
+    Parser p;
+    parser_init(&p, text, arena);
+    ASTNode  *ast = parser_parse(&p);
+    Bytecode *bc  = bytecode_compile(ast, arena);
+    CHECK(!p.has_error && bc && !bc->tree, "%s did not compile", text);
+    if (p.has_error || !bc) return;
+
+    int bad = 0;
+    bytecode_eval_batch(bc, xs, NULL, out, SAMPLES);
+    for (int i = 0; i < SAMPLES; i++) {
+        // The walkers square with pow where bytecode multiplies, and the
+        // block kernels are a few ulp off at most (vecmath.h)
+        double ref = walk_names(ast, xs[i], 0.0);
+        if (!close_to(eval_ast(ast, xs[i]), ref, 0.0) || !close_to(bytecode_eval(bc, xs[i], 0.0), ref, 1e-13) ||
+            !close_to(out[i], ref, 1e-13))
+            bad++;
+    }
+    CHECK(!bad, "%s: %d of %d samples differ from the strcmp walker", text, bad, SAMPLES);
+
+    for (Mode m = NAMES; m <= BATCH; m++)
+        ns[m] = bench_best(run_eval, &(Run){ m, ast, bc }, RUNS) * 1e9 / SAMPLES;
+    printf("  %-30s %6.1f %6.1f %6.1f %6.1f   %5.1fx %5.1fx\n", text, ns[NAMES], ns[TREE],
+           ns[SCALAR], ns[BATCH], ns[NAMES] / ns[SCALAR], ns[NAMES] / ns[BATCH]);
+}
+
+// x+(x*(x+(...))): right-nested, so every level holds one more operand
+static void check_deep(int levels, Arena *arena) {
+    char *text = malloc((size_t)levels * 4 + 2);
+    size_t len = 0;
+    for (int i = 0; i < levels; i++) len += (size_t)sprintf(text + len, "x%c(", i % 2 ? '*' : '+');
+    text[len++] = 'x';
+    memset(text + len, ')', (size_t)levels);
+    text[len + levels] = '\0';
+
+    arena_reset(arena);
+    Parser p;
+    parser_init(&p, text, arena);
+    ASTNode  *ast = parser_parse(&p);
+    Bytecode *bc  = bytecode_compile(ast, arena);
+    CHECK(!p.has_error && bc, "%d levels did not compile", levels);
+    if (!p.has_error && bc) {
+        CHECK(!bc->tree == (bc->stack_max <= BYTECODE_STACK_MAX),
+              "%d levels: stack %d, walks the tree %d", levels, bc->stack_max, bc->tree != NULL);
+        int bad = 0;
+        bytecode_eval_batch(bc, xs, ys, out, 4096);
+        for (int i = 0; i < 4096; i++) {
+            double ref = eval_ast_xy(ast, xs[i], ys[i]);
+            if (!close_to(bytecode_eval(bc, xs[i], ys[i]), ref, 0.0) || !close_to(out[i], ref, 0.0))
+                bad++;
+        }
+        CHECK(!bad, "%d levels: %d samples differ from the tree walker", levels, bad);
+        printf("  %d levels: stack %d, %s\n", levels, bc->stack_max,
+               bc->tree ? "walks the tree" : "bytecode");
+    }
+    free(text);
+}
+
+int main(void) {
+    for (int i = 0; i < SAMPLES; i++) {
+        xs[i] = -20.0 + 40.0 * i / SAMPLES;
+        ys[i] = 0.5 * xs[i];
+    }
+    Arena arena = arena_create(1 << 20);
+    double ns[4], total[4] = {0};
+
+    printf("eval: ns per sample, best of %d over %d samples; speedup on the strcmp walker\n",
+           RUNS, SAMPLES);
+    printf("  %-30s %6s %6s %6s %6s   %6s %6s\n", "expression", "strcmp", "tree", "code",
+           "block", "code", "block");
+    for (size_t i = 0; i < sizeof(EXPRS) / sizeof(EXPRS[0]); i++) bench_expr(EXPRS[i], &arena, ns);
+
+    printf("eval: a dashboard of %d trig-heavy curves\n", (int)(sizeof(DASHBOARD) / sizeof(DASHBOARD[0])));
+    for (size_t i = 0; i < sizeof(DASHBOARD) / sizeof(DASHBOARD[0]); i++) {
+        bench_expr(DASHBOARD[i], &arena, ns);
+        for (int m = 0; m < 4; m++) total[m] += ns[m];
+    }
+    // libm is most of the time on these, so one sample at a time stays well
+    // short of 5x; the plotter evaluates in blocks, which get there with
+    // the SIMD kernels. The compiled program must beat the walker either way.
+    printf("  %-30s %6.1f %6.1f %6.1f %6.1f   %5.1fx %5.1fx  (target 5x)\n", "all eight",
+           total[NAMES], total[TREE], total[SCALAR], total[BATCH], total[NAMES] / total[SCALAR],
+           total[NAMES] / total[BATCH]);
+    CHECK(total[NAMES] / total[SCALAR] > 1.2, "dashboard: bytecode only %.2fx the strcmp walker",
+          total[NAMES] / total[SCALAR]);
+
+    printf("eval: nesting past BYTECODE_STACK_MAX\n");
+    check_deep(BYTECODE_STACK_MAX / 2, &arena);
+    check_deep(BYTECODE_STACK_MAX * 2, &arena);
+
+    arena_destroy(&arena);
+    return bench_done();
+}
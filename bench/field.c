@@ -0,0 +1,192 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// RK4 streamlines on fields whose lines are known: circles of a rotation,
+// hyperbolas of a saddle, helices in 3D. Checks that lines keep their
+// invariant, are spaced h apart, close and stop where they should, and
+// that halving h shrinks the error as a fourth-order method does.
+#include "bench.h"
+#include "modules/cas/field.h"
+#include "modules/cas/simplify.h"
+#include "utils/workpool.h"
+#include <math.h>
+#include <string.h>
+
+#define SEEDS FIELD_MAX_SEEDS
+#define RUNS  5
+
+static Arena arena;
+static double seeds[3 * SEEDS];
+
+// Compile the components of a field; false if one fails
+static bool compile(const char *const text[3], int dims, Bytecode *code[3]) {
+    for (int k = 0; k < 3; k++) code[k] = NULL;
+    for (int k = 0; k < dims; k++) {
+        Parser p;
+        parser_init(&p, text[k], &arena);
+        p.allow_z = dims == 3;
+        code[k]   = bytecode_compile(simplify_ast(parser_parse(&p)), &arena);
+        CHECK(!p.has_error && code[k], "%s did not compile", text[k]);
+        if (p.has_error || !code[k]) return false;
+    }
+    return true;
+}
+
+// Seeds on a ring of radii 0.5 to 2.5 around the origin, z in [-1, 1]
+static void ring_seeds(int n) {
+    for (int i = 0; i < n; i++) {
+        double r = 0.5 + 2.0 * i / n, a = 2.399963 * i; // golden angle
+        seeds[3 * i]     = r * cos(a);
+        seeds[3 * i + 1] = r * sin(a);
+        seeds[3 * i + 2] = -1.0 + 2.0 * i / n;
+    }
+}
+
+typedef double (*Invariant)(const float *p);
+static double radius(const float *p) { return hypot(p[0], p[1]); }
+static double xy(const float *p)     { return (double)p[0] * p[1]; }
+
+// Largest drift of inv along every line from its seed, and the number of
+// steps longer than h. A step of the mean of four unit directions is h
+// long on a straight line and shorter on a bend; only the step closing a
+// loop at its seed, within 0.6 h of where it would have gone, may exceed h.
+static double drift(const FieldLines *fl, Invariant inv, double h, int *uneven) {
+    double worst = 0.0;
+    *uneven = 0;
+    const float *p = fl->points;
+    for (int l = 0; l < fl->line_count; p += 3 * fl->lengths[l++]) {
+        // The seed is the point the step lengths run out from either way
+        double ref = NAN;
+        for (int i = 0; i < fl->lengths[l]; i++) {
+            if (isnan(ref)) ref = inv(p);
+            worst = fmax(worst, fabs(inv(&p[3 * i]) - ref));
+            if (i == 0) continue;
+            const float *a = &p[3 * (i - 1)], *b = &p[3 * i];
+            double step = sqrt((double)(b[0] - a[0]) * (b[0] - a[0]) + (double)(b[1] - a[1]) * (b[1] - a[1]) +
+                               (double)(b[2] - a[2]) * (b[2] - a[2]));
+            bool closing = i + 1 == fl->lengths[l] && b[0] == p[0] && b[1] == p[1] && b[2] == p[2];
+            if (step > (closing ? 1.6 : 1.001) * h) (*uneven)++;
+        }
+    }
+    return worst;
+}
+
+typedef struct {
+    Bytecode    **code;
+    int           dims, n;
+    const double *lo, *hi;
+    double        h;
+    ArenaMark     mark;
+    FieldLines    fl;
+} Lines;
+
+// The last run's lines stay in the arena
+static void run_lines(void *ctx) {
+    Lines *r = ctx;
+    arena_rewind(&arena, r->mark);
+    r->fl = field_lines(r->code, r->dims, seeds, r->n, r->lo, r->hi, r->h, &arena);
+}
+
+// Time to trace n seeds, best of RUNS, in ms
+static double time_lines(Bytecode *code[3], int dims, int n, const double lo[3],
+                         const double hi[3], double h, FieldLines *fl) {
+    Lines run = { code, dims, n, lo, hi, h, arena_mark(&arena), {0} };
+    double best = bench_best(run_lines, &run, RUNS);
+    *fl = run.fl;
+    return best * 1e3;
+}
+
+int main(void) {
+    workpool_init(0);
+    arena = arena_create(64 << 20);
+    const double lo[3] = { -4.0, -4.0, -4.0 }, hi[3] = { 4.0, 4.0, 4.0 };
+    Bytecode *code[3];
+    FieldLines fl;
+    int uneven;
+    printf("field: %d seeds, best of %d\n", SEEDS, RUNS);
+
+    // Rotation: circles that close when FIELD_LINE_STEPS steps go round
+    static const char *const ROT[3] = { "-y", "x", NULL };
+    if (compile(ROT, 2, code)) {
+        ring_seeds(SEEDS);
+        double ms = time_lines(code, 2, SEEDS, lo, hi, 0.05, &fl);
+        double d = drift(&fl, radius, 0.05, &uneven);
+        int open = 0;
+        const float *p = fl.points;
+        for (int l = 0; l < fl.line_count; p += 3 * fl.lengths[l++]) {
+            const float *a = p, *b = &p[3 * (fl.lengths[l] - 1)];
+            bool round = 2.0 * M_PI * radius(a) < 0.95 * FIELD_LINE_STEPS * 0.05;
+            if (round && (fl.lengths[l] > FIELD_LINE_STEPS + 1 || a[0] != b[0] || a[1] != b[1])) open++;
+        }
+        CHECK(fl.line_count == SEEDS, "rotation: %d lines of %d seeds", fl.line_count, SEEDS);
+        CHECK(d < 1e-5, "rotation: radius drifts %.3g", d);
+        CHECK(!uneven, "rotation: %d steps longer than h", uneven);
+        CHECK(!open, "rotation: %d circles not closed at their seed", open);
+        printf("  rotation, h 0.05    %7.2f ms %9lld evals %6.1f Mevals/s  radius drift %.2g\n", ms,
+               fl.evals, fl.evals / ms * 1e-3, d);
+    }
+
+    // Saddle: xy is constant along the hyperbolas; error against h
+    static const char *const SADDLE[3] = { "x", "-y", NULL };
+    if (compile(SADDLE, 2, code)) {
+        ring_seeds(SEEDS);
+        double err[3], hs[3] = { 0.2, 0.1, 0.05 };
+        for (int i = 0; i < 3; i++) {
+            ArenaMark mark = arena_mark(&arena);
+            double ms = time_lines(code, 2, SEEDS, lo, hi, hs[i], &fl);
+            err[i] = drift(&fl, xy, hs[i], &uneven);
+            CHECK(!uneven, "saddle, h %g: %d steps longer than h", hs[i], uneven);
+            int outside = 0;
+            const float *p = fl.points;
+            for (int l = 0; l < fl.line_count; p += 3 * fl.lengths[l++])
+                for (int j = 1; j + 1 < fl.lengths[l]; j++)
+                    for (int c = 0; c < 2; c++)
+                        outside += p[3 * j + c] < lo[c] || p[3 * j + c] > hi[c];
+            CHECK(!outside, "saddle: %d points past the box before a line's end", outside);
+            printf("  saddle, h %-9g %7.2f ms %9lld evals %6.1f Mevals/s  xy drift %.2g\n", hs[i],
+                   ms, fl.evals, fl.evals / ms * 1e-3, err[i]);
+            arena_rewind(&arena, mark);
+        }
+        // Lines of the same length in space but twice the steps: error / 16
+        double r1 = err[0] / err[1], r2 = err[1] / err[2];
+        CHECK(r1 > 8.0 && r2 > 8.0 && r1 * r2 > 100.0, "saddle: error ratios %.1f, %.1f when h halves",
+              r1, r2);
+        printf("  saddle error ratios when h halves: %.1f, %.1f (fourth order: 16)\n", r1, r2);
+    }
+
+    // Helix in 3D: radius kept, z climbing
+    static const char *const HELIX[3] = { "-y", "x", "0.2" };
+    if (compile(HELIX, 3, code)) {
+        ring_seeds(SEEDS);
+        double ms = time_lines(code, 3, SEEDS, lo, hi, 0.05, &fl);
+        double d = drift(&fl, radius, 0.05, &uneven);
+        CHECK(d < 1e-5, "helix: radius drifts %.3g", d);
+        CHECK(!uneven, "helix: %d steps longer than h", uneven);
+        printf("  helix, h 0.05       %7.2f ms %9lld evals %6.1f Mevals/s  radius drift %.2g\n", ms,
+               fl.evals, fl.evals / ms * 1e-3, d);
+    }
+
+    // Sink: lines run into the origin and must not wander off again
+    static const char *const SINK[3] = { "-x", "-y", NULL };
+    if (compile(SINK, 2, code)) {
+        ring_seeds(64);
+        fl = field_lines(code, 2, seeds, 64, lo, hi, 0.05, &arena);
+        int away = 0, near = 0;
+        const float *p = fl.points;
+        for (int l = 0; l < fl.line_count; p += 3 * fl.lengths[l++]) {
+            bool reached = false;
+            for (int j = 0; j < fl.lengths[l]; j++) {
+                double r = hypot(p[3 * j], p[3 * j + 1]);
+                if (reached && r > 0.05 * 1.01) away++;
+                reached = reached || r < 0.05;
+                near += r < 0.1;
+            }
+        }
+        CHECK(!away, "sink: %d points more than h out after reaching it", away);
+        CHECK(near <= 3 * 64, "sink: %d points within 2 h of it, lines stay on", near);
+        printf("  sink: %d lines, %d points, %d within 2 h of it\n", fl.line_count, fl.point_count,
+               near);
+    }
+
+    arena_destroy(&arena);
+    workpool_shutdown();
+    return bench_done();
+}
@@ -0,0 +1,180 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// Surface nets over the brick octree: time per mesh, and on closed test
+// surfaces that the mesh is watertight with the right Euler characteristic,
+// its vertices within a voxel of the surface and its normals along the
+// gradient. A pole must get no triangles.
+#include "bench.h"
+#include "modules/cas/implicit3d.h"
+#include "modules/cas/eval.h"
+#include "modules/cas/simplify.h"
+#include "utils/workpool.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RUNS 3
+
+typedef struct {
+    const char *text;
+    double      range;
+    int         euler;  // V - E + F of the closed surface, or 99 if not closed
+    double      radius; // > 0: a sphere of it, for the distance check
+} Case;
+
+static const Case CASES[] = {
+    { "x^2+y^2+z^2=4",                         3.0, 2,  2.0 },
+    { "(sqrt(x^2+y^2)-2)^2+z^2=0.5",           3.5, 0,  0.0 },
+    { "x^4+y^4+z^4-5(x^2+y^2+z^2)+11.8=0",     3.0, -8, 0.0 }, // genus 5
+    { "sin(x)cos(y)+sin(y)cos(z)+sin(z)cos(x)", 5.0, 99, 0.0 },
+    { "1/(x-0.3)=0",                           3.0, 99, 0.0 },
+};
+
+// Open-addressed set of up to cap keys of two 64-bit words, for welding
+// vertices shared by bricks and parts and for counting edge uses
+typedef struct {
+    uint64_t *key; // two words per slot, (0, 0) free
+    int      *val;
+    size_t    cap;
+    int       count;
+} Table;
+
+static void table_init(Table *t, size_t cap) {
+    t->key   = calloc(2 * cap, sizeof(uint64_t));
+    t->val   = calloc(cap, sizeof(int));
+    t->cap   = cap;
+    t->count = 0;
+}
+
+static void table_free(Table *t) {
+    free(t->key);
+    free(t->val);
+}
+
+// Slot of (a, b), claimed if new; a and b are not both 0
+static int *table_at(Table *t, uint64_t a, uint64_t b, bool *added) {
+    size_t i = (size_t)((a * 0x9E3779B97F4A7C15ull ^ b * 0xC2B2AE3D27D4EB4Full) >> 20) & (t->cap - 1);
+    for (;; i = (i + 1) & (t->cap - 1)) {
+        uint64_t *k = &t->key[2 * i];
+        if (k[0] == a && k[1] == b) {
+            *added = false;
+            return &t->val[i];
+        }
+        if (!k[0] && !k[1]) {
+            k[0] = a;
+            k[1] = b;
+            t->count++;
+            *added = true;
+            return &t->val[i];
+        }
+    }
+}
+
+// Welded id of a vertex by its exact coordinates
+static int weld(Table *t, const float *v) {
+    uint32_t w[3];
+    memcpy(w, v, sizeof(w));
+    bool added;
+    int *id = table_at(t, ((uint64_t)w[0] << 32 | w[1]) + 1, w[2], &added);
+    if (added) *id = t->count - 1;
+    return *id;
+}
+
+typedef struct {
+    const Bytecode *bc;
+    const ASTNode  *ast;
+    double          range;
+    Arena          *arena;
+    ArenaMark       mark;
+    ImplicitMesh    mesh;
+} Mesh;
+
+// The last run's mesh stays in the arena
+static void run_mesh(void *ctx) {
+    Mesh *r = ctx;
+    arena_rewind(r->arena, r->mark);
+    r->mesh = implicit3d_mesh(r->bc, r->ast, r->range, r->arena);
+}
+
+static void check_case(const Case *c, Arena *arena) {
+    arena_reset(arena);
+    Parser p;
+    parser_init(&p, c->text, arena);
+    p.allow_z = true;
+    bool relation;
+    ASTNode  *ast = simplify_ast(parser_parse_relation(&p, &relation));
+    Bytecode *bc  = bytecode_compile(ast, arena);
+    CHECK(!p.has_error && bc, "%s did not compile", c->text);
+    if (p.has_error || !bc) return;
+
+    Mesh run = { bc, ast, c->range, arena, arena_mark(arena), {0} };
+    double best = bench_best(run_mesh, &run, RUNS);
+    ImplicitMesh m = run.mesh;
+
+    double h = 2.0 * c->range / IMPLICIT3D_RES, diag = h * sqrt(3.0);
+    Table verts, edges;
+    table_init(&verts, 1 << 21);
+    table_init(&edges, 1 << 22);
+    int far = 0, bad_normal = 0, degenerate = 0;
+    for (int k = 0; k < m.part_count; k++) {
+        const ImplicitPart *pt = &m.parts[k];
+        for (int i = 0; i < pt->vertex_count; i++) {
+            const float *v = &pt->vertices[3 * i], *n = &pt->normals[3 * i];
+            weld(&verts, v);
+            double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (fabs(len - 1.0) > 1e-3) bad_normal++;
+            if (c->radius > 0.0) {
+                double d = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+                if (fabs(d - c->radius) > diag) far++;
+                if ((v[0] * n[0] + v[1] * n[1] + v[2] * n[2]) / d < 0.9) bad_normal++;
+            }
+        }
+        for (int i = 0; i < pt->index_count; i += 3) {
+            int id[3];
+            for (int j = 0; j < 3; j++) id[j] = weld(&verts, &pt->vertices[3 * pt->indices[i + j]]);
+            if (id[0] == id[1] || id[1] == id[2] || id[2] == id[0]) degenerate++;
+            for (int j = 0; j < 3; j++) {
+                int a = id[j], b = id[(j + 1) % 3];
+                bool added;
+                int *uses = table_at(&edges, (uint64_t)(a < b ? a : b) + 1, (uint64_t)(a < b ? b : a), &added);
+                *uses = added ? 1 : *uses + 1;
+            }
+        }
+    }
+    int open = 0;
+    for (size_t i = 0; i < edges.cap; i++)
+        if ((edges.key[2 * i] || edges.key[2 * i + 1]) && edges.val[i] != 2) open++;
+    int euler = verts.count - edges.count + m.triangles;
+
+    CHECK(!far, "%s: %d vertices over a voxel diagonal off the sphere", c->text, far);
+    CHECK(!bad_normal, "%s: %d normals not unit or not along the gradient", c->text, bad_normal);
+    CHECK(!degenerate, "%s: %d triangles with a repeated vertex", c->text, degenerate);
+    if (c->euler != 99) {
+        CHECK(m.triangles > 0, "%s: no triangles", c->text);
+        CHECK(!open, "%s: %d edges not shared by exactly two triangles", c->text, open);
+        CHECK(euler == c->euler, "%s: V - E + F = %d, not %d", c->text, euler, c->euler);
+    }
+    if (strstr(c->text, "1/"))
+        CHECK(m.triangles == 0, "%s: %d triangles across the pole", c->text, m.triangles);
+
+    double dense = pow(IMPLICIT3D_RES + 1.0, 3.0);
+    printf("  %-40s %7.1f %6d %6.1f%% %8d %7d %5d\n", c->text, best * 1e3, m.bricks,
+           100.0 * (double)m.evals / dense, m.triangles, open, euler);
+    table_free(&verts);
+    table_free(&edges);
+}
+
+int main(void) {
+    workpool_init(0);
+    implicit3d_init();
+    Arena arena = arena_create(64 << 20);
+    printf("implicit3d: %d^3 voxels, best of %d, on %d worker(s)\n", IMPLICIT3D_RES, RUNS,
+           workpool_workers());
+    printf("  %-40s %7s %6s %7s %8s %7s %5s\n", "surface", "ms", "bricks", "evals", "tris",
+           "open", "V-E+F");
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) check_case(&CASES[i], &arena);
+    arena_destroy(&arena);
+    implicit3d_release();
+    workpool_shutdown();
+    return bench_done();
+}
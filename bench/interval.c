@@ -0,0 +1,123 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// Interval enclosures as the 2D cull uses them: every sample of a box must
+// lie inside its interval, and a box whose interval misses the view may be
+// skipped. Times one interval against sampling the box outright.
+#include "bench.h"
+#include "modules/cas/interval.h"
+#include "modules/cas/bytecode.h"
+#include "modules/cas/simplify.h"
+#include <math.h>
+
+#define BOXES   20000
+#define PER_BOX 256 // samples a box stands for, as a 64-cell chunk at 4 px
+#define RUNS    5
+
+static const char *const EXPRS[] = {
+    "sin(x)*cos(x)+tanh(x/3)",
+    "x^3-2x",
+    "1/x",
+    "tan(x)",
+    "sqrt(4-x^2)",
+    "ln(x)",
+    "floor(x)*x",
+    "x%3",
+    "sin(1/x)",
+    "abs(x-1)+cosh(x/4)",
+    "asin(x/3)+exp(-x^2)",
+    "sin(x*y)+y^2",
+};
+
+static unsigned rs = 1;
+
+static double uniform(double lo, double hi) {
+    rs = rs * 1103515245u + 12345u;
+    return lo + (hi - lo) * (double)(rs >> 8) / (1 << 24);
+}
+
+// Inside [lo, hi], give or take eval_ast_xy's own rounding
+static bool inside(double v, Interval iv) {
+    double slack = 1e-12 * fmax(fabs(iv.lo), fabs(iv.hi)) + 1e-300;
+    return v >= iv.lo - slack && v <= iv.hi + slack;
+}
+
+typedef struct {
+    const ASTNode  *ast;
+    const Bytecode *bc;
+    const double   *x0, *x1, *y;
+} Boxes;
+
+static void run_intervals(void *ctx) {
+    const Boxes *b = ctx;
+    double sum = 0.0;
+    for (int i = 0; i < BOXES; i++) sum += eval_ast_interval(b->ast, b->x0[i], b->x1[i], b->y[i], b->y[i]).lo;
+    bench_sink += sum;
+}
+
+// The samples of one box in 16
+static void run_samples(void *ctx) {
+    const Boxes *b = ctx;
+    static double xs[PER_BOX], out[PER_BOX];
+    double sum = 0.0;
+    for (int k = 0; k < BOXES / 16; k++) {
+        for (int i = 0; i < PER_BOX; i++) xs[i] = b->x0[k] + (b->x1[k] - b->x0[k]) * i / PER_BOX;
+        bytecode_eval_batch(b->bc, xs, NULL, out, PER_BOX);
+        sum += out[k % PER_BOX];
+    }
+    bench_sink += sum;
+}
+
+static void bench_expr(const char *text, Arena *arena) {
+    arena_reset(arena);
+    Parser p;
+    parser_init(&p, text, arena);
+    ASTNode  *ast = simplify_ast(parser_parse(&p));
+    Bytecode *bc  = bytecode_compile(ast, arena);
+    CHECK(!p.has_error && bc, "%s did not compile", text);
+    if (p.has_error || !bc) return;
+
+    static double x0[BOXES], x1[BOXES], yb[BOXES];
+    for (int b = 0; b < BOXES; b++) {
+        double c = uniform(-20.0, 20.0), w = pow(10.0, uniform(-4.0, 1.0));
+        x0[b] = c - w;
+        x1[b] = c + w;
+        yb[b] = uniform(-3.0, 3.0);
+    }
+
+    // Soundness, and how often a view of y in [-2, 2] lets the box go
+    int outside = 0, nan_defined = 0, culled = 0, wrongly_culled = 0;
+    for (int b = 0; b < BOXES; b++) {
+        Interval iv = eval_ast_interval(ast, x0[b], x1[b], yb[b], yb[b] + 0.5);
+        bool cull = !interval_empty(iv) && !iv.undef && (iv.hi < -2.0 || iv.lo > 2.0);
+        culled += cull;
+        for (int i = 0; i <= 64; i++) {
+            double x = fmin(x0[b] + (x1[b] - x0[b]) * i / 64, x1[b]), y = yb[b] + 0.5 * (i % 9) / 8;
+            double v = eval_ast_xy(ast, x, y);
+            if (isnan(v)) {
+                nan_defined += !iv.undef && !interval_empty(iv);
+                continue;
+            }
+            outside += !inside(v, iv);
+            wrongly_culled += cull && v >= -2.0 && v <= 2.0;
+        }
+    }
+    CHECK(!outside, "%s: %d samples outside their interval", text, outside);
+    CHECK(!nan_defined, "%s: %d NaN samples in boxes said to be defined", text, nan_defined);
+    CHECK(!wrongly_culled, "%s: %d samples in view in culled boxes", text, wrongly_culled);
+
+    // One interval per box against evaluating the samples it stands for
+    Boxes boxes = { ast, bc, x0, x1, yb };
+    double best_iv   = bench_best(run_intervals, &boxes, RUNS) / BOXES;
+    double best_eval = bench_best(run_samples, &boxes, RUNS) / (BOXES / 16);
+    printf("  %-26s %8.0f %10.0f %8.1fx %7.1f%%\n", text, best_iv * 1e9, best_eval * 1e9,
+           best_eval / best_iv, 100.0 * culled / BOXES);
+}
+
+int main(void) {
+    Arena arena = arena_create(1 << 16);
+    printf("interval: %d random boxes, ns per box; culled against y in [-2, 2]\n", BOXES);
+    printf("  %-26s %8s %10s %9s %8s\n", "expression", "interval", "256 evals", "ratio",
+           "culled");
+    for (size_t i = 0; i < sizeof(EXPRS) / sizeof(EXPRS[0]); i++) bench_expr(EXPRS[i], &arena);
+    arena_destroy(&arena);
+    return bench_done();
+}
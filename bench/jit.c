@@ -0,0 +1,207 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// Native code against the DAG interpreter it stands in for: for every
+// subset of a set of roots, jit_eval_batch must give dag_eval_batch's
+// results bit for bit, infinities and powi included, and NaN in the same
+// places, with and without ys and over lengths that are not a multiple of
+// the lane count. Also checks that dag_compile gives up on a tree with
+// more nodes than its tables hold, or in z.
+#include "bench.h"
+#include "modules/cas/jit.h"
+#include "modules/cas/simplify.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POINTS 1003
+#define RUNS   5
+
+static const char *const ROOTS[] = {
+    "x^3-2x+1",
+    "(x^2+1)/(x-1)-3/(x+2)+x^-3",
+    "sqrt(x)+ln(x)*y",
+    "sin(x)^2+sin(x)*cos(x)+sin(x)",
+    "x%y+asin(x/8)",
+    "(x+y)^7-exp(x)*y^5",
+    "x^2.5+1/x",
+};
+#define ROOT_COUNT (int)(sizeof(ROOTS) / sizeof(ROOTS[0]))
+
+// Mixed into the random inputs every few points
+static const double SPECIAL[] = { 0.0, -0.0, 1.0, -1.0, NAN, INFINITY, -INFINITY, 1e-310, 1e300, -1e300 };
+#define SPECIAL_COUNT (int)(sizeof(SPECIAL) / sizeof(SPECIAL[0]))
+
+static double xs[POINTS], ys[POINTS];
+static double jit_out[ROOT_COUNT][POINTS], dag_out[ROOT_COUNT][POINTS];
+
+static unsigned rs = 1;
+
+static double uniform(double lo, double hi) {
+    rs = rs * 1103515245u + 12345u;
+    return lo + (hi - lo) * (double)(rs >> 8) / (1 << 24);
+}
+
+// Points of the first n outputs of the roots in mask whose bits differ.
+// Where two NaNs meet, IEEE leaves open which one's sign and payload the
+// result keeps, and the kernels' compiler may swap operands, so a NaN
+// need only be matched by a NaN.
+static int differ(unsigned mask, size_t n) {
+    int bad = 0;
+    for (int r = 0; r < ROOT_COUNT; r++) {
+        if (!(mask & (1u << r))) continue;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t a, b;
+            memcpy(&a, &jit_out[r][i], sizeof(a));
+            memcpy(&b, &dag_out[r][i], sizeof(b));
+            if (isnan(jit_out[r][i]) || isnan(dag_out[r][i]))
+                bad += isnan(jit_out[r][i]) != isnan(dag_out[r][i]);
+            else
+                bad += a != b;
+        }
+    }
+    return bad;
+}
+
+// (x+x) nested levels deep, balanced: 2^(levels+1) - 1 nodes, none
+// interned, but only levels + 1 distinct instructions
+static char *put_balanced(char *p, int levels) {
+    if (levels == 0) {
+        *p++ = 'x';
+        return p;
+    }
+    *p++ = '(';
+    p = put_balanced(p, levels - 1);
+    *p++ = '+';
+    p = put_balanced(p, levels - 1);
+    *p++ = ')';
+    return p;
+}
+
+static void check_big_tree(int levels, bool fits, Arena *arena) {
+    char *text = malloc((size_t)4 << levels);
+    *put_balanced(text, levels) = '\0';
+    Parser p;
+    parser_init(&p, text, arena);
+    ASTNode *root = parser_parse(&p);
+    DagProgram *prog = dag_compile(&root, 1, arena);
+    CHECK(!p.has_error && !prog == !fits, "%d levels of x+x: %s", levels,
+          prog ? "compiled past the node tables" : "did not compile");
+    if (prog) {
+        double x = 1.5, out, *outs[1] = { &out };
+        dag_eval_batch(prog, 1, &x, NULL, outs, 1);
+        CHECK(out == ldexp(x, levels), "%d levels of x+x: %g, not %g", levels, out, ldexp(x, levels));
+    }
+    printf("jit: %d nodes of x+x %s\n", (2 << levels) - 1, prog ? "compiled" : "refused");
+    free(text);
+}
+
+// z is no variable of a program, nor of the dual numbers: a root in z
+// must not compile, and its derivatives are NaN, not those in x
+static void check_z(Arena *arena) {
+    Parser p;
+    parser_init(&p, "x+y*z", arena);
+    p.allow_z = true;
+    ASTNode *root = parser_parse(&p);
+    DagProgram *prog = dag_compile(&root, 1, arena);
+    EvalDual d = eval_ast_dual(root, 1.0, 2.0);
+    CHECK(!p.has_error && !prog, "x+y*z compiled to a program");
+    CHECK(isnan(d.v) && isnan(d.dx) && isnan(d.dy), "x+y*z: dual numbers %g %g %g", d.v, d.dx, d.dy);
+    printf("jit: a root in z %s\n", prog ? "compiled" : "refused");
+}
+
+typedef struct {
+    const DagProgram *p;
+    JitCode          *jc;
+    unsigned          mask;
+} Run;
+
+static void run_dag(void *ctx) {
+    const Run *r = ctx;
+    double *outs[ROOT_COUNT];
+    for (int k = 0; k < ROOT_COUNT; k++) outs[k] = dag_out[k];
+    dag_eval_batch(r->p, r->mask, xs, ys, outs, POINTS);
+    bench_sink += dag_out[0][POINTS / 2];
+}
+
+static void run_jit(void *ctx) {
+    const Run *r = ctx;
+    double *outs[ROOT_COUNT];
+    for (int k = 0; k < ROOT_COUNT; k++) outs[k] = jit_out[k];
+    jit_eval_batch(r->jc, xs, ys, outs, POINTS);
+    bench_sink += jit_out[0][POINTS / 2];
+}
+
+int main(void) {
+    for (int i = 0; i < POINTS; i++) {
+        xs[i] = i % 7 == 3 ? SPECIAL[i / 7 % SPECIAL_COUNT] : uniform(-12.0, 12.0);
+        ys[i] = i % 5 == 1 ? SPECIAL[i / 5 % SPECIAL_COUNT] : uniform(-3.0, 3.0);
+    }
+    Arena arena = arena_create(1 << 20);
+    check_big_tree(11, true, &arena);
+    check_big_tree(13, false, &arena);
+    check_z(&arena);
+    arena_reset(&arena);
+    if (!jit_available()) {
+        printf("jit: no native code on this platform, nothing to check\n");
+        arena_destroy(&arena);
+        return bench_done();
+    }
+
+    static DagTable table;
+    dag_reset(&table);
+    ASTNode *roots[ROOT_COUNT];
+    for (int r = 0; r < ROOT_COUNT; r++) {
+        Parser p;
+        parser_init(&p, ROOTS[r], &arena);
+        roots[r] = dag_intern(&table, simplify_ast(parser_parse(&p)));
+        CHECK(!p.has_error && roots[r], "%s did not parse", ROOTS[r]);
+    }
+    DagProgram *prog = dag_compile(roots, ROOT_COUNT, &arena);
+    CHECK(prog, "the roots did not compile to one program");
+    if (!prog) return bench_done();
+
+    // Every subset, over every length up to a few lanes and the whole set
+    int failed = 0, bad_masks = 0;
+    unsigned all = (1u << ROOT_COUNT) - 1;
+    for (unsigned mask = 1; mask <= all; mask++) {
+        JitCode *jc = jit_compile(prog, mask);
+        if (!jc) {
+            failed++;
+            continue;
+        }
+        double *jo[ROOT_COUNT], *dout[ROOT_COUNT];
+        for (int k = 0; k < ROOT_COUNT; k++) {
+            jo[k]   = mask & (1u << k) ? jit_out[k] : NULL;
+            dout[k] = mask & (1u << k) ? dag_out[k] : NULL;
+        }
+        int bad = 0;
+        for (size_t n = 1; n <= POINTS; n = n < 70 ? n + 1 : n * 2 + 1) {
+            if (n > POINTS) n = POINTS;
+            for (int with_y = 0; with_y < 2; with_y++) {
+                jit_eval_batch(jc, xs, with_y ? ys : NULL, jo, n);
+                dag_eval_batch(prog, mask, xs, with_y ? ys : NULL, dout, n);
+                bad += differ(mask, n);
+            }
+            if (n == POINTS) break;
+        }
+        bad_masks += bad > 0;
+        CHECK(!bad, "mask %#x: %d values differ from the interpreter", mask, bad);
+        jit_free(jc);
+    }
+    CHECK(!failed, "%d of %u masks did not compile", failed, all);
+    printf("jit: %u root masks over %d points, %d with differences\n", all, POINTS, bad_masks);
+
+    // Each root alone, and all of them, in ns per point
+    printf("  %-32s %7s %7s\n", "roots", "dag", "jit");
+    for (int r = 0; r <= ROOT_COUNT; r++) {
+        unsigned mask = r < ROOT_COUNT ? 1u << r : all;
+        Run run = { prog, jit_compile(prog, mask), mask };
+        if (!run.jc) continue;
+        double dag = bench_best(run_dag, &run, RUNS) * 1e9 / POINTS;
+        double jit = bench_best(run_jit, &run, RUNS) * 1e9 / POINTS;
+        printf("  %-32s %7.1f %7.1f\n", r < ROOT_COUNT ? ROOTS[r] : "all of them", dag, jit);
+        jit_free(run.jc);
+    }
+
+    arena_destroy(&arena);
+    return bench_done();
+}
@@ -0,0 +1,169 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// Building LOD surface chunks: the normals from the compiled gradient,
+// a row at a time, against the dual-number tree walk per vertex they
+// replaced, which they must match, and the build as it was with that;
+// and refining cold trees frame by frame, where frames that build must
+// stay near LOD_BUDGET however many chunks are due. One slow frame is
+// as likely the machine as the plotter, so it is the mean that is held. Builds plotter3d.c whole, on the raylib stand-in.
+#include "bench.h"
+#include "modules/cas/plotter3d.c"
+#include "modules/cas/derive.h"
+#include "modules/cas/simplify.h"
+
+#define RUNS      20
+#define FRAMES    2000
+#define FRAME_MAX (1.5 * LOD_BUDGET) // s a frame that builds, mean
+#define LEVEL     5                  // of the chunks timed alone
+
+static const char *const SURFACES[] = {
+    "3sin(x)cos(y)",
+    "sqrt(16-x^2-y^2)",
+    "exp(-(x^2+y^2)/4)*cos(3x)",
+    "x^2/4-y^3/20+ln(x^2+y^2+1)",
+};
+#define SURFACE_COUNT (int)(sizeof(SURFACES) / sizeof(SURFACES[0]))
+
+static Plot3DState ps;
+
+// Normals of chunk n as build_chunk made them before, by eval_ast_dual
+static float normals_dual(const ASTNode *ast, const SurfaceNode *n, float *out) {
+    const int side = SURF_CHUNK + 1;
+    float sum = 0.0f;
+    for (int j = 0; j < side; j++) {
+        for (int i = 0; i < side; i++) {
+            double x = chunk_coord(ps.range, n->level, n->ix, 2 * i);
+            double z = chunk_coord(ps.range, n->level, n->iz, 2 * j);
+            EvalDual d = eval_ast_dual(ast, x, z);
+            Vector3 nv = { 0.0f, 1.0f, 0.0f };
+            if (isfinite(d.dx) && isfinite(d.dy)) {
+                double len = sqrt(d.dx * d.dx + 1.0 + d.dy * d.dy);
+                nv = (Vector3){ (float)(-d.dx / len), (float)(1.0 / len), (float)(-d.dy / len) };
+            }
+            if (out) memcpy(&out[3 * (j * side + i)], &nv, sizeof(nv));
+            sum += nv.y;
+        }
+    }
+    return sum;
+}
+
+typedef struct {
+    int          si;
+    SurfaceNode *n;
+} Chunk;
+
+static void run_dual(void *ctx) {
+    const Chunk *c = ctx;
+    bench_sink += normals_dual(ps.surfs[c->si].ast, c->n, NULL);
+}
+
+// What build_chunk spends on the normals now: the gradient, row by row
+static void run_grad(void *ctx) {
+    const Chunk *c = ctx;
+    Bytecode *const *grad = ps.surfs[c->si].grad_code;
+    double xs[SURF_CHUNK + 1], zs[SURF_CHUNK + 1], fx[SURF_CHUNK + 1], fz[SURF_CHUNK + 1];
+    for (int i = 0; i <= SURF_CHUNK; i++) xs[i] = chunk_coord(ps.range, c->n->level, c->n->ix, 2 * i);
+    for (int j = 0; j <= SURF_CHUNK; j++) {
+        for (int i = 0; i <= SURF_CHUNK; i++) zs[i] = chunk_coord(ps.range, c->n->level, c->n->iz, 2 * j);
+        bytecode_eval_batch(grad[0], xs, zs, fx, SURF_CHUNK + 1);
+        bytecode_eval_batch(grad[1], xs, zs, fz, SURF_CHUNK + 1);
+        bench_sink += fx[0] + fz[0];
+    }
+}
+
+static void run_build(void *ctx) {
+    const Chunk *c = ctx;
+    LodBuild b = { c->si, ps.surfs[c->si].mesh.tree, c->n };
+    node_unload(c->n);
+    build_chunk(&(LodJob){ &ps, &b }, 0, 0);
+    bench_sink += c->n->error;
+}
+
+int main(void) {
+    workpool_init(0);
+    plotter3d_init(&ps);
+    Arena arena = arena_create(1 << 20);
+    for (int i = 0; i < SURFACE_COUNT; i++) {
+        FuncSlot *s = &ps.surfs[i];
+        s->arena = arena_create(1 << 16);
+        s->gen   = 1;
+        Parser p;
+        parser_init(&p, SURFACES[i], &s->arena);
+        s->ast  = simplify_ast(parser_parse(&p));
+        s->code = bytecode_compile(s->ast, &s->arena);
+        for (int k = 0; k < 2; k++)
+            s->grad_code[k] = bytecode_compile(derive_ast(s->ast, k ? 'y' : 'x', &s->arena), &s->arena);
+        s->valid = s->visible = !p.has_error && s->code && s->grad_code[0] && s->grad_code[1];
+        CHECK(s->valid, "%s did not compile", SURFACES[i]);
+        ps.surf_count++;
+    }
+    update_camera_from_orbit(&ps);
+
+    // One chunk of each surface alone, off-centre at LEVEL
+    const int side = SURF_CHUNK + 1;
+    static float dual[3 * (SURF_CHUNK + 1) * (SURF_CHUNK + 1)];
+    printf("lod: one chunk of %d^2 cells at level %d, us\n", SURF_CHUNK, LEVEL);
+    printf("  %-28s %8s %8s %8s %8s %6s\n", "surface", "dual", "gradient", "build", "was", "wrong");
+    for (int si = 0; si < SURFACE_COUNT; si++) {
+        SurfaceNode n = { .parent = -1, .child = -1, .level = LEVEL, .ix = 11, .iz = 19 };
+        Chunk c = { si, &n };
+        run_build(&c);
+        normals_dual(ps.surfs[si].ast, &n, dual);
+        int wrong = 0;
+        for (int v = 0; n.mesh.vertexCount && v < side * side; v++) {
+            if (isnan(n.heights[v])) continue;
+            for (int k = 0; k < 3; k++) wrong += fabsf(n.mesh.normals[3 * v + k] - dual[3 * v + k]) > 1e-5f;
+        }
+        CHECK(n.mesh.vertexCount && !wrong, "%s: %d normal components differ from the dual numbers",
+              SURFACES[si], wrong);
+        double dual_s = bench_best(run_dual, &c, RUNS);
+        double grad_s = bench_best(run_grad, &c, RUNS);
+        double build  = bench_best(run_build, &c, RUNS);
+        printf("  %-28s %8.1f %8.1f %8.1f %8.1f %6d\n", SURFACES[si], dual_s * 1e6, grad_s * 1e6,
+               build * 1e6, (build - grad_s + dual_s) * 1e6, wrong);
+        node_unload(&n);
+    }
+
+    // Every surface from cold, close up so the trees go deep
+    ps.camera.target = (Vector3){ 1.0f, 0.0f, 1.0f };
+    ps.orbit_dist    = 2.0f;
+    ps.orbit_pitch   = 0.3f;
+    ps.orbit_angle   = 0.2f;
+    update_camera_from_orbit(&ps);
+    int built = 0, frames = 0, same = 0, building = 0;
+    double slowest = 0.0, total = 0.0, busiest = 0.0;
+    for (; frames < FRAMES && same < 3; frames++) {
+        double t0 = bench_now();
+        plotter3d_draw(&ps, (Rectangle){ 0, 0, 1920, 1080 }, &arena);
+        double dt = bench_now() - t0;
+        int now = 0;
+        for (int s = 0; s < ps.surf_count; s++) {
+            const SurfaceTree *t = ps.surfs[s].mesh.tree;
+            for (int i = 0; t && i < LOD_MAX_NODES; i++) now += t->node[i].built;
+        }
+        if (now > built) {
+            building++;
+            total += dt;
+        }
+        if (now > built && dt > slowest) {
+            slowest = dt;
+            busiest = now - built;
+        }
+        same  = now == built ? same + 1 : 0;
+        built = now;
+    }
+    CHECK(same >= 3, "still refining after %d frames", frames);
+    double mean = building ? total / building : 0.0;
+    CHECK(mean < FRAME_MAX, "frames that build take %.2f ms, over %.2f", mean * 1e3, FRAME_MAX * 1e3);
+    printf("lod: %d chunks refined in %d frames, %.2f ms a frame, %.2f ms the slowest (%.0f chunks);"
+           " %d chunks a frame would take %.2f ms\n",
+           built, building, mean * 1e3, slowest * 1e3, busiest, LOD_BUILDS,
+           LOD_BUILDS * ps.chunk_time / workpool_workers() * 1e3);
+
+    for (int i = 0; i < ps.surf_count; i++) {
+        plotter3d_release(&ps.surfs[i]);
+        arena_destroy(&ps.surfs[i].arena);
+    }
+    arena_destroy(&arena);
+    workpool_shutdown();
+    return bench_done();
+}
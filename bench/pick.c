@@ -0,0 +1,162 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// Hover picking on refined LOD surfaces: random rays through a 1920x1080
+// view, picked against the drawn chunks through the height pyramids, and
+// some also by brute force over every drawn triangle, which must agree. A
+// pick must stay well under a millisecond once the surfaces are refined
+// past a 1024^2 grid. Builds plotter3d.c whole, on the raylib stand-in.
+#include "bench.h"
+#include "modules/cas/plotter3d.c"
+#include "modules/cas/simplify.h"
+
+#define RAYS      20000
+#define CHECKED   200    // of them against brute force, which is slow
+#define RUNS      100    // re-runs of the slowest ray
+#define PICK_MAX  1e-4   // s, mean
+#define WORST_MAX 1e-3   // s, slowest ray
+
+static const char *const SURFACES[] = { "3sin(x)cos(y)", "sqrt(16-x^2-y^2)" };
+#define SURFACE_COUNT (int)(sizeof(SURFACES) / sizeof(SURFACES[0]))
+
+static const struct {
+    float       x, z, dist, pitch, angle;
+    const char *tag;
+} VIEWS[] = {
+    { 0.0f, 0.0f, 12.0f, 0.5f, 0.6f, "default" },
+    { 1.0f, 1.0f, 2.0f, 0.3f, 0.2f, "close" },
+    { 0.0f, 0.0f, 0.4f, 0.15f, 1.0f, "very close" },
+};
+
+static Plot3DState ps;
+
+// Draw until the trees stop changing; the finest level drawn
+static int refine(Arena *arena) {
+    int built = -1, same = 0, finest = 0;
+    for (int f = 0; f < 1000 && same < 3; f++) {
+        plotter3d_draw(&ps, (Rectangle){ 0, 0, 1920, 1080 }, arena);
+        int now = 0;
+        finest  = 0;
+        for (int s = 0; s < ps.surf_count; s++) {
+            const SurfaceTree *t = ps.surfs[s].mesh.tree;
+            for (int i = 0; t && i < LOD_MAX_NODES; i++) {
+                now += t->node[i].built;
+                if (t->node[i].drawn == ps.frame && t->node[i].level > finest) finest = t->node[i].level;
+            }
+        }
+        same  = now == built ? same + 1 : 0;
+        built = now;
+    }
+    return finest;
+}
+
+// The nearest hit over every triangle of every chunk drawn
+static Pick brute_force(Ray ray) {
+    Pick pk = { ray.position, ray.direction, INFINITY, -1, -1 };
+    const int side = SURF_CHUNK + 1;
+    for (int s = 0; s < ps.surf_count; s++) {
+        const SurfaceTree *t = ps.surfs[s].mesh.tree;
+        pk.si = s;
+        for (int i = 0; i < LOD_MAX_NODES; i++) {
+            const SurfaceNode *n = &t->node[i];
+            if (n->drawn != ps.frame || !n->heights) continue;
+            for (int j = 0; j < SURF_CHUNK; j++)
+                for (int k = 0; k < SURF_CHUNK; k++) {
+                    const float *r0 = &n->heights[j * side + k], *r1 = r0 + side;
+                    if (isnan(r0[0]) || isnan(r0[1]) || isnan(r1[0]) || isnan(r1[1])) continue;
+                    float x0 = (float)chunk_coord(ps.range, n->level, n->ix, 2 * k);
+                    float x1 = (float)chunk_coord(ps.range, n->level, n->ix, 2 * k + 2);
+                    float z0 = (float)chunk_coord(ps.range, n->level, n->iz, 2 * j);
+                    float z1 = (float)chunk_coord(ps.range, n->level, n->iz, 2 * j + 2);
+                    Vector3 v00 = { x0, r0[0], z0 }, v10 = { x1, r0[1], z0 };
+                    Vector3 v01 = { x0, r1[0], z1 }, v11 = { x1, r1[1], z1 };
+                    pick_triangle(&pk, v00, v10, v01);
+                    pick_triangle(&pk, v10, v11, v01);
+                }
+        }
+    }
+    return pk;
+}
+
+static Ray worst_ray;
+
+static void run_worst(void *ctx) {
+    (void)ctx;
+    pick_surfaces(&ps, worst_ray);
+}
+
+int main(void) {
+    workpool_init(0);
+    plotter3d_init(&ps);
+    Arena arena = arena_create(1 << 20);
+    for (int i = 0; i < SURFACE_COUNT; i++) {
+        FuncSlot *s = &ps.surfs[i];
+        s->arena = arena_create(8192);
+        s->gen   = 1;
+        Parser p;
+        parser_init(&p, SURFACES[i], &s->arena);
+        s->ast   = simplify_ast(parser_parse(&p));
+        s->code  = bytecode_compile(s->ast, &s->arena);
+        s->valid = s->visible = !p.has_error && s->code;
+        CHECK(s->valid, "%s did not compile", SURFACES[i]);
+        ps.surf_count++;
+    }
+
+    printf("pick: %d random rays a view over %d surfaces\n", RAYS, SURFACE_COUNT);
+    printf("  %-10s %6s %9s %6s %8s %8s %10s\n", "view", "level", "grid", "hits", "wrong", "mean us",
+           "worst us");
+    unsigned rs = 1;
+    for (size_t v = 0; v < sizeof(VIEWS) / sizeof(VIEWS[0]); v++) {
+        ps.camera.target = (Vector3){ VIEWS[v].x, 0.0f, VIEWS[v].z };
+        ps.orbit_dist    = VIEWS[v].dist;
+        ps.orbit_pitch   = VIEWS[v].pitch;
+        ps.orbit_angle   = VIEWS[v].angle;
+        update_camera_from_orbit(&ps);
+        int finest = refine(&arena);
+        int grid   = SURF_CHUNK << finest; // cells a side of a uniform grid this fine
+
+        double total = 0.0, slowest = 0.0;
+        int hits = 0, wrong = 0;
+        for (int q = 0; q < RAYS; q++) {
+            rs = rs * 1103515245u + 12345u;
+            float mx = (float)((rs >> 8) % 1920);
+            rs = rs * 1103515245u + 12345u;
+            float my = (float)((rs >> 8) % 1080);
+            Ray ray = GetMouseRay((Vector2){ mx, my }, ps.camera);
+            ps.hover = -1;
+            double t0 = bench_now();
+            pick_surfaces(&ps, ray);
+            double dt = bench_now() - t0;
+            total += dt;
+            if (dt > slowest) {
+                slowest   = dt;
+                worst_ray = ray;
+            }
+            hits += ps.hover >= 0;
+            if (q % (RAYS / CHECKED)) continue;
+            Pick ref = brute_force(ray);
+            if (ref.hit != ps.hover) {
+                wrong++;
+            } else if (ref.hit >= 0) {
+                Vector3 at = Vector3Add(ray.position, Vector3Scale(ray.direction, ref.t));
+                wrong += fabsf(at.x - ps.hover_at.x) > 1e-3f || fabsf(at.z - ps.hover_at.y) > 1e-3f;
+            }
+        }
+        // One timing of the slowest ray is as noisy as it is slow; time it
+        // again as a best of many
+        double worst = bench_best(run_worst, NULL, RUNS);
+        double mean  = total / RAYS;
+        CHECK(grid >= 1024, "%s: refined to %d^2 only", VIEWS[v].tag, grid);
+        CHECK(!wrong, "%s: %d of %d picks disagree with brute force", VIEWS[v].tag, wrong, CHECKED);
+        CHECK(mean < PICK_MAX, "%s: a pick takes %.1f us", VIEWS[v].tag, mean * 1e6);
+        CHECK(worst < WORST_MAX, "%s: the slowest ray takes %.1f us", VIEWS[v].tag, worst * 1e6);
+        printf("  %-10s %6d %8d^2 %6d %8d %8.2f %10.1f\n", VIEWS[v].tag, finest, grid, hits, wrong,
+               mean * 1e6, worst * 1e6);
+    }
+
+    for (int i = 0; i < ps.surf_count; i++) {
+        plotter3d_release(&ps.surfs[i]);
+        arena_destroy(&ps.surfs[i].arena);
+    }
+    arena_destroy(&arena);
+    workpool_shutdown();
+    return bench_done();
+}
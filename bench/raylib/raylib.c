@@ -0,0 +1,178 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// The raylib calls plotter3d.c makes, for the benches: input is idle,
+// drawing does nothing, and meshes are kept in memory, not uploaded. The
+// app's own drawing helpers it calls are stubbed out at the end.
+#include "raylib.h"
+#include "raymath.h"
+#include "rlgl.h"
+#include "modules/cas/plotter.h"
+#include "ui/ui.h"
+#include "ui/theme.h"
+#include "ui/arrows.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SCREEN_W 1920
+#define SCREEN_H 1080
+
+Font g_font;
+
+int     GetScreenWidth(void) { return SCREEN_W; }
+int     GetScreenHeight(void) { return SCREEN_H; }
+bool    IsKeyPressed(int key) { (void)key; return false; }
+bool    IsKeyDown(int key) { (void)key; return false; }
+bool    IsMouseButtonPressed(int button) { (void)button; return false; }
+bool    IsMouseButtonDown(int button) { (void)button; return false; }
+Vector2 GetMousePosition(void) { return (Vector2){ 0.0f, 0.0f }; }
+float   GetMouseWheelMove(void) { return 0.0f; }
+
+// The ray through a point of a perspective camera's screen, as raylib's
+Ray GetMouseRay(Vector2 mouse, Camera camera) {
+    Vector3 f = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+    Vector3 r = Vector3Normalize(Vector3CrossProduct(f, camera.up));
+    Vector3 u = Vector3CrossProduct(r, f);
+    float tv = tanf(camera.fovy * DEG2RAD * 0.5f), th = tv * SCREEN_W / SCREEN_H;
+    float x = (2.0f * mouse.x / SCREEN_W - 1.0f) * th, y = (1.0f - 2.0f * mouse.y / SCREEN_H) * tv;
+    Vector3 d = Vector3Add(f, Vector3Add(Vector3Scale(r, x), Vector3Scale(u, y)));
+    return (Ray){ camera.position, Vector3Normalize(d) };
+}
+
+Vector2 GetWorldToScreen(Vector3 position, Camera camera) {
+    (void)position;
+    (void)camera;
+    return (Vector2){ 0.0f, 0.0f };
+}
+
+// Seconds on a monotonic clock; raylib counts from InitWindow
+double GetTime(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+void BeginMode3D(Camera3D camera) { (void)camera; }
+void EndMode3D(void) {}
+void EndScissorMode(void) {}
+void DrawRectangleRec(Rectangle rec, Color color) { (void)rec; (void)color; }
+void DrawRectangleRounded(Rectangle rec, float roundness, int segments, Color color) {
+    (void)rec;
+    (void)roundness;
+    (void)segments;
+    (void)color;
+}
+void DrawLine3D(Vector3 start, Vector3 end, Color color) { (void)start; (void)end; (void)color; }
+void DrawSphere(Vector3 center, float radius, Color color) { (void)center; (void)radius; (void)color; }
+void DrawCylinderEx(Vector3 start, Vector3 end, float start_radius, float end_radius, int sides,
+                    Color color) {
+    (void)start;
+    (void)end;
+    (void)start_radius;
+    (void)end_radius;
+    (void)sides;
+    (void)color;
+}
+
+bool CheckCollisionPointRec(Vector2 point, Rectangle rec) {
+    return point.x >= rec.x && point.x < rec.x + rec.width && point.y >= rec.y &&
+           point.y < rec.y + rec.height;
+}
+
+void UploadMesh(Mesh *mesh, bool dynamic) {
+    (void)dynamic;
+    mesh->vaoId = 1;
+}
+
+void UnloadMesh(Mesh mesh) {
+    MemFree(mesh.vertices);
+    MemFree(mesh.normals);
+    MemFree(mesh.colors);
+    MemFree(mesh.indices);
+}
+
+void DrawMesh(Mesh mesh, Material material, Matrix transform) {
+    (void)mesh;
+    (void)material;
+    (void)transform;
+}
+
+Material LoadMaterialDefault(void) {
+    static MaterialMap maps[1];
+    return (Material){ .maps = maps };
+}
+
+void *MemAlloc(unsigned int size) { return calloc(1, size); }
+void  MemFree(void *ptr) { free(ptr); }
+
+Vector3 Vector3Add(Vector3 a, Vector3 b) { return (Vector3){ a.x + b.x, a.y + b.y, a.z + b.z }; }
+Vector3 Vector3Subtract(Vector3 a, Vector3 b) { return (Vector3){ a.x - b.x, a.y - b.y, a.z - b.z }; }
+Vector3 Vector3Scale(Vector3 v, float s) { return (Vector3){ v.x * s, v.y * s, v.z * s }; }
+float   Vector3DotProduct(Vector3 a, Vector3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+Vector3 Vector3CrossProduct(Vector3 a, Vector3 b) {
+    return (Vector3){ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+Vector3 Vector3Normalize(Vector3 v) {
+    float len = sqrtf(Vector3DotProduct(v, v));
+    return len > 0.0f ? Vector3Scale(v, 1.0f / len) : v;
+}
+
+Matrix MatrixIdentity(void) {
+    return (Matrix){ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+}
+
+float Clamp(float value, float min, float max) {
+    return value < min ? min : value > max ? max : value;
+}
+
+void rlBegin(int mode) { (void)mode; }
+void rlEnd(void) {}
+void rlVertex3f(float x, float y, float z) { (void)x; (void)y; (void)z; }
+void rlColor4ub(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    (void)r;
+    (void)g;
+    (void)b;
+    (void)a;
+}
+void rlDisableBackfaceCulling(void) {}
+void rlEnableBackfaceCulling(void) {}
+
+// The app's drawing helpers and 2D plotter hooks plotter3d.c calls
+Vector2 ui_mouse(void) { return (Vector2){ 0.0f, 0.0f }; }
+Vector2 ui_from_screen(Vector2 screen_pos) { return screen_pos; }
+void    ui_scissor_begin(float x, float y, float w, float h) { (void)x; (void)y; (void)w; (void)h; }
+void    ui_draw_text(const char *text, int x, int y, int size, Color color) {
+    (void)text;
+    (void)x;
+    (void)y;
+    (void)size;
+    (void)color;
+}
+int ui_measure_text(const char *text, int size) {
+    (void)text;
+    return size;
+}
+
+Matrix ui_arrow_place(Vector3 at, Vector3 dir, float length, float mag) {
+    (void)at;
+    (void)dir;
+    (void)length;
+    (void)mag;
+    return MatrixIdentity();
+}
+void ui_arrows_draw_3d(const Matrix *arrows, int count, Color color) {
+    (void)arrows;
+    (void)count;
+    (void)color;
+}
+
+bool plotter_field_fresh(FuncSlot *slot, const double view[FIELD_VIEW]) {
+    (void)slot;
+    (void)view;
+    return false;
+}
+void plotter_field_keep_lines(FieldCache *fc, const FieldLines *fl) {
+    (void)fc;
+    (void)fl;
+}
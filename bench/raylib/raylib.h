@@ -0,0 +1,73 @@
+#ifndef RAYLIB_H
+#define RAYLIB_H
+
+// Just enough of raylib's API for the benches to build the 3D plotter
+// without it: its types, and the calls plotter3d.c makes, defined in
+// raylib.c. Nothing is drawn; meshes stay in memory.
+
+#include <stdbool.h>
+
+typedef struct Vector2 { float x, y; } Vector2;
+typedef struct Vector3 { float x, y, z; } Vector3;
+typedef struct Matrix {
+    float m0, m4, m8, m12, m1, m5, m9, m13, m2, m6, m10, m14, m3, m7, m11, m15;
+} Matrix;
+typedef struct Color { unsigned char r, g, b, a; } Color;
+typedef struct Rectangle { float x, y, width, height; } Rectangle;
+typedef struct Texture { unsigned int id; int width, height, mipmaps, format; } Texture;
+typedef Texture Texture2D;
+typedef struct Font { int baseSize; Texture2D texture; } Font;
+typedef struct Camera3D { Vector3 position, target, up; float fovy; int projection; } Camera3D;
+typedef Camera3D Camera;
+typedef struct Ray { Vector3 position, direction; } Ray;
+typedef struct Mesh {
+    int            vertexCount, triangleCount;
+    float         *vertices, *normals;
+    unsigned char *colors;
+    unsigned short *indices;
+    unsigned int   vaoId;
+} Mesh;
+typedef struct Shader { unsigned int id; int *locs; } Shader;
+typedef struct MaterialMap { Texture2D texture; Color color; float value; } MaterialMap;
+typedef struct Material { Shader shader; MaterialMap *maps; float params[4]; } Material;
+
+#define WHITE   (Color){ 255, 255, 255, 255 }
+#define DEG2RAD (3.14159265358979323846f / 180.0f)
+#define PI      3.14159265358979323846f
+
+enum { MOUSE_BUTTON_LEFT = 0, MOUSE_BUTTON_RIGHT = 1 };
+enum { KEY_HOME = 268, KEY_LEFT_SHIFT = 340, KEY_RIGHT_SHIFT = 344 };
+enum { CAMERA_PERSPECTIVE = 0 };
+enum { MATERIAL_MAP_DIFFUSE = 0 };
+
+int     GetScreenWidth(void);
+int     GetScreenHeight(void);
+bool    IsKeyPressed(int key);
+bool    IsKeyDown(int key);
+bool    IsMouseButtonPressed(int button);
+bool    IsMouseButtonDown(int button);
+Vector2 GetMousePosition(void);
+float   GetMouseWheelMove(void);
+Ray     GetMouseRay(Vector2 mouse, Camera camera);
+Vector2 GetWorldToScreen(Vector3 position, Camera camera);
+double  GetTime(void);
+
+void BeginMode3D(Camera3D camera);
+void EndMode3D(void);
+void EndScissorMode(void);
+void DrawRectangleRec(Rectangle rec, Color color);
+void DrawRectangleRounded(Rectangle rec, float roundness, int segments, Color color);
+void DrawLine3D(Vector3 start, Vector3 end, Color color);
+void DrawSphere(Vector3 center, float radius, Color color);
+void DrawCylinderEx(Vector3 start, Vector3 end, float start_radius, float end_radius, int sides,
+                    Color color);
+bool CheckCollisionPointRec(Vector2 point, Rectangle rec);
+
+void     UploadMesh(Mesh *mesh, bool dynamic);
+void     UnloadMesh(Mesh mesh);
+void     DrawMesh(Mesh mesh, Material material, Matrix transform);
+Material LoadMaterialDefault(void);
+void    *MemAlloc(unsigned int size);
+void     MemFree(void *ptr);
+
+#endif
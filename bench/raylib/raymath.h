@@ -0,0 +1,15 @@
+#ifndef RAYMATH_H
+#define RAYMATH_H
+
+#include "raylib.h"
+
+Vector3 Vector3Add(Vector3 a, Vector3 b);
+Vector3 Vector3Subtract(Vector3 a, Vector3 b);
+Vector3 Vector3Scale(Vector3 v, float s);
+Vector3 Vector3Normalize(Vector3 v);
+Vector3 Vector3CrossProduct(Vector3 a, Vector3 b);
+float   Vector3DotProduct(Vector3 a, Vector3 b);
+Matrix  MatrixIdentity(void);
+float   Clamp(float value, float min, float max);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef RLGL_H
+#define RLGL_H
+
+#define RL_LINES 0x0001
+
+void rlBegin(int mode);
+void rlEnd(void);
+void rlVertex3f(float x, float y, float z);
+void rlColor4ub(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+void rlDisableBackfaceCulling(void);
+void rlEnableBackfaceCulling(void);
+
+#endif
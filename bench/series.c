@@ -0,0 +1,135 @@
+#define _DEFAULT_SOURCE // clock_gettime and mkstemp under -std=c11
+// M4 decimation of a mapped series: pyramid build, views of the whole
+// series down to a few columns, against a full scan of every column.
+#include "bench.h"
+#include "modules/cas/series.h"
+#include "utils/workpool.h"
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SAMPLES (8LL << 20)
+#define RUNS    5
+
+static SeriesPoint points[4 * SERIES_MAX_COLUMNS + 2];
+
+// Random walk with a few runs of NaN, written as raw float64 to a scratch
+// file; NULL if it could not be written
+static const char *write_samples(char *path) {
+    int fd = mkstemp(path);
+    FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!f) return NULL;
+    static double block[1 << 16];
+    double y = 0.0;
+    unsigned rs = 1;
+    for (long long i = 0; i < SAMPLES; i += 1 << 16) {
+        for (int k = 0; k < 1 << 16; k++) {
+            rs = rs * 1103515245u + 12345u;
+            y += ((double)(rs >> 8) / (1 << 24) - 0.5) * (k % 4096 == 0 ? 50.0 : 1.0);
+            block[k] = (i + k) % 1000003 < 700 ? NAN : y;
+        }
+        fwrite(block, sizeof(double), 1 << 16, f);
+    }
+    return fclose(f) ? NULL : path;
+}
+
+// Every column's extremes among the points must be the extremes of its
+// samples, and only columns with a finite sample may have points
+static int check_view(const DataSeries *s, double x_min, double x_max, int columns, int n) {
+    long long lo = x_min > 0 ? (long long)ceil(x_min) : 0;
+    long long hi = (long long)floor(x_max) + 1;
+    if (hi > s->count) hi = s->count;
+    if (hi - lo <= 4LL * columns) return 0; // the samples themselves
+    double w = (x_max - x_min) / columns;
+    int bad = 0, p = 0;
+    while (p < n && points[p].x < (double)lo) p++;
+    long long a = lo;
+    for (int c = 0; c < columns; c++) {
+        long long b = c + 1 == columns ? hi : (long long)ceil(x_min + (c + 1) * w);
+        if (b > hi) b = hi;
+        if (b <= a) continue;
+        double s_lo = INFINITY, s_hi = -INFINITY, p_lo = INFINITY, p_hi = -INFINITY;
+        for (long long i = a; i < b; i++) {
+            double y = s->data[i];
+            if (y < s_lo) s_lo = y;
+            if (y > s_hi) s_hi = y;
+        }
+        for (; p < n && points[p].x < (double)b; p++) {
+            if (points[p].y < p_lo) p_lo = points[p].y;
+            if (points[p].y > p_hi) p_hi = points[p].y;
+        }
+        if (s_lo != p_lo || s_hi != p_hi) bad++;
+        a = b;
+    }
+    return bad;
+}
+
+typedef struct {
+    DataSeries *s;
+    double      lo, hi;
+    int         columns, n;
+} View;
+
+static void run_view(void *ctx) {
+    View *v = ctx;
+    v->n = series_decimate(v->s, v->lo, v->hi, v->columns, points);
+}
+
+int main(void) {
+    workpool_init(0);
+    char path[] = "/tmp/bench-series-XXXXXX";
+    if (!write_samples(path)) {
+        printf("series: could not write %s\n", path);
+        return 1;
+    }
+
+    DataSeries s = {0};
+    double t0 = bench_now();
+    const char *err = series_open(&s, path);
+    double t_open = bench_now() - t0;
+    unlink(path);
+    CHECK(!err, "series_open: %s", err ? err : "");
+    if (err) return bench_done();
+    CHECK(s.count == SAMPLES, "%lld samples of %lld", s.count, SAMPLES);
+    printf("series: %lld samples, pyramid of %d levels built in %.1f ms\n", s.count, s.levels,
+           t_open * 1e3);
+    printf("  %-22s %7s %8s %10s %10s\n", "view", "columns", "points", "M4 us", "scan us");
+
+    static const struct { double lo, hi; int columns; const char *tag; } VIEWS[] = {
+        { 0.0, SAMPLES - 1.0, 1920, "whole series" },
+        { -1e6, SAMPLES + 1e6, 1920, "zoomed out past it" },
+        { 1234567.5, 2345678.25, 1920, "an eighth" },
+        { 5e6, 5e6 + 40000.0, 1920, "40k samples" },
+        { 3e6 + 0.3, 3e6 + 9000.7, 1920, "9k samples" },
+        { 7e6, 7e6 + 5000.0, 4096, "5k samples, 4k columns" },
+        { 2000.0, 2100.0, 1920, "100 samples" },
+    };
+    for (size_t v = 0; v < sizeof(VIEWS) / sizeof(VIEWS[0]); v++) {
+        double lo = VIEWS[v].lo, hi = VIEWS[v].hi;
+        int columns = VIEWS[v].columns;
+        View view = { &s, lo, hi, columns, 0 };
+        double best = bench_best(run_view, &view, RUNS);
+        int n = view.n;
+        // What a full read of the view costs, for comparison
+        t0 = bench_now();
+        double sum = 0.0;
+        for (long long i = lo > 0 ? (long long)lo : 0; i < s.count && i <= hi; i++) sum += s.data[i];
+        bench_sink += sum;
+        double scan = bench_now() - t0;
+
+        CHECK(n <= 4 * columns + 2, "%s: %d points for %d columns", VIEWS[v].tag, n, columns);
+        int bad = check_view(&s, lo, hi, columns, n);
+        CHECK(!bad, "%s: %d columns with the wrong extremes", VIEWS[v].tag, bad);
+        for (int i = 1; i < n; i++)
+            if (!(points[i].x >= points[i - 1].x)) {
+                CHECK(false, "%s: x goes back at point %d", VIEWS[v].tag, i);
+                break;
+            }
+        printf("  %-22s %7d %8d %10.1f %10.1f\n", VIEWS[v].tag, columns, n, best * 1e6,
+               scan * 1e6);
+    }
+
+    series_close(&s);
+    workpool_shutdown();
+    return bench_done();
+}
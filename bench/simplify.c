@@ -0,0 +1,114 @@
+#define _DEFAULT_SOURCE // clock_gettime under -std=c11
+// Simplified expressions against the trees they came from: over inputs
+// that are NaN, infinite, zero of either sign, subnormal or at the edge of
+// overflow, both must be NaN at the same points and infinite at the same
+// points, with the same sign, and otherwise agree to the last bit or so.
+// Also times what the rewrites save in compiled blocks.
+#include "bench.h"
+#include "modules/cas/bytecode.h"
+#include "modules/cas/simplify.h"
+#include <float.h>
+
+#define SAMPLES 1000000
+#define RUNS    5
+
+// Each rule, and the rewrites that would break at extreme values
+static const char *const EXPRS[] = {
+    "x/4+y/0.5",
+    "x/3+y/10",
+    "x/2^1023+y/2^-1022",
+    "(x+10^308)+10^308",
+    "(x*10^200)*10^-200*y",
+    "((x+2)+3)*4*5",
+    "x-2+y-0",
+    "(x+0)^-1",
+    "x*1+1*y+x^1+y^0",
+    "x*-1-(y*3)+--x",
+    "x^2-y^2+(x*y)^2",
+    "1/0*x+x%0+y%(1-1)",
+    "sqrt(x)*0.5+ln(y)/16",
+    "(x+y)*(y+x)/x^2",
+    "exp(x)/8-exp(y)*2^-3",
+    "2*x+y*3-x/8",
+};
+#define EXPR_COUNT (int)(sizeof(EXPRS) / sizeof(EXPRS[0]))
+
+static const double SPECIAL[] = {
+    NAN, INFINITY, -INFINITY, 0.0, -0.0, 1.0, -1.0, 2.0, 0.5, -3.0,
+    1e-310, -1e-310, DBL_MIN, DBL_MAX, -DBL_MAX, 1e308, -1e308, 1e200, 1e-200, 3.14159,
+};
+#define SPECIAL_COUNT (int)(sizeof(SPECIAL) / sizeof(SPECIAL[0]))
+
+static double xs[SAMPLES], out[SAMPLES];
+
+static int count_nodes(const ASTNode *n) {
+    if (!n) return 0;
+    switch (n->type) {
+    case NODE_NUMBER:
+    case NODE_VAR:        return 1;
+    case NODE_UNARY_NEG:  return 1 + count_nodes(n->unary.operand);
+    case NODE_FUNC:       return 1 + count_nodes(n->func.arg);
+    case NODE_BINOP:
+        return 1 + count_nodes(n->binop.left) +
+               (n->binop.right == n->binop.left ? 0 : count_nodes(n->binop.right));
+    }
+    return 1;
+}
+
+// NaN where b is NaN, infinite where b is with its sign, else within a
+// few ulp of the larger of a, b and floor: pow(x, 2) and x*x may round
+// apart, and where terms of about floor cancel, so does what is left.
+// A zero's sign is free.
+static bool agree(double a, double b, double floor) {
+    if (isnan(a) || isnan(b)) return isnan(a) && isnan(b);
+    if (isinf(a) || isinf(b)) return a == b;
+    return fabs(a - b) <= 4 * DBL_EPSILON * fmax(fmax(fabs(a), fabs(b)), floor);
+}
+
+typedef struct {
+    const Bytecode *bc;
+} Run;
+
+static void run_block(void *ctx) {
+    const Run *r = ctx;
+    bytecode_eval_batch(r->bc, xs, xs, out, SAMPLES);
+    bench_sink += out[SAMPLES / 2];
+}
+
+int main(void) {
+    for (int i = 0; i < SAMPLES; i++) xs[i] = -20.0 + 40.0 * i / SAMPLES;
+    Arena arena = arena_create(1 << 16);
+
+    printf("simplify: %d x %d special inputs and a grid; ns per sample in blocks\n", SPECIAL_COUNT,
+           SPECIAL_COUNT);
+    printf("  %-28s %6s %6s %8s %8s %6s\n", "expression", "nodes", "after", "as is", "simple", "wrong");
+    for (int e = 0; e < EXPR_COUNT; e++) {
+        arena_reset(&arena);
+        Parser p, q;
+        parser_init(&p, EXPRS[e], &arena);
+        ASTNode *plain = parser_parse(&p);
+        parser_init(&q, EXPRS[e], &arena);
+        ASTNode *simple = simplify_ast(parser_parse(&q));
+        CHECK(!p.has_error && !q.has_error, "%s did not parse", EXPRS[e]);
+        if (p.has_error || q.has_error) continue;
+
+        int wrong = 0;
+        for (int i = 0; i < SPECIAL_COUNT; i++)
+            for (int j = 0; j < SPECIAL_COUNT; j++)
+                wrong += !agree(eval_ast_xy(simple, SPECIAL[i], SPECIAL[j]),
+                                eval_ast_xy(plain, SPECIAL[i], SPECIAL[j]), 0.0);
+        for (int i = 0; i < SAMPLES; i += 97)
+            wrong += !agree(eval_ast_xy(simple, xs[i], xs[SAMPLES - 1 - i]),
+                            eval_ast_xy(plain, xs[i], xs[SAMPLES - 1 - i]), 1.0);
+        CHECK(!wrong, "%s: %d inputs where the simplified tree disagrees", EXPRS[e], wrong);
+
+        Bytecode *pc = bytecode_compile(plain, &arena), *sc = bytecode_compile(simple, &arena);
+        double as_is = bench_best(run_block, &(Run){ pc }, RUNS) * 1e9 / SAMPLES;
+        double simpl = bench_best(run_block, &(Run){ sc }, RUNS) * 1e9 / SAMPLES;
+        printf("  %-28s %6d %6d %8.2f %8.2f %6d\n", EXPRS[e], count_nodes(plain), count_nodes(simple),
+               as_is, simpl, wrong);
+    }
+
+    arena_destroy(&arena);
+    return bench_done();
+}
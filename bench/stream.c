@@ -0,0 +1,145 @@
+#define _DEFAULT_SOURCE // clock_gettime, mkdtemp and nanosleep under -std=c11
+// Live samples through the reader thread and its ring: a producer thread
+// writes "x, y" lines into a FIFO as fast as it can while the main thread
+// polls once a frame. Every sample must arrive, in order and intact, at a
+// million samples a second or more; when the frame loop stalls, what does
+// not fit the ring must be counted as dropped, not lost.
+#include "bench.h"
+#include "modules/cas/stream.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SAMPLES    (4 << 20)
+#define FRAME_NS   4000000 // between polls, a frame at 250 Hz
+#define TIMEOUT_S  30.0
+#define RATE_MIN   1e6     // samples per second
+
+typedef struct {
+    const char *path;
+    long long   first, count;
+} Producer;
+
+// y of sample x: exact in a double, and different for neighbours
+static long long y_of(long long x) { return x * 7 % 1009 - 504; }
+
+// Decimal digits of v at p, returning the end
+static char *put_int(char *p, long long v) {
+    char tmp[24];
+    int n = 0;
+    bool neg = v < 0;
+    unsigned long long u = neg ? 0ull - (unsigned long long)v : (unsigned long long)v;
+    do tmp[n++] = (char)('0' + u % 10); while (u /= 10);
+    if (neg) *p++ = '-';
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static void *produce(void *arg) {
+    const Producer *pr = arg;
+    int fd = open(pr->path, O_WRONLY);
+    if (fd < 0) return NULL;
+    static char buf[1 << 16];
+    char *p = buf;
+    for (long long x = pr->first; x < pr->first + pr->count; x++) {
+        p = put_int(p, x);
+        *p++ = ',';
+        *p++ = ' ';
+        p = put_int(p, y_of(x));
+        *p++ = '\n';
+        if (p - buf > (long)sizeof(buf) - 64 || x + 1 == pr->first + pr->count) {
+            for (char *q = buf; q < p;) {
+                ssize_t put = write(fd, q, (size_t)(p - q));
+                if (put <= 0) break;
+                q += put;
+            }
+            p = buf;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+// Samples of the history that are not first..first+count-1 in order
+static long long check_history(const DataStream *s, long long first, long long count) {
+    long long bad = s->hist.count == count ? 0 : 1;
+    for (long long i = 0; i < s->hist.count && i < count; i++) {
+        const double *v = &s->hist.data[2 * i];
+        bad += v[0] != (double)(first + i) || v[1] != (double)y_of(first + i);
+    }
+    return bad;
+}
+
+static void sleep_ns(long ns) {
+    struct timespec t = { 0, ns };
+    nanosleep(&t, NULL);
+}
+
+int main(void) {
+    char dir[] = "/tmp/bench-stream-XXXXXX", path[64];
+    if (!mkdtemp(dir)) {
+        printf("stream: could not make a scratch directory\n");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/fifo", dir);
+    CHECK(mkfifo(path, 0600) == 0, "mkfifo %s failed", path);
+
+    // Polled every frame: nothing may be dropped
+    DataStream s;
+    const char *err = stream_open(&s, path);
+    CHECK(!err, "stream_open: %s", err ? err : "");
+    if (err) return bench_done();
+    Producer pr = { path, 0, SAMPLES };
+    pthread_t thread;
+    double t0 = bench_now(), t = t0;
+    pthread_create(&thread, NULL, produce, &pr);
+    int frames = 0;
+    while (s.received + s.dropped < SAMPLES && (t = bench_now()) - t0 < TIMEOUT_S) {
+        sleep_ns(FRAME_NS);
+        stream_poll(&s);
+        frames++;
+    }
+    pthread_join(thread, NULL);
+    stream_poll(&s);
+    double rate = s.received / (t - t0);
+    CHECK(s.received == SAMPLES, "%llu of %d samples received", s.received, SAMPLES);
+    CHECK(!s.dropped && !s.bad && !s.unordered, "%llu dropped, %llu bad, %llu unordered",
+          s.dropped, s.bad, s.unordered);
+    long long kept = SAMPLES < STREAM_HISTORY ? SAMPLES : STREAM_HISTORY;
+    long long bad = check_history(&s, SAMPLES - kept, kept);
+    CHECK(!bad, "%lld samples of the history wrong or missing", bad);
+    CHECK(rate >= RATE_MIN, "%.2f M samples/s, under %.1f M", rate * 1e-6, RATE_MIN * 1e-6);
+    printf("stream: %d samples in %.0f ms over %d polls, %.2f M samples/s, %llu dropped\n",
+           SAMPLES, (t - t0) * 1e3, frames, rate * 1e-6, s.dropped);
+    stream_close(&s);
+
+    // Not polled until the producer is done: the ring fills, and the rest
+    // must be counted as dropped. The producer is done once the reader has
+    // taken all but the last pipe buffer or so, which a pause covers.
+    err = stream_open(&s, path);
+    CHECK(!err, "stream_open: %s", err ? err : "");
+    if (!err) {
+        long long sent = STREAM_RING + 100000;
+        pr = (Producer){ path, 0, sent };
+        pthread_create(&thread, NULL, produce, &pr);
+        pthread_join(thread, NULL);
+        sleep_ns(300000000);
+        stream_poll(&s);
+        CHECK((long long)s.received == sent, "stalled: %llu of %lld samples received",
+              s.received, sent);
+        CHECK((long long)s.dropped == sent - STREAM_RING, "stalled: %llu dropped, not %lld",
+              s.dropped, sent - STREAM_RING);
+        bad = check_history(&s, 0, STREAM_RING);
+        CHECK(!bad, "stalled: %lld samples of the history wrong or missing", bad);
+        printf("stream: stalled frame loop, %lld samples sent, %lld taken, %llu dropped\n", sent,
+               s.hist.count, s.dropped);
+        stream_close(&s);
+    }
+
+    unlink(path);
+    rmdir(dir);
+    return bench_done();
+}
@@ -9,6 +9,8 @@
 #include "modules/chemistry/chemistry.h"
 #include "modules/physics/optics.h"
 #include "modules/chemistry/chemsim.h"
+#include "utils/arena.h"
+#include "utils/workpool.h"
 #include <stddef.h>
 
 #if defined(PLATFORM_WEB)
@@ -36,6 +38,9 @@ int main(void) {
 
     ui_init(&ui);
 
+    // Plot sampling is spread over one thread per core
+    workpool_init(0);
+
     // Create topics
     int math = ui_add_topic(&ui, "Mathematics", "CAS, Plotter & Calculator", (Color){66, 165, 245, 255});
     int phys = ui_add_topic(&ui, "Physics",     "Atom Models & Simulations", (Color){239, 83, 80, 255});
@@ -66,6 +71,12 @@ int main(void) {
                 ui.topics[t].modules[m]->cleanup();
         }
     }
+    workpool_shutdown();
+    for (int i = 0; i < arena_stats_count(); i++) {
+        const ArenaStats *s = arena_stats_at(i);
+        TraceLog(LOG_INFO, "ARENA: %s peak %zu bytes, %zu allocs, %zu blocks",
+                 s->owner, s->high_water, s->allocs, s->blocks);
+    }
 
     UnloadFont(g_font);
     CloseWindow();
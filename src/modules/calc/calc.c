@@ -2,7 +2,7 @@
 #include "../../ui/ui.h"
 #include "../../ui/theme.h"
 #include "../cas/parser.h"
-#include "../cas/eval.h"
+#include "../cas/bytecode.h"
 #include "../../utils/arena.h"
 #include <string.h>
 #include <stdio.h>
@@ -93,7 +93,7 @@ static void calc_init(void) {
     display[0]  = '\0';
     hist_count  = 0;
     hist_scroll = 0;
-    calc_arena  = arena_create(ARENA_DEFAULT_CAP);
+    calc_arena  = arena_create_ex(ARENA_DEFAULT_CAP, 0, "calc");
     strcpy(last_answer, "0");
 }
 
@@ -104,13 +104,14 @@ static void evaluate_display(void) {
     Parser parser;
     parser_init(&parser, display, &calc_arena);
     ASTNode *ast = parser_parse(&parser);
+    Bytecode *code = bytecode_compile(ast, &calc_arena);
 
     HistEntry *h = &history[hist_count % HIST_MAX];
     strncpy(h->expr, display, HIST_LINE - 1);
     h->expr[HIST_LINE - 1] = '\0';
 
-    if (ast && !parser.has_error) {
-        double val = eval_ast(ast, 0); // x=0 for plain calculator
+    if (code && !parser.has_error) {
+        double val = bytecode_eval(code, 0.0, 0.0); // x=0 for plain calculator
         if (isnan(val)) {
             strcpy(h->result, "Error");
         } else if (val == (long long)val && fabs(val) < 1e15) {
@@ -0,0 +1,276 @@
+#include "bytecode.h"
+#include "vecmath.h"
+#include <math.h>
+#include <string.h>
+
+// Deepest program bytecode_eval_batch runs block-wise; deeper ones fall
+// back to one bytecode_eval per sample
+#define BATCH_STACK_MAX 32
+
+typedef struct {
+    Instr *code;
+    int    len;
+    int    depth;
+    int    max_depth;
+} Emitter;
+
+static int count_nodes(const ASTNode *n) {
+    if (!n) return 1;
+    switch (n->type) {
+    case NODE_UNARY_NEG: return 1 + count_nodes(n->unary.operand);
+    case NODE_BINOP:
+        // A shared operand (x*x from simplify) is compiled once, as OP_SQR
+        if (n->binop.op == '*' && n->binop.left == n->binop.right)
+            return 2 + count_nodes(n->binop.left);
+        return 1 + count_nodes(n->binop.left) + count_nodes(n->binop.right);
+    case NODE_FUNC:      return 1 + count_nodes(n->func.arg);
+    default:             return 1;
+    }
+}
+
+static void emit(Emitter *e, OpCode op, int stack_delta) {
+    e->code[e->len].op    = op;
+    e->code[e->len].fn_id = FN_UNKNOWN;
+    e->code[e->len].k     = 0.0;
+    e->len++;
+    e->depth += stack_delta;
+    if (e->depth > e->max_depth) e->max_depth = e->depth;
+}
+
+static void emit_k(Emitter *e, OpCode op, double k, int stack_delta) {
+    emit(e, op, stack_delta);
+    e->code[e->len - 1].k = k;
+}
+
+bool bytecode_fused_op(char op, double k, bool const_on_left, OpCode *out) {
+    if (const_on_left) {
+        // Only where operand order can be swapped
+        switch (op) {
+        case '+': *out = OP_ADD_K;  return true;
+        case '*': *out = OP_MUL_K;  return true;
+        case '-': *out = OP_RSUB_K; return true;
+        default:  return false;
+        }
+    }
+    switch (op) {
+    case '+': *out = OP_ADD_K; return true;
+    case '-': *out = OP_SUB_K; return true;
+    case '*': *out = OP_MUL_K; return true;
+    case '/': *out = OP_DIV_K; return k != 0.0; // keep the zero check at runtime
+    case '^': *out = OP_POW_K; return true;
+    default:  return false;
+    }
+}
+
+static void compile_node(Emitter *e, const ASTNode *n) {
+    if (!n) {
+        emit_k(e, OP_CONST, NAN, 1);
+        return;
+    }
+
+    switch (n->type) {
+    case NODE_NUMBER:
+        emit_k(e, OP_CONST, n->number, 1);
+        return;
+
+    case NODE_VAR:
+        emit(e, n->var == 'z' ? OP_Z : n->var == 'y' ? OP_Y : OP_X, 1);
+        return;
+
+    case NODE_UNARY_NEG:
+        compile_node(e, n->unary.operand);
+        emit(e, OP_NEG, 0);
+        return;
+
+    case NODE_BINOP: {
+        const ASTNode *l = n->binop.left;
+        const ASTNode *r = n->binop.right;
+        OpCode op;
+
+        if ((n->binop.op == '^' && r && r->type == NODE_NUMBER && r->number == 2.0) ||
+            (n->binop.op == '*' && l == r)) {
+            compile_node(e, l);
+            emit(e, OP_SQR, 0);
+            return;
+        }
+        if (r && r->type == NODE_NUMBER && bytecode_fused_op(n->binop.op, r->number, false, &op)) {
+            compile_node(e, l);
+            emit_k(e, op, r->number, 0);
+            return;
+        }
+        if (l && l->type == NODE_NUMBER && bytecode_fused_op(n->binop.op, l->number, true, &op)) {
+            compile_node(e, r);
+            emit_k(e, op, l->number, 0);
+            return;
+        }
+
+        switch (n->binop.op) {
+            case '+': op = OP_ADD; break;
+            case '-': op = OP_SUB; break;
+            case '*': op = OP_MUL; break;
+            case '/': op = OP_DIV; break;
+            case '^': op = OP_POW; break;
+            case '%': op = OP_MOD; break;
+            default:
+                emit_k(e, OP_CONST, NAN, 1);
+                return;
+        }
+        compile_node(e, l);
+        compile_node(e, r);
+        emit(e, op, -1);
+        return;
+    }
+
+    case NODE_FUNC:
+        compile_node(e, n->func.arg);
+        emit(e, OP_CALL, 0);
+        e->code[e->len - 1].fn_id = n->func.id;
+        e->code[e->len - 1].fn    = eval_func_ptr(n->func.id);
+        return;
+    }
+
+    emit_k(e, OP_CONST, NAN, 1);
+}
+
+Bytecode *bytecode_compile(const ASTNode *node, Arena *arena) {
+    if (!node) return NULL;
+
+    int cap = count_nodes(node);
+    Bytecode *bc = arena_alloc(arena, sizeof(Bytecode));
+    Instr *code  = arena_alloc(arena, sizeof(Instr) * (size_t)cap);
+    if (!bc || !code) return NULL;
+
+    Emitter e = { code, 0, 0, 0 };
+    compile_node(&e, node);
+    bool deep = e.max_depth > BYTECODE_STACK_MAX;
+
+    bc->code      = deep ? NULL : code;
+    bc->len       = deep ? 0 : e.len;
+    bc->stack_max = e.max_depth;
+    bc->tree      = deep ? node : NULL;
+    return bc;
+}
+
+double bytecode_eval(const Bytecode *bc, double x, double y) {
+    return bytecode_eval_xyz(bc, x, y, 0.0);
+}
+
+double bytecode_eval_xyz(const Bytecode *bc, double x, double y, double z) {
+    if (!bc) return NAN;
+    if (bc->tree) return eval_ast_xyz(bc->tree, x, y, z);
+
+    // Top of stack lives in a register; stack[] holds everything below it
+    double stack[BYTECODE_STACK_MAX + 1];
+    double tos = 0.0;
+    int    sp  = 0;
+
+    const Instr *in  = bc->code;
+    const Instr *end = in + bc->len;
+    for (; in != end; in++) {
+        switch (in->op) {
+        case OP_CONST:  stack[sp++] = tos; tos = in->k; break;
+        case OP_X:      stack[sp++] = tos; tos = x;     break;
+        case OP_Y:      stack[sp++] = tos; tos = y;     break;
+        case OP_Z:      stack[sp++] = tos; tos = z;     break;
+        case OP_NEG:    tos = -tos; break;
+        case OP_ADD:    tos = stack[--sp] + tos; break;
+        case OP_SUB:    tos = stack[--sp] - tos; break;
+        case OP_MUL:    tos = stack[--sp] * tos; break;
+        case OP_DIV: {
+            double l = stack[--sp];
+            tos = tos != 0.0 ? l / tos : NAN;
+            break;
+        }
+        case OP_POW:    tos = pow(stack[--sp], tos); break;
+        case OP_MOD: {
+            double l = stack[--sp];
+            tos = tos != 0.0 ? fmod(l, tos) : NAN;
+            break;
+        }
+        case OP_ADD_K:  tos = tos + in->k; break;
+        case OP_SUB_K:  tos = tos - in->k; break;
+        case OP_RSUB_K: tos = in->k - tos; break;
+        case OP_MUL_K:  tos = tos * in->k; break;
+        case OP_DIV_K:  tos = tos / in->k; break;
+        case OP_POW_K:  tos = pow(tos, in->k); break;
+        case OP_SQR:    tos = tos * tos; break;
+        case OP_CALL:   tos = in->fn(tos); break;
+        }
+    }
+    return tos;
+}
+
+static void fill(double *out, double v, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = v;
+}
+
+// One block (n <= EVAL_BATCH_BLOCK) of bytecode_eval_batch. Each stack
+// slot holds a whole block of values, so every instruction is dispatched
+// once per block instead of once per sample.
+static void eval_block(const Bytecode *bc, const double *xs, const double *ys,
+                       const double *zs, double *out, size_t n) {
+    double stack[BATCH_STACK_MAX][EVAL_BATCH_BLOCK];
+    double kbuf[EVAL_BATCH_BLOCK];
+    int    sp = 0;
+
+    const Instr *in  = bc->code;
+    const Instr *end = in + bc->len;
+    for (; in != end; in++) {
+        double *top = sp > 0 ? stack[sp - 1] : NULL;
+        switch (in->op) {
+        case OP_CONST: fill(stack[sp++], in->k, n); break;
+        case OP_X:     memcpy(stack[sp++], xs, n * sizeof(double)); break;
+        case OP_Y:
+            if (ys) memcpy(stack[sp], ys, n * sizeof(double));
+            else    fill(stack[sp], 0.0, n);
+            sp++;
+            break;
+        case OP_Z:
+            if (zs) memcpy(stack[sp], zs, n * sizeof(double));
+            else    fill(stack[sp], 0.0, n);
+            sp++;
+            break;
+        case OP_NEG:   vecmath_neg(top, top, n); break;
+        case OP_ADD:   vecmath_add(stack[sp - 2], stack[sp - 2], top, n); sp--; break;
+        case OP_SUB:   vecmath_sub(stack[sp - 2], stack[sp - 2], top, n); sp--; break;
+        case OP_MUL:   vecmath_mul(stack[sp - 2], stack[sp - 2], top, n); sp--; break;
+        case OP_DIV:   vecmath_div(stack[sp - 2], stack[sp - 2], top, n); sp--; break;
+        case OP_POW:   vecmath_pow(stack[sp - 2], stack[sp - 2], top, n); sp--; break;
+        case OP_MOD:   vecmath_mod(stack[sp - 2], stack[sp - 2], top, n); sp--; break;
+        case OP_ADD_K:  fill(kbuf, in->k, n); vecmath_add(top, top, kbuf, n); break;
+        case OP_SUB_K:  fill(kbuf, in->k, n); vecmath_sub(top, top, kbuf, n); break;
+        case OP_RSUB_K: fill(kbuf, in->k, n); vecmath_sub(top, kbuf, top, n); break;
+        case OP_MUL_K:  fill(kbuf, in->k, n); vecmath_mul(top, top, kbuf, n); break;
+        case OP_DIV_K:  fill(kbuf, in->k, n); vecmath_div(top, top, kbuf, n); break;
+        case OP_POW_K:
+            if (in->k == floor(in->k) && fabs(in->k) <= 64.0) {
+                vecmath_powi(top, top, (int)in->k, n);
+            } else {
+                fill(kbuf, in->k, n);
+                vecmath_pow(top, top, kbuf, n);
+            }
+            break;
+        case OP_SQR:   vecmath_mul(top, top, top, n); break;
+        case OP_CALL:  vecmath_func(in->fn_id, top, top, n); break;
+        }
+    }
+    memcpy(out, stack[0], n * sizeof(double));
+}
+
+void bytecode_eval_batch(const Bytecode *bc, const double *xs, const double *ys,
+                         double *out, size_t n) {
+    bytecode_eval_batch_xyz(bc, xs, ys, NULL, out, n);
+}
+
+void bytecode_eval_batch_xyz(const Bytecode *bc, const double *xs, const double *ys,
+                             const double *zs, double *out, size_t n) {
+    if (!bc || bc->stack_max > BATCH_STACK_MAX) {
+        for (size_t i = 0; i < n; i++)
+            out[i] = bytecode_eval_xyz(bc, xs[i], ys ? ys[i] : 0.0, zs ? zs[i] : 0.0);
+        return;
+    }
+    for (size_t i = 0; i < n; i += EVAL_BATCH_BLOCK) {
+        size_t cnt = n - i < EVAL_BATCH_BLOCK ? n - i : EVAL_BATCH_BLOCK;
+        eval_block(bc, xs + i, ys ? ys + i : NULL, zs ? zs + i : NULL, out + i, cnt);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "parser.h"
+#include "eval.h"
+#include "../../utils/arena.h"
+
+// Deepest operand stack a compiled expression may use. Deeper expressions
+// (as their derivatives can be) are not lowered: their Bytecode walks the
+// AST instead, with eval_ast_xyz, so compilation only fails on OOM.
+#define BYTECODE_STACK_MAX 128
+
+typedef enum {
+    OP_CONST,   // push k
+    OP_X,       // push x
+    OP_Y,       // push y
+    OP_Z,       // push z (0 outside the *_xyz evaluators)
+    OP_NEG,     // top = -top
+    OP_ADD,     // pop r, top = top + r
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,     // NAN on division by zero, like eval_ast
+    OP_POW,
+    OP_MOD,
+    OP_ADD_K,   // top = top + k
+    OP_SUB_K,   // top = top - k
+    OP_RSUB_K,  // top = k - top
+    OP_MUL_K,   // top = top * k
+    OP_DIV_K,   // top = top / k  (k != 0)
+    OP_POW_K,   // top = pow(top, k)
+    OP_SQR,     // top = top * top  (x^2 or e*e with a shared operand)
+    OP_CALL,    // top = fn(top)
+} OpCode;
+
+typedef struct {
+    OpCode op;
+    FuncId fn_id;   // OP_CALL, for the batched evaluator
+    union {
+        double k;  // OP_CONST and the *_K forms
+        EvalFn fn; // OP_CALL
+    };
+} Instr;
+
+// Flat, postfix program lowered from an ASTNode tree. Function names are
+// resolved to function pointers at compile time.
+typedef struct Bytecode {
+    Instr *code;
+    int    len;
+    int    stack_max;
+    const ASTNode *tree; // set, with no code, when too deep for the stack
+} Bytecode;
+
+// Fused *_K opcode for binop op with constant operand k on the right, or on
+// the left if const_on_left. False when there is none (k is kept on the
+// stack instead).
+bool bytecode_fused_op(char op, double k, bool const_on_left, OpCode *out);
+
+// Lower an AST into bytecode allocated from arena. Returns NULL on OOM.
+Bytecode *bytecode_compile(const ASTNode *node, Arena *arena);
+
+// Run a compiled program. Same semantics as eval_ast_xy; NAN if bc is NULL.
+double bytecode_eval(const Bytecode *bc, double x, double y);
+
+// Run a compiled program over n sample points, like eval_ast_batch.
+// ys may be NULL (y = 0).
+void bytecode_eval_batch(const Bytecode *bc, const double *xs, const double *ys,
+                         double *out, size_t n);
+
+// The same with z, for expressions of x, y and z
+double bytecode_eval_xyz(const Bytecode *bc, double x, double y, double z);
+void   bytecode_eval_batch_xyz(const Bytecode *bc, const double *xs, const double *ys,
+                               const double *zs, double *out, size_t n);
+
+#endif
@@ -1,10 +1,18 @@
 #include "cas.h"
 #include "parser.h"
 #include "eval.h"
+#include "bytecode.h"
+#include "simplify.h"
+#include "derive.h"
+#include "dag.h"
+#include "jit.h"
+#include "vecmath.h"
 #include "plotter.h"
 #include "plotter3d.h"
+#include "implicit3d.h"
 #include "../../ui/ui.h"
 #include "../../ui/theme.h"
+#include "../../ui/arrows.h"
 #include "../../utils/arena.h"
 #include <string.h>
 #include <stdio.h>
@@ -17,6 +25,7 @@
 #define TEMPLATE_H    28
 #define TEMPLATE_W    48
 #define TEMPLATE_GAP   4
+#define SLOT_ARENA_CAP (1024 * 8) // first block of a slot's arena; grows on demand
 
 static void cas_layout(Rectangle area, Rectangle *sidebar, Rectangle *plot_area, bool *side_by_side) {
     float aspect = (float)GetScreenWidth() / (float)GetScreenHeight();
@@ -38,7 +47,10 @@ static void cas_layout(Rectangle area, Rectangle *sidebar, Rectangle *plot_area,
 
 typedef enum { MODE_2D, MODE_3D } CASMode;
 
-static Arena       cas_arena;
+static Arena       cas_arena;    // scratch handed to the plotters
+static Arena       plot_arena;   // plot.dag, rebuilt when a 2D slot changes
+static Arena       plot3d_arena; // plot3d.dag, rebuilt when a surface changes
+static DagTable    cas_dag;      // interning table of the slot being compiled
 static PlotState   plot;
 static Plot3DState plot3d;
 static char        error_msg[128];
@@ -55,8 +67,13 @@ static float     scroll_y;
 // 3D: vector input buffer
 static char      vec_buf[VEC_BUF_SIZE];
 
+// 2D: data file path input buffer
+static char      path_buf[EXPR_BUF_SIZE];
+
 static void cas_init(void) {
-    cas_arena = arena_create(ARENA_DEFAULT_CAP);
+    cas_arena    = arena_create_ex(ARENA_DEFAULT_CAP, 0, "plotter");
+    plot_arena   = arena_create_ex(ARENA_DEFAULT_CAP, 0, "dag");
+    plot3d_arena = arena_create_ex(ARENA_DEFAULT_CAP, 0, "dag");
     plotter_init(&plot);
     plotter3d_init(&plot3d);
     error_msg[0]  = '\0';
@@ -66,24 +83,188 @@ static void cas_init(void) {
     scroll_y       = 0;
     cas_mode       = MODE_2D;
     vec_buf[0]     = '\0';
+    path_buf[0]    = '\0';
+    // Pick the vecmath kernels up front, so plot workers never race to
+    // set the shared kernel pointer on their first call
+    (void)vecmath_isa();
+    implicit3d_init();
+}
+
+static bool uses_var(const ASTNode *n, char v) {
+    if (!n) return false;
+    switch (n->type) {
+    case NODE_NUMBER:     return false;
+    case NODE_VAR:        return n->var == v;
+    case NODE_UNARY_NEG:  return uses_var(n->unary.operand, v);
+    case NODE_FUNC:       return uses_var(n->func.arg, v);
+    case NODE_BINOP:      return uses_var(n->binop.left, v) || uses_var(n->binop.right, v);
+    }
+    return false;
 }
 
-static void reparse_all(void) {
-    arena_reset(&cas_arena);
-    // 2D functions
-    for (int i = 0; i < plot.func_count; i++) {
-        Parser parser;
-        parser_init(&parser, plot.funcs[i].expr_text, &cas_arena);
-        plot.funcs[i].ast = parser_parse(&parser);
-        plot.funcs[i].valid = !parser.has_error;
+// Split text at its top-level commas into parts; returns how many there
+// are, of which the first three are kept
+static int split_commas(const char *text, char parts[3][EXPR_BUF_SIZE]) {
+    int n = 0, len = 0, depth = 0;
+    for (const char *c = text;; c++) {
+        if (*c == '(') depth++;
+        else if (*c == ')') depth--;
+        if (*c == '\0' || (*c == ',' && depth == 0)) {
+            if (n < 3) parts[n][len] = '\0';
+            n++;
+            len = 0;
+            if (*c == '\0') return n;
+        } else if (n < 3 && len < EXPR_BUF_SIZE - 1) {
+            parts[n][len++] = *c;
+        }
     }
-    // 3D surface functions
-    for (int i = 0; i < plot3d.surf_count; i++) {
-        Parser parser;
-        parser_init(&parser, plot3d.surfs[i].expr_text, &cas_arena);
-        plot3d.surfs[i].ast = parser_parse(&parser);
-        plot3d.surfs[i].valid = !parser.has_error;
+}
+
+// Say so in error_msg when code is too deep for the bytecode stack and
+// walks its AST instead, which still plots but far slower
+static void note_tree_walk(const Bytecode *code) {
+    if (code && code->tree && !error_msg[0])
+        snprintf(error_msg, sizeof(error_msg), "Nested too deep to compile: evaluating slowly");
+}
+
+// Compile the count components of "a, b[, c]": in 3D a curve if all
+// three are functions of t alone, else a surface of u and v, else a field
+// of x, y and z; in 2D a field of x and y
+static bool compile_components(FuncSlot *slot, char parts[3][EXPR_BUF_SIZE], int count) {
+    static const char *const PARAMS[3] = { "t", "uv", NULL };
+    Parser parser;
+    for (int kind = count == 3 ? 0 : 2; kind < 3; kind++) {
+        arena_reset(&slot->arena);
+        slot->valid = true;
+        memset(slot->comp, 0, sizeof(slot->comp));
+        memset(slot->comp_code, 0, sizeof(slot->comp_code));
+        for (int k = 0; k < count && slot->valid; k++) {
+            parser_init(&parser, parts[k], &slot->arena);
+            parser.params  = PARAMS[kind];
+            parser.allow_z = count == 3;
+            ASTNode *ast = parser_parse(&parser);
+            slot->comp[k]      = parser.has_error ? NULL : simplify_ast(ast);
+            slot->comp_code[k] = slot->comp[k] ? bytecode_compile(slot->comp[k], &slot->arena) : NULL;
+            slot->valid        = slot->comp_code[k] != NULL;
+        }
+        if (slot->valid) {
+            if (PARAMS[kind]) slot->params = kind + 1;
+            else slot->field = count;
+            break;
+        }
     }
+    slot->ast  = slot->comp[0];
+    slot->code = slot->comp_code[0];
+    if (parser.has_error)
+        snprintf(error_msg, sizeof(error_msg), "%s", parser.error);
+    for (int k = 0; k < count && slot->valid; k++) note_tree_walk(slot->comp_code[k]);
+    return slot->valid;
+}
+
+// Parse, simplify and compile one slot's expression, its derivative when
+// shown, and a 3D surface's gradient, into the slot's own arena. Other
+// slots are not touched. "lhs = rhs" makes an implicit curve, or in 3D
+// (solved 'z') a surface, except solved = f(...), which stays explicit;
+// in 3D so does an expression without z. "x, y, z" is parametric or a
+// vector field, and in 2D "P, Q" a vector field. Parse errors go to
+// error_msg. Returns slot->valid.
+static bool compile_slot(FuncSlot *slot, char solved) {
+    if (!slot->arena.stats) slot->arena = arena_create_ex(SLOT_ARENA_CAP, 0, "slot");
+    arena_reset(&slot->arena);
+    dag_reset(&cas_dag);
+    slot->gen++;
+    slot->implicit   = false;
+    slot->params     = 0;
+    slot->field      = 0;
+    slot->deriv      = NULL;
+    slot->deriv_code = NULL;
+    slot->grad_code[0] = slot->grad_code[1] = NULL;
+
+    char parts[3][EXPR_BUF_SIZE];
+    int  count = split_commas(slot->expr_text, parts);
+    if (count == (solved == 'z' ? 3 : 2))
+        return compile_components(slot, parts, count);
+
+    Parser parser;
+    parser_init(&parser, slot->expr_text, &slot->arena);
+    parser.allow_z = solved == 'z';
+    bool relation = false;
+    ASTNode *ast = parser_parse_relation(&parser, &relation);
+    if (relation && ast->binop.left->type == NODE_VAR && ast->binop.left->var == solved &&
+        !uses_var(ast->binop.right, solved)) {
+        ast      = ast->binop.right;
+        relation = false;
+    }
+    slot->implicit = relation || (solved == 'z' && uses_var(ast, 'z'));
+    slot->ast   = dag_intern(&cas_dag, simplify_ast(ast));
+    slot->code  = bytecode_compile(slot->ast, &slot->arena);
+    slot->valid = !parser.has_error && slot->code;
+    if (parser.has_error)
+        snprintf(error_msg, sizeof(error_msg), "%s", parser.error);
+
+    if (slot->valid && slot->show_deriv && !slot->implicit) {
+        slot->deriv      = dag_intern(&cas_dag, derive_ast(slot->ast, 'x', &slot->arena));
+        slot->deriv_code = bytecode_compile(slot->deriv, &slot->arena);
+    }
+    // A surface's normals come from its gradient, compiled like the surface
+    for (int k = 0; solved == 'z' && slot->valid && !slot->implicit && k < 2; k++) {
+        ASTNode *d = derive_ast(slot->ast, k ? 'y' : 'x', &slot->arena);
+        slot->grad_code[k] = d ? bytecode_compile(d, &slot->arena) : NULL;
+    }
+    if (slot->valid) note_tree_walk(slot->code);
+    note_tree_walk(slot->deriv_code);
+    return slot->valid;
+}
+
+// One program over all valid explicit slots (root i = slots[i]), not
+// parametric nor fields, and, with
+// derivs, their derivatives (root PLOT_DERIV(i)), so shared subexpressions
+// are evaluated once per sample
+static DagProgram *compile_dag(const FuncSlot *slots, int count, bool derivs, Arena *arena) {
+    ASTNode *roots[PLOT_CURVES];
+    for (int i = 0; i < count; i++)
+        roots[i] = (slots[i].valid && !slots[i].implicit && !slots[i].params && !slots[i].field)
+                   ? slots[i].ast : NULL;
+    if (!derivs) return dag_compile(roots, count, arena);
+    for (int i = count; i < MAX_FUNCTIONS; i++) roots[i] = NULL;
+    for (int i = 0; i < MAX_FUNCTIONS; i++)
+        roots[PLOT_DERIV(i)] = (i < count && slots[i].deriv_code) ? slots[i].deriv : NULL;
+    return dag_compile(roots, PLOT_CURVES, arena);
+}
+
+// Rebuild a plotter's shared program after one of its slots changed. Slot
+// ASTs stay as they are; only the program and its native code go.
+static void rebuild_plot(void) {
+    jit_free(plot.jit);
+    plot.jit      = NULL;
+    plot.jit_mask = 0;
+    arena_reset(&plot_arena);
+    plot.dag = compile_dag(plot.funcs, plot.func_count, true, &plot_arena);
+}
+
+static void rebuild_plot3d(void) {
+    jit_free(plot3d.jit);
+    plot3d.jit      = NULL;
+    plot3d.jit_mask = 0;
+    arena_reset(&plot3d_arena);
+    plot3d.dag = compile_dag(plot3d.surfs, plot3d.surf_count, false, &plot3d_arena);
+}
+
+// Drop slots[index], its arenas and mesh; the slots after it move down with theirs
+static void remove_slot(FuncSlot *slots, int *count, int index, char prefix) {
+    arena_destroy(&slots[index].arena);
+    arena_destroy(&slots[index].flow.arena);
+    arena_destroy(&slots[index].lines.arena);
+    plotter3d_release(&slots[index]);
+    for (int i = index; i < *count - 1; i++)
+        slots[i] = slots[i + 1];
+    (*count)--;
+    slots[*count].arena = (Arena){0}; // now owned by slots[*count - 1]
+    slots[*count].mesh  = (SurfaceMesh){0};
+    slots[*count].flow  = (FieldCache){0};
+    slots[*count].lines = (ImplicitCache){0};
+    for (int i = 0; i < *count; i++)
+        snprintf(slots[i].name, FUNC_NAME_SIZE, "%c%d", prefix, i + 1);
 }
 
 static void add_function(const char *expr) {
@@ -94,44 +275,80 @@ static void add_function(const char *expr) {
     strncpy(slot->expr_text, expr, EXPR_BUF_SIZE - 1);
     slot->expr_text[EXPR_BUF_SIZE - 1] = '\0';
     slot->visible = true;
+    slot->show_deriv = false;
+    slot->show_stream = false;
     slot->color_idx = plot.func_count;
     snprintf(slot->name, FUNC_NAME_SIZE, "f%d", plot.func_count + 1);
 
+    // A failing expression is not added; its arena waits for the next one
+    if (!compile_slot(slot, 'y')) return;
     plot.func_count++;
-    reparse_all();
-
-    if (!slot->valid) {
-        Parser parser;
-        arena_reset(&cas_arena);
-        parser_init(&parser, expr, &cas_arena);
-        parser_parse(&parser);
-        if (parser.has_error)
-            snprintf(error_msg, sizeof(error_msg), "%s", parser.error);
-        plot.func_count--;
-        reparse_all();
-    }
+    rebuild_plot();
 }
 
 static void update_function(int index) {
     error_msg[0] = '\0';
-    reparse_all();
-    if (!plot.funcs[index].valid) {
-        Parser parser;
-        parser_init(&parser, plot.funcs[index].expr_text, &cas_arena);
-        parser_parse(&parser);
-        if (parser.has_error)
-            snprintf(error_msg, sizeof(error_msg), "%s", parser.error);
-    }
+    compile_slot(&plot.funcs[index], 'y');
+    rebuild_plot();
 }
 
 static void remove_function(int index) {
     if (index < 0 || index >= plot.func_count) return;
-    for (int i = index; i < plot.func_count - 1; i++)
-        plot.funcs[i] = plot.funcs[i + 1];
-    plot.func_count--;
-    for (int i = 0; i < plot.func_count; i++)
-        snprintf(plot.funcs[i].name, FUNC_NAME_SIZE, "f%d", i + 1);
-    reparse_all();
+    remove_slot(plot.funcs, &plot.func_count, index, 'f');
+    rebuild_plot();
+}
+
+// ---- 2D data series ----
+
+static void add_stream(const char *source) {
+    if (plot.stream_count >= MAX_STREAMS) return;
+    error_msg[0] = '\0';
+
+    DataStream *st = &plot.streams[plot.stream_count];
+    const char *err = stream_open(st, source);
+    if (err) {
+        snprintf(error_msg, sizeof(error_msg), "%s: %s", source, err);
+        return;
+    }
+    st->color_idx = plot.func_count + plot.series_count + plot.stream_count;
+    plot.stream_count++;
+}
+
+static void remove_stream(int index) {
+    if (index < 0 || index >= plot.stream_count) return;
+    stream_close(&plot.streams[index]);
+    for (int i = index; i < plot.stream_count - 1; i++)
+        plot.streams[i] = plot.streams[i + 1];
+    plot.stream_count--;
+    plot.streams[plot.stream_count] = (DataStream){0};
+}
+
+// A file path adds a series, "-", a FIFO or a socket a stream
+static void add_series(const char *path) {
+    if (stream_is_source(path)) {
+        add_stream(path);
+        return;
+    }
+    if (plot.series_count >= MAX_SERIES) return;
+    error_msg[0] = '\0';
+
+    DataSeries *s = &plot.series[plot.series_count];
+    const char *err = series_open(s, path);
+    if (err) {
+        snprintf(error_msg, sizeof(error_msg), "%s: %s", path, err);
+        return;
+    }
+    s->color_idx = plot.func_count + plot.series_count + plot.stream_count;
+    plot.series_count++;
+}
+
+static void remove_series(int index) {
+    if (index < 0 || index >= plot.series_count) return;
+    series_close(&plot.series[index]);
+    for (int i = index; i < plot.series_count - 1; i++)
+        plot.series[i] = plot.series[i + 1];
+    plot.series_count--;
+    plot.series[plot.series_count] = (DataSeries){0};
 }
 
 // ---- 3D surface functions ----
@@ -144,44 +361,26 @@ static void add_surface(const char *expr) {
     strncpy(slot->expr_text, expr, EXPR_BUF_SIZE - 1);
     slot->expr_text[EXPR_BUF_SIZE - 1] = '\0';
     slot->visible = true;
+    slot->show_stream = false;
+    slot->show_contours = false;
     slot->color_idx = plot3d.surf_count;
     snprintf(slot->name, FUNC_NAME_SIZE, "s%d", plot3d.surf_count + 1);
 
+    if (!compile_slot(slot, 'z')) return;
     plot3d.surf_count++;
-    reparse_all();
-
-    if (!slot->valid) {
-        Parser parser;
-        arena_reset(&cas_arena);
-        parser_init(&parser, expr, &cas_arena);
-        parser_parse(&parser);
-        if (parser.has_error)
-            snprintf(error_msg, sizeof(error_msg), "%s", parser.error);
-        plot3d.surf_count--;
-        reparse_all();
-    }
+    rebuild_plot3d();
 }
 
 static void update_surface(int index) {
     error_msg[0] = '\0';
-    reparse_all();
-    if (!plot3d.surfs[index].valid) {
-        Parser parser;
-        parser_init(&parser, plot3d.surfs[index].expr_text, &cas_arena);
-        parser_parse(&parser);
-        if (parser.has_error)
-            snprintf(error_msg, sizeof(error_msg), "%s", parser.error);
-    }
+    compile_slot(&plot3d.surfs[index], 'z');
+    rebuild_plot3d();
 }
 
 static void remove_surface(int index) {
     if (index < 0 || index >= plot3d.surf_count) return;
-    for (int i = index; i < plot3d.surf_count - 1; i++)
-        plot3d.surfs[i] = plot3d.surfs[i + 1];
-    plot3d.surf_count--;
-    for (int i = 0; i < plot3d.surf_count; i++)
-        snprintf(plot3d.surfs[i].name, FUNC_NAME_SIZE, "s%d", i + 1);
-    reparse_all();
+    remove_slot(plot3d.surfs, &plot3d.surf_count, index, 's');
+    rebuild_plot3d();
 }
 
 // Parse vector string "x,y,z" and add to list
@@ -244,17 +443,29 @@ static void cas_update(Rectangle area) {
     Rectangle plot_area = {0};
     cas_layout(area, &sidebar, &plot_area, NULL);
     (void)sidebar;
-    if (cas_mode == MODE_3D)
+    // Keep the cells sampled ahead last frame before anything can change
+    plotter_sync(&plot);
+    // Streams are drained in either mode, so their readers do not drop
+    for (int i = 0; i < plot.stream_count; i++) stream_poll(&plot.streams[i]);
+    if (cas_mode == MODE_3D) {
         plotter3d_update(&plot3d, plot_area);
-    else
-        plotter_update(&plot, plot_area);
+        return;
+    }
+    plotter_update(&plot, plot_area);
+
+    // Files dropped on the window are loaded as data series
+    if (IsFileDropped()) {
+        FilePathList files = LoadDroppedFiles();
+        for (unsigned i = 0; i < files.count; i++) add_series(files.paths[i]);
+        UnloadDroppedFiles(files);
+    }
 }
 
 // Draw a single function row with inline editing (shared for 2D/3D)
 static float draw_func_row_ex(int index, float x, float y, float w,
                                FuncSlot *slots, int count,
                                void (*update_fn)(int), void (*remove_fn)(int),
-                               const char *prefix) {
+                               const char *prefix, bool *toggle, const char *toggle_label) {
     (void)count;
     FuncSlot *slot = &slots[index];
     Color col = PLOT_COLORS[slot->color_idx % PLOT_COLOR_COUNT];
@@ -303,7 +514,7 @@ static float draw_func_row_ex(int index, float x, float y, float w,
         field_x += prefix_w + 2;
     }
 
-    float field_w = w - (field_x - x) - 28;
+    float field_w = w - (field_x - x) - (toggle ? 52 : 28);
     Rectangle field_rect = { field_x, y + 2, field_w, ROW_HEIGHT - 4 };
 
     if (is_editing) {
@@ -331,6 +542,21 @@ static float draw_func_row_ex(int index, float x, float y, float w,
                      FONT_SIZE_SMALL, tc);
     }
 
+    // Toggle: f' and the tangent at the cursor, a field's streamlines or
+    // a surface's contours; only f' needs the slot recompiled
+    if (toggle) {
+        Rectangle tog = { x + w - 50, y + (ROW_HEIGHT - 18) / 2, 22, 18 };
+        bool tog_hov = CheckCollisionPointRec(mouse, tog);
+        if (*toggle || tog_hov)
+            DrawRectangleRounded(tog, 0.3f, 4, (Color){col.r, col.g, col.b, *toggle ? 70 : 30});
+        ui_draw_text(toggle_label, (int)tog.x + 5, (int)tog.y + 1, FONT_SIZE_TINY,
+                     *toggle ? col : COL_TEXT_DIM);
+        if (tog_hov && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+            *toggle = !*toggle;
+            if (toggle == &slot->show_deriv) update_fn(index);
+        }
+    }
+
     // Delete button
     Rectangle del = { x + w - 24, y + (ROW_HEIGHT - 18) / 2, 18, 18 };
     bool del_hov = CheckCollisionPointRec(mouse, del);
@@ -351,16 +577,22 @@ static float draw_func_row_ex(int index, float x, float y, float w,
 
 // 2D function row
 static float draw_func_row(int index, float x, float y, float w) {
+    FuncSlot *s = &plot.funcs[index];
     return draw_func_row_ex(index, x, y, w,
                             plot.funcs, plot.func_count,
-                            update_function, remove_function, NULL);
+                            update_function, remove_function, NULL,
+                            s->field ? &s->show_stream : &s->show_deriv, s->field ? "~" : "f'");
 }
 
 // 3D surface row
 static float draw_surf_row(int index, float x, float y, float w) {
+    FuncSlot *s = &plot3d.surfs[index];
+    bool explicit = !s->implicit && !s->params && !s->field;
     return draw_func_row_ex(index, x, y, w,
                             plot3d.surfs, plot3d.surf_count,
-                            update_surface, remove_surface, "z=");
+                            update_surface, remove_surface, explicit ? "z=" : NULL,
+                            s->field ? &s->show_stream : explicit ? &s->show_contours : NULL,
+                            s->field ? "~" : "c");
 }
 
 // Draw a vector row
@@ -413,6 +645,120 @@ static float draw_vec_row(int index, float x, float y, float w) {
     return ROW_HEIGHT + ROW_GAP;
 }
 
+// Draw a data series row
+static float draw_series_row(int index, float x, float y, float w) {
+    DataSeries *ds = &plot.series[index];
+    Color col = PLOT_COLORS[ds->color_idx % PLOT_COLOR_COUNT];
+    Vector2 mouse = ui_mouse();
+
+    Rectangle row = { x, y, w, ROW_HEIGHT };
+    bool row_hovered = CheckCollisionPointRec(mouse, row);
+    Color row_bg = row_hovered ? (Color){44, 46, 54, 255} : COL_PANEL;
+    DrawRectangleRounded(row, 0.1f, 6, row_bg);
+
+    DrawRectangleRounded(
+        (Rectangle){x, y + 4, 4, ROW_HEIGHT - 8}, 1.0f, 4, col);
+
+    // Visibility toggle
+    Rectangle vis = { x + 10, y + (ROW_HEIGHT - 16) / 2, 16, 16 };
+    bool vis_hov = CheckCollisionPointRec(mouse, vis);
+    if (ds->visible) {
+        DrawCircle((int)(vis.x + 8), (int)(vis.y + 8), 5, col);
+        if (vis_hov) DrawCircleLines((int)(vis.x + 8), (int)(vis.y + 8), 7, WHITE);
+    } else {
+        DrawCircleLines((int)(vis.x + 8), (int)(vis.y + 8), 5, COL_TEXT_DIM);
+    }
+    if (vis_hov && IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+        ds->visible = !ds->visible;
+    if (vis_hov && IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
+        ds->color_idx = (ds->color_idx + 1) % PLOT_COLOR_COUNT;
+
+    // File name + sample count
+    char label[96];
+    snprintf(label, sizeof(label), "%s (%lld)", ds->name, ds->count);
+    ui_draw_text(label, (int)x + 30, (int)y + (ROW_HEIGHT - FONT_SIZE_SMALL) / 2,
+                 FONT_SIZE_SMALL, ds->visible ? col : COL_TEXT_DIM);
+
+    // Delete
+    Rectangle del = { x + w - 24, y + (ROW_HEIGHT - 18) / 2, 18, 18 };
+    bool del_hov = CheckCollisionPointRec(mouse, del);
+    if (del_hov)
+        DrawRectangleRounded(del, 0.3f, 4,
+                             (Color){COL_ERROR.r, COL_ERROR.g, COL_ERROR.b, 40});
+    ui_draw_text("x", (int)del.x + 4, (int)del.y + 1, FONT_SIZE_TINY,
+                 del_hov ? COL_ERROR : COL_TEXT_DIM);
+    if (del_hov && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+        remove_series(index);
+        return 0;
+    }
+
+    return ROW_HEIGHT + ROW_GAP;
+}
+
+// Draw a stream row: rate, drops and the follow toggle
+static float draw_stream_row(int index, float x, float y, float w) {
+    DataStream *st = &plot.streams[index];
+    Color col = PLOT_COLORS[st->color_idx % PLOT_COLOR_COUNT];
+    Vector2 mouse = ui_mouse();
+
+    Rectangle row = { x, y, w, ROW_HEIGHT };
+    bool row_hovered = CheckCollisionPointRec(mouse, row);
+    Color row_bg = row_hovered ? (Color){44, 46, 54, 255} : COL_PANEL;
+    DrawRectangleRounded(row, 0.1f, 6, row_bg);
+
+    DrawRectangleRounded(
+        (Rectangle){x, y + 4, 4, ROW_HEIGHT - 8}, 1.0f, 4, col);
+
+    // Visibility toggle
+    Rectangle vis = { x + 10, y + (ROW_HEIGHT - 16) / 2, 16, 16 };
+    bool vis_hov = CheckCollisionPointRec(mouse, vis);
+    if (st->visible) {
+        DrawCircle((int)(vis.x + 8), (int)(vis.y + 8), 5, col);
+        if (vis_hov) DrawCircleLines((int)(vis.x + 8), (int)(vis.y + 8), 7, WHITE);
+    } else {
+        DrawCircleLines((int)(vis.x + 8), (int)(vis.y + 8), 5, COL_TEXT_DIM);
+    }
+    if (vis_hov && IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+        st->visible = !st->visible;
+    if (vis_hov && IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
+        st->color_idx = (st->color_idx + 1) % PLOT_COLOR_COUNT;
+
+    // Name over rate and counters
+    ui_draw_text(st->name, (int)x + 30, (int)y + 3, FONT_SIZE_SMALL,
+                 st->visible ? col : COL_TEXT_DIM);
+    char stats[96];
+    snprintf(stats, sizeof(stats), "%.3g/s  %llu dropped  %llu bad  %llu unordered%s", st->rate,
+             st->dropped, st->bad, st->unordered, st->ended ? "  ended" : "");
+    ui_draw_text(stats, (int)x + 30, (int)y + ROW_HEIGHT - FONT_SIZE_TINY - 3, FONT_SIZE_TINY,
+                 st->dropped ? COL_ERROR : COL_TEXT_DIM);
+
+    // Follow toggle: the plot scrolls with the newest sample
+    Rectangle fol = { x + w - 58, y + (ROW_HEIGHT - 18) / 2, 30, 18 };
+    bool fol_hov = CheckCollisionPointRec(mouse, fol);
+    if (st->follow || fol_hov)
+        DrawRectangleRounded(fol, 0.3f, 4,
+                             (Color){col.r, col.g, col.b, st->follow ? 70 : 30});
+    ui_draw_text("live", (int)fol.x + 4, (int)fol.y + 1, FONT_SIZE_TINY,
+                 st->follow ? col : COL_TEXT_DIM);
+    if (fol_hov && IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+        st->follow = !st->follow;
+
+    // Delete
+    Rectangle del = { x + w - 24, y + (ROW_HEIGHT - 18) / 2, 18, 18 };
+    bool del_hov = CheckCollisionPointRec(mouse, del);
+    if (del_hov)
+        DrawRectangleRounded(del, 0.3f, 4,
+                             (Color){COL_ERROR.r, COL_ERROR.g, COL_ERROR.b, 40});
+    ui_draw_text("x", (int)del.x + 4, (int)del.y + 1, FONT_SIZE_TINY,
+                 del_hov ? COL_ERROR : COL_TEXT_DIM);
+    if (del_hov && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+        remove_stream(index);
+        return 0;
+    }
+
+    return ROW_HEIGHT + ROW_GAP;
+}
+
 static void draw_template_bar(float x, float y, float w) {
     typedef struct { const char *label; const char *insert; } Tmpl;
     Tmpl templates_2d[] = {
@@ -604,6 +950,54 @@ static void cas_draw(Rectangle area) {
             }
             cy += ROW_HEIGHT + ROW_GAP;
         }
+
+        // Separator
+        cy += 8;
+        DrawLine((int)sx, (int)cy, (int)(sx + sw), (int)cy, COL_GRID);
+        cy += 8;
+
+        // ---- 2D: data series rows ----
+        ui_draw_text("Data  file, FIFO, socket or -", (int)sx + 2, (int)cy, FONT_SIZE_SMALL, COL_TEXT_DIM);
+        cy += 20;
+
+        for (int i = 0; i < plot.series_count; i++) {
+            float adv = draw_series_row(i, sx, cy, sw);
+            if (adv == 0) { i--; continue; }
+            cy += adv;
+        }
+        for (int i = 0; i < plot.stream_count; i++) {
+            float adv = draw_stream_row(i, sx, cy, sw);
+            if (adv == 0) { i--; continue; }
+            cy += adv;
+        }
+
+        // New series or stream path input
+        if (plot.series_count < MAX_SERIES || plot.stream_count < MAX_STREAMS) {
+            Color new_col = PLOT_COLORS[(plot.func_count + plot.series_count + plot.stream_count) %
+                                        PLOT_COLOR_COUNT];
+            Rectangle new_row = { sx, cy, sw, ROW_HEIGHT };
+            Color bg = (Color){36, 38, 46, 255};
+            DrawRectangleRounded(new_row, 0.1f, 6, bg);
+            DrawRectangleRounded(
+                (Rectangle){sx, cy + 4, 4, ROW_HEIGHT - 8}, 1.0f, 4, new_col);
+
+            ui_draw_text("+", (int)sx + 12, (int)cy + (ROW_HEIGHT - FONT_SIZE_SMALL) / 2,
+                         FONT_SIZE_SMALL, new_col);
+
+            float field_x = sx + 30;
+            float field_w = sw - 34;
+            Rectangle field_rect = { field_x, cy + 2, field_w, ROW_HEIGHT - 4 };
+
+            // Separate active state, like the vector input
+            static bool path_active = false;
+            bool submitted = ui_text_input(field_rect, path_buf, EXPR_BUF_SIZE,
+                                           &path_active, "file path, or drop a file");
+            if (submitted && path_buf[0] != '\0') {
+                add_series(path_buf);
+                path_buf[0] = '\0';
+            }
+            cy += ROW_HEIGHT + ROW_GAP;
+        }
     } else {
         // ---- 3D: surface rows ----
         ui_draw_text("Surfaces  z = f(x,y)", (int)sx + 2, (int)cy, FONT_SIZE_SMALL, COL_TEXT_DIM);
@@ -742,14 +1136,43 @@ static void cas_draw(Rectangle area) {
 }
 
 static void cas_cleanup(void) {
+    plotter_sync(&plot);
+    arena_destroy(&plot.fill_arena);
+    jit_free(plot.jit);
+    jit_free(plot3d.jit);
+    plot.jit = plot3d.jit = NULL;
+    for (int i = 0; i < MAX_FUNCTIONS; i++) {
+        arena_destroy(&plot.funcs[i].arena);
+        arena_destroy(&plot3d.surfs[i].arena);
+        arena_destroy(&plot.funcs[i].flow.arena);
+        arena_destroy(&plot3d.surfs[i].flow.arena);
+        arena_destroy(&plot.funcs[i].lines.arena);
+        plotter3d_release(&plot3d.surfs[i]);
+    }
+    for (int i = 0; i < plot.series_count; i++) series_close(&plot.series[i]);
+    plot.series_count = 0;
+    for (int i = 0; i < plot.stream_count; i++) stream_close(&plot.streams[i]);
+    plot.stream_count = 0;
     arena_destroy(&cas_arena);
+    arena_destroy(&plot_arena);
+    arena_destroy(&plot3d_arena);
+    ui_plot_grid_free(&plot.grid);
+    implicit3d_release();
+    ui_arrows_unload();
 }
 
 static Module cas_mod = {
     .name    = "CAS Calculator",
     .help_text = "Enter expressions to plot (e.g. sin(x), x^2).\n"
                  "2D: Scroll to zoom, drag to pan.\n"
+                 "2D: Drop a .csv or float64 file to plot its data.\n"
+                 "2D: Enter a FIFO, UNIX socket or - (stdin) to plot it live.\n"
                  "3D: Drag to orbit, scroll to zoom, Home to reset.\n"
+                 "3D: Right-drag to pan, shift+scroll to widen the range.\n"
+                 "3D: Use z or = for a surface F(x,y,z)=0, e.g. x^2+y^2+z^2=9.\n"
+                 "3D: x,y,z of u,v is a surface, of t a curve; both run 0..2pi.\n"
+                 "Fields: P,Q (2D) or P,Q,R of x,y,z (3D) draw arrows; ~ traces them.\n"
+                 "3D: c on a z = f(x,y) row draws its contours, and isobands below.\n"
                  "Press [H] to toggle this help.",
     .init    = cas_init,
     .update  = cas_update,
@@ -0,0 +1,401 @@
+#include "dag.h"
+#include "vecmath.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// ---- Hash-consing ----
+
+static uint64_t mix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h * 0xff51afd7ed558ccdULL;
+}
+
+static uint64_t ptr_bits(const void *p) {
+    return (uint64_t)(uintptr_t)p;
+}
+
+// Children are already canonical, so they hash and compare by address
+static uint64_t node_hash(const ASTNode *n) {
+    uint64_t h = mix(0, (uint64_t)n->type);
+    switch (n->type) {
+    case NODE_NUMBER: {
+        uint64_t bits;
+        memcpy(&bits, &n->number, sizeof(bits));
+        return mix(h, bits);
+    }
+    case NODE_VAR:        return mix(h, (uint64_t)(unsigned char)n->var);
+    case NODE_UNARY_NEG:  return mix(h, ptr_bits(n->unary.operand));
+    case NODE_FUNC:       return mix(mix(h, (uint64_t)n->func.id), ptr_bits(n->func.arg));
+    case NODE_BINOP:
+        h = mix(h, (uint64_t)(unsigned char)n->binop.op);
+        return mix(mix(h, ptr_bits(n->binop.left)), ptr_bits(n->binop.right));
+    }
+    return h;
+}
+
+static bool node_equal(const ASTNode *a, const ASTNode *b) {
+    if (a->type != b->type) return false;
+    switch (a->type) {
+    case NODE_NUMBER:     return memcmp(&a->number, &b->number, sizeof(double)) == 0; // keeps -0, NAN
+    case NODE_VAR:        return a->var == b->var;
+    case NODE_UNARY_NEG:  return a->unary.operand == b->unary.operand;
+    case NODE_FUNC:       return a->func.id == b->func.id && a->func.arg == b->func.arg;
+    case NODE_BINOP:
+        return a->binop.op == b->binop.op &&
+               a->binop.left == b->binop.left && a->binop.right == b->binop.right;
+    }
+    return false;
+}
+
+void dag_reset(DagTable *t) {
+    memset(t->slots, 0, sizeof(t->slots));
+    t->count = 0;
+}
+
+ASTNode *dag_intern(DagTable *t, ASTNode *node) {
+    if (!node) return NULL;
+
+    switch (node->type) {
+    case NODE_UNARY_NEG:
+        node->unary.operand = dag_intern(t, node->unary.operand);
+        break;
+    case NODE_FUNC:
+        node->func.arg = dag_intern(t, node->func.arg);
+        break;
+    case NODE_BINOP:
+        node->binop.left  = dag_intern(t, node->binop.left);
+        node->binop.right = dag_intern(t, node->binop.right);
+        break;
+    default:
+        break;
+    }
+
+    size_t mask = DAG_TABLE_SIZE - 1;
+    size_t i = (size_t)node_hash(node) & mask;
+    for (size_t probe = 0; probe < DAG_TABLE_SIZE; probe++, i = (i + 1) & mask) {
+        ASTNode *s = t->slots[i];
+        if (!s) {
+            if (t->count >= DAG_TABLE_SIZE * 3 / 4) return node;
+            t->slots[i] = node;
+            t->count++;
+            return node;
+        }
+        if (s == node || node_equal(s, node)) return s;
+    }
+    return node;
+}
+
+// ---- Lowering to a register program ----
+
+#define MAP_SIZE (DAG_TABLE_SIZE * 2)
+
+// Scratch for dag_compile; programs are only built on reparse
+static const ASTNode *map_key[MAP_SIZE];
+static int            map_val[MAP_SIZE];
+static int            vn_slot[MAP_SIZE]; // instruction index + 1, 0 = empty
+static DagInstr       scratch[DAG_TABLE_SIZE];
+static int            last_use[DAG_TABLE_SIZE];
+static short          phys[DAG_TABLE_SIZE];
+
+typedef struct {
+    int  len;
+    int  mapped; // nodes in map_key
+    bool failed;
+} Builder;
+
+// Memo of node n, -1 until it is lowered. Trees that were not interned
+// can hold many more nodes than instructions, so the table is kept at
+// most 3/4 full: past that, NULL, and the build fails.
+static int *map_slot(Builder *b, const ASTNode *n) {
+    size_t mask = MAP_SIZE - 1;
+    size_t i = (size_t)(ptr_bits(n) >> 3) * 0x9e3779b1u & mask;
+    while (map_key[i] && map_key[i] != n) i = (i + 1) & mask;
+    if (!map_key[i]) {
+        if (b->mapped >= MAP_SIZE * 3 / 4) {
+            b->failed = true;
+            return NULL;
+        }
+        b->mapped++;
+        map_key[i] = n;
+        map_val[i] = -1;
+    }
+    return &map_val[i];
+}
+
+static bool instr_equal(const DagInstr *in, OpCode op, FuncId fn, int a, int bb, double k) {
+    if (in->op != op || in->a != a || in->b != bb) return false;
+    if (op == OP_CALL) return in->fn_id == fn;
+    return memcmp(&in->k, &k, sizeof(double)) == 0;
+}
+
+// Append an instruction, or return an identical one emitted before (value
+// numbering). This is what shares subexpressions between roots whose
+// trees were interned separately and so do not share nodes.
+static int emit(Builder *b, OpCode op, FuncId fn, int a, int bb, double k) {
+    uint64_t h = mix(mix(mix((uint64_t)op, (uint64_t)fn), (uint64_t)(a + 1)), (uint64_t)(bb + 1));
+    if (op != OP_CALL) {
+        uint64_t bits;
+        memcpy(&bits, &k, sizeof(bits));
+        h = mix(h, bits);
+    }
+    size_t mask = MAP_SIZE - 1;
+    size_t i = (size_t)h & mask;
+    for (; vn_slot[i]; i = (i + 1) & mask)
+        if (instr_equal(&scratch[vn_slot[i] - 1], op, fn, a, bb, k)) return vn_slot[i] - 1;
+
+    if (b->len >= DAG_TABLE_SIZE) {
+        b->failed = true;
+        return 0;
+    }
+    DagInstr *in = &scratch[b->len];
+    in->op    = op;
+    in->fn_id = fn;
+    in->dst   = (short)b->len;
+    in->a     = (short)a;
+    in->b     = (short)bb;
+    in->roots = 0;
+    if (op == OP_CALL) in->fn = eval_func_ptr(fn);
+    else               in->k  = k;
+    vn_slot[i] = b->len + 1;
+    return b->len++;
+}
+
+// Returns the instruction (virtual register) computing n, emitting it
+// and its operands on first use
+static int lower(Builder *b, const ASTNode *n) {
+    if (!n) return emit(b, OP_CONST, FN_UNKNOWN, -1, -1, NAN);
+    if (b->failed) return 0;
+
+    int *memo = map_slot(b, n);
+    if (!memo) return 0;
+    if (*memo >= 0) return *memo;
+
+    int v;
+    switch (n->type) {
+    case NODE_NUMBER:
+        v = emit(b, OP_CONST, FN_UNKNOWN, -1, -1, n->number);
+        break;
+    case NODE_VAR:
+        // Programs read x and y only; z or any other variable fails the build
+        if (n->var != 'x' && n->var != 'y') {
+            b->failed = true;
+            return 0;
+        }
+        v = emit(b, n->var == 'y' ? OP_Y : OP_X, FN_UNKNOWN, -1, -1, 0.0);
+        break;
+    case NODE_UNARY_NEG:
+        v = emit(b, OP_NEG, FN_UNKNOWN, lower(b, n->unary.operand), -1, 0.0);
+        break;
+    case NODE_FUNC:
+        v = emit(b, OP_CALL, n->func.id, lower(b, n->func.arg), -1, 0.0);
+        break;
+    case NODE_BINOP: {
+        const ASTNode *l = n->binop.left;
+        const ASTNode *r = n->binop.right;
+        char op = n->binop.op;
+        OpCode fused;
+        if ((op == '^' && r && r->type == NODE_NUMBER && r->number == 2.0) ||
+            (op == '*' && l == r)) {
+            v = emit(b, OP_SQR, FN_UNKNOWN, lower(b, l), -1, 0.0);
+        } else if (r && r->type == NODE_NUMBER && bytecode_fused_op(op, r->number, false, &fused)) {
+            v = emit(b, fused, FN_UNKNOWN, lower(b, l), -1, r->number);
+        } else if (l && l->type == NODE_NUMBER && bytecode_fused_op(op, l->number, true, &fused)) {
+            v = emit(b, fused, FN_UNKNOWN, lower(b, r), -1, l->number);
+        } else {
+            switch (op) {
+                case '+': fused = OP_ADD; break;
+                case '-': fused = OP_SUB; break;
+                case '*': fused = OP_MUL; break;
+                case '/': fused = OP_DIV; break;
+                case '^': fused = OP_POW; break;
+                case '%': fused = OP_MOD; break;
+                default:  fused = OP_CONST; break;
+            }
+            if (fused == OP_CONST) {
+                v = emit(b, OP_CONST, FN_UNKNOWN, -1, -1, NAN);
+            } else {
+                int a  = lower(b, l);
+                int bb = lower(b, r);
+                v = emit(b, fused, FN_UNKNOWN, a, bb, 0.0);
+            }
+        }
+        break;
+    }
+    default:
+        v = emit(b, OP_CONST, FN_UNKNOWN, -1, -1, NAN);
+        break;
+    }
+
+    *memo = v; // entries never move, so memo survives the recursion
+    return v;
+}
+
+DagProgram *dag_compile(ASTNode *const *roots, int count, Arena *arena) {
+    if (count > DAG_MAX_ROOTS) return NULL;
+
+    memset(map_key, 0, sizeof(map_key));
+    memset(vn_slot, 0, sizeof(vn_slot));
+    Builder b = { 0, 0, false };
+
+    int root_v[DAG_MAX_ROOTS];
+    for (int i = 0; i < count; i++) root_v[i] = roots[i] ? lower(&b, roots[i]) : -1;
+    if (b.failed) return NULL;
+    int len = b.len;
+
+    // Which roots need each instruction: propagate from the roots backwards
+    for (int i = 0; i < count; i++)
+        if (root_v[i] >= 0) scratch[root_v[i]].roots |= 1u << i;
+    for (int i = len - 1; i >= 0; i--) {
+        DagInstr *in = &scratch[i];
+        if (in->a >= 0) scratch[in->a].roots |= in->roots;
+        if (in->b >= 0) scratch[in->b].roots |= in->roots;
+    }
+
+    // Linear-scan register allocation; root values stay live to the end
+    for (int i = 0; i < len; i++) last_use[i] = -1;
+    for (int i = 0; i < len; i++) {
+        if (scratch[i].a >= 0) last_use[scratch[i].a] = i;
+        if (scratch[i].b >= 0) last_use[scratch[i].b] = i;
+    }
+    for (int i = 0; i < count; i++)
+        if (root_v[i] >= 0) last_use[root_v[i]] = len;
+
+    short free_regs[DAG_REG_MAX];
+    int   free_count = 0, reg_count = 0;
+    for (int i = 0; i < len; i++) {
+        DagInstr *in = &scratch[i];
+        int a = in->a, bb = in->b;
+        if (a >= 0) in->a = phys[a];
+        if (bb >= 0) in->b = phys[bb];
+        // Operands dying here are free for the result (kernels allow aliasing)
+        if (a >= 0 && last_use[a] == i) free_regs[free_count++] = phys[a];
+        if (bb >= 0 && bb != a && last_use[bb] == i) free_regs[free_count++] = phys[bb];
+
+        if (free_count > 0) {
+            phys[i] = free_regs[--free_count];
+        } else {
+            if (reg_count >= DAG_REG_MAX) return NULL;
+            phys[i] = (short)reg_count++;
+        }
+        in->dst = phys[i];
+    }
+
+    DagProgram *p   = arena_alloc(arena, sizeof(DagProgram));
+    DagInstr   *code = arena_alloc(arena, sizeof(DagInstr) * (size_t)(len > 0 ? len : 1));
+    if (!p || !code) return NULL;
+    memcpy(code, scratch, sizeof(DagInstr) * (size_t)len);
+
+    p->code       = code;
+    p->len        = len;
+    p->reg_count  = reg_count;
+    p->root_count = count;
+    for (int i = 0; i < count; i++) p->root_reg[i] = root_v[i] >= 0 ? phys[root_v[i]] : -1;
+    return p;
+}
+
+// ---- Evaluation ----
+
+void dag_eval(const DagProgram *p, unsigned mask, double x, double y, double *out) {
+    double r[DAG_REG_MAX];
+
+    const DagInstr *in  = p->code;
+    const DagInstr *end = in + p->len;
+    for (; in != end; in++) {
+        if (!(in->roots & mask)) continue;
+        double a = in->a >= 0 ? r[in->a] : 0.0;
+        double b = in->b >= 0 ? r[in->b] : 0.0;
+        double v;
+        switch (in->op) {
+        case OP_CONST:  v = in->k; break;
+        case OP_X:      v = x; break;
+        case OP_Y:      v = y; break;
+        case OP_NEG:    v = -a; break;
+        case OP_ADD:    v = a + b; break;
+        case OP_SUB:    v = a - b; break;
+        case OP_MUL:    v = a * b; break;
+        case OP_DIV:    v = b != 0.0 ? a / b : NAN; break;
+        case OP_POW:    v = pow(a, b); break;
+        case OP_MOD:    v = b != 0.0 ? fmod(a, b) : NAN; break;
+        case OP_ADD_K:  v = a + in->k; break;
+        case OP_SUB_K:  v = a - in->k; break;
+        case OP_RSUB_K: v = in->k - a; break;
+        case OP_MUL_K:  v = a * in->k; break;
+        case OP_DIV_K:  v = a / in->k; break;
+        case OP_POW_K:  v = pow(a, in->k); break;
+        case OP_SQR:    v = a * a; break;
+        case OP_CALL:   v = in->fn(a); break;
+        default:        v = NAN; break;
+        }
+        r[in->dst] = v;
+    }
+
+    for (int i = 0; i < p->root_count; i++) {
+        if (!(mask & (1u << i))) continue;
+        out[i] = p->root_reg[i] >= 0 ? r[p->root_reg[i]] : NAN;
+    }
+}
+
+static void fill(double *out, double v, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = v;
+}
+
+static void eval_block(const DagProgram *p, unsigned mask, const double *xs,
+                       const double *ys, double *const *outs, size_t off, size_t n) {
+    double r[DAG_REG_MAX][EVAL_BATCH_BLOCK];
+    double kbuf[EVAL_BATCH_BLOCK];
+
+    const DagInstr *in  = p->code;
+    const DagInstr *end = in + p->len;
+    for (; in != end; in++) {
+        if (!(in->roots & mask)) continue;
+        double *d = r[in->dst];
+        double *a = in->a >= 0 ? r[in->a] : NULL;
+        double *b = in->b >= 0 ? r[in->b] : NULL;
+        switch (in->op) {
+        case OP_CONST:  fill(d, in->k, n); break;
+        case OP_X:      memcpy(d, xs + off, n * sizeof(double)); break;
+        case OP_Y:
+            if (ys) memcpy(d, ys + off, n * sizeof(double));
+            else    fill(d, 0.0, n);
+            break;
+        case OP_NEG:    vecmath_neg(d, a, n); break;
+        case OP_ADD:    vecmath_add(d, a, b, n); break;
+        case OP_SUB:    vecmath_sub(d, a, b, n); break;
+        case OP_MUL:    vecmath_mul(d, a, b, n); break;
+        case OP_DIV:    vecmath_div(d, a, b, n); break;
+        case OP_POW:    vecmath_pow(d, a, b, n); break;
+        case OP_MOD:    vecmath_mod(d, a, b, n); break;
+        case OP_ADD_K:  fill(kbuf, in->k, n); vecmath_add(d, a, kbuf, n); break;
+        case OP_SUB_K:  fill(kbuf, in->k, n); vecmath_sub(d, a, kbuf, n); break;
+        case OP_RSUB_K: fill(kbuf, in->k, n); vecmath_sub(d, kbuf, a, n); break;
+        case OP_MUL_K:  fill(kbuf, in->k, n); vecmath_mul(d, a, kbuf, n); break;
+        case OP_DIV_K:  fill(kbuf, in->k, n); vecmath_div(d, a, kbuf, n); break;
+        case OP_POW_K:
+            if (in->k == floor(in->k) && fabs(in->k) <= 64.0) {
+                vecmath_powi(d, a, (int)in->k, n);
+            } else {
+                fill(kbuf, in->k, n);
+                vecmath_pow(d, a, kbuf, n);
+            }
+            break;
+        case OP_SQR:    vecmath_mul(d, a, a, n); break;
+        case OP_CALL:   vecmath_func(in->fn_id, d, a, n); break;
+        default:        fill(d, NAN, n); break;
+        }
+    }
+
+    for (int i = 0; i < p->root_count; i++) {
+        if (!(mask & (1u << i))) continue;
+        if (p->root_reg[i] >= 0) memcpy(outs[i] + off, r[p->root_reg[i]], n * sizeof(double));
+        else                     fill(outs[i] + off, NAN, n);
+    }
+}
+
+void dag_eval_batch(const DagProgram *p, unsigned mask, const double *xs,
+                    const double *ys, double *const *outs, size_t n) {
+    for (size_t i = 0; i < n; i += EVAL_BATCH_BLOCK) {
+        size_t cnt = n - i < EVAL_BATCH_BLOCK ? n - i : EVAL_BATCH_BLOCK;
+        eval_block(p, mask, xs, ys, outs, i, cnt);
+    }
+}
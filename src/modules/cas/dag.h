@@ -0,0 +1,68 @@
+#ifndef DAG_H
+#define DAG_H
+
+#include <stddef.h>
+#include "parser.h"
+#include "bytecode.h"
+#include "../../utils/arena.h"
+
+// Hash-consing: structurally identical subtrees are merged into one node,
+// so an ASTNode graph becomes a DAG. Interned nodes must not be rewritten
+// afterwards (run simplify_ast first).
+#define DAG_TABLE_SIZE 4096 // power of two; nodes past 3/4 full stay uninterned
+
+typedef struct DagTable {
+    ASTNode *slots[DAG_TABLE_SIZE];
+    int      count;
+} DagTable;
+
+void     dag_reset(DagTable *t);
+
+// Intern node and its subtree bottom-up; returns the canonical node.
+// Nodes that do not fit a full table are kept as they are.
+ASTNode *dag_intern(DagTable *t, ASTNode *node);
+
+// A set of expressions (roots) lowered into one register program in which
+// each distinct node is computed once per sample, however many roots or
+// subtrees use it. Equal instructions are merged as they are emitted, so
+// this holds across roots that were interned separately and share no
+// nodes. Instructions reuse the bytecode opcodes.
+#define DAG_MAX_ROOTS 32 // one bit per root in DagInstr.roots
+#define DAG_REG_MAX   32 // live registers; larger programs fail to build
+
+typedef struct {
+    OpCode   op;
+    FuncId   fn_id;    // OP_CALL
+    short    dst, a, b;
+    unsigned roots;    // bitmask of the roots that depend on this instruction
+    union {
+        double k;      // OP_CONST and the *_K forms
+        EvalFn fn;     // OP_CALL
+    };
+} DagInstr;
+
+typedef struct DagProgram {
+    DagInstr *code;
+    int       len;
+    int       reg_count;
+    int       root_count;
+    int       root_reg[DAG_MAX_ROOTS]; // -1 for a NULL root (evaluates to NAN)
+} DagProgram;
+
+// Lower roots[0..count) into one program allocated from arena. Returns
+// NULL on OOM, when the roots hold too many distinct nodes for its tables,
+// use a variable other than x and y, or need more than DAG_REG_MAX
+// registers; callers then evaluate each root's Bytecode separately.
+DagProgram *dag_compile(ASTNode *const *roots, int count, Arena *arena);
+
+// Evaluate the roots selected by mask (bit i = root i) at one point;
+// out[i] is written for each selected root. Work for unselected roots
+// is skipped.
+void dag_eval(const DagProgram *p, unsigned mask, double x, double y, double *out);
+
+// Same over n points; outs[i] receives n values for each selected root.
+// ys may be NULL (y = 0).
+void dag_eval_batch(const DagProgram *p, unsigned mask, const double *xs,
+                    const double *ys, double *const *outs, size_t n);
+
+#endif
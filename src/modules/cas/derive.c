@@ -0,0 +1,232 @@
+#include "derive.h"
+#include "simplify.h"
+#include <math.h>
+#include <string.h>
+
+#define LOG10_E 0.43429448190325182765 // d/du log10(u) = LOG10_E / u
+#define LOG2_E  1.44269504088896340736
+
+typedef struct {
+    Arena *arena;
+    char   var;
+} Deriver;
+
+// Node builders. Each returns NULL if an operand is NULL or the arena is
+// full, so an allocation failure anywhere makes the whole result NULL.
+// simplify_ast rewrites nodes in place, so no node is ever used twice.
+
+static ASTNode *new_node(Deriver *d, NodeType type) {
+    ASTNode *n = arena_alloc(d->arena, sizeof(ASTNode));
+    if (n) {
+        memset(n, 0, sizeof(*n));
+        n->type = type;
+    }
+    return n;
+}
+
+static ASTNode *num(Deriver *d, double v) {
+    ASTNode *n = new_node(d, NODE_NUMBER);
+    if (n) n->number = v;
+    return n;
+}
+
+static ASTNode *bin(Deriver *d, char op, ASTNode *l, ASTNode *r) {
+    if (!l || !r) return NULL;
+    ASTNode *n = new_node(d, NODE_BINOP);
+    if (!n) return NULL;
+    n->binop.op    = op;
+    n->binop.left  = l;
+    n->binop.right = r;
+    return n;
+}
+
+static ASTNode *neg(Deriver *d, ASTNode *a) {
+    if (!a) return NULL;
+    ASTNode *n = new_node(d, NODE_UNARY_NEG);
+    if (n) n->unary.operand = a;
+    return n;
+}
+
+static ASTNode *fn(Deriver *d, FuncId id, ASTNode *a) {
+    if (!a) return NULL;
+    ASTNode *n = new_node(d, NODE_FUNC);
+    if (!n) return NULL;
+    strncpy(n->func.name, parser_func_name(id), sizeof(n->func.name) - 1);
+    n->func.id  = id;
+    n->func.arg = a;
+    return n;
+}
+
+// Deep copy of a subtree of the input
+static ASTNode *clone(Deriver *d, const ASTNode *s) {
+    if (!s) return NULL;
+    switch (s->type) {
+    case NODE_NUMBER:     return num(d, s->number);
+    case NODE_VAR: {
+        ASTNode *n = new_node(d, NODE_VAR);
+        if (n) n->var = s->var;
+        return n;
+    }
+    case NODE_UNARY_NEG:  return neg(d, clone(d, s->unary.operand));
+    case NODE_FUNC:       return fn(d, s->func.id, clone(d, s->func.arg));
+    case NODE_BINOP:
+        return bin(d, s->binop.op, clone(d, s->binop.left), clone(d, s->binop.right));
+    }
+    return NULL;
+}
+
+static bool is_num_val(const ASTNode *n, double v) {
+    return n && n->type == NODE_NUMBER && n->number == v;
+}
+
+// Terms that are exactly 0 or 1 are left out as the tree is built
+static ASTNode *add(Deriver *d, ASTNode *a, ASTNode *b) {
+    if (is_num_val(a, 0.0)) return b;
+    if (is_num_val(b, 0.0)) return a;
+    return bin(d, '+', a, b);
+}
+
+static ASTNode *sub(Deriver *d, ASTNode *a, ASTNode *b) {
+    if (is_num_val(b, 0.0)) return a;
+    if (is_num_val(a, 0.0)) return neg(d, b);
+    return bin(d, '-', a, b);
+}
+
+static ASTNode *mul(Deriver *d, ASTNode *a, ASTNode *b) {
+    if (is_num_val(a, 1.0)) return b;
+    if (is_num_val(b, 1.0)) return a;
+    return bin(d, '*', a, b);
+}
+
+static ASTNode *sqr(Deriver *d, ASTNode *a) { return bin(d, '^', a, num(d, 2.0)); }
+
+// Does s depend on var? eval_ast reads every variable other than y as x.
+static bool depends(const Deriver *d, const ASTNode *s) {
+    if (!s) return false;
+    switch (s->type) {
+    case NODE_NUMBER:     return false;
+    case NODE_VAR:        return (s->var == 'y') == (d->var == 'y');
+    case NODE_UNARY_NEG:  return depends(d, s->unary.operand);
+    case NODE_FUNC:       return depends(d, s->func.arg);
+    case NODE_BINOP:
+        return depends(d, s->binop.left) || depends(d, s->binop.right);
+    }
+    return false;
+}
+
+// g'(u) for a built-in function g
+static ASTNode *outer(Deriver *d, FuncId id, const ASTNode *u) {
+    ASTNode *one = NULL;
+    switch (id) {
+    case FN_SIN:   return fn(d, FN_COS, clone(d, u));
+    case FN_COS:   return neg(d, fn(d, FN_SIN, clone(d, u)));
+    case FN_TAN:   return sqr(d, fn(d, FN_SEC, clone(d, u)));
+    case FN_COT:   return neg(d, sqr(d, fn(d, FN_CSC, clone(d, u))));
+    case FN_SEC:   return mul(d, fn(d, FN_SEC, clone(d, u)), fn(d, FN_TAN, clone(d, u)));
+    case FN_CSC:   return neg(d, mul(d, fn(d, FN_CSC, clone(d, u)), fn(d, FN_COT, clone(d, u))));
+    case FN_ASIN:
+    case FN_ACOS:
+        one = bin(d, '/', num(d, 1.0),
+                  fn(d, FN_SQRT, sub(d, num(d, 1.0), sqr(d, clone(d, u)))));
+        return id == FN_ASIN ? one : neg(d, one);
+    case FN_ATAN:  return bin(d, '/', num(d, 1.0), add(d, num(d, 1.0), sqr(d, clone(d, u))));
+    case FN_SINH:  return fn(d, FN_COSH, clone(d, u));
+    case FN_COSH:  return fn(d, FN_SINH, clone(d, u));
+    case FN_TANH:  return sub(d, num(d, 1.0), sqr(d, fn(d, FN_TANH, clone(d, u))));
+    case FN_ASINH:
+        return bin(d, '/', num(d, 1.0), fn(d, FN_SQRT, add(d, sqr(d, clone(d, u)), num(d, 1.0))));
+    case FN_ACOSH:
+        return bin(d, '/', num(d, 1.0), fn(d, FN_SQRT, sub(d, sqr(d, clone(d, u)), num(d, 1.0))));
+    case FN_ATANH: return bin(d, '/', num(d, 1.0), sub(d, num(d, 1.0), sqr(d, clone(d, u))));
+    case FN_SQRT:  return bin(d, '/', num(d, 0.5), fn(d, FN_SQRT, clone(d, u)));
+    case FN_CBRT:
+        return bin(d, '/', num(d, 1.0), mul(d, sqr(d, fn(d, FN_CBRT, clone(d, u))), num(d, 3.0)));
+    case FN_LOG:   return bin(d, '/', num(d, LOG10_E), clone(d, u));
+    case FN_LN:    return bin(d, '/', num(d, 1.0), clone(d, u));
+    case FN_LOG2:  return bin(d, '/', num(d, LOG2_E), clone(d, u));
+    case FN_EXP:   return fn(d, FN_EXP, clone(d, u));
+    case FN_ABS:   return fn(d, FN_SIGN, clone(d, u));
+    case FN_FLOOR:
+    case FN_CEIL:
+    case FN_ROUND:
+    case FN_SIGN:
+    case FN_SGN:   return num(d, 0.0);
+    default:       return num(d, NAN);
+    }
+}
+
+static ASTNode *diff(Deriver *d, const ASTNode *s) {
+    if (!s) return NULL;
+    if (!depends(d, s)) return num(d, 0.0);
+
+    switch (s->type) {
+    case NODE_NUMBER:
+        return num(d, 0.0);
+
+    case NODE_VAR:
+        return num(d, 1.0);
+
+    case NODE_UNARY_NEG:
+        return neg(d, diff(d, s->unary.operand));
+
+    case NODE_FUNC:
+        // 0 * u' rather than 0, so the result stays NAN where u' is
+        return bin(d, '*', outer(d, s->func.id, s->func.arg), diff(d, s->func.arg));
+
+    case NODE_BINOP: {
+        const ASTNode *l = s->binop.left;
+        const ASTNode *r = s->binop.right;
+        bool dep_l = depends(d, l), dep_r = depends(d, r);
+
+        switch (s->binop.op) {
+        case '+': return add(d, diff(d, l), diff(d, r));
+        case '-': return sub(d, diff(d, l), diff(d, r));
+
+        case '*':
+            if (l == r) return mul(d, mul(d, clone(d, l), diff(d, l)), num(d, 2.0));
+            if (!dep_l) return mul(d, clone(d, l), diff(d, r));
+            if (!dep_r) return mul(d, diff(d, l), clone(d, r));
+            return add(d, mul(d, diff(d, l), clone(d, r)), mul(d, clone(d, l), diff(d, r)));
+
+        case '/':
+            if (!dep_r) return bin(d, '/', diff(d, l), clone(d, r));
+            if (!dep_l)
+                return neg(d, bin(d, '/', mul(d, clone(d, l), diff(d, r)), sqr(d, clone(d, r))));
+            return bin(d, '/',
+                       sub(d, mul(d, diff(d, l), clone(d, r)), mul(d, clone(d, l), diff(d, r))),
+                       sqr(d, clone(d, r)));
+
+        case '^':
+            // Power rule for a fixed exponent: r * l^(r-1) * l'
+            if (!dep_r) {
+                ASTNode *k1 = (r->type == NODE_NUMBER) ? num(d, r->number - 1.0)
+                                                       : sub(d, clone(d, r), num(d, 1.0));
+                return mul(d, mul(d, bin(d, '^', clone(d, l), k1), diff(d, l)), clone(d, r));
+            }
+            // Exponential: l^r * ln(l) * r'
+            if (!dep_l)
+                return mul(d, mul(d, bin(d, '^', clone(d, l), clone(d, r)),
+                                  fn(d, FN_LN, clone(d, l))), diff(d, r));
+            return mul(d, bin(d, '^', clone(d, l), clone(d, r)),
+                       add(d, mul(d, diff(d, r), fn(d, FN_LN, clone(d, l))),
+                           bin(d, '/', mul(d, clone(d, r), diff(d, l)), clone(d, l))));
+
+        case '%':
+            // fmod(l, r) = l - trunc(l/r)*r and trunc(l/r) = (l - l%r)/r
+            if (!dep_r) return diff(d, l);
+            return sub(d, diff(d, l),
+                       mul(d, bin(d, '/', sub(d, clone(d, l), clone(d, s)), clone(d, r)),
+                           diff(d, r)));
+
+        default:
+            return num(d, NAN);
+        }
+    }
+    }
+    return NULL;
+}
+
+ASTNode *derive_ast(const ASTNode *node, char var, Arena *arena) {
+    Deriver d = { arena, var };
+    return simplify_ast(diff(&d, node));
+}
@@ -0,0 +1,17 @@
+#ifndef DERIVE_H
+#define DERIVE_H
+
+#include "parser.h"
+#include "../../utils/arena.h"
+
+// Symbolic derivative of node with respect to var ('x' or 'y'), built
+// from fresh nodes in arena and run through simplify_ast. node is only
+// read, so it may already be interned. Returns NULL when arena runs out.
+//
+// Every function in eval.c has its rule: abs' = sign, the rounding and
+// sign functions have derivative 0, and u^v with both sides depending on
+// var is u^v * (v' ln u + v u'/u). Subtrees that do not depend on var
+// contribute no terms, so f' can be finite at points where f is NAN.
+ASTNode *derive_ast(const ASTNode *node, char var, Arena *arena);
+
+#endif
@@ -1,12 +1,51 @@
 #include "eval.h"
+#include "vecmath.h"
 #include <math.h>
 #include <string.h>
 
+static double fn_cot(double a)  { double s = sin(a); return s != 0.0 ? cos(a) / s : NAN; }
+static double fn_sec(double a)  { double c = cos(a); return c != 0.0 ? 1.0 / c : NAN; }
+static double fn_csc(double a)  { double s = sin(a); return s != 0.0 ? 1.0 / s : NAN; }
+static double fn_sign(double a) { return (a > 0.0) ? 1.0 : (a < 0.0) ? -1.0 : 0.0; }
+static double fn_unknown(double a) { (void)a; return NAN; }
+
+static const EvalFn FUNC_TABLE[FN_COUNT] = {
+    // Trigonometric
+    [FN_SIN]   = sin,    [FN_COS]   = cos,    [FN_TAN]   = tan,
+    [FN_ASIN]  = asin,   [FN_ACOS]  = acos,   [FN_ATAN]  = atan,
+    [FN_COT]   = fn_cot, [FN_SEC]   = fn_sec, [FN_CSC]   = fn_csc,
+    // Hyperbolic
+    [FN_SINH]  = sinh,   [FN_COSH]  = cosh,   [FN_TANH]  = tanh,
+    [FN_ASINH] = asinh,  [FN_ACOSH] = acosh,  [FN_ATANH] = atanh,
+    // Powers / roots
+    [FN_SQRT]  = sqrt,   [FN_CBRT]  = cbrt,
+    // Logarithms
+    [FN_LOG]   = log10,  [FN_LN]    = log,    [FN_LOG2]  = log2,
+    [FN_EXP]   = exp,
+    // Rounding / misc (sgn is the GeoGebra-style alias of sign)
+    [FN_ABS]   = fabs,   [FN_FLOOR] = floor,  [FN_CEIL]  = ceil,
+    [FN_ROUND] = round,  [FN_SIGN]  = fn_sign, [FN_SGN]  = fn_sign,
+    [FN_UNKNOWN] = fn_unknown,
+};
+
+EvalFn eval_func_ptr(FuncId id) {
+    if ((unsigned)id >= FN_COUNT) return fn_unknown;
+    return FUNC_TABLE[id];
+}
+
+double eval_func(FuncId id, double a) {
+    return eval_func_ptr(id)(a);
+}
+
 double eval_ast(const ASTNode *node, double x) {
     return eval_ast_xy(node, x, 0.0);
 }
 
 double eval_ast_xy(const ASTNode *node, double x, double y) {
+    return eval_ast_xyz(node, x, y, 0.0);
+}
+
+double eval_ast_xyz(const ASTNode *node, double x, double y, double z) {
     if (!node) return NAN;
 
     switch (node->type) {
@@ -14,15 +53,18 @@ double eval_ast_xy(const ASTNode *node, double x, double y) {
         return node->number;
 
     case NODE_VAR:
+        if (node->var == 'x') return x;
         if (node->var == 'y') return y;
-        return x;
+        if (node->var == 'z') return z;
+        return NAN;
 
     case NODE_UNARY_NEG:
-        return -eval_ast_xy(node->unary.operand, x, y);
+        return -eval_ast_xyz(node->unary.operand, x, y, z);
 
     case NODE_BINOP: {
-        double l = eval_ast_xy(node->binop.left, x, y);
-        double r = eval_ast_xy(node->binop.right, x, y);
+        double l = eval_ast_xyz(node->binop.left, x, y, z);
+        double r = node->binop.right == node->binop.left
+                 ? l : eval_ast_xyz(node->binop.right, x, y, z);
         switch (node->binop.op) {
             case '+': return l + r;
             case '-': return l - r;
@@ -34,44 +76,186 @@ double eval_ast_xy(const ASTNode *node, double x, double y) {
         }
     }
 
+    case NODE_FUNC:
+        return eval_func(node->func.id, eval_ast_xyz(node->func.arg, x, y, z));
+    }
+    return NAN;
+}
+
+// g'(u) of a built-in function g, given v = g(u)
+static double func_deriv(FuncId id, double u, double v) {
+    switch (id) {
+    case FN_SIN:   return cos(u);
+    case FN_COS:   return -sin(u);
+    case FN_TAN:   return 1.0 + v * v;
+    case FN_ASIN:  return 1.0 / sqrt(1.0 - u * u);
+    case FN_ACOS:  return -1.0 / sqrt(1.0 - u * u);
+    case FN_ATAN:  return 1.0 / (1.0 + u * u);
+    case FN_COT:   return -(1.0 + v * v);
+    case FN_SEC:   return v * tan(u);
+    case FN_CSC:   return -v * fn_cot(u);
+    case FN_SINH:  return cosh(u);
+    case FN_COSH:  return sinh(u);
+    case FN_TANH:  return 1.0 - v * v;
+    case FN_ASINH: return 1.0 / sqrt(u * u + 1.0);
+    case FN_ACOSH: return 1.0 / sqrt(u * u - 1.0);
+    case FN_ATANH: return 1.0 / (1.0 - u * u);
+    case FN_SQRT:  return 0.5 / v;
+    case FN_CBRT:  return 1.0 / (3.0 * v * v);
+    case FN_LOG:   return 1.0 / (u * 2.30258509299404568402); // ln 10
+    case FN_LN:    return 1.0 / u;
+    case FN_LOG2:  return 1.0 / (u * 0.69314718055994530942); // ln 2
+    case FN_EXP:   return v;
+    case FN_ABS:   return fn_sign(u);
+    case FN_FLOOR:
+    case FN_CEIL:
+    case FN_ROUND:
+    case FN_SIGN:
+    case FN_SGN:   return 0.0;
+    default:       return NAN;
+    }
+}
+
+// Chain rule term g * du, which is 0 whenever du is
+static double chain(double g, double du) {
+    return du == 0.0 ? 0.0 : g * du;
+}
+
+EvalDual eval_ast_dual(const ASTNode *node, double x, double y) {
+    EvalDual r = { NAN, NAN, NAN };
+    if (!node) return r;
+
+    switch (node->type) {
+    case NODE_NUMBER:
+        return (EvalDual){ node->number, 0.0, 0.0 };
+
+    case NODE_VAR:
+        if (node->var == 'x') return (EvalDual){ x, 1.0, 0.0 };
+        if (node->var == 'y') return (EvalDual){ y, 0.0, 1.0 };
+        return (EvalDual){ NAN, NAN, NAN };
+
+    case NODE_UNARY_NEG: {
+        EvalDual a = eval_ast_dual(node->unary.operand, x, y);
+        return (EvalDual){ -a.v, -a.dx, -a.dy };
+    }
+
+    case NODE_BINOP: {
+        EvalDual l = eval_ast_dual(node->binop.left, x, y);
+        EvalDual b = node->binop.right == node->binop.left
+                   ? l : eval_ast_dual(node->binop.right, x, y);
+        switch (node->binop.op) {
+        case '+': return (EvalDual){ l.v + b.v, l.dx + b.dx, l.dy + b.dy };
+        case '-': return (EvalDual){ l.v - b.v, l.dx - b.dx, l.dy - b.dy };
+        case '*':
+            r.v  = l.v * b.v;
+            r.dx = chain(b.v, l.dx) + chain(l.v, b.dx);
+            r.dy = chain(b.v, l.dy) + chain(l.v, b.dy);
+            return r;
+        case '/':
+            if (b.v == 0.0) return r;
+            r.v  = l.v / b.v;
+            r.dx = (l.dx - chain(r.v, b.dx)) / b.v;
+            r.dy = (l.dy - chain(r.v, b.dy)) / b.v;
+            return r;
+        case '^':
+            r.v = pow(l.v, b.v);
+            if (b.dx == 0.0 && b.dy == 0.0) {
+                // Fixed exponent: b * l^(b-1)
+                double g = (b.v == 0.0) ? 0.0 : b.v * pow(l.v, b.v - 1.0);
+                r.dx = chain(g, l.dx);
+                r.dy = chain(g, l.dy);
+            } else {
+                // l^b * (b' ln l + b l'/l)
+                double ln_l = log(l.v), b_l = b.v / l.v;
+                r.dx = r.v * (chain(ln_l, b.dx) + chain(b_l, l.dx));
+                r.dy = r.v * (chain(ln_l, b.dy) + chain(b_l, l.dy));
+            }
+            return r;
+        case '%': {
+            if (b.v == 0.0) return r;
+            r.v = fmod(l.v, b.v);
+            double q = (l.v - r.v) / b.v; // trunc(l/b)
+            r.dx = l.dx - chain(q, b.dx);
+            r.dy = l.dy - chain(q, b.dy);
+            return r;
+        }
+        default:
+            return r;
+        }
+    }
+
     case NODE_FUNC: {
-        double a = eval_ast_xy(node->func.arg, x, y);
-        const char *n = node->func.name;
-        // Trigonometric
-        if (strcmp(n, "sin")  == 0) return sin(a);
-        if (strcmp(n, "cos")  == 0) return cos(a);
-        if (strcmp(n, "tan")  == 0) return tan(a);
-        if (strcmp(n, "asin") == 0) return asin(a);
-        if (strcmp(n, "acos") == 0) return acos(a);
-        if (strcmp(n, "atan") == 0) return atan(a);
-        if (strcmp(n, "cot")  == 0) { double s = sin(a); return s != 0.0 ? cos(a) / s : NAN; }
-        if (strcmp(n, "sec")  == 0) { double c = cos(a); return c != 0.0 ? 1.0 / c : NAN; }
-        if (strcmp(n, "csc")  == 0) { double s = sin(a); return s != 0.0 ? 1.0 / s : NAN; }
-        // Hyperbolic
-        if (strcmp(n, "sinh") == 0) return sinh(a);
-        if (strcmp(n, "cosh") == 0) return cosh(a);
-        if (strcmp(n, "tanh") == 0) return tanh(a);
-        if (strcmp(n, "asinh")== 0) return asinh(a);
-        if (strcmp(n, "acosh")== 0) return acosh(a);
-        if (strcmp(n, "atanh")== 0) return atanh(a);
-        // Powers / roots
-        if (strcmp(n, "sqrt") == 0) return sqrt(a);
-        if (strcmp(n, "cbrt") == 0) return cbrt(a);
-        // Logarithms
-        if (strcmp(n, "log")  == 0) return log10(a);
-        if (strcmp(n, "ln")   == 0) return log(a);
-        if (strcmp(n, "log2") == 0) return log2(a);
-        if (strcmp(n, "exp")  == 0) return exp(a);
-        // Rounding / misc
-        if (strcmp(n, "abs")  == 0) return fabs(a);
-        if (strcmp(n, "floor")== 0) return floor(a);
-        if (strcmp(n, "ceil") == 0) return ceil(a);
-        if (strcmp(n, "round")== 0) return round(a);
-        if (strcmp(n, "sign") == 0) return (a > 0.0) ? 1.0 : (a < 0.0) ? -1.0 : 0.0;
-        // GeoGebra-style
-        if (strcmp(n, "sgn")  == 0) return (a > 0.0) ? 1.0 : (a < 0.0) ? -1.0 : 0.0;
-        return NAN;
+        EvalDual a = eval_ast_dual(node->func.arg, x, y);
+        r.v = eval_func(node->func.id, a.v);
+        double g = func_deriv(node->func.id, a.v, r.v);
+        r.dx = chain(g, a.dx);
+        r.dy = chain(g, a.dy);
+        return r;
     }
     }
-    return NAN;
+    return r;
+}
+
+static void fill(double *out, double v, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = v;
+}
+
+// One block (n <= EVAL_BATCH_BLOCK) of eval_ast_batch
+static void eval_block(const ASTNode *node, const double *xs, const double *ys,
+                       double *out, size_t n) {
+    if (!node) { fill(out, NAN, n); return; }
+
+    switch (node->type) {
+    case NODE_NUMBER:
+        fill(out, node->number, n);
+        return;
+
+    case NODE_VAR:
+        if (node->var == 'x')      memcpy(out, xs, n * sizeof(double));
+        else if (node->var != 'y') fill(out, NAN, n);
+        else if (ys)               memcpy(out, ys, n * sizeof(double));
+        else                       fill(out, 0.0, n);
+        return;
+
+    case NODE_UNARY_NEG:
+        eval_block(node->unary.operand, xs, ys, out, n);
+        vecmath_neg(out, out, n);
+        return;
+
+    case NODE_BINOP: {
+        double r[EVAL_BATCH_BLOCK];
+        eval_block(node->binop.left, xs, ys, out, n);
+        const ASTNode *rn = node->binop.right;
+        if (node->binop.op == '^' && rn && rn->type == NODE_NUMBER &&
+            rn->number == floor(rn->number) && fabs(rn->number) <= 64.0) {
+            vecmath_powi(out, out, (int)rn->number, n);
+            return;
+        }
+        if (rn == node->binop.left) memcpy(r, out, n * sizeof(double));
+        else                        eval_block(rn, xs, ys, r, n);
+        switch (node->binop.op) {
+            case '+': vecmath_add(out, out, r, n); return;
+            case '-': vecmath_sub(out, out, r, n); return;
+            case '*': vecmath_mul(out, out, r, n); return;
+            case '/': vecmath_div(out, out, r, n); return;
+            case '^': vecmath_pow(out, out, r, n); return;
+            case '%': vecmath_mod(out, out, r, n); return;
+            default:  fill(out, NAN, n); return;
+        }
+    }
+
+    case NODE_FUNC:
+        eval_block(node->func.arg, xs, ys, out, n);
+        vecmath_func(node->func.id, out, out, n);
+        return;
+    }
+    fill(out, NAN, n);
+}
+
+void eval_ast_batch(const ASTNode *node, const double *xs, const double *ys,
+                    double *out, size_t n) {
+    for (size_t i = 0; i < n; i += EVAL_BATCH_BLOCK) {
+        size_t cnt = n - i < EVAL_BATCH_BLOCK ? n - i : EVAL_BATCH_BLOCK;
+        eval_block(node, xs + i, ys ? ys + i : NULL, out + i, cnt);
+    }
 }
@@ -2,6 +2,7 @@
 #define EVAL_H
 
 #include "parser.h"
+#include <stddef.h>
 
 // Evaluate AST for a given value of x. Returns NAN on error.
 double eval_ast(const ASTNode *node, double x);
@@ -9,4 +10,36 @@ double eval_ast(const ASTNode *node, double x);
 // Evaluate AST for given values of x and y (for 3D surfaces). Returns NAN on error.
 double eval_ast_xy(const ASTNode *node, double x, double y);
 
+// The same with z, for expressions of x, y and z
+double eval_ast_xyz(const ASTNode *node, double x, double y, double z);
+
+// Value of an expression and its partial derivatives at one point
+typedef struct {
+    double v, dx, dy;
+} EvalDual;
+
+// Evaluate f, df/dx and df/dy at (x, y) in a single pass (forward-mode
+// automatic differentiation with dual numbers). v equals eval_ast_xy.
+// A term whose inner derivative is 0 contributes 0, so f = x*sqrt(y) has
+// df/dx = sqrt(y) even where sqrt' is infinite. Any variable but x and y
+// is NAN, value and derivatives.
+EvalDual eval_ast_dual(const ASTNode *node, double x, double y);
+
+// Batched evaluation works through the sample arrays in blocks of this size
+#define EVAL_BATCH_BLOCK 64
+
+// Evaluate AST at n sample points (xs[i], ys[i]) into out. ys may be NULL
+// (y = 0); any other variable is NAN. Uses the SIMD kernels from vecmath.h, so sin/cos/exp/ln may
+// differ from eval_ast_xy by the few ulp documented there.
+void eval_ast_batch(const ASTNode *node, const double *xs, const double *ys,
+                    double *out, size_t n);
+
+typedef double (*EvalFn)(double);
+
+// Apply a built-in function to a single argument. Returns NAN for FN_UNKNOWN.
+double eval_func(FuncId id, double a);
+
+// Resolve a built-in function to a plain function pointer (for compiled code)
+EvalFn eval_func_ptr(FuncId id);
+
 #endif
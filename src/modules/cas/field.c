@@ -0,0 +1,210 @@
+#include "field.h"
+#include "../../utils/workpool.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_CHUNK 1024 // points per sampling task
+#define LINE_CHUNK   32   // seeds per tracing task, stepped together
+#define STILL        1e-12 // |F| below which a line stops
+
+typedef struct {
+    Bytecode *const *code;
+    int              dims, n;
+    const double    *xs, *ys, *zs;
+    double          *out;
+} SampleJob;
+
+static void sample_task(void *ctx, int t, int worker) {
+    (void)worker;
+    const SampleJob *job = ctx;
+    int at = t * SAMPLE_CHUNK, len = job->n - at < SAMPLE_CHUNK ? job->n - at : SAMPLE_CHUNK;
+    for (int k = 0; k < job->dims; k++) {
+        double *out = job->out + (size_t)k * job->n + at;
+        if (job->zs)
+            bytecode_eval_batch_xyz(job->code[k], job->xs + at, job->ys + at, job->zs + at, out,
+                                    (size_t)len);
+        else
+            bytecode_eval_batch(job->code[k], job->xs + at, job->ys + at, out, (size_t)len);
+    }
+}
+
+void field_sample(Bytecode *const code[3], int dims, const double *xs, const double *ys,
+                  const double *zs, int n, double *out) {
+    SampleJob job = { code, dims, n, xs, ys, zs, out };
+    workpool_run(sample_task, &job, (n + SAMPLE_CHUNK - 1) / SAMPLE_CHUNK);
+}
+
+static double norm(const double *f, int dims, int n, int i) {
+    double s = 0.0;
+    for (int k = 0; k < dims; k++) s += f[(size_t)k * n + i] * f[(size_t)k * n + i];
+    return sqrt(s);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+double field_magnitudes(const double *f, int dims, int n, float *mag, Arena *arena) {
+    // The 90th percentile rather than the largest, so one pole does not
+    // shrink every other arrow to nothing
+    ArenaMark mark = arena_mark(arena);
+    double *sorted = arena_alloc(arena, (size_t)n * sizeof(double));
+    int count = 0;
+    for (int i = 0; sorted && i < n; i++) {
+        double len = norm(f, dims, n, i);
+        if (isfinite(len)) sorted[count++] = len;
+    }
+    double typical = 1.0;
+    if (count) {
+        qsort(sorted, (size_t)count, sizeof(double), cmp_double);
+        typical = sorted[(count - 1) * 9 / 10];
+    }
+    arena_rewind(arena, mark);
+    if (!(typical > 0.0)) typical = 1.0;
+
+    for (int i = 0; i < n; i++) {
+        double len = norm(f, dims, n, i);
+        mag[i] = isfinite(len) ? (float)fmin(len / typical, 1.0) : NAN;
+    }
+    return typical;
+}
+
+typedef struct {
+    Bytecode *const *code;
+    int              dims, seed_count;
+    const double    *seeds;
+    double           lo[3], hi[3], h;
+    float           *points;  // FIELD_LINE_MAX a seed, the seed in the middle
+    int             *back, *fwd; // steps taken each way
+    long long        evals[WORKPOOL_MAX_WORKERS];
+} LineJob;
+
+// F / |F| at the m points p into d; ok[i] false where F is undefined or
+// vanishes
+static void direction(LineJob *job, const double (*p)[3], int m, double (*d)[3], bool *ok,
+                      int worker) {
+    double xs[LINE_CHUNK], ys[LINE_CHUNK], zs[LINE_CHUNK], f[3][LINE_CHUNK];
+    for (int i = 0; i < m; i++) {
+        xs[i] = p[i][0];
+        ys[i] = p[i][1];
+        zs[i] = p[i][2];
+    }
+    for (int k = 0; k < job->dims; k++) {
+        if (job->dims == 3) bytecode_eval_batch_xyz(job->code[k], xs, ys, zs, f[k], (size_t)m);
+        else bytecode_eval_batch(job->code[k], xs, ys, f[k], (size_t)m);
+    }
+    for (int i = 0; i < m; i++) {
+        double len = 0.0;
+        for (int k = 0; k < job->dims; k++) len += f[k][i] * f[k][i];
+        len = sqrt(len);
+        ok[i] = isfinite(len) && len > STILL;
+        for (int k = 0; k < 3; k++) d[i][k] = ok[i] && k < job->dims ? f[k][i] / len : 0.0;
+    }
+    job->evals[worker] += m;
+}
+
+static void put_point(const LineJob *job, int seed, int at, const double p[3]) {
+    float *dst = &job->points[((size_t)seed * FIELD_LINE_MAX + FIELD_LINE_STEPS + at) * 3];
+    for (int k = 0; k < 3; k++) dst[k] = (float)p[k];
+}
+
+// Seeds of one chunk, stepped together so that every RK4 stage is one
+// batch per component
+static void line_task(void *ctx, int t, int worker) {
+    LineJob *job = ctx;
+    int first = t * LINE_CHUNK;
+    int count = job->seed_count - first < LINE_CHUNK ? job->seed_count - first : LINE_CHUNK;
+    double h = job->h;
+    bool   closed[LINE_CHUNK] = {0};
+
+    for (int j = 0; j < count; j++) {
+        put_point(job, first + j, 0, &job->seeds[3 * (first + j)]);
+        job->back[first + j] = job->fwd[first + j] = 0;
+    }
+    for (int way = 0; way < 2; way++) {
+        double sgn = way ? -h : h;
+        int    act[LINE_CHUNK], m = 0;
+        double p[LINE_CHUNK][3], q[LINE_CHUNK][3], k[4][LINE_CHUNK][3];
+        bool   ok[4][LINE_CHUNK];
+        for (int j = 0; j < count; j++) {
+            if (closed[j]) continue;
+            memcpy(p[m], &job->seeds[3 * (first + j)], sizeof(p[m]));
+            act[m++] = j;
+        }
+        for (int step = 1; step <= FIELD_LINE_STEPS && m > 0; step++) {
+            static const double STAGE[3] = { 0.5, 0.5, 1.0 };
+            direction(job, (const double (*)[3])p, m, k[0], ok[0], worker);
+            for (int s = 0; s < 3; s++) {
+                for (int i = 0; i < m; i++)
+                    for (int c = 0; c < 3; c++) q[i][c] = p[i][c] + STAGE[s] * sgn * k[s][i][c];
+                direction(job, (const double (*)[3])q, m, k[s + 1], ok[s + 1], worker);
+            }
+
+            int kept = 0;
+            for (int i = 0; i < m; i++) {
+                if (!ok[0][i] || !ok[1][i] || !ok[2][i] || !ok[3][i]) continue;
+                // F turned round within the step: it went through a zero
+                // the samples missed, as at a sink, and would dither there
+                double turn = 0.0;
+                for (int c = 0; c < 3; c++) turn += k[0][i][c] * k[3][i][c];
+                if (turn < 0.0) continue;
+                int j = act[i];
+                const double *seed = &job->seeds[3 * (first + j)];
+                double next[3], d2 = 0.0;
+                bool inside = true;
+                for (int c = 0; c < 3; c++) {
+                    next[c] = p[i][c] + sgn / 6.0 *
+                              (k[0][i][c] + 2.0 * k[1][i][c] + 2.0 * k[2][i][c] + k[3][i][c]);
+                    inside = inside && next[c] >= job->lo[c] && next[c] <= job->hi[c];
+                    d2 += (next[c] - seed[c]) * (next[c] - seed[c]);
+                }
+                // Back at the seed after going round: close the loop there
+                bool home = step > 3 && d2 < 0.36 * h * h;
+                put_point(job, first + j, way ? -step : step, home ? seed : next);
+                if (way) job->back[first + j] = step;
+                else job->fwd[first + j] = step;
+                closed[j] = home;
+                if (!inside || home) continue;
+                memcpy(p[kept], next, sizeof(next));
+                act[kept++] = j;
+            }
+            m = kept;
+        }
+    }
+}
+
+FieldLines field_lines(Bytecode *const code[3], int dims, const double *seeds, int seed_count,
+                       const double lo[3], const double hi[3], double h, Arena *arena) {
+    FieldLines fl = {0};
+    if (seed_count > FIELD_MAX_SEEDS) seed_count = FIELD_MAX_SEEDS;
+    static LineJob job;
+    memset(&job, 0, sizeof(job));
+    job.code       = code;
+    job.dims       = dims;
+    job.seed_count = seed_count;
+    job.seeds      = seeds;
+    job.h          = h;
+    memcpy(job.lo, lo, sizeof(job.lo));
+    memcpy(job.hi, hi, sizeof(job.hi));
+    job.points = arena_alloc(arena, (size_t)seed_count * FIELD_LINE_MAX * 3 * sizeof(float));
+    job.back   = arena_alloc(arena, (size_t)seed_count * sizeof(int));
+    job.fwd    = arena_alloc(arena, (size_t)seed_count * sizeof(int));
+    fl.lengths = arena_alloc(arena, (size_t)seed_count * sizeof(int));
+    if (!job.points || !job.back || !job.fwd || !fl.lengths) return (FieldLines){0};
+    workpool_run(line_task, &job, (seed_count + LINE_CHUNK - 1) / LINE_CHUNK);
+
+    // Lines of two points or more, each run of them moved down in place
+    fl.points = job.points;
+    for (int j = 0; j < seed_count; j++) {
+        int len = job.back[j] + job.fwd[j] + 1;
+        if (len < 2) continue;
+        const float *src = &job.points[((size_t)j * FIELD_LINE_MAX + FIELD_LINE_STEPS - job.back[j]) * 3];
+        memmove(&fl.points[(size_t)fl.point_count * 3], src, (size_t)len * 3 * sizeof(float));
+        fl.lengths[fl.line_count++] = len;
+        fl.point_count += len;
+    }
+    for (int w = 0; w < WORKPOOL_MAX_WORKERS; w++) fl.evals += job.evals[w];
+    return fl;
+}
@@ -0,0 +1,42 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include "parser.h"
+#include "bytecode.h"
+#include "../../utils/arena.h"
+
+#define FIELD_MAX_POINTS 16384 // grid samples per field at most
+#define FIELD_MAX_SEEDS  512   // streamlines per field at most
+#define FIELD_LINE_STEPS 256   // RK4 steps either way from a seed
+#define FIELD_LINE_MAX   (2 * FIELD_LINE_STEPS + 1)
+
+// Vector field F = (code[0], code[1]) of x and y, or (code[0], code[1],
+// code[2]) of x, y and z, at the n points (xs, ys, zs), zs NULL in the
+// plane. Component k of point i goes to out[k * n + i]. Evaluated in
+// batches over the worker pool.
+void field_sample(Bytecode *const code[3], int dims, const double *xs, const double *ys,
+                  const double *zs, int n, double *out);
+
+// |F| of the n samples of field_sample over a typical magnitude, the 90th
+// percentile, and at most 1; NAN where F is undefined. Returns the typical
+// magnitude.
+double field_magnitudes(const double *f, int dims, int n, float *mag, Arena *arena);
+
+typedef struct {
+    float *points;  // x, y, z per point, in plot coordinates (z 0 in the plane)
+    int   *lengths; // points per line, in order
+    int    line_count, point_count;
+    long long evals; // points F was evaluated at
+} FieldLines;
+
+// Streamlines through the seeds (x, y, z each), traced both ways along
+// F / |F| in RK4 steps of length h, so the points are about h apart. A line
+// ends where F is undefined, vanishes or turns round within a step (a
+// sink or source between samples), FIELD_LINE_STEPS on, or at the
+// first point outside the box [lo, hi]; a line that comes back to its seed
+// is closed there. Seeds are traced in batches over the worker pool;
+// arrays come from arena.
+FieldLines field_lines(Bytecode *const code[3], int dims, const double *seeds, int seed_count,
+                       const double lo[3], const double hi[3], double h, Arena *arena);
+
+#endif
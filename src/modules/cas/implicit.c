@@ -0,0 +1,301 @@
+#include "implicit.h"
+#include "interval.h"
+#include "../../utils/workpool.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ROOT_LEAVES (IMPLICIT_ROOT_PX / IMPLICIT_LEAF_PX) // root side, in leaves
+#define MAX_CELLS   (ROOT_LEAVES * ROOT_LEAVES)
+
+// Side of the lattice from (ix, iy), in leaves: right (dir 0) or up (dir 1)
+typedef struct {
+    long long ix, iy;
+    int       dir;
+} Edge;
+
+// Piece of the zero line inside one leaf, between crossings of two sides
+typedef struct ImplicitSegment {
+    Edge   e[2];
+    double x[2], y[2];
+} Segment;
+
+// Square of the quadtree with F at its corners (0,0) (1,0) (1,1) (0,1)
+typedef struct {
+    long long ix, iy;   // lower left, in leaves
+    double    v[4];
+    bool      smooth;   // F is proven free of jumps here, and so in its quarters
+} Cell;
+
+typedef struct {
+    Cell   cells[2][MAX_CELLS];
+    double xs[5 * MAX_CELLS / 4], ys[5 * MAX_CELLS / 4], vs[5 * MAX_CELLS / 4];
+} Scratch;
+
+static Scratch scratch[WORKPOOL_MAX_WORKERS];
+
+// Sides of a cell, each between two corners from the lower lattice point
+static const int SIDE_A[4] = { 0, 1, 3, 0 }, SIDE_B[4] = { 1, 2, 2, 3 };
+
+// Points added by a split, in half cells: the side midpoints, then the centre
+static const int SPLIT_PT[5][2] = { {1, 0}, {2, 1}, {1, 2}, {0, 1}, {1, 1} };
+
+static double lat(const ImplicitJob *job, long long i) {
+    return (double)i * job->leaf;
+}
+
+// Can the zero line cross cell c of side size? Yes where the corners
+// change sign, or where F's bounds over the cell straddle 0. The bounds are
+// also taken where the corners change sign until they prove c smooth, so
+// that most leaves need no pole check of their own.
+static bool may_cross(const ImplicitJob *job, Cell *c, int size) {
+    bool pos = false, neg = false;
+    for (int k = 0; k < 4; k++) {
+        if (c->v[k] > 0.0) pos = true;
+        else if (c->v[k] <= 0.0) neg = true;
+    }
+    if (pos && neg && c->smooth) return true;
+    Interval iv = eval_ast_interval(job->ast, lat(job, c->ix), lat(job, c->ix + size),
+                                    lat(job, c->iy), lat(job, c->iy + size));
+    c->smooth = !iv.jump;
+    return (pos && neg) || (!interval_empty(iv) && iv.lo <= 0.0 && iv.hi >= 0.0);
+}
+
+static void add_segment(ImplicitJob *job, const Segment *s) {
+    int at = atomic_fetch_add(&job->nsegs, 1);
+    if (at < IMPLICIT_MAX_SEGS) job->segs[at] = *s;
+}
+
+// Crossing of side k of leaf c. It is interpolated from the side's lower
+// end, so the two leaves sharing a side put it at exactly the same place.
+static void crossing(const ImplicitJob *job, const Cell *c, int k, Segment *s, int end) {
+    double t = c->v[SIDE_A[k]] / (c->v[SIDE_A[k]] - c->v[SIDE_B[k]]);
+    long long ix = c->ix + (k == 1), iy = c->iy + (k == 2);
+    s->e[end] = (Edge){ ix, iy, k & 1 };
+    s->x[end] = (k & 1) ? lat(job, ix) : lat(job, ix) + t * job->leaf;
+    s->y[end] = (k & 1) ? lat(job, iy) + t * job->leaf : lat(job, iy);
+}
+
+// Marching squares on one leaf
+static void contour_leaf(ImplicitJob *job, const Cell *c) {
+    int mask = 0;
+    for (int k = 0; k < 4; k++) {
+        if (!isfinite(c->v[k])) return;
+        if (c->v[k] > 0.0) mask |= 1 << k;
+    }
+    if (mask == 0 || mask == 15) return;
+    // A sign change across a pole is not a root
+    if (!c->smooth && eval_ast_interval(job->ast, lat(job, c->ix), lat(job, c->ix + 1),
+                                        lat(job, c->iy), lat(job, c->iy + 1)).jump)
+        return;
+
+    int sides[4], n = 0;
+    for (int k = 0; k < 4; k++)
+        if (((mask >> SIDE_A[k]) ^ (mask >> SIDE_B[k])) & 1) sides[n++] = k;
+    Segment s;
+    if (n == 2) {
+        crossing(job, c, sides[0], &s, 0);
+        crossing(job, c, sides[1], &s, 1);
+        add_segment(job, &s);
+        return;
+    }
+    // Saddle: the centre's sign decides which corners are joined. Where it
+    // matches corner 0, lines cut off corners 1 and 3, else corners 0 and 2.
+    double centre = 0.25 * (c->v[0] + c->v[1] + c->v[2] + c->v[3]);
+    bool   with0  = (centre > 0.0) == (c->v[0] > 0.0);
+    static const int PAIRS[2][4] = { { 3, 0, 1, 2 }, { 0, 1, 2, 3 } };
+    for (int p = 0; p < 2; p++) {
+        crossing(job, c, PAIRS[with0][2 * p], &s, 0);
+        crossing(job, c, PAIRS[with0][2 * p + 1], &s, 1);
+        add_segment(job, &s);
+    }
+}
+
+// Refine one root level by level, every new corner of a level in one batch
+static void trace_root(void *ctx, int r, int worker) {
+    ImplicitJob *job = ctx;
+    Scratch  *sc  = &scratch[worker];
+    Cell *cur = sc->cells[0], *next = sc->cells[1];
+
+    cur[0].ix = (job->rx0 + r % job->rw) * ROOT_LEAVES;
+    cur[0].iy = (job->ry0 + r / job->rw) * ROOT_LEAVES;
+    cur[0].smooth = false;
+    for (int k = 0; k < 4; k++) {
+        sc->xs[k] = lat(job, cur[0].ix + ROOT_LEAVES * (k == 1 || k == 2));
+        sc->ys[k] = lat(job, cur[0].iy + ROOT_LEAVES * (k >= 2));
+    }
+    bytecode_eval_batch(job->code, sc->xs, sc->ys, cur[0].v, 4);
+    int n = 1, evals = 4;
+
+    for (int size = ROOT_LEAVES; size > 1; size /= 2) {
+        int m = 0;
+        for (int i = 0; i < n; i++)
+            if (may_cross(job, &cur[i], size)) cur[m++] = cur[i];
+
+        int h = size / 2;
+        for (int i = 0; i < m; i++) {
+            for (int k = 0; k < 5; k++) {
+                sc->xs[5 * i + k] = lat(job, cur[i].ix + SPLIT_PT[k][0] * h);
+                sc->ys[5 * i + k] = lat(job, cur[i].iy + SPLIT_PT[k][1] * h);
+            }
+        }
+        bytecode_eval_batch(job->code, sc->xs, sc->ys, sc->vs, (size_t)(5 * m));
+        evals += 5 * m;
+
+        for (int i = 0; i < m; i++) {
+            // F on the 3x3 points of the cell, by half cells [y][x]
+            const double *v = cur[i].v, *w = &sc->vs[5 * i];
+            double g[3][3] = {
+                { v[0], w[0], v[1] },
+                { w[3], w[4], w[1] },
+                { v[3], w[2], v[2] },
+            };
+            for (int b = 0; b < 2; b++) {
+                for (int a = 0; a < 2; a++) {
+                    Cell *ch = &next[4 * i + 2 * b + a];
+                    ch->ix   = cur[i].ix + a * h;
+                    ch->iy   = cur[i].iy + b * h;
+                    ch->v[0] = g[b][a];
+                    ch->v[1] = g[b][a + 1];
+                    ch->v[2] = g[b + 1][a + 1];
+                    ch->v[3] = g[b + 1][a];
+                    ch->smooth = cur[i].smooth;
+                }
+            }
+        }
+        Cell *t = cur; cur = next; next = t;
+        n = 4 * m;
+    }
+
+    for (int i = 0; i < n; i++) contour_leaf(job, &cur[i]);
+    atomic_fetch_add(&job->evals, evals);
+}
+
+// ---- Joining segments into lines ----
+
+// Segments ending on a lattice side; there are at most two
+typedef struct {
+    Edge key;
+    int  seg[2]; // -1 when free; seg[0] == -1 marks an empty slot
+} EdgeSlot;
+
+typedef struct {
+    EdgeSlot *slots;
+    size_t    mask;
+} EdgeMap;
+
+static bool edge_eq(Edge a, Edge b) {
+    return a.ix == b.ix && a.iy == b.iy && a.dir == b.dir;
+}
+
+static size_t edge_hash(Edge e) {
+    uint64_t h = (uint64_t)e.ix * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)e.iy * 0xC2B2AE3D27D4EB4Full + (uint64_t)e.dir;
+    return (size_t)(h ^ (h >> 29));
+}
+
+static EdgeSlot *edge_slot(EdgeMap *m, Edge e) {
+    size_t i = edge_hash(e) & m->mask;
+    while (m->slots[i].seg[0] >= 0 && !edge_eq(m->slots[i].key, e)) i = (i + 1) & m->mask;
+    return &m->slots[i];
+}
+
+// Segment meeting s at its end j, and which of its ends meets it; -1 if none
+static int next_seg(EdgeMap *m, const Segment *segs, int s, int j, int *enter) {
+    const EdgeSlot *sl = edge_slot(m, segs[s].e[j]);
+    int n = (sl->seg[0] == s) ? sl->seg[1] : sl->seg[0];
+    if (n < 0) return -1;
+    *enter = edge_eq(segs[n].e[0], segs[s].e[j]) ? 0 : 1;
+    return n;
+}
+
+// Lines of segs[0..n), with points from out and scratch from arena
+static ImplicitTrace join_segments(const Segment *segs, int n, Arena *out, Arena *arena) {
+    ImplicitTrace tr = { NULL, 0, 0 };
+
+    // Index the segments by the sides they end on
+    size_t cap = 16;
+    while (cap < 2 * (size_t)n) cap *= 2;
+    EdgeMap map = { arena_alloc(arena, cap * sizeof(EdgeSlot)), cap - 1 };
+    bool *used  = arena_alloc(arena, (size_t)n * sizeof(bool));
+    tr.pts      = arena_alloc(out, 2 * (size_t)n * sizeof(ImplicitPoint));
+    if (!map.slots || !used || !tr.pts) {
+        tr.pts = NULL;
+        return tr;
+    }
+    for (size_t i = 0; i < cap; i++) map.slots[i].seg[0] = map.slots[i].seg[1] = -1;
+    memset(used, 0, (size_t)n * sizeof(bool));
+    for (int s = 0; s < n; s++) {
+        for (int j = 0; j < 2; j++) {
+            EdgeSlot *sl = edge_slot(&map, segs[s].e[j]);
+            sl->key = segs[s].e[j];
+            sl->seg[sl->seg[0] >= 0] = s;
+        }
+    }
+
+    for (int s0 = 0; s0 < n; s0++) {
+        if (used[s0]) continue;
+        // Back up to the line's first segment, or once round a loop
+        int s = s0, out = 0, enter = 0;
+        for (int steps = 0; steps < n; steps++) {
+            int p = next_seg(&map, segs, s, out, &enter);
+            if (p < 0 || p == s0) break;
+            s   = p;
+            out = 1 - enter;
+        }
+        // Then follow it: s starts at its end out
+        tr.pts[tr.count++] = (ImplicitPoint){ segs[s].x[out], segs[s].y[out], true };
+        int in = out;
+        while (s >= 0 && !used[s]) {
+            used[s] = true;
+            tr.pts[tr.count++] = (ImplicitPoint){ segs[s].x[1 - in], segs[s].y[1 - in], false };
+            s  = next_seg(&map, segs, s, 1 - in, &enter);
+            in = enter;
+        }
+    }
+    return tr;
+}
+
+ImplicitTrace implicit_trace(ImplicitCache *cache, unsigned gen, const Bytecode *code,
+                             const ASTNode *ast, double x_min, double x_max, double y_min,
+                             double y_max, double scale, Arena *arena) {
+    double view[IMPLICIT_VIEW] = { x_min, x_max, y_min, y_max, scale };
+    if (cache->built && cache->gen == gen && memcmp(cache->view, view, sizeof(view)) == 0) {
+        ImplicitTrace tr = cache->trace;
+        tr.evals = 0;
+        return tr;
+    }
+    if (!cache->arena.stats) cache->arena = arena_create_ex(ARENA_DEFAULT_CAP, 0, "implicit");
+    arena_reset(&cache->arena);
+    cache->built = true;
+    cache->gen   = gen;
+    memcpy(cache->view, view, sizeof(view));
+    cache->trace = (ImplicitTrace){ NULL, 0, 0 };
+    if (!code || !ast) return cache->trace;
+
+    ImplicitJob *job = &cache->job;
+    ArenaMark mark = arena_mark(arena);
+    job->code = code;
+    job->ast  = ast;
+    job->leaf = IMPLICIT_LEAF_PX / scale;
+    double root = job->leaf * ROOT_LEAVES;
+    job->rx0 = (long long)floor(x_min / root);
+    job->ry0 = (long long)floor(y_min / root);
+    job->rw  = (int)((long long)floor(x_max / root) - job->rx0 + 1);
+    int rh   = (int)((long long)floor(y_max / root) - job->ry0 + 1);
+    job->segs = arena_alloc(arena, IMPLICIT_MAX_SEGS * sizeof(Segment));
+    if (!job->segs) return cache->trace;
+    atomic_store(&job->nsegs, 0);
+    atomic_store(&job->evals, 0);
+
+    workpool_run(trace_root, job, job->rw * rh);
+
+    int n = atomic_load(&job->nsegs);
+    if (n > IMPLICIT_MAX_SEGS) n = IMPLICIT_MAX_SEGS;
+    if (n > 0) cache->trace = join_segments(job->segs, n, &cache->arena, arena);
+    cache->trace.evals = atomic_load(&job->evals);
+    job->segs = NULL;
+    arena_rewind(arena, mark);
+    return cache->trace;
+}
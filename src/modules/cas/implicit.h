@@ -0,0 +1,66 @@
+#ifndef IMPLICIT_H
+#define IMPLICIT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "parser.h"
+#include "bytecode.h"
+#include "../../utils/arena.h"
+
+#define IMPLICIT_LEAF_PX  2     // finest cell, in pixels
+#define IMPLICIT_ROOT_PX  64    // quadtree root, in pixels; leaf * 2^k
+#define IMPLICIT_MAX_SEGS 32768 // segments traced per relation and frame
+
+// Point of a traced line; start marks the first point of each line
+typedef struct {
+    double x, y;
+    bool   start;
+} ImplicitPoint;
+
+typedef struct {
+    ImplicitPoint *pts;
+    int            count;
+    int            evals; // points F was evaluated at
+} ImplicitTrace;
+
+typedef struct ImplicitSegment ImplicitSegment; // piece of a line in one leaf, in implicit.c
+
+// What the workers share while they trace the roots of one view
+typedef struct {
+    const Bytecode  *code;
+    const ASTNode   *ast;
+    double           leaf;     // leaf side in units
+    long long        rx0, ry0; // first root, in roots
+    int              rw;       // roots across
+    ImplicitSegment *segs;
+    atomic_int       nsegs;
+    atomic_int       evals;
+} ImplicitJob;
+
+// Lines of a relation as last traced, kept until the relation or the view
+// changes: x_min, x_max, y_min, y_max and scale
+#define IMPLICIT_VIEW 5
+
+typedef struct {
+    Arena         arena; // owns the points; reset on every retrace
+    bool          built;
+    unsigned      gen;   // FuncSlot.gen they were traced for
+    double        view[IMPLICIT_VIEW];
+    ImplicitTrace trace;
+    ImplicitJob   job;
+} ImplicitCache;
+
+// Lines of F(x, y) = 0 over the view [x_min, x_max] x [y_min, y_max] at
+// scale pixels per unit, where code is F compiled and ast its tree for
+// the interval evaluator. Cells are squares of a quadtree on the lattice
+// x, y = k * IMPLICIT_LEAF_PX / scale, so the lines stay put as the view
+// pans. A cell is split only where F changes sign at its corners or its
+// interval bounds straddle 0; the leaves are contoured by marching squares
+// and the segments joined into lines. The lines are kept in cache and
+// handed back as they are, with no evals, while gen and the view stay the
+// same; arena is for scratch.
+ImplicitTrace implicit_trace(ImplicitCache *cache, unsigned gen, const Bytecode *code,
+                             const ASTNode *ast, double x_min, double x_max, double y_min,
+                             double y_max, double scale, Arena *arena);
+
+#endif
@@ -0,0 +1,344 @@
+#include "implicit3d.h"
+#include "interval.h"
+#include "../../utils/workpool.h"
+#include <math.h>
+#include <string.h>
+
+#define SIDE       (IMPLICIT3D_RES / IMPLICIT3D_BRICK) // bricks a side
+#define MAX_BRICKS (SIDE * SIDE * SIDE)
+#define N          IMPLICIT3D_BRICK
+#define S          (N + 3) // samples a side of a brick: its lattice and one voxel around
+#define V          (N + 2) // voxels a side that may get a vertex: its own and one around
+#define MAX_QUADS  (3 * N * N * N)
+
+// Octree cell, in bricks: corner (x, y, z), SIDE >> level bricks a side
+typedef struct {
+    short x, y, z;
+} OctCell;
+
+// One brick's mesh, in its worker's arena until it is packed into parts
+typedef struct {
+    float          *vertices, *normals;
+    unsigned short *indices;
+    int             vertex_count, index_count;
+    int             evals;
+} BrickMesh;
+
+typedef struct {
+    double         xs[S * S * S], ys[S * S * S], zs[S * S * S], f[S * S * S];
+    float          pos[V * V * V][3], nrm[V * V * V][3];
+    int            vid[V * V * V];   // vertex of a voxel, -1 if none
+    int            out[V * V * V];   // a vertex's index in the brick's mesh, -1 if unused
+    int            used[V * V * V];  // vertices in the brick's mesh, in order
+    unsigned short idx[MAX_QUADS * 6];
+} Scratch;
+
+typedef struct {
+    const Bytecode *code;
+    const ASTNode  *ast;
+    double          range, h;     // h: voxel side
+    int             level;        // of the cells being tested
+    const OctCell  *cells;
+    unsigned char  *keep;         // per cell: 0 no surface, 1 maybe, 2 maybe with a jump
+    BrickMesh      *bricks;
+} MeshJob;
+
+// Per worker, from implicit3d_init: sampling scratch, and the arena its
+// bricks are meshed into until they are packed. Workers fill the arenas at
+// once, so they have no owner, whose counters would be shared; the packed
+// mesh is counted in the caller's arena.
+static Arena    state; // owns scratch and brick_arena
+static Scratch *scratch;
+static Arena   *brick_arena;
+static int      workers;
+
+// Corners of a voxel as sample offsets, bit 0 x, bit 1 y, bit 2 z, and
+// its edges as pairs of them
+static const int EDGE_A[12] = { 0, 2, 4, 6, 0, 1, 4, 5, 0, 1, 2, 3 };
+static const int EDGE_B[12] = { 1, 3, 5, 7, 2, 3, 6, 7, 4, 5, 6, 7 };
+
+static const int AXIS[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+// Triangles of a quad's four voxels, counter-clockwise about the edge's
+// axis and back
+static const int QUAD_FWD[6] = { 0, 1, 2, 0, 2, 3 };
+static const int QUAD_REV[6] = { 0, 2, 1, 0, 3, 2 };
+
+// Lattice coordinate i along any axis
+static double lat(const MeshJob *job, double i) {
+    return -job->range + i * job->h;
+}
+
+static int sample_at(int a, int b, int c) { return (c * S + b) * S + a; }
+static int voxel_at(int a, int b, int c)  { return (c * V + b) * V + a; }
+
+// May cell index of the level hold a piece of the surface? Yes where F's
+// bounds over it straddle 0.
+static void test_cell(void *ctx, int index, int worker) {
+    (void)worker;
+    MeshJob *job = ctx;
+    const OctCell *c = &job->cells[index];
+    int side = (SIDE >> job->level) * N;
+    Interval iv = eval_ast_interval_xyz(job->ast, lat(job, c->x * N), lat(job, c->x * N + side),
+                                        lat(job, c->y * N), lat(job, c->y * N + side),
+                                        lat(job, c->z * N), lat(job, c->z * N + side));
+    bool maybe = !interval_empty(iv) && iv.lo <= 0.0 && iv.hi >= 0.0;
+    job->keep[index] = !maybe ? 0 : iv.jump ? 2 : 1;
+}
+
+// Sample brick index with one voxel around it, place a vertex in each
+// voxel the surface crosses, at the mean of its edge crossings, and join
+// them across the lattice edges the brick owns: those starting inside it.
+static void mesh_brick(void *ctx, int index, int worker) {
+    MeshJob *job = ctx;
+    const OctCell *c = &job->cells[index];
+    Scratch *s = &scratch[worker];
+    BrickMesh *out = &job->bricks[index];
+    *out = (BrickMesh){0};
+    int ox = c->x * N - 1, oy = c->y * N - 1, oz = c->z * N - 1; // sample 0 lies a voxel out
+
+    for (int k = 0; k < S; k++)
+        for (int j = 0; j < S; j++)
+            for (int i = 0; i < S; i++) {
+                int p = sample_at(i, j, k);
+                s->xs[p] = lat(job, ox + i);
+                s->ys[p] = lat(job, oy + j);
+                s->zs[p] = lat(job, oz + k);
+            }
+    bytecode_eval_batch_xyz(job->code, s->xs, s->ys, s->zs, s->f, S * S * S);
+    out->evals = S * S * S;
+
+    // Vertices, with the gradient of the voxel's trilinear blend as normal
+    int verts = 0;
+    for (int k = 0; k < V; k++) {
+        for (int j = 0; j < V; j++) {
+            for (int i = 0; i < V; i++) {
+                int v = voxel_at(i, j, k);
+                s->vid[v] = -1;
+                double f[8];
+                int neg = 0;
+                bool finite = true;
+                for (int q = 0; q < 8; q++) {
+                    f[q] = s->f[sample_at(i + (q & 1), j + (q >> 1 & 1), k + (q >> 2))];
+                    finite = finite && isfinite(f[q]);
+                    neg |= (f[q] < 0.0) << q;
+                }
+                if (!finite || neg == 0 || neg == 255) continue;
+                // A sign change across a pole is not a root
+                if (job->keep[index] == 2 &&
+                    eval_ast_interval_xyz(job->ast, lat(job, ox + i), lat(job, ox + i + 1),
+                                          lat(job, oy + j), lat(job, oy + j + 1),
+                                          lat(job, oz + k), lat(job, oz + k + 1)).jump)
+                    continue;
+
+                double p[3] = {0}, n = 0.0;
+                for (int e = 0; e < 12; e++) {
+                    int a = EDGE_A[e], b = EDGE_B[e];
+                    if (((neg >> a) & 1) == ((neg >> b) & 1)) continue;
+                    double t = f[a] / (f[a] - f[b]);
+                    for (int d = 0; d < 3; d++) {
+                        double ca = (a >> d) & 1, cb = (b >> d) & 1;
+                        p[d] += ca + t * (cb - ca);
+                    }
+                    n += 1.0;
+                }
+                for (int d = 0; d < 3; d++) p[d] /= n;
+
+                double g[3] = {0};
+                for (int q = 0; q < 8; q++) {
+                    double w[3], dw[3];
+                    for (int d = 0; d < 3; d++) {
+                        bool hi = (q >> d) & 1;
+                        w[d]  = hi ? p[d] : 1.0 - p[d];
+                        dw[d] = hi ? 1.0 : -1.0;
+                    }
+                    g[0] += f[q] * dw[0] * w[1] * w[2];
+                    g[1] += f[q] * w[0] * dw[1] * w[2];
+                    g[2] += f[q] * w[0] * w[1] * dw[2];
+                }
+                double len = sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+                s->vid[v] = verts;
+                s->pos[verts][0] = (float)lat(job, ox + i + p[0]);
+                s->pos[verts][1] = (float)lat(job, oy + j + p[1]);
+                s->pos[verts][2] = (float)lat(job, oz + k + p[2]);
+                for (int d = 0; d < 3; d++)
+                    s->nrm[verts][d] = len > 0.0 ? (float)(g[d] / len) : (d == 2);
+                verts++;
+            }
+        }
+    }
+
+
+    // A quad across each owned lattice edge the sign changes along, from
+    // the four voxels around it, wound to face up the gradient. Edges on
+    // the cube's low faces are left out so the mesh stops at its walls.
+    int g0[3] = { c->x * N, c->y * N, c->z * N };
+    for (int v = 0; v < verts; v++) s->out[v] = -1;
+    int used = 0, indices = 0;
+    for (int d = 0; d < 3; d++) {
+        int u = (d + 1) % 3, w = (d + 2) % 3;
+        for (int qk = 0; qk < N; qk++) {
+            for (int qj = 0; qj < N; qj++) {
+                for (int qi = 0; qi < N; qi++) {
+                    int q[3] = { qi, qj, qk };
+                    if (g0[u] + q[u] == 0 || g0[w] + q[w] == 0) continue;
+                    double f0 = s->f[sample_at(qi + 1, qj + 1, qk + 1)];
+                    double f1 = s->f[sample_at(qi + 1 + AXIS[d][0], qj + 1 + AXIS[d][1], qk + 1 + AXIS[d][2])];
+                    if ((f0 < 0.0) == (f1 < 0.0)) continue;
+
+                    int b[3] = { qi + 1, qj + 1, qk + 1 };
+                    int corner[4][3];
+                    for (int m = 0; m < 4; m++) {
+                        int du = (m == 0 || m == 3), dw = (m == 0 || m == 1);
+                        for (int a = 0; a < 3; a++) corner[m][a] = b[a] - du * AXIS[u][a] - dw * AXIS[w][a];
+                    }
+                    int id[4];
+                    bool whole = true;
+                    for (int m = 0; m < 4 && whole; m++) {
+                        id[m] = s->vid[voxel_at(corner[m][0], corner[m][1], corner[m][2])];
+                        whole = id[m] >= 0;
+                    }
+                    if (!whole) continue;
+                    for (int m = 0; m < 4; m++) {
+                        if (s->out[id[m]] < 0) {
+                            s->out[id[m]] = used;
+                            s->used[used++] = id[m];
+                        }
+                        id[m] = s->out[id[m]];
+                    }
+                    const int *order = f0 > 0.0 ? QUAD_REV : QUAD_FWD;
+                    for (int t = 0; t < 6; t++) s->idx[indices++] = (unsigned short)id[order[t]];
+                }
+            }
+        }
+    }
+    if (indices == 0) return;
+
+    Arena *a = &brick_arena[worker];
+    out->vertices = arena_alloc(a, (size_t)used * 3 * sizeof(float));
+    out->normals  = arena_alloc(a, (size_t)used * 3 * sizeof(float));
+    out->indices  = arena_alloc(a, (size_t)indices * sizeof(unsigned short));
+    if (!out->vertices || !out->normals || !out->indices) return;
+    for (int v = 0; v < used; v++) {
+        memcpy(out->vertices + 3 * v, s->pos[s->used[v]], 3 * sizeof(float));
+        memcpy(out->normals + 3 * v, s->nrm[s->used[v]], 3 * sizeof(float));
+    }
+    memcpy(out->indices, s->idx, (size_t)indices * sizeof(unsigned short));
+    out->vertex_count = used;
+    out->index_count  = indices;
+}
+
+ImplicitMesh implicit3d_mesh(const Bytecode *code, const ASTNode *ast, double range,
+                             Arena *arena) {
+    static OctCell       cells[2][MAX_BRICKS];
+    static unsigned char keep[MAX_BRICKS];
+    static BrickMesh     bricks[MAX_BRICKS];
+    ImplicitMesh result = {0};
+    if (!scratch) return result;
+    MeshJob job = { .code = code, .ast = ast, .range = range,
+                    .h = 2.0 * range / IMPLICIT3D_RES, .keep = keep, .bricks = bricks };
+
+    // Down the octree a level at a time; the last level is the bricks
+    int count = 1, cur = 0;
+    cells[0][0] = (OctCell){0};
+    for (int level = 0;; level++) {
+        job.level = level;
+        job.cells = cells[cur];
+        workpool_run(test_cell, &job, count);
+        int side = SIDE >> level, next = 0;
+        if (side == 1) {
+            for (int i = 0; i < count; i++)
+                if (keep[i]) {
+                    cells[cur][next] = cells[cur][i];
+                    keep[next++] = keep[i];
+                }
+            count = next;
+            break;
+        }
+        int half = side / 2;
+        for (int i = 0; i < count; i++) {
+            if (!keep[i]) continue;
+            const OctCell *c = &cells[cur][i];
+            for (int ch = 0; ch < 8; ch++)
+                cells[!cur][next++] = (OctCell){ (short)(c->x + (ch & 1) * half),
+                                                 (short)(c->y + (ch >> 1 & 1) * half),
+                                                 (short)(c->z + (ch >> 2) * half) };
+        }
+        count = next;
+        cur = !cur;
+        if (count == 0) return result;
+    }
+    result.bricks = count;
+    if (count == 0) return result;
+
+    for (int w = 0; w < workers; w++) arena_reset(&brick_arena[w]);
+    job.cells = cells[cur];
+    workpool_run(mesh_brick, &job, count);
+
+    // Pack the bricks into parts of up to IMPLICIT3D_PART vertices
+    int parts = 0, verts = 0;
+    for (int i = 0; i < count; i++) {
+        result.evals += bricks[i].evals;
+        if (bricks[i].index_count == 0) continue;
+        if (parts == 0 || verts + bricks[i].vertex_count > IMPLICIT3D_PART) {
+            parts++;
+            verts = 0;
+        }
+        verts += bricks[i].vertex_count;
+    }
+    if (parts == 0) return result;
+    result.parts = arena_alloc(arena, (size_t)parts * sizeof(ImplicitPart));
+    if (!result.parts) return result;
+    memset(result.parts, 0, (size_t)parts * sizeof(ImplicitPart));
+
+    int first = 0;
+    while (first < count) {
+        int vc = 0, ic = 0, last = first;
+        for (; last < count; last++) {
+            if (vc > 0 && vc + bricks[last].vertex_count > IMPLICIT3D_PART) break;
+            vc += bricks[last].vertex_count;
+            ic += bricks[last].index_count;
+        }
+        if (ic > 0) {
+            ImplicitPart *p = &result.parts[result.part_count];
+            p->vertices = arena_alloc(arena, (size_t)vc * 3 * sizeof(float));
+            p->normals  = arena_alloc(arena, (size_t)vc * 3 * sizeof(float));
+            p->indices  = arena_alloc(arena, (size_t)ic * sizeof(unsigned short));
+            if (!p->vertices || !p->normals || !p->indices) return result;
+            for (int i = first; i < last; i++) {
+                const BrickMesh *b = &bricks[i];
+                if (b->index_count == 0) continue;
+                memcpy(p->vertices + 3 * p->vertex_count, b->vertices, (size_t)b->vertex_count * 3 * sizeof(float));
+                memcpy(p->normals + 3 * p->vertex_count, b->normals, (size_t)b->vertex_count * 3 * sizeof(float));
+                for (int k = 0; k < b->index_count; k++)
+                    p->indices[p->index_count + k] = (unsigned short)(b->indices[k] + p->vertex_count);
+                p->vertex_count += b->vertex_count;
+                p->index_count  += b->index_count;
+            }
+            result.triangles += p->index_count / 3;
+            result.part_count++;
+        }
+        first = last;
+    }
+    return result;
+}
+
+void implicit3d_init(void) {
+    if (scratch) return;
+    workers     = workpool_workers();
+    state       = arena_create_ex(0, 0, "implicit3d");
+    scratch     = arena_alloc(&state, (size_t)workers * sizeof(Scratch));
+    brick_arena = arena_alloc(&state, (size_t)workers * sizeof(Arena));
+    if (!scratch || !brick_arena) {
+        implicit3d_release();
+        return;
+    }
+    for (int w = 0; w < workers; w++) brick_arena[w] = arena_create(ARENA_DEFAULT_CAP);
+}
+
+void implicit3d_release(void) {
+    for (int w = 0; scratch && brick_arena && w < workers; w++) arena_destroy(&brick_arena[w]);
+    arena_destroy(&state);
+    scratch     = NULL;
+    brick_arena = NULL;
+    workers     = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef IMPLICIT3D_H
+#define IMPLICIT3D_H
+
+#include "parser.h"
+#include "bytecode.h"
+#include "../../utils/arena.h"
+
+#define IMPLICIT3D_RES   256   // voxels a side of the cube
+#define IMPLICIT3D_BRICK 16    // voxels a side of an octree leaf
+#define IMPLICIT3D_PART  65535 // vertices per part, for 16-bit indices
+
+// Piece of a surface mesh, small enough for 16-bit indices
+typedef struct {
+    float          *vertices; // x, y, z per vertex, in plot coordinates
+    float          *normals;  // unit, along the gradient of F
+    unsigned short *indices;  // triangles
+    int             vertex_count, index_count;
+} ImplicitPart;
+
+typedef struct {
+    ImplicitPart *parts;
+    int           part_count;
+    int           triangles;
+    int           bricks; // leaves sampled, of (RES / BRICK)^3
+    long long     evals;  // points F was evaluated at
+} ImplicitMesh;
+
+// Surface F(x, y, z) = 0 in the cube [-range, range]^3 on a lattice of
+// IMPLICIT3D_RES voxels a side, where code is F compiled and ast its tree
+// for the interval evaluator. An octree of bricks is split, a level at a
+// time over the worker pool, only where F's bounds over a cell straddle
+// 0; the bricks left are sampled on the pool and meshed by surface nets,
+// one vertex per voxel the surface passes through and a quad across each
+// lattice edge where F changes sign. A voxel whose bounds show F jumping
+// across it is taken for a pole and gets no vertex. Arrays come from
+// arena. Empty until implicit3d_init.
+ImplicitMesh implicit3d_mesh(const Bytecode *code, const ASTNode *ast, double range,
+                             Arena *arena);
+
+// Allocate the mesher's per-worker scratch, one for each of
+// workpool_workers(); call after workpool_init
+void implicit3d_init(void);
+// Free it, with the blocks of the per-worker arenas bricks are meshed
+// into, which are kept between meshes for reuse
+void implicit3d_release(void);
+
+#endif
@@ -0,0 +1,397 @@
+#include "interval.h"
+#include "eval.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#define TWO_PI (2.0 * M_PI)
+
+static Interval iv_make(double lo, double hi) { return (Interval){lo, hi, false, false}; }
+static Interval iv_empty(void) { return (Interval){INFINITY, -INFINITY, true, false}; }
+static Interval iv_all(void)   { return (Interval){-INFINITY, INFINITY, true, true}; }
+
+// Carry the undef/jump flags of an operand over to a result
+static Interval iv_from(Interval r, Interval a) {
+    r.undef |= a.undef;
+    r.jump  |= a.jump;
+    return r;
+}
+
+static Interval iv_hull(Interval a, Interval b) {
+    Interval r = iv_from(a, b);
+    r.lo = fmin(a.lo, b.lo);
+    r.hi = fmax(a.hi, b.hi);
+    return r;
+}
+
+static double down(double v) { return nextafter(v, -INFINITY); }
+static double up(double v)   { return nextafter(v,  INFINITY); }
+
+// A libm result one ulp outward, except the exact zeros f(0) = 0 of the
+// odd functions and f(1) = 0 of the logarithms and acos
+static double fn_dn(double f, double arg) { return (f == 0.0 && (arg == 0.0 || arg == 1.0)) ? f : down(f); }
+static double fn_up(double f, double arg) { return (f == 0.0 && (arg == 0.0 || arg == 1.0)) ? f : up(f); }
+
+// ---- Directed rounding ----
+// The round-to-nearest result is stepped one ulp outward only when the
+// error-free transform says the exact result lies beyond it. NAN from
+// inf-inf or inf/inf becomes the widest bound; an overflow of finite
+// operands stops at DBL_MAX.
+
+static double add_dn(double a, double b) {
+    double s = a + b;
+    if (isnan(s)) return -INFINITY;
+    if (isinf(s)) return (s > 0 && isfinite(a) && isfinite(b)) ? DBL_MAX : s;
+    double bb = s - a;
+    double err = (a - (s - bb)) + (b - bb);
+    return err < 0.0 ? down(s) : s;
+}
+
+static double add_up(double a, double b) {
+    double s = a + b;
+    if (isnan(s)) return INFINITY;
+    if (isinf(s)) return (s < 0 && isfinite(a) && isfinite(b)) ? -DBL_MAX : s;
+    double bb = s - a;
+    double err = (a - (s - bb)) + (b - bb);
+    return err > 0.0 ? up(s) : s;
+}
+
+// 0 * inf is taken as 0: the bound of a zero factor times anything finite
+static double mul_dn(double a, double b) {
+    if (a == 0.0 || b == 0.0) return 0.0;
+    double p = a * b;
+    if (isinf(p)) return (p > 0 && isfinite(a) && isfinite(b)) ? DBL_MAX : p;
+    if (fabs(p) < DBL_MIN) return down(p); // fma error term may underflow
+    return fma(a, b, -p) < 0.0 ? down(p) : p;
+}
+
+static double mul_up(double a, double b) {
+    if (a == 0.0 || b == 0.0) return 0.0;
+    double p = a * b;
+    if (isinf(p)) return (p < 0 && isfinite(a) && isfinite(b)) ? -DBL_MAX : p;
+    if (fabs(p) < DBL_MIN) return up(p);
+    return fma(a, b, -p) > 0.0 ? up(p) : p;
+}
+
+// b is nonzero or a signed zero standing for the limit from that side
+static double div_dn(double a, double b) {
+    if (a == 0.0) return 0.0;
+    double q = a / b;
+    if (isnan(q)) return -INFINITY;
+    if (isinf(q)) return (q > 0 && isfinite(a) && b != 0.0) ? DBL_MAX : q;
+    if (isinf(b) || fabs(q) < DBL_MIN) return down(q);
+    double r = fma(-q, b, a); // a - q*b; exact quotient is q + r/b
+    return (b > 0 ? r < 0.0 : r > 0.0) ? down(q) : q;
+}
+
+static double div_up(double a, double b) {
+    if (a == 0.0) return 0.0;
+    double q = a / b;
+    if (isnan(q)) return INFINITY;
+    if (isinf(q)) return (q < 0 && isfinite(a) && b != 0.0) ? -DBL_MAX : q;
+    if (isinf(b) || fabs(q) < DBL_MIN) return up(q);
+    double r = fma(-q, b, a);
+    return (b > 0 ? r > 0.0 : r < 0.0) ? up(q) : q;
+}
+
+// ---- Arithmetic ----
+
+static Interval iv_add(Interval a, Interval b) {
+    return iv_from(iv_from(iv_make(add_dn(a.lo, b.lo), add_up(a.hi, b.hi)), a), b);
+}
+
+static Interval iv_neg(Interval a) {
+    return iv_from(iv_make(-a.hi, -a.lo), a);
+}
+
+static Interval iv_mul(Interval a, Interval b) {
+    double lo = fmin(fmin(mul_dn(a.lo, b.lo), mul_dn(a.lo, b.hi)),
+                     fmin(mul_dn(a.hi, b.lo), mul_dn(a.hi, b.hi)));
+    double hi = fmax(fmax(mul_up(a.lo, b.lo), mul_up(a.lo, b.hi)),
+                     fmax(mul_up(a.hi, b.lo), mul_up(a.hi, b.hi)));
+    return iv_from(iv_from(iv_make(lo, hi), a), b);
+}
+
+// x*x with both factors the same node: never negative
+static Interval iv_sqr(Interval a) {
+    Interval r;
+    if (a.lo >= 0.0)      r = iv_make(mul_dn(a.lo, a.lo), mul_up(a.hi, a.hi));
+    else if (a.hi <= 0.0) r = iv_make(mul_dn(a.hi, a.hi), mul_up(a.lo, a.lo));
+    else                  r = iv_make(0.0, fmax(mul_up(a.lo, a.lo), mul_up(a.hi, a.hi)));
+    return iv_from(r, a);
+}
+
+// a / [dlo, dhi] where the divisor does not change sign
+static Interval quot(Interval a, double dlo, double dhi) {
+    double lo = fmin(fmin(div_dn(a.lo, dlo), div_dn(a.lo, dhi)),
+                     fmin(div_dn(a.hi, dlo), div_dn(a.hi, dhi)));
+    double hi = fmax(fmax(div_up(a.lo, dlo), div_up(a.lo, dhi)),
+                     fmax(div_up(a.hi, dlo), div_up(a.hi, dhi)));
+    return iv_make(lo, hi);
+}
+
+// x/0 is NAN, so a divisor through zero splits into its negative and
+// positive parts, each unbounded towards the zero: a pole, unless the
+// dividend is 0 throughout
+static Interval iv_div(Interval a, Interval b) {
+    if (b.lo == 0.0 && b.hi == 0.0) return iv_empty();
+    Interval r;
+    if (b.lo > 0.0 || b.hi < 0.0) {
+        r = quot(a, b.lo, b.hi);
+    } else {
+        r = iv_empty();
+        if (b.hi > 0.0) r = iv_hull(r, quot(a, +0.0, b.hi));
+        if (b.lo < 0.0) r = iv_hull(r, quot(a, b.lo, -0.0));
+        r.undef = true;
+        if (a.lo != 0.0 || a.hi != 0.0) r.jump = true;
+    }
+    return iv_from(iv_from(r, a), b);
+}
+
+// ---- Functions ----
+
+// Apply a monotonic f on its domain [dlo, dhi] (NAN outside)
+static Interval mono(Interval a, FuncId id, bool increasing, double dlo, double dhi) {
+    if (a.hi < dlo || a.lo > dhi) return iv_empty();
+    Interval r = iv_from(iv_make(0.0, 0.0), a);
+    if (a.lo < dlo || a.hi > dhi) r.undef = true;
+    double lo = fmax(a.lo, dlo), hi = fmin(a.hi, dhi);
+    if (increasing) {
+        r.lo = fn_dn(eval_func(id, lo), lo);
+        r.hi = fn_up(eval_func(id, hi), hi);
+    } else {
+        r.lo = fn_dn(eval_func(id, hi), hi);
+        r.hi = fn_up(eval_func(id, lo), lo);
+    }
+    return r;
+}
+
+// Step functions (floor, ceil, round, sign) are exact and jump wherever
+// the ends of the box differ
+static Interval step(Interval a, FuncId id) {
+    Interval r = iv_from(iv_make(eval_func(id, a.lo), eval_func(id, a.hi)), a);
+    if (r.lo != r.hi) r.jump = true;
+    return r;
+}
+
+// Does [lo, hi] contain offset + k*period for some integer k? Errs towards
+// yes near the ends, which only loosens the bounds.
+static bool hits(double lo, double hi, double offset, double period) {
+    double tol = 1e-12 * (1.0 + fmax(fabs(lo), fabs(hi)));
+    double k = ceil((lo - tol - offset) / period);
+    return offset + k * period <= hi + tol;
+}
+
+// sin (max at pi/2) or cos (max at 0), from the ends of the box plus any
+// extremum inside it
+static Interval periodic(Interval a, FuncId id, double max_at) {
+    Interval r = iv_from(iv_make(-1.0, 1.0), a);
+    if (a.hi - a.lo >= TWO_PI || fabs(a.lo) > 1e12 || fabs(a.hi) > 1e12) return r;
+    double flo = eval_func(id, a.lo), fhi = eval_func(id, a.hi);
+    double lo = fmin(fn_dn(flo, a.lo), fn_dn(fhi, a.hi));
+    double hi = fmax(fn_up(flo, a.lo), fn_up(fhi, a.hi));
+    if (!hits(a.lo, a.hi, max_at, TWO_PI))        r.hi = fmin(hi, 1.0);
+    if (!hits(a.lo, a.hi, max_at + M_PI, TWO_PI)) r.lo = fmax(lo, -1.0);
+    return r;
+}
+
+// tan/cot: increasing/decreasing between poles at pole + k*pi
+static Interval poles(Interval a, FuncId id, double pole, bool increasing) {
+    if (a.hi - a.lo >= M_PI || hits(a.lo, a.hi, pole, M_PI) ||
+        fabs(a.lo) > 1e12 || fabs(a.hi) > 1e12) {
+        Interval r = iv_from(iv_all(), a);
+        r.undef = a.undef; // libm never returns NAN at a double next to a pole
+        if (id == FN_COT && a.lo <= 0.0 && a.hi >= 0.0) r.undef = true;
+        return r;
+    }
+    return mono(a, id, increasing, -INFINITY, INFINITY);
+}
+
+static Interval iv_func(FuncId id, Interval a) {
+    switch (id) {
+    case FN_SIN:   return periodic(a, id, M_PI / 2.0);
+    case FN_COS:   return periodic(a, id, 0.0);
+    case FN_TAN:   return poles(a, id, M_PI / 2.0, true);
+    case FN_COT:   return poles(a, id, 0.0, false);
+    case FN_SEC:
+    case FN_CSC: {
+        double pole = (id == FN_SEC) ? M_PI / 2.0 : 0.0;
+        if (a.hi - a.lo >= M_PI || hits(a.lo, a.hi, pole, M_PI)) {
+            Interval r = iv_from(iv_all(), a);
+            r.undef = a.undef;
+            return r;
+        }
+        Interval c = periodic(a, id == FN_SEC ? FN_COS : FN_SIN, id == FN_SEC ? 0.0 : M_PI / 2.0);
+        return iv_div(iv_make(1.0, 1.0), c);
+    }
+    case FN_ASIN:  return mono(a, id, true, -1.0, 1.0);
+    case FN_ACOS:  return mono(a, id, false, -1.0, 1.0);
+    case FN_ATAN:  return mono(a, id, true, -INFINITY, INFINITY);
+    case FN_SINH:  return mono(a, id, true, -INFINITY, INFINITY);
+    case FN_COSH: {
+        if (a.lo >= 0.0) return mono(a, id, true, 0.0, INFINITY);
+        if (a.hi <= 0.0) return mono(a, id, false, -INFINITY, 0.0);
+        Interval r = mono(iv_from(iv_make(0.0, fmax(-a.lo, a.hi)), a), id, true, 0.0, INFINITY);
+        r.lo = 1.0;
+        return r;
+    }
+    case FN_TANH: {
+        Interval r = mono(a, id, true, -INFINITY, INFINITY);
+        r.lo = fmax(r.lo, -1.0);
+        r.hi = fmin(r.hi, 1.0);
+        return r;
+    }
+    case FN_ASINH: return mono(a, id, true, -INFINITY, INFINITY);
+    case FN_ACOSH: return mono(a, id, true, 1.0, INFINITY);
+    case FN_ATANH: return mono(a, id, true, -1.0, 1.0);
+    case FN_SQRT:
+    case FN_LOG:
+    case FN_LN:
+    case FN_LOG2: {
+        // log(0) is -inf rather than NAN, so 0 stays in the domain
+        Interval r = mono(a, id, true, 0.0, INFINITY);
+        if (id == FN_SQRT) r.lo = fmax(r.lo, 0.0);
+        return r;
+    }
+    case FN_CBRT:  return mono(a, id, true, -INFINITY, INFINITY);
+    case FN_EXP: {
+        Interval r = mono(a, id, true, -INFINITY, INFINITY);
+        r.lo = fmax(r.lo, 0.0);
+        return r;
+    }
+    case FN_ABS:
+        if (a.lo >= 0.0) return a;
+        if (a.hi <= 0.0) return iv_neg(a);
+        return iv_from(iv_make(0.0, fmax(-a.lo, a.hi)), a);
+    case FN_FLOOR:
+    case FN_CEIL:
+    case FN_ROUND:
+    case FN_SIGN:
+    case FN_SGN:   return step(a, id);
+    default:       return iv_empty();
+    }
+}
+
+// ---- Powers and remainders ----
+
+// a^k for a constant k, with pow()'s rules: x^0 = 1 (even for NAN),
+// 0^-k = inf, negative bases only with integer exponents
+static Interval iv_pow_k(Interval a, double k) {
+    if (k == 0.0) return iv_make(1.0, 1.0);
+    if (k == floor(k) && fabs(k) < 9007199254740992.0) {
+        if (k < 0.0) return iv_div(iv_make(1.0, 1.0), iv_pow_k(a, -k));
+        double plo = pow(a.lo, k), phi = pow(a.hi, k);
+        bool even = fmod(k, 2.0) == 0.0;
+        Interval r;
+        if (!even || a.lo >= 0.0) r = iv_make(plo, phi);
+        else if (a.hi <= 0.0)     r = iv_make(phi, plo);
+        else                      r = iv_make(0.0, fmax(plo, phi));
+        if (r.lo != 0.0) r.lo = down(r.lo);
+        if (r.hi != 0.0) r.hi = up(r.hi);
+        return iv_from(r, a);
+    }
+    if (a.hi < 0.0) return iv_empty();
+    Interval r = iv_from(iv_make(0.0, 0.0), a);
+    if (a.lo < 0.0) r.undef = true;
+    double lo = fmax(a.lo, 0.0);
+    double plo = pow(lo, k), phi = pow(a.hi, k);
+    if (k < 0.0) { double t = plo; plo = phi; phi = t; }
+    r.lo = (plo == 0.0) ? 0.0 : down(plo);
+    r.hi = up(phi);
+    return r;
+}
+
+static Interval iv_pow(Interval a, Interval b) {
+    if (b.lo == b.hi) return iv_from(iv_pow_k(a, b.lo), b);
+    Interval r;
+    if (a.lo > 0.0) {
+        // exp(b * ln a)
+        Interval la = mono(a, FN_LN, true, 0.0, INFINITY);
+        r = iv_func(FN_EXP, iv_mul(la, b));
+    } else if (a.lo >= 0.0) {
+        r = iv_make(0.0, INFINITY); // 0^b is 0, 1 or inf
+        if (a.hi > 0.0) r.jump = true;
+    } else {
+        r = iv_all();
+    }
+    return iv_from(iv_from(r, a), b);
+}
+
+// fmod truncates, so it is continuous through 0 and jumps at the other
+// multiples of the divisor
+static Interval iv_mod(Interval a, Interval b) {
+    if (b.lo == 0.0 && b.hi == 0.0) return iv_empty();
+    Interval r;
+    double m = fmax(fabs(b.lo), fabs(b.hi));
+    bool zero = b.lo <= 0.0 && b.hi >= 0.0;
+    if (b.lo == b.hi && !zero && isfinite(a.lo) && isfinite(a.hi)) {
+        double q_lo = trunc(a.lo / m), q_hi = trunc(a.hi / m);
+        double r_lo = fmod(a.lo, m), r_hi = fmod(a.hi, m);
+        if (q_lo == q_hi && r_lo <= r_hi)
+            return iv_from(iv_from(iv_make(r_lo, r_hi), a), b);
+    }
+    r = iv_make(a.lo >= 0.0 ? 0.0 : -m, a.hi <= 0.0 ? 0.0 : m);
+    r.jump = true;
+    if (zero) r.undef = true;
+    return iv_from(iv_from(r, a), b);
+}
+
+// ---- Tree walk ----
+
+static Interval walk(const ASTNode *node, Interval x, Interval y, Interval z) {
+    if (!node) return iv_empty();
+
+    switch (node->type) {
+    case NODE_NUMBER:
+        if (isnan(node->number)) return iv_empty();
+        return iv_make(node->number, node->number);
+
+    case NODE_VAR:
+        return node->var == 'z' ? z : node->var == 'y' ? y : x;
+
+    case NODE_UNARY_NEG: {
+        Interval a = walk(node->unary.operand, x, y, z);
+        if (interval_empty(a)) return iv_empty();
+        return iv_neg(a);
+    }
+
+    case NODE_FUNC: {
+        Interval a = walk(node->func.arg, x, y, z);
+        if (interval_empty(a)) return iv_empty();
+        return iv_func(node->func.id, a);
+    }
+
+    case NODE_BINOP: {
+        Interval l = walk(node->binop.left, x, y, z);
+        // x^0 is 1 even where x is NAN
+        if (node->binop.op == '^' && node->binop.right->type == NODE_NUMBER &&
+            node->binop.right->number == 0.0) return iv_make(1.0, 1.0);
+        if (interval_empty(l)) return iv_empty();
+        if (node->binop.op == '*' && node->binop.right == node->binop.left) return iv_sqr(l);
+        Interval r = walk(node->binop.right, x, y, z);
+        if (interval_empty(r)) return iv_empty();
+
+        switch (node->binop.op) {
+            case '+': return iv_add(l, r);
+            case '-': return iv_add(l, iv_neg(r));
+            case '*': return iv_mul(l, r);
+            case '/': return iv_div(l, r);
+            case '^': return iv_pow(l, r);
+            case '%': return iv_mod(l, r);
+            default:  return iv_empty();
+        }
+    }
+    }
+    return iv_empty();
+}
+
+Interval eval_ast_interval(const ASTNode *node, double x_lo, double x_hi,
+                           double y_lo, double y_hi) {
+    return walk(node, iv_make(x_lo, x_hi), iv_make(y_lo, y_hi), iv_make(0.0, 0.0));
+}
+
+Interval eval_ast_interval_xyz(const ASTNode *node, double x_lo, double x_hi,
+                               double y_lo, double y_hi, double z_lo, double z_hi) {
+    return walk(node, iv_make(x_lo, x_hi), iv_make(y_lo, y_hi), iv_make(z_lo, z_hi));
+}
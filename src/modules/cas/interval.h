@@ -0,0 +1,35 @@
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdbool.h>
+#include <float.h>
+#include "parser.h"
+
+// Enclosure of an expression over a box of inputs. Every value the exact
+// expression takes on the box lies in [lo, hi]; lo > hi means it is NAN on
+// the whole box. Bounds are rounded outward (arithmetic exactly, libm
+// results by one ulp), so they also hold for eval_ast_xy's samples up to
+// that function's own rounding.
+typedef struct {
+    double lo, hi;
+    bool   undef; // may be NAN somewhere in the box (x/0, ln(-1), ...)
+    bool   jump;  // may be discontinuous in the box (pole, floor, %, ...)
+} Interval;
+
+// Bounds of node for x in [x_lo, x_hi] and y in [y_lo, y_hi]
+Interval eval_ast_interval(const ASTNode *node, double x_lo, double x_hi,
+                           double y_lo, double y_hi);
+// The same with z in [z_lo, z_hi], for expressions of x, y and z
+Interval eval_ast_interval_xyz(const ASTNode *node, double x_lo, double x_hi,
+                               double y_lo, double y_hi, double z_lo, double z_hi);
+
+static inline bool interval_empty(Interval iv) { return !(iv.lo <= iv.hi); }
+
+// Defined, finite and continuous over the whole box: its graph is one
+// connected piece, so neighbouring samples may be joined by a line.
+static inline bool interval_continuous(Interval iv) {
+    return !iv.undef && !iv.jump && iv.lo <= iv.hi &&
+           iv.lo >= -DBL_MAX && iv.hi <= DBL_MAX;
+}
+
+#endif
@@ -0,0 +1,473 @@
+#define _DEFAULT_SOURCE // mmap flags under -std=c11
+#include "jit.h"
+#include "vecmath.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)) && \
+    !defined(PLATFORM_WEB) && !defined(CAS_NO_JIT)
+    #define JIT_X86_64 1
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #ifndef MAP_ANONYMOUS
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif
+#endif
+
+#define JIT_WIDE 32 // lanes per iteration for programs with calls
+
+typedef void (*JitFn)(const double *xs, const double *ys, double *const *outs, size_t n);
+
+struct JitCode {
+    JitFn    fn;       // n must be a nonzero multiple of lanes
+    void    *mem;
+    size_t   size;
+    unsigned mask;
+    int      root_count;
+    int      lanes;
+    bool     uses_y;
+};
+
+#ifdef JIT_X86_64
+
+// ---- Minimal x86-64 encoder ----
+
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+       R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+
+enum {
+    MOVUPD_LD = 0x10, MOVUPD_ST = 0x11, MOVAPD_LD = 0x28, MOVAPD_ST = 0x29,
+    ANDPD = 0x54, ANDNPD = 0x55, ORPD = 0x56, XORPD = 0x57,
+    ADDPD = 0x58, MULPD = 0x59, SUBPD = 0x5C, DIVPD = 0x5E,
+    PUNPCKLQDQ = 0x6C, CMPPD = 0xC2,
+};
+
+typedef struct {
+    uint8_t *buf;
+    size_t   len, cap;  // len may run past cap; checked once at the end
+} Asm;
+
+static void put(Asm *as, uint8_t b) {
+    if (as->len < as->cap) as->buf[as->len] = b;
+    as->len++;
+}
+
+static void put32(Asm *as, uint32_t v) {
+    for (int i = 0; i < 4; i++) put(as, (uint8_t)(v >> (8 * i)));
+}
+
+static void put64(Asm *as, uint64_t v) {
+    for (int i = 0; i < 8; i++) put(as, (uint8_t)(v >> (8 * i)));
+}
+
+static void rex(Asm *as, bool w, int reg, int index, int base) {
+    uint8_t r = (uint8_t)(0x40 | (w ? 8 : 0) | ((reg >> 3) & 1) << 2 |
+                          ((index >= 0 ? index >> 3 : 0) & 1) << 1 | ((base >> 3) & 1));
+    if (r != 0x40) put(as, r);
+}
+
+// ModRM (+SIB, disp) for [base + index*8 + disp]; index -1 for none
+static void mem_operand(Asm *as, int reg, int base, int index, int32_t disp) {
+    int mod = (disp == 0 && (base & 7) != RBP) ? 0 : (disp >= -128 && disp <= 127) ? 1 : 2;
+    if (index >= 0 || (base & 7) == RSP) {
+        put(as, (uint8_t)(mod << 6 | (reg & 7) << 3 | 4));
+        put(as, (uint8_t)((index >= 0 ? 3 : 0) << 6 | (index >= 0 ? index & 7 : 4) << 3 | (base & 7)));
+    } else {
+        put(as, (uint8_t)(mod << 6 | (reg & 7) << 3 | (base & 7)));
+    }
+    if (mod == 1)      put(as, (uint8_t)(int8_t)disp);
+    else if (mod == 2) put32(as, (uint32_t)disp);
+}
+
+static void sse_rr(Asm *as, uint8_t op, int x, int y) {
+    put(as, 0x66);
+    rex(as, false, x, -1, y);
+    put(as, 0x0F);
+    put(as, op);
+    put(as, (uint8_t)(0xC0 | (x & 7) << 3 | (y & 7)));
+}
+
+static void sse_rm(Asm *as, uint8_t op, int x, int base, int index, int32_t disp) {
+    put(as, 0x66);
+    rex(as, false, x, index, base);
+    put(as, 0x0F);
+    put(as, op);
+    mem_operand(as, x, base, index, disp);
+}
+
+static void mov_imm64(Asm *as, int r, uint64_t v) {
+    rex(as, true, 0, -1, r);
+    put(as, (uint8_t)(0xB8 | (r & 7)));
+    put64(as, v);
+}
+
+static void mov_imm32(Asm *as, int r, uint32_t v) { // r < 8, zero-extends
+    put(as, (uint8_t)(0xB8 | r));
+    put32(as, v);
+}
+
+static void mov_rr(Asm *as, int dst, int src) {
+    rex(as, true, src, -1, dst);
+    put(as, 0x89);
+    put(as, (uint8_t)(0xC0 | (src & 7) << 3 | (dst & 7)));
+}
+
+static void mov_load(Asm *as, int r, int base, int32_t disp) {
+    rex(as, true, r, -1, base);
+    put(as, 0x8B);
+    mem_operand(as, r, base, -1, disp);
+}
+
+static void lea(Asm *as, int r, int base, int32_t disp) {
+    rex(as, true, r, -1, base);
+    put(as, 0x8D);
+    mem_operand(as, r, base, -1, disp);
+}
+
+static void push(Asm *as, int r) {
+    if (r >= 8) put(as, 0x41);
+    put(as, (uint8_t)(0x50 | (r & 7)));
+}
+
+static void pop(Asm *as, int r) {
+    if (r >= 8) put(as, 0x41);
+    put(as, (uint8_t)(0x58 | (r & 7)));
+}
+
+static void call_abs(Asm *as, uintptr_t fn) {
+    mov_imm64(as, RAX, (uint64_t)fn);
+    put(as, 0xFF);
+    put(as, 0xD0); // call rax
+}
+
+// xmm x = {k, k}
+static void load_const(Asm *as, int x, double k) {
+    uint64_t bits;
+    memcpy(&bits, &k, sizeof(bits));
+    mov_imm64(as, RAX, bits);
+    put(as, 0x66);
+    rex(as, true, x, -1, RAX);
+    put(as, 0x0F);
+    put(as, 0x6E); // movq xmm, rax
+    put(as, (uint8_t)(0xC0 | (x & 7) << 3 | RAX));
+    sse_rr(as, PUNPCKLQDQ, x, x);
+}
+
+// ---- Code generation ----
+
+// Programs without calls run two lanes per iteration with each register in
+// an xmm register (xmm4..) when they fit; xmm0-3 are scratch. Otherwise
+// registers are stack slots of JIT_WIDE lanes at [rsp + r*slot], so a call
+// into vecmath covers JIT_WIDE lanes. Slot DAG_REG_MAX holds a broadcast
+// constant for calls.
+#define XMM_FIRST   4
+#define XMM_REGS    12
+
+typedef struct {
+    Asm  as;
+    int  lanes;   // per loop iteration: 2 or JIT_WIDE
+    bool in_xmm;
+} Gen;
+
+static int32_t slot(const Gen *g, int r, int pair) {
+    return r * g->lanes * 8 + pair * 16;
+}
+
+static int32_t frame_size(const Gen *g) {
+    return slot(g, DAG_REG_MAX + 1, 0);
+}
+
+static void load(Gen *g, int x, int r, int pair) {
+    if (g->in_xmm) sse_rr(&g->as, MOVAPD_LD, x, XMM_FIRST + r);
+    else           sse_rm(&g->as, MOVAPD_LD, x, RSP, -1, slot(g, r, pair));
+}
+
+static void store(Gen *g, int r, int x, int pair) {
+    if (g->in_xmm) sse_rr(&g->as, MOVAPD_LD, XMM_FIRST + r, x);
+    else           sse_rm(&g->as, MOVAPD_ST, x, RSP, -1, slot(g, r, pair));
+}
+
+static bool needs_call(const DagInstr *in) {
+    switch (in->op) {
+    case OP_POW: case OP_MOD: case OP_CALL: return true;
+    case OP_POW_K: return !(in->k == floor(in->k) && fabs(in->k) <= 64.0);
+    default: return false;
+    }
+}
+
+// kernel(dst, a, b, lanes) on the register slots; OP_CALL passes the
+// FuncId first instead, POW_K a broadcast of k as b
+static void gen_call(Gen *g, const DagInstr *in) {
+    Asm *as = &g->as;
+    if (in->op == OP_CALL) {
+        mov_imm32(as, RDI, (uint32_t)in->fn_id);
+        lea(as, RSI, RSP, slot(g, in->dst, 0));
+        lea(as, RDX, RSP, slot(g, in->a, 0));
+        mov_imm32(as, RCX, (uint32_t)g->lanes);
+        call_abs(as, (uintptr_t)vecmath_func);
+        return;
+    }
+    int b = in->b;
+    if (b < 0) {
+        b = DAG_REG_MAX;
+        load_const(as, 0, in->k);
+        for (int j = 0; j < g->lanes / 2; j++) store(g, b, 0, j);
+    }
+    lea(as, RDI, RSP, slot(g, in->dst, 0));
+    lea(as, RSI, RSP, slot(g, in->a, 0));
+    lea(as, RDX, RSP, slot(g, b, 0));
+    mov_imm32(as, RCX, (uint32_t)g->lanes);
+    call_abs(as, in->op == OP_MOD ? (uintptr_t)vecmath_mod : (uintptr_t)vecmath_pow);
+}
+
+// One instruction on lanes 2*pair, 2*pair+1
+static void gen_pair(Gen *g, const DagInstr *in, int pair) {
+    Asm *as = &g->as;
+    int a = in->a, b = in->b;
+
+    switch (in->op) {
+    case OP_CONST:
+        load_const(as, 0, in->k);
+        break;
+    case OP_X:
+        sse_rm(as, MOVUPD_LD, 0, RBX, R15, 16 * pair);
+        break;
+    case OP_Y:
+        sse_rm(as, MOVUPD_LD, 0, R12, R15, 16 * pair);
+        break;
+    case OP_NEG:
+        load(g, 0, a, pair);
+        load_const(as, 1, -0.0);
+        sse_rr(as, XORPD, 0, 1);
+        break;
+    case OP_ADD: case OP_SUB: case OP_MUL: {
+        uint8_t op = in->op == OP_ADD ? ADDPD : in->op == OP_SUB ? SUBPD : MULPD;
+        load(g, 0, a, pair);
+        load(g, 1, b, pair);
+        sse_rr(as, op, 0, 1);
+        break;
+    }
+    case OP_DIV:
+        // NAN where b == 0, like vecmath_div
+        load(g, 0, a, pair);
+        load(g, 1, b, pair);
+        sse_rr(as, XORPD, 2, 2);
+        sse_rr(as, CMPPD, 2, 1);
+        put(as, 4); // NEQ_UQ: 0 != b, true for NAN too
+        sse_rr(as, DIVPD, 0, 1);
+        sse_rr(as, ANDPD, 0, 2);
+        load_const(as, 3, NAN);
+        sse_rr(as, ANDNPD, 2, 3);
+        sse_rr(as, ORPD, 0, 2);
+        break;
+    case OP_ADD_K: case OP_SUB_K: case OP_MUL_K: case OP_DIV_K: {
+        uint8_t op = in->op == OP_ADD_K ? ADDPD : in->op == OP_SUB_K ? SUBPD :
+                     in->op == OP_MUL_K ? MULPD : DIVPD;
+        load(g, 0, a, pair);
+        load_const(as, 1, in->k);
+        sse_rr(as, op, 0, 1);
+        break;
+    }
+    case OP_RSUB_K:
+        load_const(as, 0, in->k);
+        load(g, 1, a, pair);
+        sse_rr(as, SUBPD, 0, 1);
+        break;
+    case OP_SQR:
+        load(g, 0, a, pair);
+        sse_rr(as, MULPD, 0, 0);
+        break;
+    case OP_POW_K: {
+        // Small integer k (needs_call is false): same multiplications as vecmath_powi
+        int k = (int)in->k;
+        unsigned e = (unsigned)(k < 0 ? -k : k);
+        load(g, 1, a, pair);
+        load_const(as, 0, 1.0);
+        for (unsigned bits = e; bits; bits >>= 1) {
+            if (bits & 1) sse_rr(as, MULPD, 0, 1);
+            if (bits > 1) sse_rr(as, MULPD, 1, 1);
+        }
+        if (k < 0) {
+            load_const(as, 2, 1.0);
+            sse_rr(as, DIVPD, 2, 0);
+            sse_rr(as, MOVAPD_LD, 0, 2);
+        }
+        break;
+    }
+    default:
+        load_const(as, 0, NAN);
+        break;
+    }
+    store(g, in->dst, 0, pair);
+}
+
+// void fn(const double *xs, const double *ys, double *const *outs, size_t n)
+// for n a nonzero multiple of g->lanes: rbx = xs, r12 = ys, r13 = outs,
+// r14 = n, r15 = i
+static void gen_function(Gen *g, const DagProgram *p, unsigned mask) {
+    Asm *as = &g->as;
+    push(as, RBX);
+    push(as, R12);
+    push(as, R13);
+    push(as, R14);
+    push(as, R15);
+    // 5 pushes + return address leave rsp 16-byte aligned; keep it so
+    put(as, 0x48); put(as, 0x81); put(as, 0xEC); put32(as, (uint32_t)frame_size(g)); // sub rsp
+    mov_rr(as, RBX, RDI);
+    mov_rr(as, R12, RSI);
+    mov_rr(as, R13, RDX);
+    mov_rr(as, R14, RCX);
+    put(as, 0x45); put(as, 0x31); put(as, 0xFF); // xor r15d, r15d
+
+    size_t loop = as->len;
+    for (int i = 0; i < p->len; i++) {
+        const DagInstr *in = &p->code[i];
+        if (!(in->roots & mask)) continue;
+        if (needs_call(in)) {
+            gen_call(g, in);
+            continue;
+        }
+        for (int j = 0; j < g->lanes / 2; j++) gen_pair(g, in, j);
+    }
+
+    for (int i = 0; i < p->root_count; i++) {
+        if (!(mask & (1u << i))) continue;
+        mov_load(as, RDX, R13, 8 * i); // load_const clobbers rax
+        for (int j = 0; j < g->lanes / 2; j++) {
+            if (p->root_reg[i] >= 0) load(g, 0, p->root_reg[i], j);
+            else                     load_const(as, 0, NAN);
+            sse_rm(as, MOVUPD_ST, 0, RDX, R15, 16 * j);
+        }
+    }
+
+    put(as, 0x49); put(as, 0x83); put(as, 0xC7); put(as, (uint8_t)g->lanes); // add r15, lanes
+    put(as, 0x4D); put(as, 0x39); put(as, 0xF7);                            // cmp r15, r14
+    put(as, 0x0F); put(as, 0x82);                                           // jb loop
+    put32(as, (uint32_t)(int32_t)((int64_t)loop - (int64_t)(as->len + 4)));
+
+    put(as, 0x48); put(as, 0x81); put(as, 0xC4); put32(as, (uint32_t)frame_size(g)); // add rsp
+    pop(as, R15);
+    pop(as, R14);
+    pop(as, R13);
+    pop(as, R12);
+    pop(as, RBX);
+    put(as, 0xC3);
+}
+
+bool jit_available(void) {
+    return true;
+}
+
+JitCode *jit_compile(const DagProgram *p, unsigned mask) {
+    if (!p || !mask || p->reg_count > DAG_REG_MAX) return NULL;
+
+    bool calls = false;
+    for (int i = 0; i < p->len; i++)
+        if ((p->code[i].roots & mask) && needs_call(&p->code[i])) calls = true;
+
+    Gen g = {0};
+    g.in_xmm = !calls && p->reg_count <= XMM_REGS;
+    g.lanes  = g.in_xmm ? 2 : JIT_WIDE;
+    g.as.cap = 256 + ((size_t)p->len * 64 + (size_t)p->root_count * 48) * (size_t)(g.lanes / 2);
+    g.as.buf    = malloc(g.as.cap);
+    if (!g.as.buf) return NULL;
+    gen_function(&g, p, mask);
+    if (g.as.len > g.as.cap) {
+        free(g.as.buf);
+        return NULL;
+    }
+
+    // Write while RW, then flip to RX; never both at once
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = (g.as.len + (size_t)page - 1) & ~((size_t)page - 1);
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        free(g.as.buf);
+        return NULL;
+    }
+    memcpy(mem, g.as.buf, g.as.len);
+    free(g.as.buf);
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, size);
+        return NULL;
+    }
+
+    JitCode *jc = malloc(sizeof(JitCode));
+    if (!jc) {
+        munmap(mem, size);
+        return NULL;
+    }
+    jc->fn         = (JitFn)(uintptr_t)mem;
+    jc->mem        = mem;
+    jc->size       = size;
+    jc->mask       = mask;
+    jc->root_count = p->root_count;
+    jc->lanes      = g.lanes;
+    jc->uses_y     = false;
+    for (int i = 0; i < p->len; i++)
+        if (p->code[i].op == OP_Y && (p->code[i].roots & mask)) jc->uses_y = true;
+    return jc;
+}
+
+void jit_free(JitCode *jc) {
+    if (!jc) return;
+    munmap(jc->mem, jc->size);
+    free(jc);
+}
+
+#else // !JIT_X86_64
+
+bool jit_available(void) {
+    return false;
+}
+
+JitCode *jit_compile(const DagProgram *p, unsigned mask) {
+    (void)p;
+    (void)mask;
+    return NULL;
+}
+
+void jit_free(JitCode *jc) {
+    (void)jc;
+}
+
+#endif
+
+void jit_eval_batch(const JitCode *jc, const double *xs, const double *ys,
+                    double *const *outs, size_t n) {
+    static const double zeros[EVAL_BATCH_BLOCK]; // a multiple of any lane count
+    size_t lanes = (size_t)jc->lanes;
+    size_t main  = n - n % lanes;
+
+    if (jc->uses_y && !ys) {
+        // Feed y = 0 one block at a time
+        double *o[DAG_MAX_ROOTS];
+        for (size_t i = 0; i < main; i += EVAL_BATCH_BLOCK) {
+            size_t cnt = main - i < EVAL_BATCH_BLOCK ? main - i : EVAL_BATCH_BLOCK;
+            for (int r = 0; r < jc->root_count; r++)
+                o[r] = (jc->mask & (1u << r)) ? outs[r] + i : NULL;
+            jc->fn(xs + i, zeros, o, cnt);
+        }
+    } else if (main > 0) {
+        jc->fn(xs, ys ? ys : xs, outs, main);
+    }
+
+    if (main < n) {
+        // Remainder: pad one iteration's worth with the last point
+        double px[JIT_WIDE], py[JIT_WIDE], tmp[DAG_MAX_ROOTS][JIT_WIDE];
+        double *o[DAG_MAX_ROOTS];
+        for (size_t j = 0; j < lanes; j++) {
+            size_t k = main + j < n ? main + j : n - 1;
+            px[j] = xs[k];
+            py[j] = ys ? ys[k] : 0.0;
+        }
+        for (int r = 0; r < jc->root_count; r++) o[r] = tmp[r];
+        jc->fn(px, py, o, lanes);
+        for (int r = 0; r < jc->root_count; r++) {
+            if (!(jc->mask & (1u << r))) continue;
+            for (size_t j = 0; main + j < n; j++) outs[r][main + j] = tmp[r][j];
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "dag.h"
+
+// Native code for a DagProgram on x86-64 (System V ABI, SSE2 packed
+// doubles). Arithmetic is inlined; pow, fmod and built-in functions call
+// the vecmath kernels, so results are bit-identical to dag_eval_batch,
+// except which NaN is kept where two meet (IEEE leaves that open).
+//
+// Code is written to an mmap'd page that is then flipped to read+exec.
+// jit_compile returns NULL on other platforms, in web builds, when built
+// with -DCAS_NO_JIT or when the OS refuses executable memory (W^X);
+// callers then use the interpreter.
+typedef struct JitCode JitCode;
+
+bool     jit_available(void);
+
+// Compile the roots selected by mask. The code does not refer back to p.
+JitCode *jit_compile(const DagProgram *p, unsigned mask);
+
+// Same contract as dag_eval_batch for the mask given to jit_compile
+void     jit_eval_batch(const JitCode *jc, const double *xs, const double *ys,
+                        double *const *outs, size_t n);
+
+void     jit_free(JitCode *jc);
+
+#endif
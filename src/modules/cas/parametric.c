@@ -0,0 +1,375 @@
+#include "parametric.h"
+#include "eval.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TWO_PI   6.28318530717958647692
+#define MIN_STEP ((PARAM_HI - PARAM_LO) / 65536) // narrowest interval split
+
+typedef struct {
+    double c[3];
+} P3;
+
+static bool finite3(const P3 *p) {
+    return isfinite(p->c[0]) && isfinite(p->c[1]) && isfinite(p->c[2]);
+}
+
+static double dist3(const P3 *a, const P3 *b) {
+    double d = 0.0;
+    for (int k = 0; k < 3; k++) d += (a->c[k] - b->c[k]) * (a->c[k] - b->c[k]);
+    return sqrt(d);
+}
+
+// r at the n points (us[i], vs[i]); vs NULL for curves
+static void eval_points(Bytecode *const code[3], const double *us, const double *vs, int n,
+                        P3 *out, Arena *arena) {
+    ArenaMark mark = arena_mark(arena);
+    double *f = arena_alloc(arena, (size_t)n * sizeof(double));
+    for (int k = 0; k < 3; k++) {
+        if (f) bytecode_eval_batch(code[k], us, vs, f, (size_t)n);
+        for (int i = 0; i < n; i++) out[i].c[k] = f ? f[i] : NAN;
+    }
+    arena_rewind(arena, mark);
+}
+
+// How far mid lies off the chord from a to b. Where r is defined at some
+// of the three and not all, twice tol, so the edge of where it is gets
+// narrowed down too.
+static double gap(const P3 *a, const P3 *b, const P3 *mid, double tol) {
+    bool fa = finite3(a), fb = finite3(b), fm = finite3(mid);
+    if (!fa && !fb && !fm) return 0.0;
+    if (!fa || !fb || !fm) return 2.0 * tol;
+    double d = 0.0;
+    for (int k = 0; k < 3; k++) {
+        double e = mid->c[k] - 0.5 * (a->c[k] + b->c[k]);
+        d += e * e;
+    }
+    return sqrt(d);
+}
+
+static int cmp_desc(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x < y) - (x > y);
+}
+
+// Mark the n intervals to split: those more than tol off, the worst first
+// while there is room. Returns how many.
+static int choose_splits(const double *err, int n, double tol, int room, bool *split,
+                         Arena *arena) {
+    memset(split, 0, (size_t)n * sizeof(bool));
+    int over = 0;
+    for (int i = 0; i < n; i++) over += err[i] > tol;
+    double cut = tol;
+    if (over > room) {
+        if (room <= 0) return 0;
+        ArenaMark mark = arena_mark(arena);
+        double *sorted = arena_alloc(arena, (size_t)n * sizeof(double));
+        if (!sorted) return 0;
+        memcpy(sorted, err, (size_t)n * sizeof(double));
+        qsort(sorted, (size_t)n, sizeof(double), cmp_desc);
+        cut = sorted[room - 1];
+        arena_rewind(arena, mark);
+    }
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        split[i] = err[i] > tol && err[i] >= cut && count < room;
+        count += split[i];
+    }
+    return count;
+}
+
+// Parameters with the marked intervals' midpoints put in; returns the count
+static int insert_mids(const double *t, int n, const bool *split, double *out) {
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        out[m++] = t[i];
+        if (i < n - 1 && split[i]) out[m++] = 0.5 * (t[i] + t[i + 1]);
+    }
+    return m;
+}
+
+static void put3(float *dst, const P3 *p) {
+    for (int k = 0; k < 3; k++) dst[k] = finite3(p) ? (float)p->c[k] : 0.0f;
+}
+
+static void put_unit(float *dst, const double n[3]) {
+    double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    for (int k = 0; k < 3; k++) dst[k] = len > 0.0 && isfinite(len) ? (float)(n[k] / len) : 0.0f;
+}
+
+static void cross3(const double a[3], const double b[3], double out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+ParamMesh param_surface(Bytecode *const code[3], ASTNode *const ast[3], double tol,
+                        Arena *arena) {
+    ParamMesh m = {0};
+    const size_t most = (size_t)PARAM_SIDE * PARAM_SIDE;
+    double *us = arena_alloc(arena, PARAM_SIDE * sizeof(double));
+    double *vs = arena_alloc(arena, PARAM_SIDE * sizeof(double));
+    double *us2 = arena_alloc(arena, PARAM_SIDE * sizeof(double));
+    double *vs2 = arena_alloc(arena, PARAM_SIDE * sizeof(double));
+    double *err = arena_alloc(arena, PARAM_SIDE * sizeof(double));
+    bool   *su  = arena_alloc(arena, PARAM_SIDE * sizeof(bool));
+    bool   *sv  = arena_alloc(arena, PARAM_SIDE * sizeof(bool));
+    double *xs  = arena_alloc(arena, most * sizeof(double));
+    double *ys  = arena_alloc(arena, most * sizeof(double));
+    P3     *g   = arena_alloc(arena, most * sizeof(P3));
+    P3     *g2  = arena_alloc(arena, most * sizeof(P3));
+    P3     *mu  = arena_alloc(arena, most * sizeof(P3));
+    P3     *mv  = arena_alloc(arena, most * sizeof(P3));
+    P3     *mx  = arena_alloc(arena, most * sizeof(P3));
+    if (!us || !vs || !us2 || !vs2 || !err || !su || !sv || !xs || !ys || !g || !g2 || !mu ||
+        !mv || !mx)
+        return m;
+
+    int nu = PARAM_START + 1, nv = PARAM_START + 1;
+    for (int i = 0; i < nu; i++) us[i] = vs[i] = PARAM_LO + (PARAM_HI - PARAM_LO) * i / PARAM_START;
+    for (int j = 0; j < nv; j++)
+        for (int i = 0; i < nu; i++) {
+            xs[j * nu + i] = us[i];
+            ys[j * nu + i] = vs[j];
+        }
+    eval_points(code, xs, ys, nu * nv, g, arena);
+    m.samples = nu * nv;
+
+    // Split the rows and columns whose midpoints are off the mesh; the
+    // midpoints become samples, so only the crossings of new rows with new
+    // columns are evaluated on top
+    for (;;) {
+        int n = 0;
+        for (int j = 0; j < nv; j++)
+            for (int i = 0; i < nu - 1; i++, n++) {
+                xs[n] = 0.5 * (us[i] + us[i + 1]);
+                ys[n] = vs[j];
+            }
+        eval_points(code, xs, ys, n, mu, arena);
+        m.samples += n;
+        for (int i = 0; i < nu - 1; i++) {
+            err[i] = 0.0;
+            for (int j = 0; j < nv && us[i + 1] - us[i] >= MIN_STEP; j++)
+                err[i] = fmax(err[i], gap(&g[j * nu + i], &g[j * nu + i + 1],
+                                          &mu[j * (nu - 1) + i], tol));
+        }
+        int split_u = choose_splits(err, nu - 1, tol, PARAM_SIDE - nu, su, arena);
+
+        n = 0;
+        for (int j = 0; j < nv - 1; j++)
+            for (int i = 0; i < nu; i++, n++) {
+                xs[n] = us[i];
+                ys[n] = 0.5 * (vs[j] + vs[j + 1]);
+            }
+        eval_points(code, xs, ys, n, mv, arena);
+        m.samples += n;
+        for (int j = 0; j < nv - 1; j++) {
+            err[j] = 0.0;
+            for (int i = 0; i < nu && vs[j + 1] - vs[j] >= MIN_STEP; i++)
+                err[j] = fmax(err[j], gap(&g[j * nu + i], &g[(j + 1) * nu + i],
+                                          &mv[j * nu + i], tol));
+        }
+        int split_v = choose_splits(err, nv - 1, tol, PARAM_SIDE - nv, sv, arena);
+        if (split_u == 0 && split_v == 0) break;
+
+        n = 0;
+        for (int j = 0; j < nv - 1; j++)
+            for (int i = 0; i < nu - 1; i++)
+                if (sv[j] && su[i]) {
+                    xs[n] = 0.5 * (us[i] + us[i + 1]);
+                    ys[n] = 0.5 * (vs[j] + vs[j + 1]);
+                    n++;
+                }
+        eval_points(code, xs, ys, n, mx, arena);
+        m.samples += n;
+
+        // Merge: each new row is an old row or a v midpoint row, each new
+        // column an old column or a u midpoint column
+        int nu2 = insert_mids(us, nu, su, us2), nv2 = insert_mids(vs, nv, sv, vs2);
+        int k = 0, cross = 0;
+        for (int j = 0; j < nv; j++) {
+            for (int half = 0; half < 2; half++) {
+                if (half && (j == nv - 1 || !sv[j])) break;
+                for (int i = 0; i < nu; i++) {
+                    g2[k++] = half ? mv[j * nu + i] : g[j * nu + i];
+                    if (i == nu - 1 || !su[i]) continue;
+                    g2[k++] = half ? mx[cross++] : mu[j * (nu - 1) + i];
+                }
+            }
+        }
+        P3 *t = g;
+        g  = g2;
+        g2 = t;
+        memcpy(us, us2, (size_t)nu2 * sizeof(double));
+        memcpy(vs, vs2, (size_t)nv2 * sizeof(double));
+        nu = nu2;
+        nv = nv2;
+    }
+
+    // One vertex per sample, normal r_u x r_v; where that vanishes, as at
+    // a pole, the grid's differences stand in
+    int verts = nu * nv;
+    m.vertices = arena_alloc(arena, (size_t)verts * 3 * sizeof(float));
+    m.normals  = arena_alloc(arena, (size_t)verts * 3 * sizeof(float));
+    m.indices  = arena_alloc(arena, (size_t)(nu - 1) * (nv - 1) * 6 * sizeof(unsigned short));
+    if (!m.vertices || !m.normals || !m.indices) return (ParamMesh){0};
+    for (int j = 0; j < nv; j++) {
+        for (int i = 0; i < nu; i++) {
+            int v = j * nu + i;
+            put3(&m.vertices[3 * v], &g[v]);
+            double du[3], dv[3], nrm[3];
+            for (int c = 0; c < 3; c++) {
+                EvalDual d = eval_ast_dual(ast[c], us[i], vs[j]);
+                du[c] = d.dx;
+                dv[c] = d.dy;
+            }
+            cross3(du, dv, nrm);
+            double len = sqrt(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+            if (!(len > 0.0) || !isfinite(len)) {
+                const P3 *a = &g[j * nu + (i > 0 ? i - 1 : i)], *b = &g[j * nu + (i < nu - 1 ? i + 1 : i)];
+                const P3 *c = &g[(j > 0 ? j - 1 : j) * nu + i], *d = &g[(j < nv - 1 ? j + 1 : j) * nu + i];
+                for (int q = 0; q < 3; q++) {
+                    du[q] = b->c[q] - a->c[q];
+                    dv[q] = d->c[q] - c->c[q];
+                }
+                cross3(du, dv, nrm);
+            }
+            put_unit(&m.normals[3 * v], nrm);
+        }
+    }
+    for (int j = 0; j < nv - 1; j++) {
+        for (int i = 0; i < nu - 1; i++) {
+            int a = j * nu + i, b = a + 1, c = a + nu + 1, d = a + nu;
+            if (!finite3(&g[a]) || !finite3(&g[b]) || !finite3(&g[c]) || !finite3(&g[d])) continue;
+            unsigned short *ix = &m.indices[m.index_count];
+            ix[0] = (unsigned short)a; ix[1] = (unsigned short)b; ix[2] = (unsigned short)c;
+            ix[3] = (unsigned short)a; ix[4] = (unsigned short)c; ix[5] = (unsigned short)d;
+            m.index_count += 6;
+        }
+    }
+    m.vertex_count = verts;
+    return m;
+}
+
+ParamMesh param_curve(Bytecode *const code[3], double tol, double radius, Arena *arena) {
+    ParamMesh m = {0};
+    double *ts  = arena_alloc(arena, PARAM_CURVE_MAX * sizeof(double));
+    double *t2  = arena_alloc(arena, PARAM_CURVE_MAX * sizeof(double));
+    double *err = arena_alloc(arena, PARAM_CURVE_MAX * sizeof(double));
+    bool   *sp  = arena_alloc(arena, PARAM_CURVE_MAX * sizeof(bool));
+    P3     *p   = arena_alloc(arena, PARAM_CURVE_MAX * sizeof(P3));
+    P3     *p2  = arena_alloc(arena, PARAM_CURVE_MAX * sizeof(P3));
+    P3     *mid = arena_alloc(arena, PARAM_CURVE_MAX * sizeof(P3));
+    if (!ts || !t2 || !err || !sp || !p || !p2 || !mid) return m;
+
+    int n = PARAM_CURVE_START + 1;
+    for (int i = 0; i < n; i++) ts[i] = PARAM_LO + (PARAM_HI - PARAM_LO) * i / PARAM_CURVE_START;
+    eval_points(code, ts, NULL, n, p, arena);
+    m.samples = n;
+    for (;;) {
+        for (int i = 0; i < n - 1; i++) t2[i] = 0.5 * (ts[i] + ts[i + 1]);
+        eval_points(code, t2, NULL, n - 1, mid, arena);
+        m.samples += n - 1;
+        for (int i = 0; i < n - 1; i++)
+            err[i] = ts[i + 1] - ts[i] >= MIN_STEP ? gap(&p[i], &p[i + 1], &mid[i], tol) : 0.0;
+        if (choose_splits(err, n - 1, tol, PARAM_CURVE_MAX - n, sp, arena) == 0) break;
+        int k = 0;
+        for (int i = 0; i < n; i++) {
+            p2[k] = p[i];
+            t2[k++] = ts[i];
+            if (i < n - 1 && sp[i]) {
+                p2[k] = mid[i];
+                t2[k++] = 0.5 * (ts[i] + ts[i + 1]);
+            }
+        }
+        P3 *t = p;
+        p  = p2;
+        p2 = t;
+        memcpy(ts, t2, (size_t)k * sizeof(double));
+        n = k;
+    }
+
+    // A segment is drawn unless an end is undefined, or its midpoint is so
+    // far off the chord that it spans a jump rather than a bend
+    for (int i = 0; i < n - 1; i++) {
+        double off = gap(&p[i], &p[i + 1], &mid[i], tol);
+        sp[i] = finite3(&p[i]) && finite3(&p[i + 1]) && finite3(&mid[i]) &&
+                !(off > tol && off > 0.25 * dist3(&p[i], &p[i + 1]));
+    }
+
+    const int S = PARAM_TUBE_SIDES;
+    m.vertices = arena_alloc(arena, (size_t)n * S * 3 * sizeof(float));
+    m.normals  = arena_alloc(arena, (size_t)n * S * 3 * sizeof(float));
+    m.indices  = arena_alloc(arena, (size_t)(n - 1) * S * 6 * sizeof(unsigned short));
+    if (!m.vertices || !m.normals || !m.indices) return (ParamMesh){0};
+    memset(m.vertices, 0, (size_t)n * S * 3 * sizeof(float));
+    memset(m.normals, 0, (size_t)n * S * 3 * sizeof(float));
+
+    // Rings, framed by carrying the last normal over to each new tangent
+    double nrm[3] = {0};
+    bool   framed = false;
+    for (int i = 0; i < n; i++) {
+        bool before = i > 0 && sp[i - 1], after = i < n - 1 && sp[i];
+        if (!before && !after) {
+            framed = false;
+            continue;
+        }
+        const P3 *a = &p[before ? i - 1 : i], *b = &p[after ? i + 1 : i];
+        double tan[3], len = 0.0;
+        for (int k = 0; k < 3; k++) {
+            tan[k] = b->c[k] - a->c[k];
+            len += tan[k] * tan[k];
+        }
+        len = sqrt(len);
+        if (!(len > 0.0)) { // no direction here: no ring, nor segments to it
+            if (before) sp[i - 1] = false;
+            if (after) sp[i] = false;
+            framed = false;
+            continue;
+        }
+        for (int k = 0; k < 3; k++) tan[k] /= len;
+
+        double dot = nrm[0] * tan[0] + nrm[1] * tan[1] + nrm[2] * tan[2], nl = 0.0;
+        for (int k = 0; k < 3; k++) {
+            nrm[k] -= dot * tan[k];
+            nl += nrm[k] * nrm[k];
+        }
+        if (!framed || nl < 1e-12) {
+            // Start anew: any normal will do, across the tangent's smallest component
+            int ax = fabs(tan[0]) < fabs(tan[1]) ? (fabs(tan[0]) < fabs(tan[2]) ? 0 : 2)
+                                                 : (fabs(tan[1]) < fabs(tan[2]) ? 1 : 2);
+            double e[3] = {0};
+            e[ax] = 1.0;
+            cross3(tan, e, nrm);
+            nl = nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2];
+        }
+        nl = sqrt(nl);
+        for (int k = 0; k < 3; k++) nrm[k] /= nl;
+        framed = true;
+
+        double bin[3];
+        cross3(tan, nrm, bin);
+        for (int s = 0; s < S; s++) {
+            double ang = TWO_PI * s / S, dir[3];
+            for (int k = 0; k < 3; k++) dir[k] = cos(ang) * nrm[k] + sin(ang) * bin[k];
+            int v = i * S + s;
+            for (int k = 0; k < 3; k++) {
+                m.vertices[3 * v + k] = (float)(p[i].c[k] + radius * dir[k]);
+                m.normals[3 * v + k]  = (float)dir[k];
+            }
+        }
+    }
+    for (int i = 0; i < n - 1; i++) {
+        if (!sp[i]) continue;
+        for (int s = 0; s < S; s++) {
+            int a = i * S + s, b = i * S + (s + 1) % S, c = b + S, d = a + S;
+            unsigned short *ix = &m.indices[m.index_count];
+            ix[0] = (unsigned short)a; ix[1] = (unsigned short)b; ix[2] = (unsigned short)c;
+            ix[3] = (unsigned short)a; ix[4] = (unsigned short)c; ix[5] = (unsigned short)d;
+            m.index_count += 6;
+        }
+    }
+    m.vertex_count = n * S;
+    return m;
+}
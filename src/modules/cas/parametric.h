@@ -0,0 +1,43 @@
+#ifndef PARAMETRIC_H
+#define PARAMETRIC_H
+
+#include "parser.h"
+#include "bytecode.h"
+#include "../../utils/arena.h"
+
+#define PARAM_START       32    // intervals a side to begin a surface with
+#define PARAM_SIDE        255   // samples a side at most, for 16-bit indices
+#define PARAM_CURVE_START 64    // intervals to begin a curve with
+#define PARAM_CURVE_MAX   4096  // samples along a curve at most
+#define PARAM_TUBE_SIDES  8     // vertices around a tube
+
+// u, v and t all run over [0, 2 pi]
+#define PARAM_LO 0.0
+#define PARAM_HI 6.28318530717958647692
+
+typedef struct {
+    float          *vertices; // x, y, z per vertex, in plot coordinates
+    float          *normals;  // unit, or 0 where the surface has none
+    unsigned short *indices;  // triangles
+    int             vertex_count, index_count;
+    int             samples;  // parameter points evaluated
+} ParamMesh;
+
+// Surface (x, y, z)(u, v), from code[k] and ast[k] compiled with u, v
+// read as x, y. The parameter grid starts at PARAM_START intervals a side
+// and splits, a whole row or column at a time, every interval whose
+// midpoints lie more than tol off the mesh, until none does or a side has
+// PARAM_SIDE samples. Normals are r_u x r_v by dual numbers. Quads with a
+// corner where the surface is undefined are left out. Arrays come from
+// arena.
+ParamMesh param_surface(Bytecode *const code[3], ASTNode *const ast[3], double tol,
+                        Arena *arena);
+
+// Tube of the given radius along the curve (x, y, z)(t), from code[k]
+// compiled with t read as x. Segments split where their midpoint lies more
+// than tol off the chord, up to PARAM_CURVE_MAX samples; rings follow
+// rotation-minimising frames, so the tube does not twist. It breaks where
+// the curve is undefined.
+ParamMesh param_curve(Bytecode *const code[3], double tol, double radius, Arena *arena);
+
+#endif
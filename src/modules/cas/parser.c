@@ -38,12 +38,39 @@ static ASTNode *alloc_node(Parser *p) {
     return n;
 }
 
+static const char *FUNC_NAMES[FN_COUNT] = {
+    [FN_SIN]   = "sin",   [FN_COS]   = "cos",   [FN_TAN]   = "tan",
+    [FN_ASIN]  = "asin",  [FN_ACOS]  = "acos",  [FN_ATAN]  = "atan",
+    [FN_COT]   = "cot",   [FN_SEC]   = "sec",   [FN_CSC]   = "csc",
+    [FN_SINH]  = "sinh",  [FN_COSH]  = "cosh",  [FN_TANH]  = "tanh",
+    [FN_ASINH] = "asinh", [FN_ACOSH] = "acosh", [FN_ATANH] = "atanh",
+    [FN_SQRT]  = "sqrt",  [FN_CBRT]  = "cbrt",
+    [FN_LOG]   = "log",   [FN_LN]    = "ln",    [FN_LOG2]  = "log2",
+    [FN_EXP]   = "exp",
+    [FN_ABS]   = "abs",   [FN_FLOOR] = "floor", [FN_CEIL]  = "ceil",
+    [FN_ROUND] = "round", [FN_SIGN]  = "sign",  [FN_SGN]   = "sgn",
+};
+
+FuncId parser_func_id(const char *name) {
+    for (int i = 0; i < FN_UNKNOWN; i++) {
+        if (strcmp(name, FUNC_NAMES[i]) == 0) return (FuncId)i;
+    }
+    return FN_UNKNOWN;
+}
+
+const char *parser_func_name(FuncId id) {
+    if ((unsigned)id >= FN_UNKNOWN) return "?";
+    return FUNC_NAMES[id];
+}
+
 void parser_init(Parser *p, const char *input, Arena *arena) {
     p->input     = input;
     p->pos       = 0;
     p->arena     = arena;
     p->error[0]  = '\0';
     p->has_error = false;
+    p->allow_z   = false;
+    p->params    = NULL;
 }
 
 ASTNode *parser_parse(Parser *p) {
@@ -55,6 +82,29 @@ ASTNode *parser_parse(Parser *p) {
     return p->has_error ? NULL : node;
 }
 
+ASTNode *parser_parse_relation(Parser *p, bool *relation) {
+    *relation = false;
+    ASTNode *node = parse_expr(p);
+    if (!p->has_error && peek(p) == '=') {
+        advance(p);
+        ASTNode *right = parse_expr(p);
+        if (p->has_error) return NULL;
+        ASTNode *diff = alloc_node(p);
+        if (!diff) return NULL;
+        diff->type = NODE_BINOP;
+        diff->binop.op    = '-';
+        diff->binop.left  = node;
+        diff->binop.right = right;
+        node = diff;
+        *relation = true;
+    }
+    skip_ws(p);
+    if (!p->has_error && p->input[p->pos] != '\0') {
+        set_error(p, "Unexpected character");
+    }
+    return p->has_error ? NULL : node;
+}
+
 // expr = term (('+' | '-') term)*
 static ASTNode *parse_expr(Parser *p) {
     ASTNode *left = parse_term(p);
@@ -205,6 +255,7 @@ static ASTNode *parse_primary(Parser *p) {
         if (!node) return NULL;
         node->type = NODE_FUNC;
         strcpy(node->func.name, "abs");
+        node->func.id  = FN_ABS;
         node->func.arg = inner;
         return node;
     }
@@ -235,8 +286,18 @@ static ASTNode *parse_primary(Parser *p) {
             return node;
         }
 
-        // Single-letter variable (x or y)
-        if (ni == 1 && (name[0] == 'x' || name[0] == 'y')) {
+        // Single-letter variable (x, y, and z when allowed), or a parameter
+        // standing in for x or y
+        const char *param = p->params && ni == 1 ? strchr(p->params, name[0]) : NULL;
+        if (param) {
+            ASTNode *node = alloc_node(p);
+            if (!node) return NULL;
+            node->type = NODE_VAR;
+            node->var  = param - p->params ? 'y' : 'x';
+            return node;
+        }
+        if (ni == 1 && !p->params &&
+            (name[0] == 'x' || name[0] == 'y' || (name[0] == 'z' && p->allow_z))) {
             ASTNode *node = alloc_node(p);
             if (!node) return NULL;
             node->type = NODE_VAR;
@@ -260,6 +321,7 @@ static ASTNode *parse_primary(Parser *p) {
             node->type = NODE_FUNC;
             strncpy(node->func.name, name, 15);
             node->func.name[15] = '\0';
+            node->func.id  = parser_func_id(name);
             node->func.arg = arg;
             return node;
         }
@@ -6,12 +6,24 @@
 
 typedef enum {
     NODE_NUMBER,
-    NODE_VAR,       // x
+    NODE_VAR,       // x, y, or z where the parser allows it
     NODE_BINOP,     // +, -, *, /, ^
     NODE_UNARY_NEG, // unary minus
     NODE_FUNC,      // sin, cos, tan, sqrt, log, ln, abs, exp
 } NodeType;
 
+// Built-in functions, resolved from the name once at parse time
+typedef enum {
+    FN_SIN, FN_COS, FN_TAN, FN_ASIN, FN_ACOS, FN_ATAN,
+    FN_COT, FN_SEC, FN_CSC,
+    FN_SINH, FN_COSH, FN_TANH, FN_ASINH, FN_ACOSH, FN_ATANH,
+    FN_SQRT, FN_CBRT,
+    FN_LOG, FN_LN, FN_LOG2, FN_EXP,
+    FN_ABS, FN_FLOOR, FN_CEIL, FN_ROUND, FN_SIGN, FN_SGN,
+    FN_UNKNOWN,     // evaluates to NAN
+    FN_COUNT
+} FuncId;
+
 typedef struct ASTNode {
     NodeType type;
     union {
@@ -26,7 +38,8 @@ typedef struct ASTNode {
             struct ASTNode *operand;
         } unary;
         struct {                  // NODE_FUNC
-            char name[16];
+            char   name[16];
+            FuncId id;
             struct ASTNode *arg;
         } func;
     };
@@ -38,9 +51,22 @@ typedef struct {
     Arena      *arena;
     char        error[128];
     bool        has_error;
+    bool        allow_z;  // z is a variable too (3D relations); off after init
+    const char *params;   // letters read as x and y in turn, in place of them
+                          // ("uv", "t": 3D parametric input); NULL after init
 } Parser;
 
 void     parser_init(Parser *p, const char *input, Arena *arena);
 ASTNode *parser_parse(Parser *p);
 
+// Parse "expr" or the relation "lhs = rhs". A relation comes back as
+// lhs - rhs, whose zero set it is, with *relation set.
+ASTNode *parser_parse_relation(Parser *p, bool *relation);
+
+// Resolve a function name to its FuncId (FN_UNKNOWN if not built in)
+FuncId   parser_func_id(const char *name);
+
+// Name of a built-in function ("?" for FN_UNKNOWN)
+const char *parser_func_name(FuncId id);
+
 #endif
@@ -1,19 +1,51 @@
 #include "plotter.h"
-#include "eval.h"
+#include "bytecode.h"
+#include "dag.h"
+#include "jit.h"
+#include "interval.h"
+#include "implicit.h"
+#include "field.h"
 #include "../../ui/ui.h"
+#include "../../ui/polyline.h"
+#include "../../ui/arrows.h"
 #include "../../ui/theme.h"
+#include "../../utils/workpool.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define PLOT_BATCH  256 // points evaluated per batch call
+#define PLOT_CHUNK  64  // cells sampled per pass
+#define PLOT_AHEAD  64  // cells sampled ahead either side of the view
+#define PLOT_TOL_PX 0.5 // screen error allowed between samples, in pixels
+
+// Vector fields, in pixels: arrows and streamline seeds are this far
+// apart at the least, and streamlines step this far
+#define FIELD_ARROW_PX 24.0
+#define FIELD_SEED_PX  64.0
+#define FIELD_STEP_PX  4.0
 
 void plotter_init(PlotState *ps) {
     ps->center_x  = 0.0;
     ps->center_y  = 0.0;
     ps->scale     = 80.0;
     ps->func_count = 0;
+    ps->dag        = NULL;
+    ps->jit        = NULL;
+    ps->jit_mask   = 0;
+    ps->samples    = 0;
+    ps->ahead      = NULL;
+    ps->ahead_samples = 0;
+    ps->fill_arena = arena_create_ex(ARENA_DEFAULT_CAP, 0, "plotter");
     ps->dragging   = false;
+    ps->grid.labels     = true;
+    ps->grid.axis_width = 2.0f;
+    ps->grid.built      = false;
 }
 
-static Vector2 math_to_screen(PlotState *ps, Rectangle area, double mx, double my) {
+static Vector2 math_to_screen(const PlotState *ps, Rectangle area, double mx, double my) {
     Vector2 v;
     v.x = (float)(area.x + area.width  / 2.0 + (mx - ps->center_x) * ps->scale);
     v.y = (float)(area.y + area.height / 2.0 - (my - ps->center_y) * ps->scale);
@@ -33,7 +65,7 @@ void plotter_update(PlotState *ps, Rectangle area) {
 
             double factor = (wheel > 0) ? 1.15 : 1.0 / 1.15;
             ps->scale *= factor;
-            if (ps->scale < 2.0)    ps->scale = 2.0;
+            if (ps->scale < 1e-6)   ps->scale = 1e-6; // whole data series in view
             if (ps->scale > 10000.0) ps->scale = 10000.0;
 
             double mx_after = ps->center_x + (mouse.x - area.x - area.width / 2.0) / ps->scale;
@@ -68,147 +100,908 @@ void plotter_update(PlotState *ps, Rectangle area) {
         ps->center_y = 0.0;
         ps->scale    = 80.0;
     }
+
+    // Scroll with the newest sample of a followed stream, which stays a
+    // tenth of the width in from the right edge. Panning by hand stops
+    // following.
+    for (int si = 0; si < ps->stream_count; si++) {
+        DataStream *st = &ps->streams[si];
+        if (!st->follow) continue;
+        if (ps->dragging) {
+            st->follow = false;
+            continue;
+        }
+        if (!st->visible || !st->hist.count) continue;
+        double newest = st->hist.data[2 * (st->hist.count - 1)];
+        ps->center_x = newest - area.width * 0.4 / ps->scale;
+        break;
+    }
+}
+
+// Curve c is funcs[c] or, from PLOT_DERIV(0) on, a func's derivative
+static const FuncSlot *curve_slot(const PlotState *ps, int c) {
+    return &ps->funcs[c < MAX_FUNCTIONS ? c : c - MAX_FUNCTIONS];
+}
+
+static const ASTNode *curve_ast(const PlotState *ps, int c) {
+    return c < MAX_FUNCTIONS ? ps->funcs[c].ast : curve_slot(ps, c)->deriv;
+}
+
+static const Bytecode *curve_code(const PlotState *ps, int c) {
+    return c < MAX_FUNCTIONS ? ps->funcs[c].code : curve_slot(ps, c)->deriv_code;
+}
+
+// Evaluate the curves selected by mask over xs into outs[c]. Prefers native
+// code for the shared DAG program, then the program itself, then curve by
+// curve.
+static void eval_funcs(PlotState *ps, unsigned mask, const double *xs,
+                       double *const *outs, size_t n) {
+    // Native code for a superset of mask still beats interpreting fewer roots
+    if (ps->jit && (mask & ~ps->jit_mask) == 0) {
+        jit_eval_batch(ps->jit, xs, NULL, outs, n);
+        return;
+    }
+    if (ps->dag) {
+        dag_eval_batch(ps->dag, mask, xs, NULL, outs, n);
+        return;
+    }
+    for (int c = 0; c < PLOT_CURVES; c++)
+        if (mask & (1u << c)) bytecode_eval_batch(curve_code(ps, c), xs, NULL, outs[c], n);
+}
+
+static SampleCache *curve_cache(PlotState *ps, int c) {
+    return &ps->funcs[c < MAX_FUNCTIONS ? c : c - MAX_FUNCTIONS].cache[c >= MAX_FUNCTIONS];
+}
+
+static int ring(long long cell) {
+    int r = (int)(cell % PLOT_CACHE_CELLS);
+    return r < 0 ? r + PLOT_CACHE_CELLS : r;
+}
+
+static long long floor_div(long long a, long long b) {
+    long long q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+// x of subdivision sub (0..PLOT_CELL_SUBS) of a cell
+static double cell_x(const PlotState *ps, long long cell, int sub) {
+    return (double)(cell * PLOT_CELL_SUBS + sub) /
+           (ps->scale * (PLOT_CELL_SUBS / PLOT_CELL_COLS));
+}
+
+// Part of a cell still to be settled; ends in subdivisions of the cell
+typedef struct {
+    int    cell; // within the pass
+    int    sa, sb;
+    double ya, yb;
+    bool   flat;    // the curvature estimate is within tolerance
+    bool   checked; // already proven continuous and near its ends' box
+} Seg;
+
+static int cmp_cell_off(const void *a, const void *b) {
+    const CurveCell *ca = *(CurveCell *const *)a, *cb = *(CurveCell *const *)b;
+    return (ca->off > cb->off) - (ca->off < cb->off);
+}
+
+// Move the cells of sc in [c0, c1) other than [a, a_end) to the front of
+// the pool, dropping the samples of everything else
+static void compact_points(SampleCache *sc, long long c0, long long c1,
+                           long long a, long long a_end) {
+    static CurveCell *live[PLOT_CACHE_CELLS];
+    int n = 0;
+    for (long long i = c0; i < c1; i++) {
+        CurveCell *cc = &sc->cells[ring(i)];
+        if (cc->cell == i && (i < a || i >= a_end)) live[n++] = cc;
+    }
+    qsort(live, (size_t)n, sizeof(live[0]), cmp_cell_off);
+    int used = 0;
+    for (int i = 0; i < n; i++) {
+        memmove(&sc->points[used], &sc->points[live[i]->off],
+                (size_t)live[i]->count * sizeof(CurvePoint));
+        live[i]->off = used;
+        used += live[i]->count;
+    }
+    sc->used = used;
+}
+
+// Do the interval bounds of a stretch stay near the box [lo, hi] of its
+// samples? The slack is the box's height plus tol: interval overestimation
+// grows with the slope much as the height does, while a spike or wiggle
+// between the samples usually pokes out further.
+static bool in_box(Interval iv, double lo, double hi, double tol) {
+    double slack = (hi - lo) + tol;
+    return iv.lo >= lo - slack && iv.hi <= hi + slack;
+}
+
+// Mark the cells [lo, hi) of a pass that lie in a range the interval
+// evaluator proves continuous and near the box of its knots (ky as for
+// refine_cells), halving the range until it holds or is one cell
+static void check_cells(const PlotState *ps, const ASTNode *ast, long long a,
+                        const double *ky, int lo, int hi, double tol, bool *ok) {
+    double klo = INFINITY, khi = -INFINITY;
+    bool finite = true;
+    for (int i = lo; i <= hi; i++) {
+        finite = finite && isfinite(ky[i + 1]);
+        klo = fmin(klo, ky[i + 1]);
+        khi = fmax(khi, ky[i + 1]);
+    }
+    bool pass = false;
+    if (finite) {
+        Interval iv = eval_ast_interval(ast, cell_x(ps, a + lo, 0), cell_x(ps, a + hi, 0), 0.0, 0.0);
+        pass = interval_continuous(iv) && in_box(iv, klo, khi, tol);
+    }
+    if (pass || hi - lo == 1) {
+        for (int i = lo; i < hi; i++) ok[i] = pass;
+        return;
+    }
+    int mid = (lo + hi) / 2;
+    check_cells(ps, ast, a, ky, lo, mid, tol, ok);
+    check_cells(ps, ast, a, ky, mid, hi, tol, ok);
 }
 
-static void draw_grid(PlotState *ps, Rectangle area) {
-    double raw_step = 60.0 / ps->scale;
-    double mag = pow(10.0, floor(log10(raw_step)));
-    double norm = raw_step / mag;
-    double step;
-    if (norm < 2.0)      step = 2.0 * mag;
-    else if (norm < 5.0) step = 5.0 * mag;
-    else                 step = 10.0 * mag;
+// Scratch of one worker for refine_cells
+typedef struct {
+    Seg        segs[2][PLOT_CHUNK * PLOT_CELL_SUBS];
+    CurvePoint grid[PLOT_CHUNK][PLOT_CELL_SUBS + 1]; // by sub; sub 0 = empty
+    double     ys[PLOT_CURVES][PLOT_BATCH];
+} RefineScratch;
+
+// Settle curve c over cells [a, a + cnt) into its cache, writing their
+// points from pool offset off on. ky[i + 1] is the curve at the start of
+// cell a + i, for i in -1..cnt+1. A part of a cell is settled when the
+// interval evaluator proves it continuous and near the box of its ends (see
+// in_box) and the curve is straight enough there; otherwise it is halved,
+// down to 1/PLOT_CELL_SUBS of a cell. The halves of a proven part stay
+// proven. Touches only those cells, so chunks and curves can be refined on
+// different workers. Returns the number of points evaluated.
+static int refine_cells(PlotState *ps, int c, long long a, int cnt, const double *ky,
+                        int off, RefineScratch *rs) {
+    double *outs[PLOT_CURVES];
+    for (int k = 0; k < PLOT_CURVES; k++) outs[k] = rs->ys[k];
+
+    SampleCache   *sc  = curve_cache(ps, c);
+    const ASTNode *ast = curve_ast(ps, c);
+    double tol = PLOT_TOL_PX / ps->scale;
+    int samples = 0;
 
+    memset(rs->grid, 0, (size_t)cnt * sizeof(rs->grid[0]));
+
+    // A chord strays from a parabola by an eighth of its second difference:
+    // whole cells are straight enough where the knots' second differences
+    // at both ends keep that under half the tolerance
+    bool ok[PLOT_CHUNK];
+    check_cells(ps, ast, a, ky, 0, cnt, tol, ok);
+    Seg *in = rs->segs[0], *out = rs->segs[1];
+    int n = 0;
+    for (int i = 0; i < cnt; i++) {
+        double d2a = ky[i] - 2.0 * ky[i + 1] + ky[i + 2];
+        double d2b = ky[i + 1] - 2.0 * ky[i + 2] + ky[i + 3];
+        in[n++] = (Seg){ i, 0, PLOT_CELL_SUBS, ky[i + 1], ky[i + 2],
+                         fabs(d2a) <= 4.0 * tol && fabs(d2b) <= 4.0 * tol, ok[i] };
+    }
+
+    while (n > 0) {
+        // Settle what can be, keep the rest in in[0..m)
+        int m = 0;
+        for (int j = 0; j < n; j++) {
+            Seg s = in[j];
+            bool empty = false, cont = true, boxed = true;
+            if (!s.checked) {
+                Interval iv = eval_ast_interval(ast, cell_x(ps, a + s.cell, s.sa),
+                                                cell_x(ps, a + s.cell, s.sb), 0.0, 0.0);
+                empty = interval_empty(iv);
+                cont  = interval_continuous(iv) && isfinite(s.ya) && isfinite(s.yb);
+                boxed = in_box(iv, fmin(s.ya, s.yb), fmax(s.ya, s.yb), tol);
+                s.checked = cont && boxed;
+            }
+            if (empty || s.sb - s.sa == 1 || (s.checked && s.flat)) {
+                CurvePoint *p = &rs->grid[s.cell][s.sb];
+                p->y    = s.yb;
+                p->sub  = (unsigned char)s.sb;
+                p->join = cont;
+            } else {
+                in[m++] = s;
+            }
+        }
+
+        // Halve the rest; a half strays from its chord by about a quarter
+        // of what its parent's midpoint did
+        int k = 0;
+        for (int j0 = 0; j0 < m; j0 += PLOT_BATCH) {
+            int bn = (m - j0 < PLOT_BATCH) ? m - j0 : PLOT_BATCH;
+            double xs[PLOT_BATCH];
+            for (int j = 0; j < bn; j++) {
+                const Seg *s = &in[j0 + j];
+                xs[j] = cell_x(ps, a + s->cell, (s->sa + s->sb) / 2);
+            }
+            eval_funcs(ps, 1u << c, xs, outs, (size_t)bn);
+            for (int j = 0; j < bn; j++) {
+                Seg s = in[j0 + j];
+                int    sm   = (s.sa + s.sb) / 2;
+                double ym   = rs->ys[c][j];
+                bool   flat = fabs(ym - 0.5 * (s.ya + s.yb)) <= 2.0 * tol;
+                out[k++] = (Seg){ s.cell, s.sa, sm, s.ya, ym, flat, s.checked };
+                out[k++] = (Seg){ s.cell, sm, s.sb, ym, s.yb, flat, s.checked };
+            }
+        }
+        samples += m;
+        Seg *t = in; in = out; out = t;
+        n = k;
+    }
+
+    for (int i = 0; i < cnt; i++) {
+        CurveCell *cc = &sc->cells[ring(a + i)];
+        cc->cell  = a + i;
+        cc->off   = off;
+        cc->count = 0;
+        for (int s = 1; s <= PLOT_CELL_SUBS; s++)
+            if (rs->grid[i][s].sub) sc->points[off + cc->count++] = rs->grid[i][s];
+        off += cc->count;
+    }
+    return samples;
+}
+
+// A stretch of cells being sampled by the worker pool, PLOT_CHUNK cells
+// per task
+typedef struct {
+    PlotState     *ps;
+    long long      a;
+    int            len, chunks;
+    double         y_lo, y_hi;          // the view's y range, padded by a stroke
+    int            curves[PLOT_CURVES]; // the curves in need
+    int            ncurves;
+    int            base[PLOT_CURVES];   // pool offset reserved for the stretch
+    unsigned      *shown;               // by chunk: the curves in need that reach the view
+    int          (*samples)[PLOT_CURVES];
+    // By chunk: the knots of every curve in need, with one either side for
+    // the second differences
+    double       (*knots)[PLOT_CURVES][PLOT_CHUNK + 3];
+    RefineScratch *scratch;             // by worker
+} FillJob;
+
+static int chunk_len(const FillJob *job, int j) {
+    int rest = job->len - j * PLOT_CHUNK;
+    return rest < PLOT_CHUNK ? rest : PLOT_CHUNK;
+}
+
+// Can a curve with bounds [lo, hi] show between y_lo and y_hi?
+static bool reaches(double lo, double hi, double y_lo, double y_hi) {
+    return lo <= y_hi && hi >= y_lo;
+}
+
+// Curves of chunk j whose bounds over it, and a cell either side, keep
+// them out of view get empty cells holding those bounds; the knots of the
+// others are evaluated at once
+static void knots_task(void *ctx, int j, int worker) {
+    (void)worker;
+    FillJob *job = ctx;
+    int cnt = chunk_len(job, j);
+    long long a = job->a + (long long)j * PLOT_CHUNK;
+    unsigned shown = 0;
+    for (int k = 0; k < job->ncurves; k++) {
+        int c = job->curves[k];
+        Interval iv = eval_ast_interval(curve_ast(job->ps, c), cell_x(job->ps, a - 1, 0),
+                                        cell_x(job->ps, a + cnt + 1, 0), 0.0, 0.0);
+        if (reaches(iv.lo, iv.hi, job->y_lo, job->y_hi)) {
+            shown |= 1u << c;
+            continue;
+        }
+        SampleCache *sc = curve_cache(job->ps, c);
+        for (int i = 0; i < cnt; i++)
+            sc->cells[ring(a + i)] = (CurveCell){ a + i, 0, 0, iv.lo, iv.hi };
+    }
+    job->shown[j] = shown;
+    if (!shown) return;
+
+    double xs[PLOT_CHUNK + 3];
+    double *outs[PLOT_CURVES];
+    for (int c = 0; c < PLOT_CURVES; c++) outs[c] = job->knots[j][c];
+    for (int i = 0; i < cnt + 3; i++) xs[i] = cell_x(job->ps, a + i - 1, 0);
+    eval_funcs(job->ps, shown, xs, outs, (size_t)cnt + 3);
+}
+
+// Chunk t / ncurves of the t % ncurves'th curve in need
+static void refine_task(void *ctx, int t, int worker) {
+    FillJob *job = ctx;
+    int j = t / job->ncurves, c = job->curves[t % job->ncurves];
+    int cnt = chunk_len(job, j);
+    int off = job->base[c] + j * PLOT_CHUNK * PLOT_CELL_SUBS;
+    if (!(job->shown[j] & (1u << c))) {
+        job->samples[j][c] = 0;
+        return;
+    }
+    job->samples[j][c] = cnt + 3 + refine_cells(job->ps, c, job->a + (long long)j * PLOT_CHUNK,
+                                                cnt, job->knots[j][c], off,
+                                                &job->scratch[worker]);
+}
+
+// Both passes over chunk j, for a job posted to run on its own
+static void chunk_task(void *ctx, int j, int worker) {
+    FillJob *job = ctx;
+    knots_task(job, j, worker);
+    for (int k = 0; k < job->ncurves; k++) refine_task(job, j * job->ncurves + k, worker);
+}
+
+// A job for the curves in need over cells [a, a_end), in fill_arena, with
+// room reserved in their pools for every point the stretch can take, so
+// tasks never share pool space. The cells of [k0, k1) outside the stretch
+// are kept. NULL when out of memory.
+static FillJob *plan_fill(PlotState *ps, unsigned need, long long a, long long a_end,
+                          long long k0, long long k1, double y_lo, double y_hi) {
+    Arena   *ar  = &ps->fill_arena;
+    FillJob *job = arena_alloc(ar, sizeof(FillJob));
+    if (!job) return NULL;
+    *job = (FillJob){ .ps = ps, .a = a, .len = (int)(a_end - a), .y_lo = y_lo, .y_hi = y_hi };
+    job->chunks  = (job->len + PLOT_CHUNK - 1) / PLOT_CHUNK;
+    job->shown   = arena_alloc(ar, (size_t)job->chunks * sizeof(*job->shown));
+    job->samples = arena_alloc(ar, (size_t)job->chunks * sizeof(*job->samples));
+    job->knots   = arena_alloc(ar, (size_t)job->chunks * sizeof(*job->knots));
+    job->scratch = arena_alloc(ar, (size_t)workpool_workers() * sizeof(RefineScratch));
+    if (!job->shown || !job->samples || !job->knots || !job->scratch) return NULL;
+
+    for (int c = 0; c < PLOT_CURVES; c++) {
+        if (!(need & (1u << c))) continue;
+        SampleCache *sc = curve_cache(ps, c);
+        if (sc->used + job->len * PLOT_CELL_SUBS > PLOT_CACHE_POINTS)
+            compact_points(sc, k0, k1, a, a_end);
+        job->base[c] = sc->used;
+        sc->used += job->len * PLOT_CELL_SUBS;
+        job->curves[job->ncurves++] = c;
+    }
+    return job;
+}
+
+// Pack the points of a finished job down to the start of its room, and
+// count them; returns the points evaluated
+static int finish_fill(FillJob *job) {
+    int samples = 0;
+    for (int k = 0; k < job->ncurves; k++) {
+        int c = job->curves[k];
+        SampleCache *sc = curve_cache(job->ps, c);
+        int used = job->base[c];
+        for (long long i = job->a; i < job->a + job->len; i++) {
+            CurveCell *cc = &sc->cells[ring(i)];
+            memmove(&sc->points[used], &sc->points[cc->off], (size_t)cc->count * sizeof(CurvePoint));
+            cc->off = used;
+            used += cc->count;
+        }
+        sc->used = used;
+        for (int j = 0; j < job->chunks; j++) samples += job->samples[j][c];
+    }
+    return samples;
+}
+
+// Sample the curves in need over cells [a, a_end) into their caches,
+// skipping chunks where they cannot reach [y_lo, y_hi]. The knots of each
+// chunk are evaluated for all of them at once, then every chunk of every
+// curve is refined, each pass spread over the worker pool. False when out
+// of memory, with the stretch left unsampled.
+static bool fill_cells(PlotState *ps, unsigned need, long long a, long long a_end,
+                       long long k0, long long k1, double y_lo, double y_hi) {
+    ArenaMark mark = arena_mark(&ps->fill_arena);
+    FillJob *job = plan_fill(ps, need, a, a_end, k0, k1, y_lo, y_hi);
+    if (job) {
+        workpool_run(knots_task, job, job->chunks);
+        workpool_run(refine_task, job, job->chunks * job->ncurves);
+        ps->samples += finish_fill(job);
+    }
+    arena_rewind(&ps->fill_arena, mark);
+    return job != NULL;
+}
+
+// Was cell left empty for a view the curve did not reach, but reaches now?
+static bool culled_in_view(const CurveCell *cc, double y_lo, double y_hi) {
+    return cc->count == 0 && reaches(cc->lo, cc->hi, y_lo, y_hi);
+}
+
+// Bring the caches of the curves in mask to cells [c0, c1), sampling only
+// the cells they lack and only where the curve can reach [y_lo, y_hi].
+// Cells cached beyond the view are kept as far as [k0, k1). Curves whose
+// cache cannot be allocated or filled are dropped from the returned mask.
+static unsigned refresh_caches(PlotState *ps, unsigned mask, long long c0, long long c1,
+                               long long k0, long long k1, double y_lo, double y_hi) {
+    long long cuts[2 * PLOT_CURVES + 2];
+    int ncuts = 0;
+    cuts[ncuts++] = c0;
+    cuts[ncuts++] = c1;
+
+    for (int c = 0; c < PLOT_CURVES; c++) {
+        if (!(mask & (1u << c))) continue;
+        FuncSlot    *slot = &ps->funcs[c < MAX_FUNCTIONS ? c : c - MAX_FUNCTIONS];
+        SampleCache *sc   = curve_cache(ps, c);
+        // The cache lives in the slot's arena, which a recompile resets
+        if (!sc->cells || sc->gen != slot->gen) {
+            sc->cells  = arena_alloc(&slot->arena, PLOT_CACHE_CELLS * sizeof(CurveCell));
+            sc->points = arena_alloc(&slot->arena, PLOT_CACHE_POINTS * sizeof(CurvePoint));
+            if (!sc->cells || !sc->points) {
+                sc->cells = NULL;
+                mask &= ~(1u << c);
+                continue;
+            }
+            sc->gen     = slot->gen;
+            sc->cell_lo = sc->cell_hi = 0;
+            sc->scale   = 0.0;
+        }
+        if (sc->scale != ps->scale) {
+            for (int i = 0; i < PLOT_CACHE_CELLS; i++) sc->cells[i].cell = LLONG_MIN;
+            sc->scale   = ps->scale;
+            sc->used    = 0;
+            sc->cell_lo = sc->cell_hi = 0;
+        }
+        // Keep what is within [k0, k1) and joins the view; the rest is up
+        // for compaction
+        long long lo = sc->cell_lo > k0 ? sc->cell_lo : k0;
+        long long hi = sc->cell_hi < k1 ? sc->cell_hi : k1;
+        if (lo >= hi || hi < c0 || lo > c1) lo = hi = c0;
+        for (long long i = sc->cell_lo; i < sc->cell_hi; i++)
+            if (i < lo || i >= hi) sc->cells[ring(i)].cell = LLONG_MIN;
+        sc->cell_lo = lo;
+        sc->cell_hi = hi;
+        cuts[ncuts++] = lo > c0 ? lo : c0;
+        cuts[ncuts++] = hi < c1 ? hi : c1;
+    }
+
+    // Between neighbouring cuts each curve either has every cell or none,
+    // so each stretch is sampled once for all the curves that lack it
+    for (int i = 1; i < ncuts; i++) {
+        long long v = cuts[i];
+        int j = i;
+        for (; j > 0 && cuts[j - 1] > v; j--) cuts[j] = cuts[j - 1];
+        cuts[j] = v;
+    }
+    for (int i = 0; i + 1 < ncuts; i++) {
+        long long a = cuts[i], b = cuts[i + 1];
+        if (a >= b || a < c0 || b > c1) continue;
+        unsigned need = 0;
+        for (int c = 0; c < PLOT_CURVES; c++) {
+            if (!(mask & (1u << c))) continue;
+            const SampleCache *sc = curve_cache(ps, c);
+            if (a < sc->cell_lo || a >= sc->cell_hi) need |= 1u << c;
+        }
+        if (need && !fill_cells(ps, need, a, b, k0, k1, y_lo, y_hi)) mask &= ~need;
+    }
+
+    // Cells left empty for an earlier view that this one reaches into
+    for (int c = 0; c < PLOT_CURVES; c++) {
+        if (!(mask & (1u << c))) continue;
+        const SampleCache *sc = curve_cache(ps, c);
+        for (long long a = c0; a < c1; a++) {
+            if (!culled_in_view(&sc->cells[ring(a)], y_lo, y_hi)) continue;
+            long long b = a + 1;
+            while (b < c1 && culled_in_view(&sc->cells[ring(b)], y_lo, y_hi)) b++;
+            if (!fill_cells(ps, 1u << c, a, b, k0, k1, y_lo, y_hi)) mask &= ~(1u << c);
+            a = b;
+        }
+    }
+
+    for (int c = 0; c < PLOT_CURVES; c++) {
+        if (!(mask & (1u << c))) continue;
+        SampleCache *sc = curve_cache(ps, c);
+        if (sc->cell_lo > c0) sc->cell_lo = c0;
+        if (sc->cell_hi < c1) sc->cell_hi = c1;
+    }
+    return mask;
+}
+
+// Cells being sampled ahead of the view while the frame is presented
+struct PlotAhead {
+    FillJob *job;
+    unsigned need;
+    bool     right; // the stretch extends the caches right, not left
+};
+
+// Sample ahead into the side of [k0, k1) the caches of the curves in mask
+// reach least far past the view [c0, c1), which is the side the view
+// moves to, on the worker pool and without waiting for it
+static void post_ahead(PlotState *ps, unsigned mask, long long c0, long long c1,
+                       long long k0, long long k1, double y_lo, double y_hi) {
+    long long left = k0, right = k1; // how far every curve reaches
+    for (int c = 0; c < PLOT_CURVES; c++) {
+        if (!(mask & (1u << c))) continue;
+        const SampleCache *sc = curve_cache(ps, c);
+        if (sc->cell_lo > left) left = sc->cell_lo;
+        if (sc->cell_hi < right) right = sc->cell_hi;
+    }
+    bool go_right = k1 - right > left - k0 || (k1 - right == left - k0 && right - c1 < c0 - left);
+    long long a = go_right ? right : k0, b = go_right ? k1 : left;
+    if (a >= b) return;
+
+    unsigned need = 0;
+    for (int c = 0; c < PLOT_CURVES; c++) {
+        if (!(mask & (1u << c))) continue;
+        const SampleCache *sc = curve_cache(ps, c);
+        if (go_right ? sc->cell_hi < k1 : sc->cell_lo > k0) need |= 1u << c;
+    }
+    PlotAhead *ah = arena_alloc(&ps->fill_arena, sizeof(PlotAhead));
+    FillJob  *job = ah ? plan_fill(ps, need, a, b, k0, k1, y_lo, y_hi) : NULL;
+    if (!job) return;
+    *ah = (PlotAhead){ job, need, go_right };
+    ps->ahead = ah;
+    workpool_post(chunk_task, job, job->chunks);
+}
+
+void plotter_sync(PlotState *ps) {
+    PlotAhead *ah = ps->ahead;
+    if (ah) {
+        workpool_wait();
+        ps->ahead_samples += finish_fill(ah->job);
+        for (int c = 0; c < PLOT_CURVES; c++) {
+            if (!(ah->need & (1u << c))) continue;
+            SampleCache *sc = curve_cache(ps, c);
+            if (ah->right) sc->cell_hi = ah->job->a + ah->job->len;
+            else           sc->cell_lo = ah->job->a;
+        }
+        ps->ahead = NULL;
+    }
+    arena_reset(&ps->fill_arena);
+}
+
+// Curve c's polyline at x, as drawn; NAN where it is broken or not cached
+static double cache_at(PlotState *ps, int c, double x) {
+    const SampleCache *sc = curve_cache(ps, c);
+    long long cell = (long long)floor(x * ps->scale / PLOT_CELL_COLS);
+    if (cell <= sc->cell_lo || cell >= sc->cell_hi) return NAN;
+    const CurveCell *prev = &sc->cells[ring(cell - 1)], *cc = &sc->cells[ring(cell)];
+    if (!prev->count) return NAN;
+    double xa = cell_x(ps, cell, 0), ya = sc->points[prev->off + prev->count - 1].y;
+    for (int i = 0; i < cc->count; i++) {
+        const CurvePoint *p = &sc->points[cc->off + i];
+        double xb = cell_x(ps, cell, p->sub);
+        if (x <= xb) {
+            if (p->join) return ya + (p->y - ya) * (x - xa) / (xb - xa);
+            return (x - xa < xb - x) ? ya : p->y;
+        }
+        xa = xb;
+        ya = p->y;
+    }
+    return NAN;
+}
+
+// Tangent through (x0, y0) with slope m, clipped to the view
+static void draw_tangent(PlotState *ps, Rectangle area, double x0, double y0,
+                         double m, Color col) {
+    double half_w = area.width / 2.0 / ps->scale, half_h = area.height / 2.0 / ps->scale;
+    double xa = ps->center_x - half_w, xb = ps->center_x + half_w;
+    if (m != 0.0) {
+        double x_top = x0 + (ps->center_y + half_h - y0) / m;
+        double x_bot = x0 + (ps->center_y - half_h - y0) / m;
+        xa = fmax(xa, fmin(x_top, x_bot));
+        xb = fmin(xb, fmax(x_top, x_bot));
+    }
+    if (!(xa < xb)) return;
+    DrawLineEx(math_to_screen(ps, area, xa, y0 + m * (xa - x0)),
+               math_to_screen(ps, area, xb, y0 + m * (xb - x0)),
+               1.5f, (Color){col.r, col.g, col.b, 150});
+}
+
+// Name pill of a curve, just above and right of pt
+static void draw_curve_label(const char *lbl, Vector2 pt, Color col) {
+    int lw = ui_measure_text(lbl, FONT_SIZE_TINY);
+    DrawRectangleRounded(
+        (Rectangle){pt.x + 6, pt.y - 18, (float)(lw + 10), 20},
+        0.4f, 6, (Color){col.r, col.g, col.b, 180}
+    );
+    ui_draw_text(lbl, (int)pt.x + 11, (int)pt.y - 17, FONT_SIZE_TINY, WHITE);
+}
+
+// Label spot: the first point past label_x well inside the plot
+static bool label_spot(Rectangle area, float label_x, Vector2 pt) {
+    return pt.x >= label_x && pt.y > area.y + 20 && pt.y < area.y + area.height - 20;
+}
+
+bool plotter_field_fresh(FuncSlot *slot, const double view[FIELD_VIEW]) {
+    FieldCache *fc = &slot->flow;
+    if (fc->built && fc->gen == slot->gen && fc->streams == slot->show_stream &&
+        memcmp(fc->view, view, sizeof(fc->view)) == 0)
+        return true;
+    if (!fc->arena.stats) fc->arena = arena_create_ex(ARENA_DEFAULT_CAP, 0, "field");
+    arena_reset(&fc->arena);
+    fc->built       = true;
+    fc->gen         = slot->gen;
+    fc->streams     = slot->show_stream;
+    memcpy(fc->view, view, sizeof(fc->view));
+    fc->arrows      = NULL;
+    fc->points      = NULL;
+    fc->lengths     = NULL;
+    fc->arrow_count = fc->line_count = 0;
+    return false;
+}
+
+void plotter_field_keep_lines(FieldCache *fc, const FieldLines *fl) {
+    fc->points  = arena_alloc(&fc->arena, (size_t)fl->point_count * 3 * sizeof(float));
+    fc->lengths = arena_alloc(&fc->arena, (size_t)fl->line_count * sizeof(int));
+    if (!fc->points || !fc->lengths) return;
+    memcpy(fc->points, fl->points, (size_t)fl->point_count * 3 * sizeof(float));
+    memcpy(fc->lengths, fl->lengths, (size_t)fl->line_count * sizeof(int));
+    fc->line_count = fl->line_count;
+}
+
+// Points of the lattice of multiples of step inside [lo, hi], at most max
+static int lattice(double lo, double hi, double step, double offset, double *at, int max) {
+    int n = 0;
+    for (double k = ceil(lo / step - offset); n < max && (k + offset) * step <= hi; k++)
+        at[n++] = (k + offset) * step;
+    return n;
+}
+
+// Arrows of a 2D field on the lattice of multiples of FIELD_ARROW_PX, so
+// they stay put as the view pans, and its streamlines when shown, seeded
+// on the lattice between; rebuilt only when the slot or the view changes,
+// with arena for scratch
+static void build_field(PlotState *ps, FuncSlot *slot, Rectangle area, Arena *arena) {
+    double view[FIELD_VIEW] = { ps->center_x, ps->center_y, ps->scale,
+                                area.x, area.y, area.width, area.height };
+    if (plotter_field_fresh(slot, view)) return;
+    FieldCache *fc = &slot->flow;
     double x_min = ps->center_x - (area.width / 2.0) / ps->scale;
     double x_max = ps->center_x + (area.width / 2.0) / ps->scale;
     double y_min = ps->center_y - (area.height / 2.0) / ps->scale;
     double y_max = ps->center_y + (area.height / 2.0) / ps->scale;
+    double room  = (double)area.width * area.height;
 
-    ui_scissor_begin((int)area.x, (int)area.y, (int)area.width, (int)area.height);
-
-    // Sub-grid (lighter)
-    double sub_step = step / 5.0;
-    Color sub_col = (Color){42, 44, 50, 255};
-    double sx_start = floor(x_min / sub_step) * sub_step;
-    for (double gx = sx_start; gx <= x_max; gx += sub_step) {
-        Vector2 top = math_to_screen(ps, area, gx, y_max);
-        Vector2 bot = math_to_screen(ps, area, gx, y_min);
-        DrawLineV(top, bot, sub_col);
-    }
-    double sy_start = floor(y_min / sub_step) * sub_step;
-    for (double gy = sy_start; gy <= y_max; gy += sub_step) {
-        Vector2 left  = math_to_screen(ps, area, x_min, gy);
-        Vector2 right = math_to_screen(ps, area, x_max, gy);
-        DrawLineV(left, right, sub_col);
-    }
-
-    // Major grid lines
-    double x_start = floor(x_min / step) * step;
-    for (double gx = x_start; gx <= x_max; gx += step) {
-        Vector2 top = math_to_screen(ps, area, gx, y_max);
-        Vector2 bot = math_to_screen(ps, area, gx, y_min);
-        DrawLineV(top, bot, COL_GRID);
-
-        char label[32];
-        snprintf(label, sizeof(label), "%.4g", gx);
-        Vector2 axis_pos = math_to_screen(ps, area, gx, 0);
-        // Clamp label to plot area
-        float ly = axis_pos.y + 4;
-        if (ly < area.y + 2) ly = area.y + 2;
-        if (ly > area.y + area.height - 16) ly = area.y + area.height - 16;
-        ui_draw_text(label, (int)axis_pos.x + 4, (int)ly, FONT_SIZE_TINY, COL_TEXT_DIM);
-    }
-
-    double y_start = floor(y_min / step) * step;
-    for (double gy = y_start; gy <= y_max; gy += step) {
-        Vector2 left  = math_to_screen(ps, area, x_min, gy);
-        Vector2 right = math_to_screen(ps, area, x_max, gy);
-        DrawLineV(left, right, COL_GRID);
-
-        if (fabs(gy) > step * 0.01) {
-            char label[32];
-            snprintf(label, sizeof(label), "%.4g", gy);
-            Vector2 axis_pos = math_to_screen(ps, area, 0, gy);
-            float lx = axis_pos.x + 4;
-            if (lx < area.x + 2) lx = area.x + 2;
-            ui_draw_text(label, (int)lx, (int)axis_pos.y - 14, FONT_SIZE_TINY, COL_TEXT_DIM);
+    ArenaMark mark = arena_mark(arena);
+    double *gx = arena_alloc(arena, FIELD_MAX_POINTS * sizeof(double));
+    double *gy = arena_alloc(arena, FIELD_MAX_POINTS * sizeof(double));
+    double px  = fmax(FIELD_ARROW_PX, sqrt(room / FIELD_MAX_POINTS) + 1.0);
+    int nx = gx ? lattice(x_min, x_max, px / ps->scale, 0.0, gx, FIELD_MAX_POINTS) : 0;
+    int ny = gy && nx ? lattice(y_min, y_max, px / ps->scale, 0.0, gy, FIELD_MAX_POINTS / nx) : 0;
+    int n  = nx * ny;
+    double *xs  = arena_alloc(arena, (size_t)n * sizeof(double));
+    double *ys  = arena_alloc(arena, (size_t)n * sizeof(double));
+    double *f   = arena_alloc(arena, (size_t)n * 2 * sizeof(double));
+    float  *mag = arena_alloc(arena, (size_t)n * sizeof(float));
+    fc->arrows  = arena_alloc(&fc->arena, (size_t)n * sizeof(Matrix));
+    if (n && xs && ys && f && mag && fc->arrows) {
+        for (int j = 0; j < ny; j++)
+            for (int i = 0; i < nx; i++) {
+                xs[j * nx + i] = gx[i];
+                ys[j * nx + i] = gy[j];
+            }
+        field_sample(slot->comp_code, 2, xs, ys, NULL, n, f);
+        ps->samples += n;
+        field_magnitudes(f, 2, n, mag, arena);
+        for (int i = 0; i < n; i++) {
+            double len = hypot(f[i], f[n + i]);
+            if (isnan(mag[i]) || !(len > 0.0)) continue;
+            Vector2 at  = math_to_screen(ps, area, xs[i], ys[i]);
+            Vector3 dir = { (float)(f[i] / len), (float)(-f[n + i] / len), 0.0f };
+            fc->arrows[fc->arrow_count++] = ui_arrow_place((Vector3){ at.x, at.y, 0.0f }, dir,
+                                                           (float)px * (0.35f + 0.55f * mag[i]), mag[i]);
         }
     }
 
-    // Axes (thicker)
-    Vector2 ax_left  = math_to_screen(ps, area, x_min, 0);
-    Vector2 ax_right = math_to_screen(ps, area, x_max, 0);
-    DrawLineEx(ax_left, ax_right, 2.0f, COL_AXIS);
-
-    Vector2 ax_top = math_to_screen(ps, area, 0, y_max);
-    Vector2 ax_bot = math_to_screen(ps, area, 0, y_min);
-    DrawLineEx(ax_top, ax_bot, 2.0f, COL_AXIS);
+    if (slot->show_stream) {
+        double sx[FIELD_MAX_SEEDS], sy[FIELD_MAX_SEEDS];
+        double spx  = fmax(FIELD_SEED_PX, sqrt(room / FIELD_MAX_SEEDS) + 1.0);
+        int    snx  = lattice(x_min, x_max, spx / ps->scale, 0.5, sx, FIELD_MAX_SEEDS);
+        int    sny  = lattice(y_min, y_max, spx / ps->scale, 0.5, sy, snx ? FIELD_MAX_SEEDS / snx : 0);
+        double *seeds = arena_alloc(arena, (size_t)snx * sny * 3 * sizeof(double));
+        for (int j = 0; seeds && j < sny; j++)
+            for (int i = 0; i < snx; i++) {
+                double *s = &seeds[3 * (j * snx + i)];
+                s[0] = sx[i];
+                s[1] = sy[j];
+                s[2] = 0.0;
+            }
+        double lo[3] = { x_min, y_min, 0.0 }, hi[3] = { x_max, y_max, 0.0 };
+        FieldLines fl = seeds ? field_lines(slot->comp_code, 2, seeds, snx * sny, lo, hi,
+                                            FIELD_STEP_PX / ps->scale, arena)
+                              : (FieldLines){0};
+        ps->samples += (int)fl.evals;
+        plotter_field_keep_lines(fc, &fl);
+    }
+    arena_rewind(arena, mark);
+}
 
-    // Origin marker
-    Vector2 origin = math_to_screen(ps, area, 0, 0);
-    DrawCircleV(origin, 3.0f, COL_AXIS);
+// Streamlines under the arrows, in the field's colour
+static void draw_field(const PlotState *ps, const FuncSlot *slot, Rectangle area) {
+    const FieldCache *fc = &slot->flow;
+    Color col = PLOT_COLORS[slot->color_idx % PLOT_COLOR_COUNT];
+    const float *p = fc->points;
+    for (int l = 0; l < fc->line_count; l++) {
+        ui_polyline_begin(1.5f, (Color){ col.r, col.g, col.b, 140 });
+        for (int i = 0; i < fc->lengths[l]; i++, p += 3)
+            ui_polyline_point(math_to_screen(ps, area, p[0], p[1]));
+        ui_polyline_end();
+    }
+    ui_arrows_draw_2d(fc->arrows, fc->arrow_count, col);
+}
 
-    EndScissorMode();
+// One data line, labelled right of the curve labels
+static void draw_series_line(const PlotState *ps, Rectangle area, const SeriesPoint *pts, int n,
+                             const char *name, int color_idx) {
+    Color col = PLOT_COLORS[color_idx % PLOT_COLOR_COUNT];
+    Vector2 label_pt = {0};
+    bool label_placed = false;
+    ui_polyline_begin(1.5f, col);
+    for (int i = 0; i < n; i++) {
+        Vector2 pt = math_to_screen(ps, area, pts[i].x, pts[i].y);
+        if (pts[i].start) ui_polyline_break();
+        ui_polyline_point(pt);
+        if (!label_placed && label_spot(area, area.x + area.width * 0.6f, pt)) {
+            label_pt = pt;
+            label_placed = true;
+        }
+    }
+    ui_polyline_end();
+    if (label_placed) draw_curve_label(name, label_pt, col);
 }
 
 void plotter_draw(PlotState *ps, Rectangle area, Arena *arena) {
-    (void)arena;
+    plotter_sync(ps);
 
     DrawRectangleRec(area, COL_BG);
-    draw_grid(ps, area);
 
     ui_scissor_begin((int)area.x, (int)area.y, (int)area.width, (int)area.height);
+    ui_plot_grid_draw(&ps->grid, area, ps->center_x, ps->center_y, ps->scale);
 
     double x_min = ps->center_x - (area.width / 2.0) / ps->scale;
+    double x_max = ps->center_x + (area.width / 2.0) / ps->scale;
+
+    // Data series under the curves, at most four points per pixel column
+    // whatever their size, decimated again only when the view changes
+    int columns = (int)area.width > 1 ? (int)area.width : 1;
+    for (int si = 0; si < ps->series_count; si++) {
+        DataSeries *s = &ps->series[si];
+        if (!s->visible) continue;
+        int n;
+        const SeriesPoint *pts = series_view(s, x_min, x_max, columns, &n);
+        draw_series_line(ps, area, pts, n, s->name, s->color_idx);
+    }
+    // Streams change every frame; theirs go through the frame arena
+    for (int si = 0; arena && si < ps->stream_count; si++) {
+        const DataStream *st = &ps->streams[si];
+        if (!st->visible) continue;
+        ArenaMark mark = arena_mark(arena);
+        SeriesPoint *pts = arena_alloc(arena, (size_t)(4 * columns + 2) * sizeof(SeriesPoint));
+        int n = pts ? series_decimate(&st->hist, x_min, x_max, columns, pts) : 0;
+        draw_series_line(ps, area, pts, n, st->name, st->color_idx);
+        arena_rewind(arena, mark);
+    }
 
-    // Draw each function
+    // Curves that get drawn, as a DAG root mask, the relations and the
+    // vector fields
+    unsigned mask = 0, rel = 0, fields = 0;
     for (int fi = 0; fi < ps->func_count; fi++) {
-        if (!ps->funcs[fi].visible || !ps->funcs[fi].valid || !ps->funcs[fi].ast) continue;
+        const FuncSlot *slot = &ps->funcs[fi];
+        if (!slot->visible || !slot->valid || !slot->code) continue;
+        if (slot->field) {
+            fields |= 1u << fi;
+            continue;
+        }
+        if (slot->implicit) {
+            rel |= 1u << fi;
+            continue;
+        }
+        mask |= 1u << fi;
+        if (slot->show_deriv && slot->deriv_code) mask |= 1u << PLOT_DERIV(fi);
+    }
 
-        Color col = PLOT_COLORS[ps->funcs[fi].color_idx % PLOT_COLOR_COUNT];
-        int steps = (int)area.width;
+    // These curves are sampled whenever new cells come into view: JIT
+    // them, once per set
+    if (ps->dag && mask != ps->jit_mask) {
+        jit_free(ps->jit);
+        ps->jit      = jit_compile(ps->dag, mask);
+        ps->jit_mask = mask;
+    }
 
-        Vector2 prev = {0};
-        bool prev_valid = false;
-        bool label_placed = false;
-        // Place label at ~20% from left of plot
-        int label_target_x = (int)(area.width * 0.2f);
+    // Cells of the view, with a column to spare either side, on the lattice
+    // x = k / scale so that panning keeps the samples still in view
+    long long c0 = floor_div((long long)floor(x_min * ps->scale) - 1, PLOT_CELL_COLS);
+    long long c1 = floor_div((long long)ceil(x_max * ps->scale) + 1, PLOT_CELL_COLS) + 1;
+    if (c1 - c0 > PLOT_CACHE_CELLS) c1 = c0 + PLOT_CACHE_CELLS;
+    // Cells kept either side of the view, as many as the ring holds up to
+    // PLOT_AHEAD
+    long long ahead = (PLOT_CACHE_CELLS - (c1 - c0)) / 2;
+    if (ahead > PLOT_AHEAD) ahead = PLOT_AHEAD;
+    long long k0 = c0 - ahead, k1 = c1 + ahead;
 
-        for (int i = 0; i <= steps; i++) {
-            double mx = x_min + (double)i / ps->scale;
-            double my = eval_ast(ps->funcs[fi].ast, mx);
+    // Visible y range, padded by the stroke width
+    double y_min = ps->center_y - (area.height / 2.0) / ps->scale;
+    double y_max = ps->center_y + (area.height / 2.0) / ps->scale;
+    double pad   = 4.0 / ps->scale;
+    ps->samples       = ps->ahead_samples;
+    ps->ahead_samples = 0;
+    mask = refresh_caches(ps, mask, c0, c1, k0, k1, y_min - pad, y_max + pad);
 
-            if (isnan(my) || isinf(my)) {
-                prev_valid = false;
-                continue;
-            }
+    // Vector fields under the curves, rebuilt when the view moves
+    for (int fi = 0; arena && fi < ps->func_count; fi++) {
+        if (!(fields & (1u << fi))) continue;
+        build_field(ps, &ps->funcs[fi], area, arena);
+        draw_field(ps, &ps->funcs[fi], area);
+    }
 
-            Vector2 pt = math_to_screen(ps, area, mx, my);
+    // Place label at ~20% from left of plot
+    float label_x = area.x + area.width * 0.2f;
+    float top = area.y - 4.0f, bottom = area.y + area.height + 4.0f;
 
-            if (prev_valid) {
-                float dy = fabsf(pt.y - prev.y);
-                if (dy < area.height * 2.0f) {
-                    DrawLineEx(prev, pt, 2.5f, col);
+    for (int c = 0; c < PLOT_CURVES; c++) {
+        if (!(mask & (1u << c))) continue;
+        const SampleCache *sc = curve_cache(ps, c);
+        bool  deriv = c >= MAX_FUNCTIONS;
+        Color col   = PLOT_COLORS[curve_slot(ps, c)->color_idx % PLOT_COLOR_COUNT];
+        // Derivatives are drawn thinner and translucent
+        float width = deriv ? 1.8f : 2.5f;
+        if (deriv) col.a = 170;
+
+        // The curve is one polyline, broken where it breaks or leaves the
+        // view; its label goes on top once the line is drawn
+        Vector2 prev = {0}, label_pt = {0};
+        bool prev_valid = false, label_placed = false;
+        ui_polyline_begin(width, col);
+        for (long long cell = c0; cell < c1; cell++) {
+            const CurveCell *cc = &sc->cells[ring(cell)];
+            if (!cc->count) prev_valid = false; // out of view when sampled
+            for (int i = 0; i < cc->count; i++) {
+                const CurvePoint *p = &sc->points[cc->off + i];
+                if (isnan(p->y) || isinf(p->y)) {
+                    ui_polyline_break();
+                    prev_valid = false;
+                    continue;
+                }
+
+                Vector2 pt = math_to_screen(ps, area, cell_x(ps, cell, p->sub), p->y);
+
+                // Break only where the curve really does: steep but continuous
+                // stretches stay connected. Segments wholly above or below the
+                // view are left out.
+                if (!prev_valid || !p->join ||
+                    (pt.y < top && prev.y < top) || (pt.y > bottom && prev.y > bottom))
+                    ui_polyline_break();
+                ui_polyline_point(pt);
+
+                if (!label_placed && label_spot(area, label_x, pt)) {
+                    label_pt = pt;
+                    label_placed = true;
                 }
+
+                prev = pt;
+                prev_valid = true;
             }
+        }
+        ui_polyline_end();
+
+        // Draw label on curve
+        if (label_placed) {
+            char lbl[FUNC_NAME_SIZE + 1];
+            snprintf(lbl, sizeof(lbl), deriv ? "%s'" : "%s", curve_slot(ps, c)->name);
+            draw_curve_label(lbl, label_pt, col);
+        }
+    }
+
+    // Relations F(x, y) = 0, traced again only when the slot or the view
+    // changes, with the frame arena for scratch
+    for (int fi = 0; arena && fi < ps->func_count; fi++) {
+        if (!(rel & (1u << fi))) continue;
+        FuncSlot *slot = &ps->funcs[fi];
+        Color col = PLOT_COLORS[slot->color_idx % PLOT_COLOR_COUNT];
+        ImplicitTrace tr = implicit_trace(&slot->lines, slot->gen, slot->code, slot->ast, x_min,
+                                          x_max, y_min, y_max, ps->scale, arena);
+        ps->samples += tr.evals;
 
-            // Draw label on curve
-            if (!label_placed && i >= label_target_x &&
-                pt.y > area.y + 20 && pt.y < area.y + area.height - 20) {
-                // Background pill behind label
-                const char *lbl = ps->funcs[fi].name;
-                int lw = ui_measure_text(lbl, FONT_SIZE_TINY);
-                DrawRectangleRounded(
-                    (Rectangle){pt.x + 6, pt.y - 18, (float)(lw + 10), 20},
-                    0.4f, 6, (Color){col.r, col.g, col.b, 180}
-                );
-                ui_draw_text(lbl, (int)pt.x + 11, (int)pt.y - 17, FONT_SIZE_TINY, WHITE);
+        Vector2 label_pt = {0};
+        bool label_placed = false;
+        ui_polyline_begin(2.5f, col);
+        for (int i = 0; i < tr.count; i++) {
+            Vector2 pt = math_to_screen(ps, area, tr.pts[i].x, tr.pts[i].y);
+            if (tr.pts[i].start) ui_polyline_break();
+            ui_polyline_point(pt);
+            if (!label_placed && label_spot(area, label_x, pt)) {
+                label_pt = pt;
                 label_placed = true;
             }
-
-            prev = pt;
-            prev_valid = true;
         }
+        ui_polyline_end();
+        if (label_placed) draw_curve_label(slot->name, label_pt, col);
+    }
+
+    // Points evaluated this frame: 0 while the view stands still
+    if (mask || rel || fields) {
+        char info[32];
+        snprintf(info, sizeof(info), "%d samples", ps->samples);
+        int iw = ui_measure_text(info, FONT_SIZE_TINY);
+        ui_draw_text(info, (int)(area.x + area.width) - iw - 8, (int)(area.y + area.height) - 18,
+                     FONT_SIZE_TINY, COL_TEXT_DIM);
     }
 
     // Crosshair + coordinate display + function values at cursor
@@ -234,22 +1027,36 @@ void plotter_draw(PlotState *ps, Rectangle area, Arena *arena) {
         );
         ui_draw_text(coords, (int)mouse.x + 19, (int)mouse.y - 21, FONT_SIZE_TINY, COL_TEXT);
 
-        // Show function values at cursor x
-        float info_y = mouse.y + 8;
+        // Curve values at the cursor, read off the cached polylines
+        double vals[PLOT_CURVES];
+        for (int c = 0; c < PLOT_CURVES; c++)
+            if (mask & (1u << c)) vals[c] = cache_at(ps, c, mx);
+
+        // Tangents of the funcs whose derivative is shown
         for (int fi = 0; fi < ps->func_count; fi++) {
-            if (!ps->funcs[fi].visible || !ps->funcs[fi].valid || !ps->funcs[fi].ast) continue;
-            double fy = eval_ast(ps->funcs[fi].ast, mx);
+            if (!(mask & (1u << PLOT_DERIV(fi)))) continue;
+            double fy = vals[fi], slope = vals[PLOT_DERIV(fi)];
+            if (!isfinite(fy) || !isfinite(slope)) continue;
+            draw_tangent(ps, area, mx, fy, slope,
+                         PLOT_COLORS[ps->funcs[fi].color_idx % PLOT_COLOR_COUNT]);
+        }
+
+        float info_y = mouse.y + 8;
+        for (int c = 0; c < PLOT_CURVES; c++) {
+            if (!(mask & (1u << c))) continue;
+            double fy = vals[c];
             if (isnan(fy) || isinf(fy)) continue;
 
             // Draw dot on curve
             Vector2 dot_pos = math_to_screen(ps, area, mx, fy);
-            Color col = PLOT_COLORS[ps->funcs[fi].color_idx % PLOT_COLOR_COUNT];
+            Color col = PLOT_COLORS[curve_slot(ps, c)->color_idx % PLOT_COLOR_COUNT];
             DrawCircleV(dot_pos, 4.0f, col);
             DrawCircleV(dot_pos, 2.0f, WHITE);
 
             // Value tooltip near cursor
             char val[80];
-            snprintf(val, sizeof(val), "%s = %.4g", ps->funcs[fi].name, fy);
+            snprintf(val, sizeof(val), c >= MAX_FUNCTIONS ? "%s' = %.4g" : "%s = %.4g",
+                     curve_slot(ps, c)->name, fy);
             int vw = ui_measure_text(val, FONT_SIZE_TINY);
             DrawRectangleRounded(
                 (Rectangle){mouse.x + 14, info_y, (float)(vw + 10), 18},
@@ -261,4 +1068,10 @@ void plotter_draw(PlotState *ps, Rectangle area, Arena *arena) {
     }
 
     EndScissorMode();
+
+    // The caches are not read again this frame: the workers may sample
+    // the cells a pan comes to next, in a y range as much wider, while it
+    // is presented
+    double more = (double)(ahead * PLOT_CELL_COLS) / ps->scale;
+    post_ahead(ps, mask, c0, c1, k0, k1, y_min - pad - more, y_max + pad + more);
 }
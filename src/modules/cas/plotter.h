@@ -3,29 +3,158 @@
 
 #include "raylib.h"
 #include "parser.h"
+#include "bytecode.h"
+#include "dag.h"
+#include "jit.h"
+#include "series.h"
+#include "stream.h"
+#include "field.h"
+#include "implicit.h"
+#include "../../ui/plotgrid.h"
 
 #define MAX_FUNCTIONS 8
 #define EXPR_BUF_SIZE 256
 #define FUNC_NAME_SIZE 32
+#define MAX_SERIES     4
+#define MAX_STREAMS    2
+
+// Curves drawn by the 2D plotter, and the roots of its DagProgram:
+// funcs[i] is i and its derivative is PLOT_DERIV(i)
+#define PLOT_CURVES    (2 * MAX_FUNCTIONS)
+#define PLOT_DERIV(i)  (MAX_FUNCTIONS + (i))
+
+// Adaptive samples of one 2D curve, kept across frames so that a pan only
+// samples the cells it exposes. The view is cut into cells of
+// PLOT_CELL_COLS columns on the lattice x = k / scale; each cell is
+// subdivided down to 1/PLOT_CELL_SUBS of itself where the curve bends or
+// breaks. Cell i lives at i mod PLOT_CACHE_CELLS of the ring.
+#define PLOT_CACHE_COLS   4096 // widest plot area cached whole, in pixels
+#define PLOT_CELL_COLS    4
+#define PLOT_CELL_SUBS    32   // finest step: 1/8 column
+#define PLOT_CACHE_CELLS  (PLOT_CACHE_COLS / PLOT_CELL_COLS)
+#define PLOT_CACHE_POINTS (PLOT_CACHE_CELLS * PLOT_CELL_SUBS)
+
+// Sample at subdivision sub (1..PLOT_CELL_SUBS) of its cell
+typedef struct {
+    double        y;
+    unsigned char sub;
+    bool          join; // the segment from the previous sample may be drawn
+} CurvePoint;
+
+// The samples in (start, end] of one cell, end included. A cell with no
+// samples was out of view when it was filled: [lo, hi] bounds the curve
+// there, so it is sampled once a view reaches that far.
+typedef struct {
+    long long cell; // which cell the entry holds, to tell stale entries
+    int       off, count;
+    double    lo, hi;
+} CurveCell;
+
+typedef struct {
+    unsigned    gen;    // FuncSlot.gen the samples were taken for
+    double      scale;
+    long long   cell_lo, cell_hi; // cells [cell_lo, cell_hi) are cached
+    CurveCell  *cells;  // PLOT_CACHE_CELLS entries, in the slot's arena
+    CurvePoint *points; // PLOT_CACHE_POINTS samples the cells point into
+    int         used;   // points handed out; compacted when full
+} SampleCache;
+
+// 3D surfaces are quadtrees of chunks over the range, each a mesh of
+// SURF_CHUNK x SURF_CHUNK cells. A chunk is split in four where its gap
+// to the surface would show as more than a pixel or two from the camera,
+// so the mesh is fine close up and where the surface bends, and coarse
+// far away and where it is flat. Implicit surfaces F(x, y, z) = 0 are one
+// mesh over the range cube, in parts small enough for 16-bit indices, and
+// parametric surfaces and curves one mesh over their parameters.
+#define SURF_CHUNK 32
+
+typedef struct SurfaceTree SurfaceTree; // nodes and their meshes, in plotter3d.c
+
+// A 3D surface on the GPU. Chunks stay uploaded while they are in use, or
+// were lately; the tree or parts are dropped when the slot or the range
+// changes.
+typedef struct {
+    bool         built;
+    unsigned     gen;   // FuncSlot.gen it was built for
+    float        range;
+    SurfaceTree *tree;  // MemAlloc'd; explicit surfaces
+    Mesh        *parts; // MemAlloc'd, uploaded; implicit and parametric ones
+    int          part_count;
+} SurfaceMesh;
+
+// Arrows and streamlines of a vector field as last built, kept until the
+// slot or the view changes: the 2D view's centre, scale and area, or the
+// 3D range alone
+#define FIELD_VIEW 7
+
+typedef struct {
+    Arena     arena;   // owns the arrays; reset on every rebuild
+    bool      built;
+    unsigned  gen;     // FuncSlot.gen they were built for
+    double    view[FIELD_VIEW];
+    bool      streams; // whether the streamlines were traced
+    Matrix   *arrows;  // instance transforms, see ui_arrow_place
+    int       arrow_count;
+    float    *points;  // streamline points, x, y, z each, in plot coordinates
+    int      *lengths; // points per streamline
+    int       line_count;
+} FieldCache;
 
 typedef struct {
     char     expr_text[EXPR_BUF_SIZE];
     char     name[FUNC_NAME_SIZE];  // custom name like "f1", "g", "velocity"
-    ASTNode *ast;
+    ASTNode  *ast;
+    Bytecode *code;  // compiled form of ast, what the plotters evaluate
+    ASTNode  *deriv;       // d/dx of ast when show_deriv is set (2D), or NULL
+    Bytecode *deriv_code;
+    Bytecode *grad_code[2]; // 3D explicit: df/dx and df/dy, for the surface normals
     bool     valid;
     bool     visible;
+    bool     show_deriv;   // plot f' and the tangent at the cursor
+    bool     implicit;     // relation: ast is F(x, y), or F(x, y, z) in 3D, drawn where F = 0
+    int      params;       // 3D parametric: 2, a surface of (u, v), or 1, a curve of t
+    int      field;        // vector field: 2, (P, Q)(x, y), or 3, (P, Q, R)(x, y, z) in 3D
+    bool     show_stream;  // field: draw streamlines too
+    bool     show_contours; // 3D explicit: contour lines on the surface and isobands below it
+    ASTNode  *comp[3];     // parametric: x, y and z, with u, t read as x and v as y; field: P, Q, R
+    Bytecode *comp_code[3];
+    Arena    arena;        // owns the trees and code; reset when the slot is recompiled
+    unsigned gen;          // bumped on every recompile, for caches keyed on the slot
+    SampleCache cache[2];  // 2D samples of ast and of deriv
+    SurfaceMesh mesh;      // 3D surface of ast
+    FieldCache  flow;      // field: its arrows and streamlines
+    ImplicitCache lines;   // 2D relation: its traced lines
     int      color_idx;
 } FuncSlot;
 
+typedef struct PlotAhead PlotAhead; // cells being sampled ahead, in plotter.c
+
 typedef struct {
     // View window in math coordinates
     double center_x;
     double center_y;
     double scale; // pixels per unit
+    PlotGrid grid; // grid and axis layer of the view
 
     // Functions
     FuncSlot funcs[MAX_FUNCTIONS];
     int      func_count;
+    DagProgram *dag; // all curves as one program (see PLOT_DERIV), or NULL
+    JitCode    *jit; // native code of dag for the funcs in jit_mask, or NULL
+    unsigned    jit_mask;
+    int         samples;  // points evaluated for the last frame, ahead of it included
+
+    // Cells either side of the view, sampled on the worker pool while the
+    // frame is presented, and kept by plotter_sync
+    PlotAhead  *ahead;      // in fill_arena while posted, else NULL
+    int         ahead_samples;
+    Arena       fill_arena; // jobs and worker scratch of the sampling
+
+    // Measured data drawn under the curves: files, and live streams
+    DataSeries series[MAX_SERIES];
+    int        series_count;
+    DataStream streams[MAX_STREAMS];
+    int        stream_count;
 
     // Interaction state
     bool   dragging;
@@ -36,5 +165,15 @@ typedef struct {
 void plotter_init(PlotState *ps);
 void plotter_update(PlotState *ps, Rectangle area);
 void plotter_draw(PlotState *ps, Rectangle area, Arena *arena);
+// Wait for the cells plotter_draw left sampling ahead and keep them. Call
+// it before the functions, the view or ps change or are freed: at the
+// start of every update and at cleanup.
+void plotter_sync(PlotState *ps);
+
+// True if slot's field cache was built for the slot as it is and view; if
+// not, it is emptied and keyed to them, for the caller to rebuild
+bool plotter_field_fresh(FuncSlot *slot, const double view[FIELD_VIEW]);
+// Copy the streamlines fl into fc's arena
+void plotter_field_keep_lines(FieldCache *fc, const FieldLines *fl);
 
 #endif
@@ -1,13 +1,55 @@
 #include "plotter3d.h"
+#include "bytecode.h"
+#include "dag.h"
+#include "jit.h"
 #include "eval.h"
+#include "implicit3d.h"
+#include "parametric.h"
+#include "field.h"
 #include "../../ui/ui.h"
 #include "../../ui/theme.h"
+#include "../../ui/arrows.h"
+#include "../../utils/workpool.h"
 #include "rlgl.h"
+#include "raymath.h"
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #define GRID_LINES 20
-#define SURF_RES   60
+#define WIRE_STEP  8  // chunk cells between wireframe lines and nodes
+
+// Surface chunk quadtree
+#define LOD_MIN_LEVEL 2     // always split this far: a 128-cell grid
+#define LOD_MAX_LEVEL 12
+#define LOD_PIXELS    2.0f  // largest gap a drawn chunk may show on screen
+#define LOD_MAX_NODES 769   // per surface: the root, then blocks of four
+#define LOD_BLOCKS    ((LOD_MAX_NODES - 1) / 4)
+#define LOD_BUILDS    48    // chunks built in one round at most, all surfaces together
+#define LOD_BUDGET    0.004 // s a frame may spend building chunks
+#define LOD_KEEP      120   // frames unused chunks stay uploaded
+#define HALF          (2 * SURF_CHUNK + 1) // samples a side, half a cell apart
+#define MIP_CELLS     ((4 * SURF_CHUNK * SURF_CHUNK - 1) / 3) // a chunk's min/max pyramid
+
+// Contours of explicit surfaces: levels at a round step, about ISO_LEVELS
+// of them across the range; a triangle crossing more than ISO_MAX_CROSS
+// is a cliff and gets none. Lines on the surface are lifted ISO_LIFT of
+// the range, against z-fighting.
+#define ISO_LEVELS      16
+#define ISO_MAX_CROSS   8
+#define ISO_MAX_SEGS    (4 * SURF_CHUNK * SURF_CHUNK) // per chunk
+#define ISO_MAX_VERTS   65535                         // isoband vertices per chunk
+#define ISO_LIFT        0.002f
+
+// Parametric surfaces and curves, in parts of the range
+#define PARAM_GAP   0.001f // largest gap left between mesh and surface
+#define TUBE_RADIUS 0.006f
+
+// Vector fields: arrows a side of the range cube, streamline seeds a side,
+// and the streamline step in parts of the range
+#define FIELD_SIDE  22 // 10648 arrows
+#define FIELD_SEEDS 6
+#define FIELD_STEP  (1.0 / 64)
 
 void plotter3d_init(Plot3DState *ps) {
     ps->orbit_angle = 0.6f;
@@ -15,8 +57,15 @@ void plotter3d_init(Plot3DState *ps) {
     ps->orbit_dist  = 12.0f;
     ps->orbiting    = false;
     ps->surf_count  = 0;
+    ps->dag         = NULL;
+    ps->jit         = NULL;
+    ps->jit_mask    = 0;
     ps->vec_count   = 0;
     ps->range       = 5.0f;
+    ps->frame       = 0;
+    ps->chunk_time  = 0.0;
+    ps->panning     = false;
+    ps->hover       = -1;
 
     ps->camera.target   = (Vector3){0, 0, 0};
     ps->camera.up       = (Vector3){0, 1, 0};
@@ -34,8 +83,11 @@ static void update_camera_from_orbit(Plot3DState *ps) {
         ps->orbit_dist * sinf(ps->orbit_pitch),
         ps->orbit_dist * cp * cosf(ps->orbit_angle)
     };
+    ps->camera.position = Vector3Add(ps->camera.position, ps->camera.target);
 }
 
+static void pick_surfaces(Plot3DState *ps, Ray ray);
+
 void plotter3d_update(Plot3DState *ps, Rectangle area) {
     Vector2 mouse = ui_mouse();
     bool in_area = CheckCollisionPointRec(mouse, area);
@@ -60,14 +112,40 @@ void plotter3d_update(Plot3DState *ps, Rectangle area) {
         }
     }
 
-    // Zoom with scroll
+    // Pan with right-drag, across the view and along it, over the x-z plane
+    if (in_area && IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) {
+        ps->panning     = true;
+        ps->pan_start   = mouse;
+        ps->pan_target0 = ps->camera.target;
+    }
+    if (ps->panning) {
+        if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT)) {
+            float k  = ps->orbit_dist * 0.0015f;
+            float dx = (mouse.x - ps->pan_start.x) * k;
+            float dy = (mouse.y - ps->pan_start.y) * k;
+            float sa = sinf(ps->orbit_angle), ca = cosf(ps->orbit_angle);
+            Vector3 t = ps->pan_target0;
+            t.x = Clamp(t.x - dx * ca - dy * sa, -ps->range, ps->range);
+            t.z = Clamp(t.z + dx * sa - dy * ca, -ps->range, ps->range);
+            ps->camera.target = t;
+        } else {
+            ps->panning = false;
+        }
+    }
+
+    // Zoom with scroll, in steps of the distance; shift-scroll widens or
+    // narrows the range
     if (in_area) {
         float wheel = GetMouseWheelMove();
-        if (wheel != 0.0f) {
-            ps->orbit_dist -= wheel * 1.5f;
-            if (ps->orbit_dist < 2.0f)  ps->orbit_dist = 2.0f;
-            if (ps->orbit_dist > 60.0f) ps->orbit_dist = 60.0f;
+        if (wheel != 0.0f && (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT))) {
+            ps->range = Clamp(ps->range * powf(1.25f, -wheel), 0.5f, 100.0f);
+            ps->camera.target.x = Clamp(ps->camera.target.x, -ps->range, ps->range);
+            ps->camera.target.z = Clamp(ps->camera.target.z, -ps->range, ps->range);
+        } else if (wheel != 0.0f) {
+            ps->orbit_dist -= wheel * ps->orbit_dist * 0.125f;
         }
+        // Far enough to see the whole range, short of the far clip plane
+        ps->orbit_dist = Clamp(ps->orbit_dist, ps->range * 0.05f, fminf(ps->range * 12.0f, 800.0f));
     }
 
     // Reset with Home
@@ -76,9 +154,15 @@ void plotter3d_update(Plot3DState *ps, Rectangle area) {
         ps->orbit_pitch = 0.5f;
         ps->orbit_dist  = 12.0f;
         ps->range       = 5.0f;
+        ps->camera.target = (Vector3){0, 0, 0};
     }
 
     update_camera_from_orbit(ps);
+
+    // Hover: the nearest surface point under the cursor, unless dragging
+    ps->hover = -1;
+    if (in_area && !ps->orbiting && !ps->panning)
+        pick_surfaces(ps, GetMouseRay(GetMousePosition(), ps->camera));
 }
 
 static void draw_axes(float range) {
@@ -131,72 +215,1146 @@ static void draw_vector(VecEntry *v) {
     DrawSphere(tip, 0.06f, col);
 }
 
-static void draw_surface(FuncSlot *slot, float range, Arena *arena) {
-    (void)arena;
-    if (!slot->ast || !slot->valid || !slot->visible) return;
+// Lambert shading of a vertex from its unit normal, 0.75 where there is
+// none. Both faces are drawn, so the light counts from either side.
+static float surface_shade(Vector3 n) {
+    static const float L[3] = { 0.40f, 0.82f, 0.41f }; // unit vector to the light
+    if (n.x == 0.0f && n.y == 0.0f && n.z == 0.0f) return 0.75f;
+    return 0.35f + 0.65f * fabsf(n.x * L[0] + n.y * L[1] + n.z * L[2]);
+}
+
+// Chunk quadtree. A chunk's error is the largest gap between its mesh and
+// the surface at the points between its vertices, which are its children's
+// vertices; its edges are kept apart because they decide the skirts.
+enum { EDGE_ZMIN, EDGE_XMAX, EDGE_ZMAX, EDGE_XMIN };
+
+typedef struct {
+    int      parent, child; // pool indices; child is the first of four, or -1
+    int      level, ix, iz; // among the 2^level x 2^level chunks of level
+    bool     built;
+    unsigned used;          // Plot3DState.frame it was last visited
+    unsigned open;          // LodWalk.pass that drew its children instead of it
+    unsigned force;         // Plot3DState.frame lod_balance made it split
+    float    error;         // largest gap, in world units
+    float    edge_error[4]; // the same along each edge, heights only
+    float    ymin, ymax;    // of its drawn vertices
+    Mesh     mesh;          // vertexCount 0 when there is nothing to draw
+    Vector3 *wire;          // wireframe segments as vertex pairs
+    int      wire_count;
+    float   *heights;       // of its vertices, NAN where not drawn; contours are cut from them
+    float    iso_step;      // level step of iso and bands, 0 before they are cut
+    Vector2 *iso;           // contour segments as (x, z) pairs; levels in iso_level
+    float   *iso_level;     // per segment
+    int      iso_count;     // segments
+    Mesh     bands;         // isobands on the floor of the range, vertexCount 0 when none
+    float  (*mip)[2];       // min and max height of its cells, then of blocks of 2x2 cells
+                            // and so on up to the chunk; [INFINITY, -INFINITY] where not drawn
+    unsigned drawn;         // Plot3DState.frame it was last drawn
+    unsigned span_frame;    // frame span_lo and span_hi are for
+    float    span_lo, span_hi; // heights of the chunks drawn at or under it that frame
+} SurfaceNode;
+
+struct SurfaceTree {
+    SurfaceNode node[LOD_MAX_NODES];
+    int         free_block[LOD_BLOCKS]; // blocks of four after the root
+    int         free_count;
+};
+
+// A vertex is drawn if its height is finite and within the clamp
+static bool vertex_ok(double y, float clamp) {
+    return isfinite(y) && fabs(y) <= clamp;
+}
+
+// Cell width of the chunks of level, and x (or z) of half-cell sample h of
+// chunk ix. Shared vertices come out bit-identical at every level, since
+// the steps differ by powers of two.
+static double chunk_cell(float range, int level) {
+    return 2.0 * range / ((double)SURF_CHUNK * (1 << level));
+}
+
+static double chunk_coord(float range, int level, int ix, int h) {
+    return -range + (double)(2 * SURF_CHUNK * ix + h) * (chunk_cell(range, level) * 0.5);
+}
+
+static SurfaceTree *tree_create(void) {
+    SurfaceTree *t = MemAlloc(sizeof(SurfaceTree));
+    if (!t) return NULL;
+    memset(t, 0, sizeof(*t));
+    t->node[0] = (SurfaceNode){ .parent = -1, .child = -1 };
+    for (int b = 0; b < LOD_BLOCKS; b++) t->free_block[b] = LOD_BLOCKS - 1 - b;
+    t->free_count = LOD_BLOCKS;
+    return t;
+}
+
+// Free a mesh that was never uploaded: its CPU arrays only. UnloadMesh
+// would also make GL calls, which pool workers have no context for.
+static void mesh_free_arrays(Mesh *m) {
+    MemFree(m->vertices);
+    MemFree(m->normals);
+    MemFree(m->colors);
+    MemFree(m->indices);
+    *m = (Mesh){0};
+}
+
+static void iso_unload(SurfaceNode *n) {
+    if (n->bands.vertexCount) UnloadMesh(n->bands);
+    MemFree(n->iso);
+    MemFree(n->iso_level);
+    n->bands     = (Mesh){0};
+    n->iso       = NULL;
+    n->iso_level = NULL;
+    n->iso_count = 0;
+    n->iso_step  = 0.0f;
+}
+
+static void node_unload(SurfaceNode *n) {
+    if (n->mesh.vertexCount) UnloadMesh(n->mesh);
+    iso_unload(n);
+    MemFree(n->wire);
+    MemFree(n->heights);
+    MemFree(n->mip);
+    n->mesh       = (Mesh){0};
+    n->wire       = NULL;
+    n->wire_count = 0;
+    n->heights    = NULL;
+    n->mip        = NULL;
+    n->built      = false;
+}
+
+static void free_children(SurfaceTree *t, SurfaceNode *n) {
+    if (n->child < 0) return;
+    for (int c = 0; c < 4; c++) {
+        SurfaceNode *k = &t->node[n->child + c];
+        free_children(t, k);
+        node_unload(k);
+    }
+    t->free_block[t->free_count++] = (n->child - 1) / 4;
+    n->child = -1;
+}
+
+static bool alloc_children(SurfaceTree *t, int index) {
+    if (!t->free_count) return false;
+    SurfaceNode *n = &t->node[index];
+    n->child = 1 + 4 * t->free_block[--t->free_count];
+    for (int c = 0; c < 4; c++)
+        t->node[n->child + c] = (SurfaceNode){
+            .parent = index, .child = -1, .level = n->level + 1,
+            .ix = 2 * n->ix + (c & 1), .iz = 2 * n->iz + (c >> 1),
+        };
+    return true;
+}
+
+void plotter3d_release(FuncSlot *slot) {
+    SurfaceTree *t = slot->mesh.tree;
+    if (t)
+        for (int i = 0; i < LOD_MAX_NODES; i++) node_unload(&t->node[i]);
+    MemFree(t);
+    for (int i = 0; i < slot->mesh.part_count; i++) UnloadMesh(slot->mesh.parts[i]);
+    MemFree(slot->mesh.parts);
+    slot->mesh = (SurfaceMesh){0};
+}
+
+typedef struct {
+    int          si;   // surface index
+    SurfaceTree *tree;
+    SurfaceNode *node;
+} LodBuild;
+
+typedef struct {
+    const Plot3DState *ps;
+    LodBuild          *builds;
+} LodJob;
+
+// Heights of surface si at the half-cell samples of chunk n, row by row
+static void eval_chunk(const Plot3DState *ps, int si, const SurfaceNode *n, double h[HALF][HALF]) {
+    double xs[HALF], zs[HALF], spare[HALF];
+    double *outs[MAX_FUNCTIONS];
+    for (int i = 0; i < HALF; i++) xs[i] = chunk_coord(ps->range, n->level, n->ix, i);
+    for (int j = 0; j < HALF; j++) {
+        double z = chunk_coord(ps->range, n->level, n->iz, j);
+        for (int i = 0; i < HALF; i++) zs[i] = z;
+        // The JIT computes every surface it was built for; the others' rows are dropped
+        for (int k = 0; k < MAX_FUNCTIONS; k++) outs[k] = k == si ? h[j] : spare;
+        if (ps->jit && (ps->jit_mask & (1u << si)))
+            jit_eval_batch(ps->jit, xs, zs, outs, HALF);
+        else if (ps->dag)
+            dag_eval_batch(ps->dag, 1u << si, xs, zs, outs, HALF);
+        else
+            bytecode_eval_batch(ps->surfs[si].code, xs, zs, h[j], HALF);
+    }
+}
+
+// Gap at sample y between two neighbours a and b: how far the line
+// between them misses it, or half the cell width where they disagree on
+// whether the surface is there. *height tells which; across an edge with
+// a gap of the second kind there is no surface for a skirt to meet.
+static float sample_gap(double y, double a, double b, float clamp, float cell, bool *height) {
+    bool ok = vertex_ok(y, clamp), ok_a = vertex_ok(a, clamp), ok_b = vertex_ok(b, clamp);
+    *height = ok && ok_a && ok_b;
+    if (*height) return (float)fabs(y - 0.5 * (a + b));
+    return ok || ok_a || ok_b ? cell * 0.5f : 0.0f;
+}
+
+// The min/max pyramid of chunk n from its heights: each cell from its
+// corners, each block from the four below it. A cell is drawn only with
+// all four corners, as in the mesh.
+static void build_mip(SurfaceNode *n) {
+    const int side = SURF_CHUNK + 1;
+    float (*m)[2] = n->mip;
+    for (int j = 0; j < SURF_CHUNK; j++) {
+        for (int i = 0; i < SURF_CHUNK; i++) {
+            const float *r0 = &n->heights[j * side + i], *r1 = r0 + side;
+            bool drawn = !isnan(r0[0]) && !isnan(r0[1]) && !isnan(r1[0]) && !isnan(r1[1]);
+            m[j * SURF_CHUNK + i][0] = drawn ? fminf(fminf(r0[0], r0[1]), fminf(r1[0], r1[1])) : INFINITY;
+            m[j * SURF_CHUNK + i][1] = drawn ? fmaxf(fmaxf(r0[0], r0[1]), fmaxf(r1[0], r1[1])) : -INFINITY;
+        }
+    }
+    int below = 0, at = SURF_CHUNK * SURF_CHUNK;
+    for (int size = SURF_CHUNK / 2; size >= 1; size /= 2) {
+        for (int j = 0; j < size; j++) {
+            for (int i = 0; i < size; i++) {
+                int q0 = below + 2 * j * 2 * size + 2 * i, q1 = q0 + 2 * size;
+                const float *a = m[q0], *b = m[q0 + 1], *c = m[q1], *d = m[q1 + 1];
+                m[at + j * size + i][0] = fminf(fminf(a[0], b[0]), fminf(c[0], d[0]));
+                m[at + j * size + i][1] = fmaxf(fmaxf(a[1], b[1]), fmaxf(c[1], d[1]));
+            }
+        }
+        below = at;
+        at += size * size;
+    }
+}
+
+// Evaluate chunk index of the job and fill its mesh arrays and wireframe,
+// for the render thread to upload. Vertices are every other sample; the
+// samples between them give the error. Edges inside the range get a
+// skirt hanging below them, as deep as the larger of their own gap and
+// their parent's along the same line, which covers the crack to a
+// coarser neighbour.
+static void build_chunk(void *ctx, int index, int worker) {
+    (void)worker;
+    LodJob *job = ctx;
+    const Plot3DState *ps = job->ps;
+    LodBuild *b = &job->builds[index];
+    SurfaceNode *n = b->node;
+    const SurfaceNode *parent = n->parent >= 0 ? &b->tree->node[n->parent] : NULL;
+    float range = ps->range, clamp = range * 2.0f;
+    float cell = (float)chunk_cell(range, n->level);
+    int last = (1 << n->level) - 1;
+
+    double h[HALF][HALF]; // [z][x]
+    eval_chunk(ps, b->si, n, h);
+
+    // Error: x-odd samples lie on cell edges along x, z-odd ones along z,
+    // and the rest on the diagonal each cell is cut along
+    n->error = 0.0f;
+    for (int e = 0; e < 4; e++) n->edge_error[e] = 0.0f;
+    for (int j = 0; j < HALF; j++) {
+        for (int i = (j & 1) ? 0 : 1; i < HALF; i += (j & 1) ? 1 : 2) {
+            bool height;
+            float g = (i & 1) && (j & 1) ? sample_gap(h[j][i], h[j - 1][i + 1], h[j + 1][i - 1], clamp, cell, &height)
+                    : (i & 1)            ? sample_gap(h[j][i], h[j][i - 1], h[j][i + 1], clamp, cell, &height)
+                                         : sample_gap(h[j][i], h[j - 1][i], h[j + 1][i], clamp, cell, &height);
+            n->error = fmaxf(n->error, g);
+            if (!height) continue;
+            if (j == 0)        n->edge_error[EDGE_ZMIN] = fmaxf(n->edge_error[EDGE_ZMIN], g);
+            if (i == HALF - 1) n->edge_error[EDGE_XMAX] = fmaxf(n->edge_error[EDGE_XMAX], g);
+            if (j == HALF - 1) n->edge_error[EDGE_ZMAX] = fmaxf(n->edge_error[EDGE_ZMAX], g);
+            if (i == 0)        n->edge_error[EDGE_XMIN] = fmaxf(n->edge_error[EDGE_XMIN], g);
+        }
+    }
+
+    // Skirt depth per edge, 0 on the rim of the range
+    int cx = n->ix & 1, cz = n->iz & 1;
+    bool rim[4]    = { n->iz == 0, n->ix == last, n->iz == last, n->ix == 0 };
+    bool on_par[4] = { cz == 0, cx == 1, cz == 1, cx == 0 };
+    float skirt[4];
+    for (int e = 0; e < 4; e++) {
+        skirt[e] = rim[e] ? 0.0f : fmaxf(n->edge_error[e], cell * 0.1f);
+        if (!rim[e] && parent && on_par[e]) skirt[e] = fmaxf(skirt[e], parent->edge_error[e]);
+    }
+
+    const int side = SURF_CHUNK + 1;
+    const int cells = SURF_CHUNK * SURF_CHUNK;
+    Mesh mesh = {0};
+    mesh.vertices = MemAlloc((side * side + 4 * side) * 3 * sizeof(float));
+    mesh.normals  = MemAlloc((side * side + 4 * side) * 3 * sizeof(float));
+    mesh.colors   = MemAlloc((side * side + 4 * side) * 4);
+    mesh.indices  = MemAlloc((cells + 4 * SURF_CHUNK) * 6 * sizeof(unsigned short));
+    n->wire       = MemAlloc(2 * (SURF_CHUNK / WIRE_STEP + 1) * (SURF_CHUNK / WIRE_STEP) * 2 * sizeof(Vector3));
+    n->heights    = MemAlloc(side * side * sizeof(float));
+    n->mip        = MemAlloc(MIP_CELLS * sizeof(n->mip[0]));
+    if (!mesh.vertices || !mesh.normals || !mesh.colors || !mesh.indices || !n->wire || !n->heights ||
+        !n->mip) {
+        mesh_free_arrays(&mesh);
+        MemFree(n->wire);
+        MemFree(n->heights);
+        MemFree(n->mip);
+        n->wire    = NULL;
+        n->heights = NULL;
+        n->mip     = NULL;
+        n->mesh    = (Mesh){0};
+        n->error   = 0.0f; // as good as it gets
+        return;
+    }
+
+    // Vertices, with normals (-f_x, 1, -f_z) from the compiled gradient a
+    // row at a time, and the shade as colour. Without a gradient they face up.
+    Bytecode *const *grad = ps->surfs[b->si].grad_code;
+    double xs[SURF_CHUNK + 1], zs[SURF_CHUNK + 1], fx[SURF_CHUNK + 1], fz[SURF_CHUNK + 1];
+    for (int i = 0; i < side; i++) xs[i] = chunk_coord(range, n->level, n->ix, 2 * i);
+    n->ymin = INFINITY;
+    n->ymax = -INFINITY;
+    for (int j = 0; j < side; j++) {
+        double z = chunk_coord(range, n->level, n->iz, 2 * j);
+        for (int i = 0; i < side; i++) zs[i] = z;
+        for (int i = 0; i < side; i++) fx[i] = fz[i] = NAN;
+        if (grad[0] && grad[1]) {
+            bytecode_eval_batch(grad[0], xs, zs, fx, side);
+            bytecode_eval_batch(grad[1], xs, zs, fz, side);
+        }
+        for (int i = 0; i < side; i++) {
+            int v = j * side + i;
+            double x = xs[i];
+            double y = h[2 * j][2 * i];
+            Vector3 nv = {0};
+            if (vertex_ok(y, clamp)) {
+                n->ymin = fminf(n->ymin, (float)y);
+                n->ymax = fmaxf(n->ymax, (float)y);
+                if (isfinite(fx[i]) && isfinite(fz[i])) {
+                    double len = sqrt(fx[i] * fx[i] + 1.0 + fz[i] * fz[i]);
+                    nv = (Vector3){ (float)(-fx[i] / len), (float)(1.0 / len), (float)(-fz[i] / len) };
+                }
+            }
+            unsigned char shade = (unsigned char)(255.0f * surface_shade(nv));
+            if (nv.x == 0.0f && nv.y == 0.0f && nv.z == 0.0f) nv.y = 1.0f;
+            mesh.vertices[3 * v]     = (float)x;
+            mesh.vertices[3 * v + 1] = vertex_ok(y, clamp) ? (float)y : 0.0f;
+            n->heights[v]            = vertex_ok(y, clamp) ? (float)y : NAN;
+            mesh.vertices[3 * v + 2] = (float)z;
+            mesh.normals[3 * v]      = nv.x;
+            mesh.normals[3 * v + 1]  = nv.y;
+            mesh.normals[3 * v + 2]  = nv.z;
+            mesh.colors[4 * v] = mesh.colors[4 * v + 1] = mesh.colors[4 * v + 2] = shade;
+            mesh.colors[4 * v + 3] = 255;
+        }
+    }
+    if (n->ymin > n->ymax) { // nothing drawn: bound it by the clamp
+        n->ymin = -clamp;
+        n->ymax = clamp;
+    }
+
+    build_mip(n);
+
+    // Two triangles per cell whose four corners are drawn, cut along the
+    // diagonal the error was measured on
+    int k = 0;
+    for (int j = 0; j < SURF_CHUNK; j++) {
+        for (int i = 0; i < SURF_CHUNK; i++) {
+            if (!vertex_ok(h[2 * j][2 * i], clamp) || !vertex_ok(h[2 * j][2 * i + 2], clamp) ||
+                !vertex_ok(h[2 * j + 2][2 * i], clamp) || !vertex_ok(h[2 * j + 2][2 * i + 2], clamp))
+                continue;
+            unsigned short v00 = (unsigned short)(j * side + i), v10 = v00 + 1;
+            unsigned short v01 = v00 + side, v11 = v01 + 1;
+            unsigned short *ix = &mesh.indices[k];
+            ix[0] = v00; ix[1] = v10; ix[2] = v01;
+            ix[3] = v10; ix[4] = v11; ix[5] = v01;
+            k += 6;
+        }
+    }
+
+    // Skirts: a copy of each edge lowered by its depth, joined to it
+    int nv = side * side;
+    for (int e = 0; e < 4; e++) {
+        if (skirt[e] <= 0.0f) continue;
+        for (int s = 0; s < side; s++) {
+            int i = e == EDGE_XMAX ? SURF_CHUNK : e == EDGE_XMIN ? 0 : s;
+            int j = e == EDGE_ZMAX ? SURF_CHUNK : e == EDGE_ZMIN ? 0 : s;
+            int src = j * side + i, dst = nv + s;
+            memcpy(&mesh.vertices[3 * dst], &mesh.vertices[3 * src], 3 * sizeof(float));
+            memcpy(&mesh.normals[3 * dst], &mesh.normals[3 * src], 3 * sizeof(float));
+            memcpy(&mesh.colors[4 * dst], &mesh.colors[4 * src], 4);
+            mesh.vertices[3 * dst + 1] -= skirt[e];
+        }
+        for (int s = 0; s < SURF_CHUNK; s++) {
+            int i = e == EDGE_XMAX ? SURF_CHUNK : e == EDGE_XMIN ? 0 : s;
+            int j = e == EDGE_ZMAX ? SURF_CHUNK : e == EDGE_ZMIN ? 0 : s;
+            int i1 = e == EDGE_XMAX || e == EDGE_XMIN ? i : i + 1;
+            int j1 = e == EDGE_XMAX || e == EDGE_XMIN ? j + 1 : j;
+            if (!vertex_ok(h[2 * j][2 * i], clamp) || !vertex_ok(h[2 * j1][2 * i1], clamp)) continue;
+            unsigned short a = (unsigned short)(j * side + i), b1 = (unsigned short)(j1 * side + i1);
+            unsigned short as = (unsigned short)(nv + s), bs = as + 1;
+            unsigned short *ix = &mesh.indices[k];
+            ix[0] = a; ix[1] = b1; ix[2] = as;
+            ix[3] = b1; ix[4] = bs; ix[5] = as;
+            k += 6;
+        }
+        nv += side;
+    }
+    mesh.vertexCount   = nv;
+    mesh.triangleCount = k / 3;
+    if (!k) mesh_free_arrays(&mesh);
+    n->mesh = mesh;
+
+    // Wireframe: every WIRE_STEP-th line, segments WIRE_STEP cells long
+    // and left out where a vertex along them is not drawn. The far edges
+    // belong to the next chunk, except on the rim.
+    n->wire_count = 0;
+    for (int l = 0; l <= SURF_CHUNK; l += WIRE_STEP) {
+        for (int s = 0; s < SURF_CHUNK; s += WIRE_STEP) {
+            bool along_x = l < SURF_CHUNK || rim[EDGE_ZMAX], along_z = l < SURF_CHUNK || rim[EDGE_XMAX];
+            for (int t = s; t <= s + WIRE_STEP; t++) {
+                along_x = along_x && vertex_ok(h[2 * l][2 * t], clamp);
+                along_z = along_z && vertex_ok(h[2 * t][2 * l], clamp);
+            }
+            float a  = (float)chunk_coord(range, n->level, n->iz, 2 * l);
+            float b0 = (float)chunk_coord(range, n->level, n->ix, 2 * s);
+            float b1 = (float)chunk_coord(range, n->level, n->ix, 2 * (s + WIRE_STEP));
+            if (along_x) {
+                n->wire[n->wire_count++] = (Vector3){ b0, (float)h[2 * l][2 * s], a };
+                n->wire[n->wire_count++] = (Vector3){ b1, (float)h[2 * l][2 * (s + WIRE_STEP)], a };
+            }
+            a  = (float)chunk_coord(range, n->level, n->ix, 2 * l);
+            b0 = (float)chunk_coord(range, n->level, n->iz, 2 * s);
+            b1 = (float)chunk_coord(range, n->level, n->iz, 2 * (s + WIRE_STEP));
+            if (along_z) {
+                n->wire[n->wire_count++] = (Vector3){ a, (float)h[2 * s][2 * l], b0 };
+                n->wire[n->wire_count++] = (Vector3){ a, (float)h[2 * (s + WIRE_STEP)][2 * l], b1 };
+            }
+        }
+    }
+}
+
+// One walk of a surface's tree. Collecting, it queues the chunks the view
+// wants that are not built yet; drawing, it lists the chunks to draw,
+// each either fine enough or the finest whose children are not all built.
+typedef struct {
+    const Plot3DState *ps;
+    Vector3      eye;
+    Vector3      plane[4];    // inward normals of the frustum sides, through eye
+    float        px_per_unit; // on screen, per world unit at distance 1
+    int          si;
+    SurfaceTree *tree;
+    LodBuild    *queue;       // collecting: chunks to build
+    int          queued, cap;
+    SurfaceNode **drawn;      // drawing: chunks to draw, or NULL
+    int          drawn_count;
+    unsigned     pass;        // numbers the walks, for SurfaceNode.open
+} LodWalk;
+
+static void lod_camera(LodWalk *w, const Camera3D *cam) {
+    Vector3 fwd   = Vector3Normalize(Vector3Subtract(cam->target, cam->position));
+    Vector3 right = Vector3Normalize(Vector3CrossProduct(fwd, cam->up));
+    Vector3 up    = Vector3CrossProduct(right, fwd);
+    float tv = tanf(cam->fovy * DEG2RAD * 0.5f);
+    float th = tv * (float)GetScreenWidth() / (float)GetScreenHeight();
+    w->eye      = cam->position;
+    w->plane[0] = Vector3Subtract(Vector3Scale(fwd, th), right);
+    w->plane[1] = Vector3Add(Vector3Scale(fwd, th), right);
+    w->plane[2] = Vector3Subtract(Vector3Scale(fwd, tv), up);
+    w->plane[3] = Vector3Add(Vector3Scale(fwd, tv), up);
+    w->px_per_unit = (float)GetScreenHeight() / (2.0f * tv);
+}
+
+static void lod_queue(LodWalk *w, SurfaceNode *n) {
+    if (w->queued < w->cap) w->queue[w->queued++] = (LodBuild){ w->si, w->tree, n };
+}
+
+static void lod_visit(LodWalk *w, int index) {
+    SurfaceTree *t = w->tree;
+    SurfaceNode *n = &t->node[index];
+    n->used = w->ps->frame;
+
+    // Bounds, padded by the error for what the children may add
+    float range = w->ps->range;
+    float lo[3] = { (float)chunk_coord(range, n->level, n->ix, 0), n->ymin - n->error,
+                    (float)chunk_coord(range, n->level, n->iz, 0) };
+    float hi[3] = { (float)chunk_coord(range, n->level, n->ix, HALF - 1), n->ymax + n->error,
+                    (float)chunk_coord(range, n->level, n->iz, HALF - 1) };
+    bool visible = true;
+    for (int p = 0; p < 4 && visible; p++) {
+        Vector3 nrm = w->plane[p];
+        Vector3 far = { nrm.x > 0 ? hi[0] : lo[0], nrm.y > 0 ? hi[1] : lo[1], nrm.z > 0 ? hi[2] : lo[2] };
+        visible = Vector3DotProduct(nrm, Vector3Subtract(far, w->eye)) >= 0.0f;
+    }
+    float e[3] = { w->eye.x, w->eye.y, w->eye.z }, d2 = 0.0f;
+    for (int a = 0; a < 3; a++) {
+        float d = fmaxf(fmaxf(lo[a] - e[a], e[a] - hi[a]), 0.0f);
+        d2 += d * d;
+    }
+    bool split = visible && n->level < LOD_MAX_LEVEL &&
+                 (n->level < LOD_MIN_LEVEL || n->force == w->ps->frame ||
+                  n->error * w->px_per_unit > LOD_PIXELS * sqrtf(d2));
+
+    if (!split) {
+        if (n->child >= 0 && w->ps->frame - t->node[n->child].used > LOD_KEEP) free_children(t, n);
+        if (visible && w->drawn) w->drawn[w->drawn_count++] = n;
+        return;
+    }
+    if (n->child < 0 && !alloc_children(t, index)) {
+        if (w->drawn) w->drawn[w->drawn_count++] = n;
+        return;
+    }
+    bool ready = true;
+    for (int c = 0; c < 4; c++) {
+        SurfaceNode *k = &t->node[n->child + c];
+        if (k->built) continue;
+        ready = false;
+        if (!w->drawn) lod_queue(w, k);
+    }
+    if (!ready) {
+        if (w->drawn) w->drawn[w->drawn_count++] = n;
+        return;
+    }
+    n->open = w->pass;
+    for (int c = 0; c < 4; c++) lod_visit(w, n->child + c);
+}
+
+// Did the walk draw the children of chunk (ix, iz) of level, not it?
+static bool lod_open(const LodWalk *w, int level, int ix, int iz) {
+    const SurfaceNode *n = &w->tree->node[0];
+    for (int l = 0; l < level; l++) {
+        if (n->open != w->pass) return false;
+        int s = level - l - 1;
+        n = &w->tree->node[n->child + (((ix >> s) & 1) | (((iz >> s) & 1) << 1))];
+    }
+    return n->open == w->pass;
+}
+
+// Make every chunk the walk drew split where a neighbour's children along
+// their shared edge are split in turn, so neighbours drawn differ by one
+// level at most and the skirts, as deep as the parent's gap, close every
+// crack. True if a split was forced, for the walk to be done again.
+static bool lod_balance(LodWalk *w, int index) {
+    SurfaceNode *n = &w->tree->node[index];
+    if (n->used != w->ps->frame) return false;
+    if (n->open == w->pass) {
+        bool forced = false;
+        for (int c = 0; c < 4; c++) forced |= lod_balance(w, n->child + c);
+        return forced;
+    }
+    if (n->force == w->ps->frame || n->level >= LOD_MAX_LEVEL) return false;
+    static const int dx[4] = { 0, 1, 0, -1 }, dz[4] = { -1, 0, 1, 0 };
+    int size = 1 << n->level;
+    for (int e = 0; e < 4; e++) {
+        int mx = n->ix + dx[e], mz = n->iz + dz[e];
+        if (mx < 0 || mz < 0 || mx >= size || mz >= size) continue;
+        // The neighbour's two children along the edge, at level + 1
+        int kx = 2 * mx + (dx[e] < 0), kz = 2 * mz + (dz[e] < 0);
+        int sx = dx[e] == 0, sz = dz[e] == 0;
+        if (lod_open(w, n->level + 1, kx, kz) || lod_open(w, n->level + 1, kx + sx, kz + sz)) {
+            n->force = w->ps->frame;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Walk the tree, again for as long as lod_balance forces splits
+static void lod_walk(LodWalk *w) {
+    static unsigned pass;
+    int queued = w->queued;
+    do {
+        w->pass        = ++pass;
+        w->queued      = queued;
+        w->drawn_count = 0;
+        lod_visit(w, 0);
+    } while (lod_balance(w, 0));
+}
+
+// The tree of slot for the current range, emptied when it is stale
+static SurfaceTree *surface_tree(FuncSlot *slot, float range) {
+    SurfaceMesh *m = &slot->mesh;
+    if (!m->built || m->gen != slot->gen || m->range != range) {
+        plotter3d_release(slot);
+        m->tree  = tree_create();
+        m->built = m->tree != NULL;
+        m->gen   = slot->gen;
+        m->range = range;
+    }
+    return m->tree;
+}
+
+// Upload a piece of a whole surface as the next of m's parts. Plot x, y, z
+// go to world x, z, y, so z is up as for z = f(x, y).
+static void add_part(SurfaceMesh *m, const float *vertices, const float *normals,
+                     const unsigned short *indices, int vertex_count, int index_count) {
+    if (index_count == 0) return;
+    Mesh mesh = {0};
+    mesh.vertices = MemAlloc(vertex_count * 3 * sizeof(float));
+    mesh.normals  = MemAlloc(vertex_count * 3 * sizeof(float));
+    mesh.colors   = MemAlloc(vertex_count * 4);
+    mesh.indices  = MemAlloc(index_count * sizeof(unsigned short));
+    if (!mesh.vertices || !mesh.normals || !mesh.colors || !mesh.indices) {
+        mesh_free_arrays(&mesh);
+        return;
+    }
+    for (int v = 0; v < vertex_count; v++) {
+        const float *pv = &vertices[3 * v], *pn = &normals[3 * v];
+        Vector3 nv = { pn[0], pn[2], pn[1] };
+        mesh.vertices[3 * v]     = pv[0];
+        mesh.vertices[3 * v + 1] = pv[2];
+        mesh.vertices[3 * v + 2] = pv[1];
+        mesh.normals[3 * v]      = nv.x;
+        mesh.normals[3 * v + 1]  = nv.y;
+        mesh.normals[3 * v + 2]  = nv.z;
+        mesh.colors[4 * v] = mesh.colors[4 * v + 1] = mesh.colors[4 * v + 2] =
+            (unsigned char)(255.0f * surface_shade(nv));
+        mesh.colors[4 * v + 3] = 255;
+    }
+    memcpy(mesh.indices, indices, index_count * sizeof(unsigned short));
+    mesh.vertexCount   = vertex_count;
+    mesh.triangleCount = index_count / 3;
+    UploadMesh(&mesh, false);
+    m->parts[m->part_count++] = mesh;
+}
+
+// Mesh of an implicit or parametric slot for the current range, rebuilt
+// in arena when it is stale
+static void whole_surface(FuncSlot *slot, float range, Arena *arena) {
+    SurfaceMesh *m = &slot->mesh;
+    if (m->built && m->gen == slot->gen && m->range == range) return;
+    plotter3d_release(slot);
+    m->built = true;
+    m->gen   = slot->gen;
+    m->range = range;
+
+    ArenaMark mark = arena_mark(arena);
+    if (slot->params) {
+        ParamMesh pm = slot->params == 2
+            ? param_surface(slot->comp_code, slot->comp, range * PARAM_GAP, arena)
+            : param_curve(slot->comp_code, range * PARAM_GAP, range * TUBE_RADIUS, arena);
+        m->parts = MemAlloc(sizeof(Mesh));
+        if (m->parts) add_part(m, pm.vertices, pm.normals, pm.indices, pm.vertex_count, pm.index_count);
+    } else {
+        ImplicitMesh im = implicit3d_mesh(slot->code, slot->ast, range, arena);
+        if (im.part_count) m->parts = MemAlloc(im.part_count * sizeof(Mesh));
+        for (int p = 0; m->parts && p < im.part_count; p++) {
+            const ImplicitPart *ip = &im.parts[p];
+            add_part(m, ip->vertices, ip->normals, ip->indices, ip->vertex_count, ip->index_count);
+        }
+    }
+    arena_rewind(arena, mark);
+}
+
+// Lattice coordinate i of n cells across [-range, range], at the cell's middle
+static double cell_mid(double range, int n, int i) {
+    return -range + (i + 0.5) * 2.0 * range / n;
+}
+
+// Arrows of a 3D field at the middles of FIELD_SIDE^3 cells over the range
+// cube, and its streamlines when shown, rebuilt only when the slot or the
+// range changes, with arena for scratch. Plot x, y, z go to world x, z, y.
+static void build_field(FuncSlot *slot, float range, Arena *arena) {
+    double view[FIELD_VIEW] = { range };
+    if (plotter_field_fresh(slot, view)) return;
+    FieldCache *fc = &slot->flow;
+
+    ArenaMark mark = arena_mark(arena);
+    const int n = FIELD_SIDE * FIELD_SIDE * FIELD_SIDE;
+    double *xs  = arena_alloc(arena, (size_t)n * sizeof(double));
+    double *ys  = arena_alloc(arena, (size_t)n * sizeof(double));
+    double *zs  = arena_alloc(arena, (size_t)n * sizeof(double));
+    double *f   = arena_alloc(arena, (size_t)n * 3 * sizeof(double));
+    float  *mag = arena_alloc(arena, (size_t)n * sizeof(float));
+    fc->arrows  = arena_alloc(&fc->arena, (size_t)n * sizeof(Matrix));
+    if (xs && ys && zs && f && mag && fc->arrows) {
+        for (int i = 0; i < n; i++) {
+            xs[i] = cell_mid(range, FIELD_SIDE, i % FIELD_SIDE);
+            ys[i] = cell_mid(range, FIELD_SIDE, i / FIELD_SIDE % FIELD_SIDE);
+            zs[i] = cell_mid(range, FIELD_SIDE, i / (FIELD_SIDE * FIELD_SIDE));
+        }
+        field_sample(slot->comp_code, 3, xs, ys, zs, n, f);
+        field_magnitudes(f, 3, n, mag, arena);
+        float cell = 2.0f * range / FIELD_SIDE;
+        for (int i = 0; i < n; i++) {
+            double len = sqrt(f[i] * f[i] + f[n + i] * f[n + i] + f[2 * n + i] * f[2 * n + i]);
+            if (isnan(mag[i]) || !(len > 0.0)) continue;
+            Vector3 at  = { (float)xs[i], (float)zs[i], (float)ys[i] };
+            Vector3 dir = { (float)(f[i] / len), (float)(f[2 * n + i] / len), (float)(f[n + i] / len) };
+            fc->arrows[fc->arrow_count++] = ui_arrow_place(at, dir, cell * (0.35f + 0.55f * mag[i]), mag[i]);
+        }
+    }
+
+    if (slot->show_stream) {
+        const int seed_count = FIELD_SEEDS * FIELD_SEEDS * FIELD_SEEDS;
+        double *seeds = arena_alloc(arena, (size_t)seed_count * 3 * sizeof(double));
+        for (int i = 0; seeds && i < seed_count; i++) {
+            seeds[3 * i]     = cell_mid(range, FIELD_SEEDS, i % FIELD_SEEDS);
+            seeds[3 * i + 1] = cell_mid(range, FIELD_SEEDS, i / FIELD_SEEDS % FIELD_SEEDS);
+            seeds[3 * i + 2] = cell_mid(range, FIELD_SEEDS, i / (FIELD_SEEDS * FIELD_SEEDS));
+        }
+        double lo[3] = { -range, -range, -range }, hi[3] = { range, range, range };
+        FieldLines fl = seeds ? field_lines(slot->comp_code, 3, seeds, seed_count, lo, hi,
+                                            range * FIELD_STEP, arena)
+                              : (FieldLines){0};
+        plotter_field_keep_lines(fc, &fl);
+    }
+    arena_rewind(arena, mark);
+}
+
+// Streamlines, then the arrows in one instanced draw
+static void draw_field(const FuncSlot *slot) {
+    const FieldCache *fc = &slot->flow;
+    Color col = PLOT_COLORS[slot->color_idx % PLOT_COLOR_COUNT];
+    const float *p = fc->points;
+    rlBegin(RL_LINES);
+    rlColor4ub(col.r, col.g, col.b, 170);
+    for (int l = 0; l < fc->line_count; l++, p += 3) {
+        for (int i = 1; i < fc->lengths[l]; i++, p += 3) {
+            rlVertex3f(p[0], p[2], p[1]);
+            rlVertex3f(p[3], p[5], p[4]);
+        }
+    }
+    rlEnd();
+    ui_arrows_draw_3d(fc->arrows, fc->arrow_count, col);
+}
+
+// Round level step for about ISO_LEVELS levels across [-range, range]: 1,
+// 2 or 5 times a power of ten
+static float iso_step(float range) {
+    double raw = 2.0 * range / ISO_LEVELS, p = pow(10.0, floor(log10(raw))), m = raw / p;
+    return (float)(p * (m < 1.5 ? 1.0 : m < 3.5 ? 2.0 : m < 7.5 ? 5.0 : 10.0));
+}
+
+// Levels a triangle crosses: k * step for k from *k_lo, above its lowest
+// corner and up to its highest. -1 where a corner is not drawn or the
+// triangle is a cliff.
+static int iso_crossed(const float v[3], float step, int *k_lo) {
+    if (isnan(v[0]) || isnan(v[1]) || isnan(v[2])) return -1;
+    float lo = fminf(v[0], fminf(v[1], v[2])), hi = fmaxf(v[0], fmaxf(v[1], v[2]));
+    *k_lo = (int)floorf(lo / step) + 1;
+    int count = (int)floorf(hi / step) - *k_lo + 1;
+    return count > ISO_MAX_CROSS ? -1 : count;
+}
+
+// Polygon of (x, z, height) corners clipped to height >= level, or <=;
+// convex in, convex out, with at most one corner more
+static int clip_level(const float (*in)[3], int count, float level, bool above, float (*out)[3]) {
+    int m = 0;
+    for (int i = 0; i < count; i++) {
+        const float *a = in[i], *b = in[(i + 1) % count];
+        bool ia = above ? a[2] >= level : a[2] <= level;
+        bool ib = above ? b[2] >= level : b[2] <= level;
+        if (ia) memcpy(out[m++], a, sizeof(out[0]));
+        if (ia != ib) {
+            float t = (level - a[2]) / (b[2] - a[2]);
+            out[m][0] = a[0] + t * (b[0] - a[0]);
+            out[m][1] = a[1] + t * (b[1] - a[1]);
+            out[m][2] = level;
+            m++;
+        }
+    }
+    return m;
+}
+
+typedef struct {
+    SurfaceNode *const *nodes;
+    float        range, step;
+} IsoJob;
+
+// A chunk's contours and isobands by marching triangles: each cell cut
+// along the mesh's diagonal, so the lines lie on the drawn surface and
+// saddles need no deciding. A level crosses a triangle in one segment; a
+// band between two levels is the triangle clipped to it, a fan of at most
+// five corners, shaded by its height. Counted first, then cut into arrays
+// of the right size.
+static void cut_chunk(void *ctx, int index, int worker) {
+    (void)worker;
+    const IsoJob *job = ctx;
+    SurfaceNode *n = job->nodes[index];
+    const int side = SURF_CHUNK + 1;
+    float range = job->range, step = job->step, floor_y = -range;
+    float xs[SURF_CHUNK + 1], zs[SURF_CHUNK + 1];
+    for (int i = 0; i < side; i++) {
+        xs[i] = (float)chunk_coord(range, n->level, n->ix, 2 * i);
+        zs[i] = (float)chunk_coord(range, n->level, n->iz, 2 * i);
+    }
+
+    // A triangle crossing c levels has c segments and c + 1 bands, whose
+    // corners number 3 + 4c, one level on a corner adding at most 2
+    int segs = 0, verts = 0;
+    for (int j = 0; j < SURF_CHUNK; j++) {
+        for (int i = 0; i < SURF_CHUNK; i++) {
+            const float *r0 = &n->heights[j * side + i], *r1 = r0 + side;
+            float tri[2][3] = { { r0[0], r0[1], r1[0] }, { r0[1], r1[1], r1[0] } };
+            for (int t = 0; t < 2; t++) {
+                int k_lo, c = iso_crossed(tri[t], step, &k_lo);
+                if (c < 0) continue;
+                segs  += c;
+                verts += 5 + 4 * c;
+            }
+        }
+    }
+    if (verts > ISO_MAX_VERTS) verts = ISO_MAX_VERTS;
+    Mesh bands = {0};
+    n->iso       = segs ? MemAlloc(2 * segs * sizeof(Vector2)) : NULL;
+    n->iso_level = segs ? MemAlloc(segs * sizeof(float)) : NULL;
+    if (verts) {
+        bands.vertices = MemAlloc(verts * 3 * sizeof(float));
+        bands.colors   = MemAlloc(verts * 4);
+        bands.indices  = MemAlloc(verts * 3 * sizeof(unsigned short));
+    }
+    if ((segs && (!n->iso || !n->iso_level)) ||
+        (verts && (!bands.vertices || !bands.colors || !bands.indices))) {
+        MemFree(n->iso);
+        MemFree(n->iso_level);
+        mesh_free_arrays(&bands);
+        n->iso       = NULL;
+        n->iso_level = NULL;
+        n->iso_step  = step; // not tried again
+        return;
+    }
+
+    int seg = 0, vert = 0, ix = 0;
+    for (int j = 0; j < SURF_CHUNK; j++) {
+        for (int i = 0; i < SURF_CHUNK; i++) {
+            const float *r0 = &n->heights[j * side + i], *r1 = r0 + side;
+            float corner[2][3][3] = {
+                { { xs[i], zs[j], r0[0] }, { xs[i + 1], zs[j], r0[1] }, { xs[i], zs[j + 1], r1[0] } },
+                { { xs[i + 1], zs[j], r0[1] }, { xs[i + 1], zs[j + 1], r1[1] }, { xs[i], zs[j + 1], r1[0] } },
+            };
+            for (int t = 0; t < 2; t++) {
+                const float (*p)[3] = corner[t];
+                float v[3] = { p[0][2], p[1][2], p[2][2] };
+                int k_lo, c = iso_crossed(v, step, &k_lo);
+                if (c < 0) continue;
+
+                for (int k = k_lo; k < k_lo + c; k++) {
+                    float level = k * step;
+                    Vector2 *end = &n->iso[2 * seg];
+                    int e = 0;
+                    for (int a = 0; a < 3 && e < 2; a++) {
+                        int b = (a + 1) % 3;
+                        if ((v[a] >= level) == (v[b] >= level)) continue;
+                        float s = (level - v[a]) / (v[b] - v[a]);
+                        end[e++] = (Vector2){ p[a][0] + s * (p[b][0] - p[a][0]), p[a][1] + s * (p[b][1] - p[a][1]) };
+                    }
+                    if (e == 2) n->iso_level[seg++] = level;
+                }
+
+                for (int k = k_lo - 1; k < k_lo + c; k++) {
+                    float lower[4][3], piece[5][3];
+                    int m = clip_level(p, 3, k * step, true, lower);
+                    m = clip_level((const float (*)[3])lower, m, (k + 1) * step, false, piece);
+                    if (m < 3 || vert + m > verts) continue;
+                    float t01 = ((k + 0.5f) * step + range) / (2.0f * range);
+                    unsigned char shade = (unsigned char)(255.0f * (0.25f + 0.75f * fminf(fmaxf(t01, 0.0f), 1.0f)));
+                    for (int q = 0; q < m; q++) {
+                        bands.vertices[3 * (vert + q)]     = piece[q][0];
+                        bands.vertices[3 * (vert + q) + 1] = floor_y;
+                        bands.vertices[3 * (vert + q) + 2] = piece[q][1];
+                        bands.colors[4 * (vert + q)] = bands.colors[4 * (vert + q) + 1] =
+                            bands.colors[4 * (vert + q) + 2] = shade;
+                        bands.colors[4 * (vert + q) + 3] = 255;
+                        if (q < 2) continue;
+                        bands.indices[ix++] = (unsigned short)vert;
+                        bands.indices[ix++] = (unsigned short)(vert + q - 1);
+                        bands.indices[ix++] = (unsigned short)(vert + q);
+                    }
+                    vert += m;
+                }
+            }
+        }
+    }
+    n->iso_count = seg;
+    n->iso_step  = step;
+    if (vert) {
+        bands.vertexCount   = vert;
+        bands.triangleCount = ix / 3;
+        n->bands = bands;
+    } else {
+        mesh_free_arrays(&bands);
+    }
+}
+
+// Cut the contours the drawn chunks of a surface lack, one chunk to a
+// pool task, and upload their bands. Chunks keep them while they live;
+// the levels change only with the range, which starts a new tree.
+static void cut_contours(float range, SurfaceNode *const *drawn, int count) {
+    static SurfaceNode *todo[LOD_MAX_NODES];
+    float step = iso_step(range);
+    int m = 0;
+    for (int i = 0; i < count; i++) {
+        if (!drawn[i]->heights || drawn[i]->iso_step == step) continue;
+        iso_unload(drawn[i]);
+        todo[m++] = drawn[i];
+    }
+    if (!m) return;
+    IsoJob job = { todo, range, step };
+    workpool_run(cut_chunk, &job, m);
+    for (int q = 0; q < m; q++)
+        if (todo[q]->bands.vertexCount) UploadMesh(&todo[q]->bands, false);
+}
+
+// Isobands and contour lines on the floor of the range, under the surface
+static void draw_floor_contours(const FuncSlot *slot, float range, SurfaceNode *const *drawn,
+                                int count, Material *mat) {
+    Color col = PLOT_COLORS[slot->color_idx % PLOT_COLOR_COUNT];
+    mat->maps[MATERIAL_MAP_DIFFUSE].color = (Color){col.r, col.g, col.b, 200};
+    rlDisableBackfaceCulling();
+    for (int i = 0; i < count; i++)
+        if (drawn[i]->bands.vertexCount) DrawMesh(drawn[i]->bands, *mat, MatrixIdentity());
+    rlEnableBackfaceCulling();
+
+    float y = -range + ISO_LIFT * range;
+    rlBegin(RL_LINES);
+    rlColor4ub(240, 240, 240, 110);
+    for (int i = 0; i < count; i++) {
+        const SurfaceNode *n = drawn[i];
+        for (int s = 0; s < n->iso_count; s++) {
+            rlVertex3f(n->iso[2 * s].x, y, n->iso[2 * s].y);
+            rlVertex3f(n->iso[2 * s + 1].x, y, n->iso[2 * s + 1].y);
+        }
+    }
+    rlEnd();
+}
+
+// Contour lines on the surface, each at its level
+static void draw_surface_contours(float range, SurfaceNode *const *drawn, int count) {
+    float lift = ISO_LIFT * range;
+    rlBegin(RL_LINES);
+    rlColor4ub(240, 240, 240, 150);
+    for (int i = 0; i < count; i++) {
+        const SurfaceNode *n = drawn[i];
+        for (int s = 0; s < n->iso_count; s++) {
+            float y = n->iso_level[s] + lift;
+            rlVertex3f(n->iso[2 * s].x, y, n->iso[2 * s].y);
+            rlVertex3f(n->iso[2 * s + 1].x, y, n->iso[2 * s + 1].y);
+        }
+    }
+    rlEnd();
+}
+
+// Bring the trees of the surfaces in mask up to the view, in rounds of a
+// walk of every tree and one pool job, while LOD_BUDGET lasts. Each round
+// is sized by how long a chunk took lately, so it ends within the budget;
+// the first builds at least one chunk, so a slow surface still refines.
+static void refine_surfaces(Plot3DState *ps, unsigned mask, LodWalk *w) {
+    static LodBuild queue[LOD_BUILDS];
+    int workers = workpool_workers();
+    double start = GetTime(), left = LOD_BUDGET;
+    while (left > 0.0) {
+        int cap = ps->chunk_time > 0.0 ? (int)(left / ps->chunk_time) * workers : workers;
+        w->queue  = queue;
+        w->queued = 0;
+        w->cap    = cap < 1 ? 1 : cap > LOD_BUILDS ? LOD_BUILDS : cap;
+        w->drawn  = NULL;
+        for (int i = 0; i < ps->surf_count; i++) {
+            if (!(mask & (1u << i))) continue;
+            w->si   = i;
+            w->tree = ps->surfs[i].mesh.tree;
+            if (w->tree->node[0].built) lod_walk(w);
+            else lod_queue(w, &w->tree->node[0]);
+        }
+        if (!w->queued) break;
+        LodJob job = { ps, queue };
+        double t0 = GetTime();
+        workpool_run(build_chunk, &job, w->queued);
+        for (int q = 0; q < w->queued; q++) {
+            SurfaceNode *n = queue[q].node;
+            if (n->mesh.vertexCount) UploadMesh(&n->mesh, false);
+            n->built = true;
+        }
+        double now = GetTime();
+        ps->chunk_time = (now - t0) / ((w->queued + workers - 1) / workers);
+        left = LOD_BUDGET - (now - start);
+    }
+}
 
+static void draw_surface(const FuncSlot *slot, SurfaceNode *const *drawn, int count, Material *mat) {
     Color col = PLOT_COLORS[slot->color_idx % PLOT_COLOR_COUNT];
-    Color col_t = (Color){col.r, col.g, col.b, 160};
-
-    float step = (range * 2.0f) / SURF_RES;
-
-    for (int ix = 0; ix < SURF_RES; ix++) {
-        for (int iz = 0; iz < SURF_RES; iz++) {
-            float x0 = -range + ix * step;
-            float z0 = -range + iz * step;
-            float x1 = x0 + step;
-            float z1 = z0 + step;
-
-            // Evaluate z = f(x, y) at 4 corners
-            // In our coordinate system: x→x, z→y (user's y input), result→Y (up)
-            double y00 = eval_ast_xy(slot->ast, x0, z0);
-            double y10 = eval_ast_xy(slot->ast, x1, z0);
-            double y01 = eval_ast_xy(slot->ast, x0, z1);
-            double y11 = eval_ast_xy(slot->ast, x1, z1);
-
-            // Skip if any value is invalid or too large
-            if (isnan(y00) || isnan(y10) || isnan(y01) || isnan(y11)) continue;
-            if (isinf(y00) || isinf(y10) || isinf(y01) || isinf(y11)) continue;
-            float clamp = range * 2.0f;
-            if (fabsf((float)y00) > clamp || fabsf((float)y10) > clamp ||
-                fabsf((float)y01) > clamp || fabsf((float)y11) > clamp) continue;
-
-            // Triangle 1
-            DrawTriangle3D(
-                (Vector3){x0, (float)y00, z0},
-                (Vector3){x1, (float)y10, z0},
-                (Vector3){x0, (float)y01, z1},
-                col_t
-            );
-            // Triangle 2
-            DrawTriangle3D(
-                (Vector3){x1, (float)y10, z0},
-                (Vector3){x1, (float)y11, z1},
-                (Vector3){x0, (float)y01, z1},
-                col_t
-            );
-            // Back faces (reverse winding)
-            DrawTriangle3D(
-                (Vector3){x0, (float)y01, z1},
-                (Vector3){x1, (float)y10, z0},
-                (Vector3){x0, (float)y00, z0},
-                col_t
-            );
-            DrawTriangle3D(
-                (Vector3){x0, (float)y01, z1},
-                (Vector3){x1, (float)y11, z1},
-                (Vector3){x1, (float)y10, z0},
-                col_t
-            );
-
-            // Wireframe on top
-            Color wire = (Color){col.r, col.g, col.b, 80};
-            DrawLine3D((Vector3){x0, (float)y00, z0}, (Vector3){x1, (float)y10, z0}, wire);
-            DrawLine3D((Vector3){x0, (float)y00, z0}, (Vector3){x0, (float)y01, z1}, wire);
+
+    // Translucent, both faces; the vertex colours shade the slot's colour
+    mat->maps[MATERIAL_MAP_DIFFUSE].color = (Color){col.r, col.g, col.b, 160};
+    rlDisableBackfaceCulling();
+    for (int i = 0; i < count; i++)
+        if (drawn[i]->mesh.vertexCount) DrawMesh(drawn[i]->mesh, *mat, MatrixIdentity());
+    for (int i = 0; i < slot->mesh.part_count; i++)
+        DrawMesh(slot->mesh.parts[i], *mat, MatrixIdentity());
+    rlEnableBackfaceCulling();
+
+    // Wireframe on top
+    rlBegin(RL_LINES);
+    rlColor4ub(col.r, col.g, col.b, 80);
+    for (int i = 0; i < count; i++) {
+        const SurfaceNode *n = drawn[i];
+        for (int v = 0; v < n->wire_count; v++) rlVertex3f(n->wire[v].x, n->wire[v].y, n->wire[v].z);
+    }
+    rlEnd();
+}
+
+// Stamp the drawn chunks of a tree and spread their heights up it, so
+// that each node bounds what is drawn under it, for picking
+static void mark_drawn(SurfaceTree *t, SurfaceNode *const *drawn, int count, unsigned frame) {
+    for (int i = 0; i < count; i++) {
+        SurfaceNode *n = drawn[i];
+        n->drawn = frame;
+        if (!n->mip) continue;
+        const float *top = n->mip[MIP_CELLS - 1];
+        for (SurfaceNode *p = n;; p = &t->node[p->parent]) {
+            if (p->span_frame != frame) {
+                p->span_frame = frame;
+                p->span_lo    = INFINITY;
+                p->span_hi    = -INFINITY;
+            }
+            p->span_lo = fminf(p->span_lo, top[0]);
+            p->span_hi = fmaxf(p->span_hi, top[1]);
+            if (p->parent < 0) break;
         }
     }
 }
 
+// A ray against the drawn surfaces, nearest hit first. Both the tree and
+// each chunk's pyramid are columns over the x-z plane holding a range of
+// heights: the ray skips every column whose box it misses, or meets
+// beyond the nearest hit so far, and goes down the rest nearest first,
+// so it tests the triangles of a few cells out of the whole grid.
+typedef struct {
+    Vector3 o, d;  // world coordinates
+    float   t;     // nearest hit along d, INFINITY if none
+    int     si;    // surface being tested
+    int     hit;   // surface hit at t, or -1
+} Pick;
+
+// Where the ray enters the box [lo, hi], if it does before pk->t
+static bool pick_box(const Pick *pk, const float lo[3], const float hi[3], float *enter) {
+    if (lo[1] > hi[1]) return false; // nothing drawn in it
+    float o[3] = { pk->o.x, pk->o.y, pk->o.z }, d[3] = { pk->d.x, pk->d.y, pk->d.z };
+    float t0 = 0.0f, t1 = pk->t;
+    for (int a = 0; a < 3; a++) {
+        if (d[a] == 0.0f) {
+            if (o[a] < lo[a] || o[a] > hi[a]) return false;
+            continue;
+        }
+        float ta = (lo[a] - o[a]) / d[a], tb = (hi[a] - o[a]) / d[a];
+        t0 = fmaxf(t0, fminf(ta, tb));
+        t1 = fminf(t1, fmaxf(ta, tb));
+        if (t0 > t1) return false;
+    }
+    *enter = t0;
+    return true;
+}
+
+static void pick_triangle(Pick *pk, Vector3 a, Vector3 b, Vector3 c) {
+    Vector3 e1 = Vector3Subtract(b, a), e2 = Vector3Subtract(c, a);
+    Vector3 p = Vector3CrossProduct(pk->d, e2);
+    float det = Vector3DotProduct(e1, p);
+    if (fabsf(det) < 1e-12f) return;
+    Vector3 s = Vector3Subtract(pk->o, a);
+    float u = Vector3DotProduct(s, p) / det;
+    if (u < 0.0f || u > 1.0f) return;
+    Vector3 q = Vector3CrossProduct(s, e1);
+    float v = Vector3DotProduct(pk->d, q) / det;
+    if (v < 0.0f || u + v > 1.0f) return;
+    float t = Vector3DotProduct(e2, q) / det;
+    if (t < 0.0f || t >= pk->t) return;
+    pk->t   = t;
+    pk->hit = pk->si;
+}
+
+// The k-th quadrant of a 2x2 split along the ray, c & 1 the far half
+// along x and c >> 1 along z: nearest on both axes first, farthest last;
+// of the two between, the ray crosses one at most
+static int pick_order(const Pick *pk, int k) {
+    int nx = pk->d.x < 0.0f, nz = pk->d.z < 0.0f;
+    static const int FLIP[4][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+    return (nx ^ FLIP[k][0]) | (nz ^ FLIP[k][1]) << 1;
+}
+
+// Block (bi, bj) of size cells a side in chunk n, its pyramid level
+// starting at base
+static void pick_block(Pick *pk, const SurfaceNode *n, float range, int size, int base, int bi, int bj) {
+    int per = SURF_CHUNK / size;
+    const float *mm = n->mip[base + bj * per + bi];
+    float lo[3] = { (float)chunk_coord(range, n->level, n->ix, 2 * bi * size), mm[0],
+                    (float)chunk_coord(range, n->level, n->iz, 2 * bj * size) };
+    float hi[3] = { (float)chunk_coord(range, n->level, n->ix, 2 * (bi + 1) * size), mm[1],
+                    (float)chunk_coord(range, n->level, n->iz, 2 * (bj + 1) * size) };
+    float enter;
+    if (!pick_box(pk, lo, hi, &enter)) return;
+    if (size == 1) {
+        const int side = SURF_CHUNK + 1;
+        const float *r0 = &n->heights[bj * side + bi], *r1 = r0 + side;
+        Vector3 v00 = { lo[0], r0[0], lo[2] }, v10 = { hi[0], r0[1], lo[2] };
+        Vector3 v01 = { lo[0], r1[0], hi[2] }, v11 = { hi[0], r1[1], hi[2] };
+        pick_triangle(pk, v00, v10, v01);
+        pick_triangle(pk, v10, v11, v01);
+        return;
+    }
+    int below = base - 4 * per * per;
+    for (int k = 0; k < 4; k++) {
+        int c = pick_order(pk, k);
+        pick_block(pk, n, range, size / 2, below, 2 * bi + (c & 1), 2 * bj + (c >> 1));
+    }
+}
+
+static void pick_node(Pick *pk, const SurfaceTree *t, int index, float range, unsigned frame) {
+    const SurfaceNode *n = &t->node[index];
+    if (n->span_frame != frame) return;
+    float lo[3] = { (float)chunk_coord(range, n->level, n->ix, 0), n->span_lo,
+                    (float)chunk_coord(range, n->level, n->iz, 0) };
+    float hi[3] = { (float)chunk_coord(range, n->level, n->ix, HALF - 1), n->span_hi,
+                    (float)chunk_coord(range, n->level, n->iz, HALF - 1) };
+    float enter;
+    if (!pick_box(pk, lo, hi, &enter)) return;
+    if (n->drawn == frame) {
+        pick_block(pk, n, range, SURF_CHUNK, MIP_CELLS - 1, 0, 0);
+        return;
+    }
+    if (n->child < 0) return;
+    for (int k = 0; k < 4; k++) pick_node(pk, t, n->child + pick_order(pk, k), range, frame);
+}
+
+// The nearest point of a z = f(x,y) surface on the ray, into ps->hover
+// and hover_at; the value there is f's own, not the mesh's
+static void pick_surfaces(Plot3DState *ps, Ray ray) {
+    Pick pk = { ray.position, ray.direction, INFINITY, -1, -1 };
+    for (int i = 0; i < ps->surf_count; i++) {
+        const FuncSlot *slot = &ps->surfs[i];
+        const SurfaceMesh *m = &slot->mesh;
+        if (!m->tree || m->gen != slot->gen || m->range != ps->range || !slot->valid || !slot->visible)
+            continue;
+        pk.si = i;
+        pick_node(&pk, m->tree, 0, ps->range, ps->frame);
+    }
+    if (pk.hit < 0) return;
+    Vector3 at = Vector3Add(pk.o, Vector3Scale(pk.d, pk.t));
+    double f = eval_ast_xy(ps->surfs[pk.hit].ast, at.x, at.z);
+    ps->hover    = pk.hit;
+    ps->hover_at = (Vector3){ at.x, at.z, isfinite(f) ? (float)f : at.y };
+}
+
+// The hovered point, marked on the surface inside the 3D mode
+static void draw_hover_mark(const Plot3DState *ps) {
+    const FuncSlot *slot = &ps->surfs[ps->hover];
+    Color col = PLOT_COLORS[slot->color_idx % PLOT_COLOR_COUNT];
+    Vector3 at = { ps->hover_at.x, ps->hover_at.z, ps->hover_at.y };
+    DrawSphere(at, ps->range * 0.012f, WHITE);
+    DrawSphere(at, ps->range * 0.008f, col);
+}
+
+// Its coordinates and value by the cursor, as the 2D crosshair shows them
+static void draw_hover_tooltip(const Plot3DState *ps) {
+    const FuncSlot *slot = &ps->surfs[ps->hover];
+    Color col = PLOT_COLORS[slot->color_idx % PLOT_COLOR_COUNT];
+    Vector2 mouse = ui_mouse();
+    Vector3 at = ps->hover_at;
+
+    char coords[96];
+    snprintf(coords, sizeof(coords), "(%.3f, %.3f, %.3f)", at.x, at.y, at.z);
+    int cw = ui_measure_text(coords, FONT_SIZE_TINY);
+    DrawRectangleRounded((Rectangle){mouse.x + 14, mouse.y - 22, (float)(cw + 10), 20},
+                         0.3f, 6, (Color){COL_PANEL.r, COL_PANEL.g, COL_PANEL.b, 220});
+    ui_draw_text(coords, (int)mouse.x + 19, (int)mouse.y - 21, FONT_SIZE_TINY, COL_TEXT);
+
+    char val[80];
+    snprintf(val, sizeof(val), "%s = %.4g", slot->name, at.z);
+    int vw = ui_measure_text(val, FONT_SIZE_TINY);
+    DrawRectangleRounded((Rectangle){mouse.x + 14, mouse.y + 8, (float)(vw + 10), 18},
+                         0.3f, 6, (Color){col.r, col.g, col.b, 160});
+    ui_draw_text(val, (int)mouse.x + 19, (int)mouse.y + 9, FONT_SIZE_TINY, WHITE);
+}
+
 void plotter3d_draw(Plot3DState *ps, Rectangle area, Arena *arena) {
     DrawRectangleRec(area, COL_BG);
 
@@ -206,9 +1364,55 @@ void plotter3d_draw(Plot3DState *ps, Rectangle area, Arena *arena) {
     draw_grid_3d(ps->range);
     draw_axes(ps->range);
 
-    // Draw surfaces
+    // Vector fields first: their arrows are opaque, the surfaces not
     for (int i = 0; i < ps->surf_count; i++) {
-        draw_surface(&ps->surfs[i], ps->range, arena);
+        FuncSlot *slot = &ps->surfs[i];
+        if (!slot->field || !slot->valid || !slot->visible) continue;
+        build_field(slot, ps->range, arena);
+        draw_field(slot);
+    }
+
+    // Surfaces: each tree is refined toward the view, building the chunks
+    // it lacks on the worker pool, then walked again for what to draw,
+    // with the contours of the drawn chunks when shown.
+    // Implicit and parametric surfaces are meshed whole when they change,
+    // in arena.
+    static Material     material;
+    static SurfaceNode *drawn[LOD_MAX_NODES];
+    if (!material.maps) material = LoadMaterialDefault();
+    ps->frame++;
+    unsigned mask = 0;
+    for (int i = 0; i < ps->surf_count; i++) {
+        FuncSlot *slot = &ps->surfs[i];
+        if (!slot->code || !slot->valid || !slot->visible || slot->field) continue;
+        if (slot->implicit || slot->params) whole_surface(slot, ps->range, arena);
+        else if (surface_tree(slot, ps->range)) mask |= 1u << i;
+    }
+    if (ps->dag && mask && mask != ps->jit_mask) {
+        jit_free(ps->jit);
+        ps->jit      = jit_compile(ps->dag, mask);
+        ps->jit_mask = mask;
+    }
+    LodWalk walk = { .ps = ps };
+    lod_camera(&walk, &ps->camera);
+    refine_surfaces(ps, mask, &walk);
+    for (int i = 0; i < ps->surf_count; i++) {
+        const FuncSlot *slot = &ps->surfs[i];
+        if ((slot->implicit || slot->params) && slot->valid && slot->visible)
+            draw_surface(slot, drawn, 0, &material);
+        if (!(mask & (1u << i))) continue;
+        walk.si          = i;
+        walk.tree        = ps->surfs[i].mesh.tree;
+        walk.drawn       = drawn;
+        walk.drawn_count = 0;
+        if (walk.tree->node[0].built) lod_walk(&walk);
+        mark_drawn(walk.tree, drawn, walk.drawn_count, ps->frame);
+        if (slot->show_contours) {
+            cut_contours(ps->range, drawn, walk.drawn_count);
+            draw_floor_contours(slot, ps->range, drawn, walk.drawn_count, &material);
+        }
+        draw_surface(slot, drawn, walk.drawn_count, &material);
+        if (slot->show_contours) draw_surface_contours(ps->range, drawn, walk.drawn_count);
     }
 
     // Draw vectors
@@ -217,6 +1421,9 @@ void plotter3d_draw(Plot3DState *ps, Rectangle area, Arena *arena) {
             draw_vector(&ps->vecs[i]);
     }
 
+    bool hover = ps->hover >= 0 && ps->hover < ps->surf_count;
+    if (hover) draw_hover_mark(ps);
+
     EndMode3D();
     EndScissorMode();
 
@@ -244,4 +1451,6 @@ void plotter3d_draw(Plot3DState *ps, Rectangle area, Arena *arena) {
     float hx = area.x + area.width - 260;
     float hy = area.y + area.height - 20;
     ui_draw_text("Drag=Orbit  Scroll=Zoom  Home=Reset", (int)hx, (int)hy, FONT_SIZE_TINY, COL_TEXT_DIM);
+
+    if (hover) draw_hover_tooltip(ps);
 }
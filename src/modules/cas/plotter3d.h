@@ -28,10 +28,16 @@ typedef struct {
     Vector2  orbit_start;
     float    orbit_angle0;
     float    orbit_pitch0;
+    bool     panning;      // right-drag moves camera.target over the x-z plane
+    Vector2  pan_start;
+    Vector3  pan_target0;
 
     // Surface functions (z = f(x,y))
     FuncSlot  surfs[MAX_FUNCTIONS];
     int       surf_count;
+    DagProgram *dag; // all surfs as one program (root i = surfs[i]), or NULL
+    JitCode    *jit; // native code of dag for the surfs in jit_mask, or NULL
+    unsigned    jit_mask;
 
     // Vectors
     VecEntry  vecs[MAX_VECTORS];
@@ -39,10 +45,18 @@ typedef struct {
 
     // View range
     float     range; // half-extent of x/y axes
+    unsigned  frame; // plotter3d_draw calls, to age surface chunks
+    double    chunk_time; // s a worker took per surface chunk lately, to size refinement rounds
+
+    // Hover, found by plotter3d_update among the surfaces as last drawn
+    int       hover;    // z = f(x,y) surface under the cursor, or -1
+    Vector3   hover_at; // the point there: x, y, f(x, y)
 } Plot3DState;
 
 void plotter3d_init(Plot3DState *ps);
 void plotter3d_update(Plot3DState *ps, Rectangle area);
 void plotter3d_draw(Plot3DState *ps, Rectangle area, Arena *arena);
+// Free slot's surface mesh, before the slot is dropped
+void plotter3d_release(FuncSlot *slot);
 
 #endif
@@ -0,0 +1,434 @@
+#define _DEFAULT_SOURCE // mmap, madvise and fileno under -std=c11
+#include "series.h"
+#include "../../utils/workpool.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BUILD_BLOCKS 4096 // pyramid leaves per build task
+#define CSV_BUF      8192 // doubles converted per write
+
+static inline double sample_x(const DataSeries *s, long long i) {
+    return s->stride == 2 ? s->data[2 * i] : (double)i;
+}
+
+static inline double sample_y(const DataSeries *s, long long i) {
+    return s->data[i * s->stride + s->stride - 1];
+}
+
+static inline void widen(SeriesRange *r, SeriesRange e) {
+    if (e.lo < r->lo) r->lo = e.lo;
+    if (e.hi > r->hi) r->hi = e.hi;
+}
+
+// r widened by samples [i0, i1); NaN fails both compares and is skipped.
+// One loop per stride, so each runs with a constant step.
+static SeriesRange scan(const DataSeries *s, long long i0, long long i1, SeriesRange r) {
+    double lo = r.lo, hi = r.hi;
+    if (s->stride == 1) {
+        for (long long i = i0; i < i1; i++) {
+            double y = s->data[i];
+            lo = y < lo ? y : lo;
+            hi = y > hi ? y : hi;
+        }
+    } else {
+        for (long long i = i0; i < i1; i++) {
+            double y = s->data[2 * i + 1];
+            lo = y < lo ? y : lo;
+            hi = y > hi ? y : hi;
+        }
+    }
+    return (SeriesRange){ lo, hi };
+}
+
+// Extremes of samples [i0, i1): the partial blocks at the ends are read,
+// the whole ones taken from the highest level that covers them; without
+// a pyramid, all are read. Empty (lo > hi) if all are NaN.
+static SeriesRange range_of(const DataSeries *s, long long i0, long long i1) {
+    SeriesRange r = { INFINITY, -INFINITY };
+    long long b0 = (i0 + SERIES_BLOCK - 1) / SERIES_BLOCK, b1 = i1 / SERIES_BLOCK;
+    if (b0 >= b1 || !s->levels) return scan(s, i0, i1, r);
+    r = scan(s, i0, b0 * SERIES_BLOCK, r);
+    r = scan(s, b1 * SERIES_BLOCK, i1, r);
+
+    for (int l = 0;; l++) {
+        long long p0 = (b0 + SERIES_FANOUT - 1) / SERIES_FANOUT, p1 = b1 / SERIES_FANOUT;
+        if (l + 1 == s->levels || p0 >= p1) {
+            for (long long b = b0; b < b1; b++) widen(&r, s->level[l][b]);
+            return r;
+        }
+        for (long long b = b0; b < p0 * SERIES_FANOUT; b++) widen(&r, s->level[l][b]);
+        for (long long b = p1 * SERIES_FANOUT; b < b1; b++) widen(&r, s->level[l][b]);
+        b0 = p0;
+        b1 = p1;
+    }
+}
+
+// First sample with x >= v, or with x > v when after
+static long long search(const DataSeries *s, double v, bool after) {
+    if (s->stride == 1) {
+        double i = after ? floor(v) + 1.0 : ceil(v);
+        if (!(i > 0.0)) return 0;
+        return i >= (double)s->count ? s->count : (long long)i;
+    }
+    long long lo = 0, hi = s->count;
+    while (lo < hi) {
+        long long mid = lo + (hi - lo) / 2;
+        double x = sample_x(s, mid);
+        if (after ? x <= v : x < v) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// ---- Pyramid ----
+
+static void leaf_task(void *ctx, int index, int worker) {
+    (void)worker;
+    DataSeries *s = ctx;
+    long long b0 = (long long)index * BUILD_BLOCKS;
+    long long b1 = b0 + BUILD_BLOCKS < s->level_len[0] ? b0 + BUILD_BLOCKS : s->level_len[0];
+    for (long long b = b0; b < b1; b++) {
+        long long end = (b + 1) * SERIES_BLOCK < s->count ? (b + 1) * SERIES_BLOCK : s->count;
+        s->level[0][b] = scan(s, b * SERIES_BLOCK, end, (SeriesRange){ INFINITY, -INFINITY });
+    }
+}
+
+// Leaves in parallel, one pass over the mapping; the levels above are an
+// eighth of the one below each and built from it
+static bool build_pyramid(DataSeries *s) {
+    s->arena = arena_create_ex(ARENA_DEFAULT_CAP, 0, "series");
+    long long len = (s->count + SERIES_BLOCK - 1) / SERIES_BLOCK;
+    for (s->levels = 0; s->levels < SERIES_MAX_LEVELS; s->levels++) {
+        SeriesRange *lv = arena_alloc(&s->arena, (size_t)len * sizeof(SeriesRange));
+        if (!lv) return false;
+        s->level[s->levels]     = lv;
+        s->level_len[s->levels] = len;
+        if (len <= SERIES_FANOUT) {
+            s->levels++;
+            break;
+        }
+        len = (len + SERIES_FANOUT - 1) / SERIES_FANOUT;
+    }
+
+    madvise(s->map, s->map_size, MADV_SEQUENTIAL);
+    workpool_run(leaf_task, s, (int)((s->level_len[0] + BUILD_BLOCKS - 1) / BUILD_BLOCKS));
+    madvise(s->map, s->map_size, MADV_NORMAL);
+
+    for (int l = 1; l < s->levels; l++) {
+        for (long long p = 0; p < s->level_len[l]; p++) {
+            SeriesRange r = { INFINITY, -INFINITY };
+            long long end = (p + 1) * SERIES_FANOUT;
+            if (end > s->level_len[l - 1]) end = s->level_len[l - 1];
+            for (long long b = p * SERIES_FANOUT; b < end; b++) widen(&r, s->level[l - 1][b]);
+            s->level[l][p] = r;
+        }
+    }
+    return true;
+}
+
+// ---- CSV ----
+
+static const double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Decimal number at p, before end: sign, digits with an optional point,
+// exponent, or "nan". Exact when the digits fit 2^53 and the exponent
+// 10^22, which covers instrument output. Returns the end of the number,
+// or NULL if p does not start one.
+static const char *parse_number(const char *p, const char *end, double *out) {
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    if (end - p >= 3 && (p[0] | 0x20) == 'n' && (p[1] | 0x20) == 'a' && (p[2] | 0x20) == 'n') {
+        *out = NAN;
+        return p + 3;
+    }
+
+    uint64_t m = 0;
+    int exp = 0, digits = 0;
+    bool any = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+        if (digits < 19) { m = m * 10 + (uint64_t)(*p - '0'); if (m) digits++; }
+        else exp++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+            if (digits < 19) { m = m * 10 + (uint64_t)(*p - '0'); exp--; if (m) digits++; }
+        }
+    }
+    if (!any) return NULL;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool eneg = false;
+        if (q < end && (*q == '-' || *q == '+')) eneg = *q++ == '-';
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            for (; q < end && *q >= '0' && *q <= '9'; q++)
+                if (e < 10000) e = e * 10 + (*q - '0');
+            exp += eneg ? -e : e;
+            p = q;
+        }
+    }
+
+    double v;
+    if (m < (1ull << 53) && exp >= -22 && exp <= 22)
+        v = exp < 0 ? (double)m / POW10[-exp] : (double)m * POW10[exp];
+    else
+        v = (double)m * pow(10.0, exp);
+    *out = neg ? -v : v;
+    return p;
+}
+
+int series_parse_row(const char *p, const char *end, double *v) {
+    int n = 0;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p == end) break;
+        double x;
+        const char *q = parse_number(p, end, &x);
+        if (!q) return 0;
+        if (n < 2) v[n] = x;
+        n++;
+        p = q;
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p < end && (*p == ',' || *p == ';')) p++;
+    }
+    return n < 2 ? n : 2;
+}
+
+static double csv_buf[CSV_BUF];
+
+// Samples of the CSV text into out, as y or (x, y) by the first data row.
+// Rows that are not numbers (headers, comments) are skipped, as are rows
+// with fewer columns and rows whose x is NaN.
+static const char *convert_csv(const char *text, size_t size, FILE *out,
+                               int *stride, long long *count) {
+    const char *p = text, *end = text + size;
+    int used = 0;
+    double last_x = -INFINITY;
+    *stride = 0;
+    *count  = 0;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        double v[2];
+        int n = series_parse_row(p, eol, v);
+        p = eol + 1;
+        if (n == 0) continue;
+        if (!*stride) *stride = n;
+        if (n < *stride) continue;
+        if (*stride == 2) {
+            if (isnan(v[0])) continue;
+            if (v[0] < last_x) return "x column is not ascending";
+            last_x = v[0];
+            csv_buf[used++] = v[0];
+            csv_buf[used++] = v[1];
+        } else {
+            csv_buf[used++] = v[0];
+        }
+        (*count)++;
+        if (used + 2 > CSV_BUF) {
+            if (fwrite(csv_buf, sizeof(double), (size_t)used, out) != (size_t)used)
+                return "cannot write scratch file";
+            used = 0;
+        }
+    }
+    if (fwrite(csv_buf, sizeof(double), (size_t)used, out) != (size_t)used || fflush(out))
+        return "cannot write scratch file";
+    return *count ? NULL : "no samples in file";
+}
+
+static void *map_fd(int fd, size_t *size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return NULL;
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return p;
+}
+
+// An unlinked file made in dir, or NULL
+static FILE *scratch_in(const char *dir, size_t dir_len) {
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%.*s/.series-XXXXXX", (int)dir_len, dir) >= (int)sizeof(path))
+        return NULL;
+    int fd = mkstemp(path);
+    if (fd < 0) return NULL;
+    unlink(path);
+    FILE *f = fdopen(fd, "w+b");
+    if (!f) close(fd);
+    return f;
+}
+
+// Where the samples of the CSV at path are converted to: next to it, on a
+// disk that holds the source, else under the user's cache directory. Not
+// tmpfile, whose /tmp may be RAM that a large series would fill.
+static FILE *scratch_file(const char *path) {
+    const char *slash = strrchr(path, '/');
+    FILE *f = slash ? scratch_in(path, (size_t)(slash - path + (slash == path)))
+                    : scratch_in(".", 1);
+    if (f) return f;
+    const char *cache = getenv("XDG_CACHE_HOME");
+    if (cache && *cache) return scratch_in(cache, strlen(cache));
+    const char *home = getenv("HOME");
+    if (!home || !*home) return NULL;
+    char dir[4096];
+    int n = snprintf(dir, sizeof(dir), "%s/.cache", home);
+    return n < (int)sizeof(dir) ? scratch_in(dir, (size_t)n) : NULL;
+}
+
+// The CSV at fd converted into an unlinked scratch file and mapped, so
+// its samples are paged like a raw file's instead of held in memory
+static const char *open_csv(DataSeries *s, int fd, const char *path) {
+    size_t text_size = 0;
+    void *text = map_fd(fd, &text_size);
+    if (!text) return "empty file";
+    FILE *tmp = scratch_file(path);
+    if (!tmp) {
+        munmap(text, text_size);
+        return "cannot create scratch file";
+    }
+    madvise(text, text_size, MADV_SEQUENTIAL);
+    const char *err = convert_csv(text, text_size, tmp, &s->stride, &s->count);
+    munmap(text, text_size);
+    if (!err) {
+        s->map = map_fd(fileno(tmp), &s->map_size);
+        if (!s->map) err = "cannot map scratch file";
+    }
+    fclose(tmp);
+    return err;
+}
+
+static const char *open_raw(DataSeries *s, int fd) {
+    s->map = map_fd(fd, &s->map_size);
+    if (!s->map) return "empty file";
+    if (s->map_size % sizeof(double)) return "not a float64 file";
+    s->stride = 1;
+    s->count  = (long long)(s->map_size / sizeof(double));
+    return NULL;
+}
+
+const char *series_open(DataSeries *s, const char *path) {
+    *s = (DataSeries){0};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return "cannot open file";
+    size_t len = strlen(path);
+    bool csv = len >= 4 && strcasecmp(path + len - 4, ".csv") == 0;
+    const char *err = csv ? open_csv(s, fd, path) : open_raw(s, fd);
+    close(fd);
+    s->data = s->map;
+    if (!err && !build_pyramid(s)) err = "out of memory";
+    if (err) {
+        series_close(s);
+        return err;
+    }
+
+    s->visible = true;
+    const char *base = strrchr(path, '/');
+    snprintf(s->name, sizeof(s->name), "%s", base ? base + 1 : path);
+    return NULL;
+}
+
+void series_close(DataSeries *s) {
+    if (s->map) munmap(s->map, s->map_size);
+    arena_destroy(&s->arena);
+    *s = (DataSeries){0};
+}
+
+// ---- Decimation ----
+
+typedef struct {
+    SeriesPoint *out;
+    int          n;
+    bool         start; // the next point starts a line
+} Emit;
+
+static void emit(Emit *e, double x, double y) {
+    if (isnan(y)) {
+        e->start = true;
+        return;
+    }
+    e->out[e->n++] = (SeriesPoint){ x, y, e->start };
+    e->start = false;
+}
+
+// Samples [a, b) of one column as first, extremes, last: the extremes at
+// the column's middle, in the order that draws the least
+static void emit_column(Emit *e, const DataSeries *s, long long a, long long b) {
+    if (b - a <= 4) {
+        for (long long i = a; i < b; i++) emit(e, sample_x(s, i), sample_y(s, i));
+        return;
+    }
+    SeriesRange r = range_of(s, a, b);
+    if (r.lo > r.hi) {
+        e->start = true;
+        return;
+    }
+    double xa = sample_x(s, a), xb = sample_x(s, b - 1), xc = 0.5 * (xa + xb);
+    double first = sample_y(s, a), last = sample_y(s, b - 1);
+    double f = isnan(first) ? r.lo : first, l = isnan(last) ? r.hi : last;
+    emit(e, xa, first);
+    if (fabs(f - r.lo) + fabs(r.hi - l) <= fabs(f - r.hi) + fabs(r.lo - l)) {
+        emit(e, xc, r.lo);
+        emit(e, xc, r.hi);
+    } else {
+        emit(e, xc, r.hi);
+        emit(e, xc, r.lo);
+    }
+    emit(e, xb, last);
+}
+
+int series_decimate(const DataSeries *s, double x_min, double x_max, int columns,
+                    SeriesPoint *out) {
+    if (!s->count || columns < 1 || !(x_max > x_min)) return 0;
+    Emit e = { out, 0, true };
+    long long lo = search(s, x_min, false), hi = search(s, x_max, true);
+
+    if (lo > 0) emit(&e, sample_x(s, lo - 1), sample_y(s, lo - 1));
+    if (hi - lo <= 4LL * columns) {
+        for (long long i = lo; i < hi; i++) emit(&e, sample_x(s, i), sample_y(s, i));
+    } else {
+        double w = (x_max - x_min) / columns;
+        long long a = lo;
+        for (int c = 0; c < columns; c++) {
+            long long b = c + 1 == columns ? hi : search(s, x_min + (c + 1) * w, false);
+            if (b > hi) b = hi;
+            if (b > a) {
+                emit_column(&e, s, a, b);
+                a = b;
+            }
+        }
+    }
+    if (hi < s->count) emit(&e, sample_x(s, hi), sample_y(s, hi));
+    return e.n;
+}
+
+const SeriesPoint *series_view(DataSeries *s, double x_min, double x_max, int columns,
+                               int *count) {
+    if (columns > SERIES_MAX_COLUMNS) columns = SERIES_MAX_COLUMNS;
+    if (!s->view) {
+        s->view = arena_alloc(&s->arena, (4 * SERIES_MAX_COLUMNS + 2) * sizeof(SeriesPoint));
+        if (!s->view) {
+            *count = 0;
+            return NULL;
+        }
+        s->view_columns = 0;
+    }
+    if (s->view_columns != columns || s->view_min != x_min || s->view_max != x_max) {
+        s->view_count   = series_decimate(s, x_min, x_max, columns, s->view);
+        s->view_columns = columns;
+        s->view_min     = x_min;
+        s->view_max     = x_max;
+    }
+    *count = s->view_count;
+    return s->view;
+}
@@ -0,0 +1,78 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../utils/arena.h"
+
+#define SERIES_BLOCK      256 // samples per leaf of the min/max pyramid
+#define SERIES_FANOUT     8   // entries per entry of the next level
+#define SERIES_MAX_LEVELS 16
+#define SERIES_NAME_SIZE  48
+#define SERIES_MAX_COLUMNS 4096 // widest view series_view keeps
+
+// Decimated point of a series; start marks the first point of each line
+typedef struct {
+    double x, y;
+    bool   start;
+} SeriesPoint;
+
+// Min and max of one pyramid entry
+typedef struct {
+    double lo, hi;
+} SeriesRange;
+
+// Measured samples behind a file mapping. Raw files are native float64
+// values at x = 0, 1, 2, ...; CSV files have a y column, or x and y with x
+// ascending, and are converted once into a mapped scratch file beside the
+// source or in the cache directory. The pyramid keeps the min and max of
+// every SERIES_BLOCK samples and, level by level, of every SERIES_FANOUT
+// entries below, so the extremes of any range cost O(log n) reads and
+// nothing has to be read in whole again.
+typedef struct {
+    char    name[SERIES_NAME_SIZE]; // file name, for the sidebar and label
+    bool    visible;
+    int     color_idx;
+
+    const double *data;   // samples, stride doubles apart: y, or x then y
+    int           stride; // 1 (y only) or 2 (x, y pairs)
+    long long     count;
+    void         *map;    // mapping data points into
+    size_t        map_size;
+
+    SeriesRange *level[SERIES_MAX_LEVELS]; // level 0 covers SERIES_BLOCK samples
+    long long    level_len[SERIES_MAX_LEVELS];
+    int          levels;  // 0: no pyramid, extremes are read from data
+
+    // Line of the last series_view, kept until the view changes
+    SeriesPoint *view;    // 4 * SERIES_MAX_COLUMNS + 2 points
+    int          view_count, view_columns;
+    double       view_min, view_max;
+
+    Arena        arena;   // owns the pyramid and view
+} DataSeries;
+
+// Map path (".csv" by extension, anything else raw float64) into s and
+// build its pyramid. Returns NULL, or why it failed with s left closed.
+const char *series_open(DataSeries *s, const char *path);
+void        series_close(DataSeries *s);
+
+// Up to two numbers of the text line [p, end), split by commas,
+// semicolons, tabs or spaces, into v. Returns how many, 0 if the line is
+// blank or a field is not a number.
+int series_parse_row(const char *p, const char *end, double *v);
+
+// Line through the samples with x in [x_min, x_max] and one either side,
+// as at most 4 * columns + 2 points: the samples themselves when there
+// are few enough, else per column its first and last sample and its
+// extremes (M4). Lines break at NaN samples, or at columns of nothing
+// but NaN. Returns the point count.
+int series_decimate(const DataSeries *s, double x_min, double x_max, int columns,
+                    SeriesPoint *out);
+
+// series_decimate of the view, columns at most SERIES_MAX_COLUMNS, from
+// s->view when the view is the last one
+const SeriesPoint *series_view(DataSeries *s, double x_min, double x_max, int columns,
+                               int *count);
+
+#endif
@@ -0,0 +1,188 @@
+#include "simplify.h"
+#include "eval.h"
+#include <math.h>
+#include <float.h>
+
+static bool is_num(const ASTNode *n) {
+    return n && n->type == NODE_NUMBER;
+}
+
+static bool is_num_val(const ASTNode *n, double v) {
+    return is_num(n) && n->number == v;
+}
+
+// A power of two whose reciprocal is normal too: dividing by it and
+// multiplying by its reciprocal round the same exact quotient
+static bool is_exact_divisor(double c) {
+    int e;
+    double inv = 1.0 / c;
+    return isfinite(c) && fabs(frexp(c, &e)) == 0.5 && isfinite(inv) && fabs(inv) >= DBL_MIN;
+}
+
+static void make_num(ASTNode *n, double v) {
+    n->type   = NODE_NUMBER;
+    n->number = v;
+}
+
+static int type_rank(NodeType t) {
+    switch (t) {
+    case NODE_VAR:        return 0;
+    case NODE_FUNC:       return 1;
+    case NODE_UNARY_NEG:  return 2;
+    case NODE_BINOP:      return 3;
+    case NODE_NUMBER:     return 4;
+    }
+    return 5;
+}
+
+int simplify_compare(const ASTNode *a, const ASTNode *b) {
+    if (a == b) return 0;
+    if (!a) return -1;
+    if (!b) return 1;
+
+    int ra = type_rank(a->type), rb = type_rank(b->type);
+    if (ra != rb) return ra < rb ? -1 : 1;
+
+    switch (a->type) {
+    case NODE_NUMBER:
+        if (a->number < b->number) return -1;
+        if (a->number > b->number) return 1;
+        return 0;
+    case NODE_VAR:
+        return (a->var > b->var) - (a->var < b->var);
+    case NODE_UNARY_NEG:
+        return simplify_compare(a->unary.operand, b->unary.operand);
+    case NODE_FUNC:
+        if (a->func.id != b->func.id) return a->func.id < b->func.id ? -1 : 1;
+        return simplify_compare(a->func.arg, b->func.arg);
+    case NODE_BINOP: {
+        if (a->binop.op != b->binop.op) return a->binop.op < b->binop.op ? -1 : 1;
+        int c = simplify_compare(a->binop.left, b->binop.left);
+        return c ? c : simplify_compare(a->binop.right, b->binop.right);
+    }
+    }
+    return 0;
+}
+
+static double fold_binop(char op, double l, double r) {
+    switch (op) {
+        case '+': return l + r;
+        case '-': return l - r;
+        case '*': return l * r;
+        case '/': return r != 0.0 ? l / r : NAN;
+        case '^': return pow(l, r);
+        case '%': return r != 0.0 ? fmod(l, r) : NAN;
+        default:  return NAN;
+    }
+}
+
+// Apply the rewrite rules at one binop whose children are already simplified.
+// Returns the replacement node, or n itself (possibly modified) when done.
+static ASTNode *rewrite_binop(ASTNode *n) {
+    ASTNode *l = n->binop.left;
+    ASTNode *r = n->binop.right;
+    if (!l || !r) return n;
+
+    if (is_num(l) && is_num(r)) {
+        make_num(n, fold_binop(n->binop.op, l->number, r->number));
+        return n;
+    }
+
+    switch (n->binop.op) {
+    case '-':
+        // x - c == x + (-c) exactly; lets constant chains fold as sums
+        if (is_num(r)) {
+            r->number = -r->number;
+            n->binop.op = '+';
+            return rewrite_binop(n);
+        }
+        return n;
+
+    case '/':
+        if (is_num(r)) {
+            if (r->number == 0.0) { make_num(n, NAN); return n; }
+            if (r->number == 1.0) return l;
+            if (is_exact_divisor(r->number)) {
+                r->number = 1.0 / r->number;
+                n->binop.op = '*';
+                return rewrite_binop(n);
+            }
+        }
+        return n;
+
+    case '%':
+        if (is_num_val(r, 0.0)) make_num(n, NAN);
+        return n;
+
+    case '^':
+        if (is_num(r)) {
+            if (r->number == 1.0) return l;
+            if (r->number == 0.0) { make_num(n, 1.0); return n; } // pow(NAN, 0) == 1 too
+            if (r->number == 2.0) {
+                n->binop.op    = '*';
+                n->binop.right = l;
+                return n;
+            }
+        }
+        return n;
+
+    case '+':
+    case '*': {
+        if (simplify_compare(l, r) > 0) {
+            n->binop.left  = r;
+            n->binop.right = l;
+            l = n->binop.left;
+            r = n->binop.right;
+        }
+        char op = n->binop.op;
+        // x + -0 is x, -0 included; x + 0 turns -0 into 0, so it stays
+        if (op == '+' && is_num_val(r, 0.0) && signbit(r->number)) return l;
+        if (op == '*' && is_num_val(r, 1.0)) return l;
+        if (op == '*' && is_num_val(r, -1.0)) {
+            n->type = NODE_UNARY_NEG;
+            n->unary.operand = l;
+            return n;
+        }
+        return n;
+    }
+
+    default:
+        return n;
+    }
+}
+
+ASTNode *simplify_ast(ASTNode *node) {
+    if (!node) return NULL;
+
+    switch (node->type) {
+    case NODE_NUMBER:
+    case NODE_VAR:
+        return node;
+
+    case NODE_UNARY_NEG: {
+        ASTNode *op = simplify_ast(node->unary.operand);
+        node->unary.operand = op;
+        if (is_num(op)) { make_num(node, -op->number); return node; }
+        if (op && op->type == NODE_UNARY_NEG) return op->unary.operand;
+        // -(e*c) -> e*(-c), exact
+        if (op && op->type == NODE_BINOP && op->binop.op == '*' && is_num(op->binop.right)) {
+            op->binop.right->number = -op->binop.right->number;
+            return op;
+        }
+        return node;
+    }
+
+    case NODE_FUNC: {
+        ASTNode *arg = simplify_ast(node->func.arg);
+        node->func.arg = arg;
+        if (is_num(arg)) make_num(node, eval_func(node->func.id, arg->number));
+        return node;
+    }
+
+    case NODE_BINOP:
+        node->binop.left  = simplify_ast(node->binop.left);
+        node->binop.right = simplify_ast(node->binop.right);
+        return rewrite_binop(node);
+    }
+    return node;
+}
@@ -0,0 +1,27 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "parser.h"
+
+// Rewrite a freshly parsed AST in place so that evaluating it does less
+// work per sample. Returns the new root (may be a child of the old one).
+//
+//   - constant subtrees are folded with eval_ast semantics (x/0, x%0 -> NAN)
+//   - x*1, x-0, x/1, x^1 -> x;  x^0 -> 1;  x*-1 -> -x;  --x -> x
+//   - -(x*c) -> x*(-c)
+//   - x-c -> x+(-c);  x/c -> x*(1/c) when c is a power of two
+//   - x^2 -> x*x, with both operands pointing at the same node
+//   - operands of + and * are put in a canonical order, constants last
+//
+// Each rewrite is exact in IEEE arithmetic, so results keep their NaN and
+// INF wherever they had them. Operands are never regrouped across
+// (x+a)+b: that would let an intermediate overflow, or stop overflowing.
+// Only x^2 can move a finite result, by the last bit where pow and x*x
+// round differently, and a NaN may keep a different sign or payload.
+ASTNode *simplify_ast(ASTNode *node);
+
+// Total order on expression trees used for canonical operand order:
+// variables < functions < negations < operators < numbers
+int      simplify_compare(const ASTNode *a, const ASTNode *b);
+
+#endif
@@ -0,0 +1,256 @@
+#define _DEFAULT_SOURCE // sockets, poll and clock_gettime under -std=c11
+#include "stream.h"
+#include <string.h>
+
+#if defined(PLATFORM_WEB)
+
+// No threads or local sockets in the browser
+bool stream_is_source(const char *path) { return strcmp(path, "-") == 0; }
+
+const char *stream_open(DataStream *s, const char *source) {
+    (void)source;
+    *s = (DataStream){0};
+    return "streams need the desktop build";
+}
+
+void stream_close(DataStream *s) { *s = (DataStream){0}; }
+void stream_poll(DataStream *s) { (void)s; }
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define READ_BUF    (1 << 16) // bytes per read, lines carried over whole
+#define POLL_MS     100       // how soon the reader notices stream_close
+
+// head and tail on lines of their own, so the two threads do not share
+// one for the counters they write
+struct StreamRing {
+    _Alignas(64) atomic_size_t head; // next slot the reader fills
+    _Alignas(64) atomic_size_t tail; // next slot the frame loop takes
+    _Alignas(64) atomic_ullong received, dropped, bad, unordered;
+    atomic_bool  stop, ended;
+    int          fd;
+    bool         own_fd;
+    pthread_t    thread;
+    StreamSample slot[STREAM_RING];
+};
+
+static bool blank(const char *p, const char *end) {
+    for (; p < end; p++)
+        if (*p != ' ' && *p != '\t' && *p != '\r') return false;
+    return true;
+}
+
+static void *reader_main(void *arg) {
+    StreamRing *r = arg;
+    char buf[READ_BUF];
+    size_t have = 0;
+    double index = 0.0;       // x of the next y-only sample
+    double last  = -INFINITY; // x of the last sample taken; x may not go back
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+    while (!atomic_load_explicit(&r->stop, memory_order_relaxed)) {
+        struct pollfd pfd = { r->fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, POLL_MS);
+        if (ready == 0 || (ready < 0 && errno == EINTR)) continue;
+        if (ready < 0) break;
+        ssize_t got = read(r->fd, buf + have, sizeof(buf) - have);
+        if (got < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (got <= 0) break;
+        have += (size_t)got;
+
+        unsigned long long received = 0, dropped = 0, bad = 0, unordered = 0;
+        const char *p = buf, *end = buf + have;
+        for (const char *eol; (eol = memchr(p, '\n', (size_t)(end - p))); p = eol + 1) {
+            double v[2];
+            int n = series_parse_row(p, eol, v);
+            if (n == 0) {
+                if (!blank(p, eol)) bad++;
+                continue;
+            }
+            StreamSample smp = n == 2 ? (StreamSample){ v[0], v[1] } : (StreamSample){ index, v[0] };
+            index += 1.0;
+            // The history is searched by x, so it must not decrease
+            if (!(smp.x >= last)) {
+                unordered++;
+                continue;
+            }
+            last = smp.x;
+            received++;
+            if (head - tail == STREAM_RING) {
+                tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+                if (head - tail == STREAM_RING) {
+                    dropped++;
+                    continue;
+                }
+            }
+            r->slot[head & (STREAM_RING - 1)] = smp;
+            head++;
+        }
+        atomic_store_explicit(&r->head, head, memory_order_release);
+        atomic_fetch_add_explicit(&r->received, received, memory_order_relaxed);
+        atomic_fetch_add_explicit(&r->dropped, dropped, memory_order_relaxed);
+        atomic_fetch_add_explicit(&r->bad, bad, memory_order_relaxed);
+        atomic_fetch_add_explicit(&r->unordered, unordered, memory_order_relaxed);
+
+        // Keep the partial last line; one longer than the buffer is bad
+        have = (size_t)(end - p);
+        memmove(buf, p, have);
+        if (have == sizeof(buf)) {
+            have = 0;
+            atomic_fetch_add_explicit(&r->bad, 1, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&r->ended, true, memory_order_release);
+    return NULL;
+}
+
+bool stream_is_source(const char *path) {
+    if (strcmp(path, "-") == 0) return true;
+    struct stat st;
+    return stat(path, &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) ||
+                                     S_ISCHR(st.st_mode));
+}
+
+// fd to read source from: stdin, a connected socket, or the FIFO or
+// device opened. A FIFO is opened for writing as well, so opening does
+// not wait for a writer and writers may come and go without an EOF.
+static int open_source(const char *source, bool *own, const char **err) {
+    *own = true;
+    if (strcmp(source, "-") == 0) {
+        *own = false;
+        return STDIN_FILENO;
+    }
+    struct stat st;
+    if (stat(source, &st) != 0) {
+        *err = "cannot open source";
+        return -1;
+    }
+    if (S_ISSOCK(st.st_mode)) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        if (strlen(source) >= sizeof(addr.sun_path)) {
+            *err = "socket path too long";
+            return -1;
+        }
+        strcpy(addr.sun_path, source);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) return fd;
+        if (fd >= 0) close(fd);
+        *err = "cannot connect to socket";
+        return -1;
+    }
+    int fd = open(source, S_ISFIFO(st.st_mode) ? O_RDWR : O_RDONLY);
+    if (fd < 0) *err = "cannot open source";
+    return fd;
+}
+
+const char *stream_open(DataStream *s, const char *source) {
+    *s = (DataStream){0};
+    s->arena  = arena_create_ex(ARENA_DEFAULT_CAP, 0, "stream");
+    s->window = arena_alloc(&s->arena, 2 * STREAM_HISTORY * sizeof(StreamSample));
+    StreamRing *r = aligned_alloc(64, sizeof(StreamRing));
+    if (!s->window || !r) {
+        free(r);
+        stream_close(s);
+        return "out of memory";
+    }
+    memset(r, 0, offsetof(StreamRing, slot));
+
+    const char *err = NULL;
+    r->fd = open_source(source, &r->own_fd, &err);
+    if (r->fd < 0) {
+        free(r);
+        stream_close(s);
+        return err;
+    }
+    if (pthread_create(&r->thread, NULL, reader_main, r) != 0) {
+        if (r->own_fd) close(r->fd);
+        free(r);
+        stream_close(s);
+        return "cannot start reader thread";
+    }
+
+    s->ring        = r;
+    s->visible     = true;
+    s->follow      = true;
+    s->hist.data   = (const double *)s->window;
+    s->hist.stride = 2;
+    const char *base = strrchr(source, '/');
+    snprintf(s->name, sizeof(s->name), "%s", strcmp(source, "-") == 0 ? "stdin"
+                                             : base ? base + 1 : source);
+    return NULL;
+}
+
+void stream_close(DataStream *s) {
+    StreamRing *r = s->ring;
+    if (r) {
+        atomic_store(&r->stop, true);
+        pthread_join(r->thread, NULL);
+        if (r->own_fd) close(r->fd);
+        free(r);
+    }
+    arena_destroy(&s->arena);
+    *s = (DataStream){0};
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void stream_poll(DataStream *s) {
+    StreamRing *r = s->ring;
+    if (!r) return;
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+    // Append to the window; when it is full, the history slides back to
+    // its start, a move of STREAM_HISTORY samples per STREAM_HISTORY taken
+    long long len = s->hist.count;
+    for (; tail != head; tail++) {
+        if (s->start + len == 2 * STREAM_HISTORY) {
+            memmove(s->window, s->window + s->start, (size_t)len * sizeof(StreamSample));
+            s->start = 0;
+        }
+        s->window[s->start + len] = r->slot[tail & (STREAM_RING - 1)];
+        if (len == STREAM_HISTORY) s->start++;
+        else len++;
+    }
+    atomic_store_explicit(&r->tail, tail, memory_order_release);
+    s->hist.data  = (const double *)(s->window + s->start);
+    s->hist.count = len;
+
+    s->received  = atomic_load_explicit(&r->received, memory_order_relaxed);
+    s->dropped   = atomic_load_explicit(&r->dropped, memory_order_relaxed);
+    s->bad       = atomic_load_explicit(&r->bad, memory_order_relaxed);
+    s->unordered = atomic_load_explicit(&r->unordered, memory_order_relaxed);
+    s->ended     = atomic_load_explicit(&r->ended, memory_order_acquire);
+
+    double t = now_seconds();
+    if (s->rate_time == 0.0) {
+        s->rate_time = t;
+        s->rate_base = s->received;
+    } else if (t - s->rate_time >= 1.0) {
+        s->rate      = (double)(s->received - s->rate_base) / (t - s->rate_time);
+        s->rate_time = t;
+        s->rate_base = s->received;
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include "series.h"
+#include "../../utils/arena.h"
+
+#define STREAM_RING    (1 << 18) // samples in flight from the reader thread
+#define STREAM_HISTORY (1 << 20) // samples kept for drawing, oldest go first
+
+typedef struct {
+    double x, y;
+} StreamSample;
+
+typedef struct StreamRing StreamRing; // shared with the reader thread
+
+// Live samples read on a background thread from stdin ("-"), a FIFO or a
+// UNIX socket, one "y" or "x, y" text line each; without x, x counts the
+// samples read. Samples whose x is below the last one's are skipped and
+// counted, as the history must stay sorted by x. The reader hands them to
+// the frame loop through a single-producer, single-consumer ring and never
+// waits for it: when the ring is full the samples are dropped and counted.
+// stream_poll moves them into the history, which hist presents as an x, y
+// series.
+typedef struct {
+    char  name[SERIES_NAME_SIZE];
+    bool  visible;
+    bool  follow;    // the plot scrolls with the newest sample
+    int   color_idx;
+
+    StreamRing   *ring;   // NULL when closed
+    StreamSample *window; // 2 * STREAM_HISTORY; the history slides along it
+    long long     start;  // first history sample in window
+    DataSeries    hist;   // the history, no pyramid
+
+    // Counters as of the last stream_poll
+    unsigned long long received;  // samples parsed
+    unsigned long long dropped;   // samples lost to a full ring
+    unsigned long long bad;       // lines that were not numbers
+    unsigned long long unordered; // samples skipped for an x going back
+    bool               ended;     // the source closed or failed
+    double             rate;      // samples per second received
+    double             rate_time;
+    unsigned long long rate_base;
+
+    Arena arena; // owns window
+} DataStream;
+
+// Whether path names a stream source rather than a file
+bool        stream_is_source(const char *path);
+// Start reading source into s. Returns NULL, or why it failed with s left
+// closed.
+const char *stream_open(DataStream *s, const char *source);
+void        stream_close(DataStream *s);
+// Take in what the reader has sent since the last poll; never blocks
+void        stream_poll(DataStream *s);
+
+#endif
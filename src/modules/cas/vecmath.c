@@ -0,0 +1,270 @@
+#include "vecmath.h"
+#include "eval.h"
+#include <math.h>
+#include <float.h>
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(PLATFORM_WEB)
+    #define VECMATH_X86 1
+    #include <immintrin.h>
+#endif
+
+typedef struct {
+    void (*add)(double *, const double *, const double *, size_t);
+    void (*sub)(double *, const double *, const double *, size_t);
+    void (*mul)(double *, const double *, const double *, size_t);
+    void (*div)(double *, const double *, const double *, size_t);
+    void (*neg)(double *, const double *, size_t);
+    void (*powi)(double *, const double *, int, size_t);
+    void (*sin)(double *, const double *, size_t);
+    void (*cos)(double *, const double *, size_t);
+    void (*exp)(double *, const double *, size_t);
+    void (*log)(double *, const double *, size_t);
+} VecKernels;
+
+// x^k by binary powering, the same multiplications the SIMD lanes do
+static double powi_scalar(double x, int k) {
+    unsigned e = (unsigned)(k < 0 ? -k : k);
+    double acc = 1.0;
+    for (unsigned b = e; b; b >>= 1) {
+        if (b & 1) acc *= x;
+        x *= x;
+    }
+    return k < 0 ? 1.0 / acc : acc;
+}
+
+// ---- Scalar fallback (exact libm) ----
+
+static void sc_add(double *out, const double *a, const double *b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = a[i] + b[i];
+}
+static void sc_sub(double *out, const double *a, const double *b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = a[i] - b[i];
+}
+static void sc_mul(double *out, const double *a, const double *b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = a[i] * b[i];
+}
+static void sc_div(double *out, const double *a, const double *b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = b[i] != 0.0 ? a[i] / b[i] : NAN;
+}
+static void sc_neg(double *out, const double *a, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = -a[i];
+}
+static void sc_powi(double *out, const double *a, int k, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = powi_scalar(a[i], k);
+}
+static void sc_sin(double *out, const double *a, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = sin(a[i]);
+}
+static void sc_cos(double *out, const double *a, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = cos(a[i]);
+}
+static void sc_exp(double *out, const double *a, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = exp(a[i]);
+}
+static void sc_log(double *out, const double *a, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = log(a[i]);
+}
+
+static const VecKernels scalar_kernels = {
+    sc_add, sc_sub, sc_mul, sc_div, sc_neg, sc_powi,
+    sc_sin, sc_cos, sc_exp, sc_log,
+};
+
+#ifdef VECMATH_X86
+
+// Constants shared by the SIMD kernels (see vecmath_impl.h)
+#define VM_ROUND_MAGIC  6755399441055744.0          // 1.5 * 2^52
+#define VM_TWO_OVER_PI  6.36619772367581382433e-01
+#define VM_PIO2_1       1.57079632673412561417e+00  // first 33 bits of pi/2
+#define VM_PIO2_2       6.07710050630396597660e-11  // next 33 bits
+#define VM_PIO2_3       2.02226624871116645580e-21  // pi/2 - (PIO2_1 + PIO2_2)
+#define VM_SINCOS_MAX   1e5
+#define VM_S1 -1.66666666666666324348e-01
+#define VM_S2  8.33333333332248946124e-03
+#define VM_S3 -1.98412698298579493134e-04
+#define VM_S4  2.75573137070700676789e-06
+#define VM_S5 -2.50507602534068634195e-08
+#define VM_S6  1.58969099521155010221e-10
+#define VM_C1  4.16666666666666019037e-02
+#define VM_C2 -1.38888888888741095749e-03
+#define VM_C3  2.48015872894767294178e-05
+#define VM_C4 -2.75573143513906633035e-07
+#define VM_C5  2.08757232129817482790e-09
+#define VM_C6 -1.13596475577881948265e-11
+#define VM_LOG2E        1.44269504088896338700e+00
+#define VM_LN2_HI       6.93147180369123816490e-01  // low 32 bits zero
+#define VM_LN2_LO       1.90821492927058770002e-10
+#define VM_EXP_MIN     -708.0
+#define VM_EXP_MAX      709.0
+#define VM_LG1 6.666666666666735130e-01
+#define VM_LG2 3.999999999940941908e-01
+#define VM_LG3 2.857142874366239149e-01
+#define VM_LG4 2.222219843214978396e-01
+#define VM_LG5 1.818357216161805012e-01
+#define VM_LG6 1.531383769920937332e-01
+#define VM_LG7 1.479819860511658591e-01
+
+// ---- SSE2: baseline on x86-64 ----
+#define VT            __m128d
+#define VI            __m128i
+#define VN            2
+#define VFN(name)     sse2_##name
+#define VTARGET
+#define v_load        _mm_loadu_pd
+#define v_store       _mm_storeu_pd
+#define v_set1        _mm_set1_pd
+#define v_add         _mm_add_pd
+#define v_sub         _mm_sub_pd
+#define v_mul         _mm_mul_pd
+#define v_div         _mm_div_pd
+#define v_and         _mm_and_pd
+#define v_or          _mm_or_pd
+#define v_xor         _mm_xor_pd
+#define v_andnot      _mm_andnot_pd
+#define v_cmpneq      _mm_cmpneq_pd
+#define v_cmple       _mm_cmple_pd
+#define v_cmplt       _mm_cmplt_pd
+#define v_cmpge       _mm_cmpge_pd
+#define v_cmpgt       _mm_cmpgt_pd
+#define v_movemask    _mm_movemask_pd
+#define v_as_int      _mm_castpd_si128
+#define v_as_dbl      _mm_castsi128_pd
+#define i_set1        _mm_set1_epi64x
+#define i_add         _mm_add_epi64
+#define i_sub         _mm_sub_epi64
+#define i_and         _mm_and_si128
+#define i_or          _mm_or_si128
+#define i_slli        _mm_slli_epi64
+#define i_srli        _mm_srli_epi64
+#include "vecmath_impl.h"
+#undef VT
+#undef VI
+#undef VN
+#undef VFN
+#undef VTARGET
+#undef v_load
+#undef v_store
+#undef v_set1
+#undef v_add
+#undef v_sub
+#undef v_mul
+#undef v_div
+#undef v_and
+#undef v_or
+#undef v_xor
+#undef v_andnot
+#undef v_cmpneq
+#undef v_cmple
+#undef v_cmplt
+#undef v_cmpge
+#undef v_cmpgt
+#undef v_movemask
+#undef v_as_int
+#undef v_as_dbl
+#undef i_set1
+#undef i_add
+#undef i_sub
+#undef i_and
+#undef i_or
+#undef i_slli
+#undef i_srli
+
+// ---- AVX2: selected at runtime when the CPU supports it ----
+#if defined(__GNUC__) || defined(__clang__)
+#define VECMATH_AVX2 1
+#define VT            __m256d
+#define VI            __m256i
+#define VN            4
+#define VFN(name)     avx2_##name
+#define VTARGET       __attribute__((target("avx2")))
+#define v_load        _mm256_loadu_pd
+#define v_store       _mm256_storeu_pd
+#define v_set1        _mm256_set1_pd
+#define v_add         _mm256_add_pd
+#define v_sub         _mm256_sub_pd
+#define v_mul         _mm256_mul_pd
+#define v_div         _mm256_div_pd
+#define v_and         _mm256_and_pd
+#define v_or          _mm256_or_pd
+#define v_xor         _mm256_xor_pd
+#define v_andnot      _mm256_andnot_pd
+#define v_cmpneq(a, b) _mm256_cmp_pd(a, b, _CMP_NEQ_UQ)
+#define v_cmple(a, b)  _mm256_cmp_pd(a, b, _CMP_LE_OQ)
+#define v_cmplt(a, b)  _mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define v_cmpge(a, b)  _mm256_cmp_pd(a, b, _CMP_GE_OQ)
+#define v_cmpgt(a, b)  _mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#define v_movemask    _mm256_movemask_pd
+#define v_as_int      _mm256_castpd_si256
+#define v_as_dbl      _mm256_castsi256_pd
+#define i_set1        _mm256_set1_epi64x
+#define i_add         _mm256_add_epi64
+#define i_sub         _mm256_sub_epi64
+#define i_and         _mm256_and_si256
+#define i_or          _mm256_or_si256
+#define i_slli        _mm256_slli_epi64
+#define i_srli        _mm256_srli_epi64
+#include "vecmath_impl.h"
+#endif
+
+#endif // VECMATH_X86
+
+static const VecKernels *active_kernels;
+
+static const VecKernels *kernels(void) {
+    if (active_kernels) return active_kernels;
+    const VecKernels *k = &scalar_kernels;
+#ifdef VECMATH_X86
+    k = &sse2_kernels;
+#ifdef VECMATH_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) k = &avx2_kernels;
+#endif
+#endif
+    active_kernels = k;
+    return k;
+}
+
+const char *vecmath_isa(void) {
+    const VecKernels *k = kernels();
+#ifdef VECMATH_X86
+    if (k == &sse2_kernels) return "sse2";
+#ifdef VECMATH_AVX2
+    if (k == &avx2_kernels) return "avx2";
+#endif
+#endif
+    (void)k;
+    return "scalar";
+}
+
+void vecmath_add(double *out, const double *a, const double *b, size_t n) { kernels()->add(out, a, b, n); }
+void vecmath_sub(double *out, const double *a, const double *b, size_t n) { kernels()->sub(out, a, b, n); }
+void vecmath_mul(double *out, const double *a, const double *b, size_t n) { kernels()->mul(out, a, b, n); }
+void vecmath_div(double *out, const double *a, const double *b, size_t n) { kernels()->div(out, a, b, n); }
+void vecmath_neg(double *out, const double *a, size_t n)                  { kernels()->neg(out, a, n); }
+void vecmath_powi(double *out, const double *a, int k, size_t n)          { kernels()->powi(out, a, k, n); }
+void vecmath_sin(double *out, const double *a, size_t n)                  { kernels()->sin(out, a, n); }
+void vecmath_cos(double *out, const double *a, size_t n)                  { kernels()->cos(out, a, n); }
+void vecmath_exp(double *out, const double *a, size_t n)                  { kernels()->exp(out, a, n); }
+void vecmath_log(double *out, const double *a, size_t n)                  { kernels()->log(out, a, n); }
+
+void vecmath_pow(double *out, const double *a, const double *b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = pow(a[i], b[i]);
+}
+
+void vecmath_mod(double *out, const double *a, const double *b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = b[i] != 0.0 ? fmod(a[i], b[i]) : NAN;
+}
+
+void vecmath_func(FuncId id, double *out, const double *a, size_t n) {
+    switch (id) {
+    case FN_SIN: vecmath_sin(out, a, n); return;
+    case FN_COS: vecmath_cos(out, a, n); return;
+    case FN_EXP: vecmath_exp(out, a, n); return;
+    case FN_LN:  vecmath_log(out, a, n); return;
+    default: {
+        EvalFn fn = eval_func_ptr(id);
+        for (size_t i = 0; i < n; i++) out[i] = fn(a[i]);
+        return;
+    }
+    }
+}
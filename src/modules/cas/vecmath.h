@@ -0,0 +1,47 @@
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <stddef.h>
+#include "parser.h"
+
+// Elementwise double-precision kernels for batched evaluation.
+// The best instruction set is picked once at runtime: AVX2 (4 lanes),
+// SSE2 (2 lanes) or plain scalar code (e.g. WASM builds). out may alias
+// any input.
+//
+// Arithmetic (+ - * / neg) is exact IEEE, identical to scalar code.
+// Division by zero yields NAN like eval_ast. The vector sin/cos/exp/log
+// are polynomial approximations with these measured worst-case errors
+// against a long double reference (see vecmath_impl.h):
+//   sin, cos  <= 1.5 ulp for |x| <= 100, <= 2.5 ulp for |x| <= 1e5
+//   exp       <= 1.2 ulp for -708 <= x <= 709
+//   log       <= 1 ulp for normal positive x
+// Lanes outside those ranges (and NAN/INF) fall back to libm, so special
+// values match libm exactly. A lane's result does not depend on n or on
+// its position in the array.
+
+void vecmath_add(double *out, const double *a, const double *b, size_t n);
+void vecmath_sub(double *out, const double *a, const double *b, size_t n);
+void vecmath_mul(double *out, const double *a, const double *b, size_t n);
+void vecmath_div(double *out, const double *a, const double *b, size_t n);
+void vecmath_neg(double *out, const double *a, size_t n);
+
+// pow and fmod go through libm per lane. vecmath_powi is exact repeated
+// multiplication for small integer exponents (at most ~log2(k) ulp apart
+// from pow).
+void vecmath_pow(double *out, const double *a, const double *b, size_t n);
+void vecmath_mod(double *out, const double *a, const double *b, size_t n);
+void vecmath_powi(double *out, const double *a, int k, size_t n);
+
+void vecmath_sin(double *out, const double *a, size_t n);
+void vecmath_cos(double *out, const double *a, size_t n);
+void vecmath_exp(double *out, const double *a, size_t n);
+void vecmath_log(double *out, const double *a, size_t n);
+
+// Apply a built-in function over an array; vectorized where available
+void vecmath_func(FuncId id, double *out, const double *a, size_t n);
+
+// Name of the active kernel set: "avx2", "sse2" or "scalar"
+const char *vecmath_isa(void);
+
+#endif
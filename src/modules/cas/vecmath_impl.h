@@ -0,0 +1,241 @@
+// Kernel template for vecmath.c. Included once per instruction set with
+// these macros defined:
+//   VT, VI        vector of doubles / of 64-bit integers
+//   VN            lanes per vector
+//   VFN(name)     mangles a kernel name for this instruction set
+//   VTARGET       function attribute enabling the instruction set
+//   v_* / i_*     the double / integer operations used below
+//
+// Polynomials follow fdlibm (k_sin.c, k_cos.c, e_log.c); exp uses a
+// degree-13 Taylor series on |r| <= ln2/2 whose truncation error is
+// below 5e-18. Range reduction uses the Cody-Waite split constants.
+// Lanes outside a kernel's valid range are redone with libm from a copy
+// of the input, as out may alias a.
+
+static VTARGET void VFN(add)(double *out, const double *a, const double *b, size_t n) {
+    size_t i = 0;
+    for (; i + VN <= n; i += VN) v_store(out + i, v_add(v_load(a + i), v_load(b + i)));
+    for (; i < n; i++) out[i] = a[i] + b[i];
+}
+
+static VTARGET void VFN(sub)(double *out, const double *a, const double *b, size_t n) {
+    size_t i = 0;
+    for (; i + VN <= n; i += VN) v_store(out + i, v_sub(v_load(a + i), v_load(b + i)));
+    for (; i < n; i++) out[i] = a[i] - b[i];
+}
+
+static VTARGET void VFN(mul)(double *out, const double *a, const double *b, size_t n) {
+    size_t i = 0;
+    for (; i + VN <= n; i += VN) v_store(out + i, v_mul(v_load(a + i), v_load(b + i)));
+    for (; i < n; i++) out[i] = a[i] * b[i];
+}
+
+static VTARGET void VFN(div)(double *out, const double *a, const double *b, size_t n) {
+    const VT zero = v_set1(0.0);
+    const VT nan  = v_set1(NAN);
+    size_t i = 0;
+    for (; i + VN <= n; i += VN) {
+        VT vb = v_load(b + i);
+        VT ok = v_cmpneq(vb, zero); // true for NAN too, like scalar r != 0.0
+        VT q  = v_div(v_load(a + i), vb);
+        v_store(out + i, v_or(v_and(ok, q), v_andnot(ok, nan)));
+    }
+    for (; i < n; i++) out[i] = b[i] != 0.0 ? a[i] / b[i] : NAN;
+}
+
+static VTARGET void VFN(neg)(double *out, const double *a, size_t n) {
+    const VT sign = v_set1(-0.0);
+    size_t i = 0;
+    for (; i + VN <= n; i += VN) v_store(out + i, v_xor(v_load(a + i), sign));
+    for (; i < n; i++) out[i] = -a[i];
+}
+
+static VTARGET void VFN(powi)(double *out, const double *a, int k, size_t n) {
+    unsigned e = (unsigned)(k < 0 ? -k : k);
+    const VT one = v_set1(1.0);
+    size_t i = 0;
+    for (; i + VN <= n; i += VN) {
+        VT base = v_load(a + i);
+        VT acc  = one;
+        for (unsigned b = e; b; b >>= 1) {
+            if (b & 1) acc = v_mul(acc, base);
+            base = v_mul(base, base);
+        }
+        if (k < 0) acc = v_div(one, acc);
+        v_store(out + i, acc);
+    }
+    for (; i < n; i++) out[i] = powi_scalar(a[i], k);
+}
+
+// Shared body of sin and cos: reduce x by multiples of pi/2, evaluate both
+// kernel polynomials and pick/negate per quadrant. cos(x) is sin(x + pi/2),
+// i.e. the same thing with the quadrant advanced by one.
+static inline VTARGET VT VFN(sincos)(VT x, int quadrant_offset) {
+    const VT magic = v_set1(VM_ROUND_MAGIC);
+    VT t = v_add(v_mul(x, v_set1(VM_TWO_OVER_PI)), magic);
+    VT k = v_sub(t, magic);
+    VT r = v_sub(x, v_mul(k, v_set1(VM_PIO2_1)));
+    r = v_sub(r, v_mul(k, v_set1(VM_PIO2_2)));
+    r = v_sub(r, v_mul(k, v_set1(VM_PIO2_3)));
+
+    VT z = v_mul(r, r);
+    VT ps = v_add(v_set1(VM_S5), v_mul(z, v_set1(VM_S6)));
+    ps = v_add(v_set1(VM_S4), v_mul(z, ps));
+    ps = v_add(v_set1(VM_S3), v_mul(z, ps));
+    ps = v_add(v_set1(VM_S2), v_mul(z, ps));
+    ps = v_add(v_set1(VM_S1), v_mul(z, ps));
+    ps = v_add(r, v_mul(v_mul(r, z), ps));
+
+    VT pc = v_add(v_set1(VM_C5), v_mul(z, v_set1(VM_C6)));
+    pc = v_add(v_set1(VM_C4), v_mul(z, pc));
+    pc = v_add(v_set1(VM_C3), v_mul(z, pc));
+    pc = v_add(v_set1(VM_C2), v_mul(z, pc));
+    pc = v_add(v_set1(VM_C1), v_mul(z, pc));
+    // 1 - z/2 + z^2*pc, with the rounding error of 1 - z/2 added back (k_cos.c)
+    VT hz = v_mul(v_set1(0.5), z);
+    VT w  = v_sub(v_set1(1.0), hz);
+    pc = v_add(w, v_add(v_sub(v_sub(v_set1(1.0), w), hz), v_mul(v_mul(z, z), pc)));
+
+    // The low mantissa bits of t hold k as a two's complement integer
+    VI q    = i_add(v_as_int(t), i_set1(quadrant_offset));
+    VT odd  = v_as_dbl(i_sub(i_set1(0), i_and(q, i_set1(1))));
+    VT sign = v_as_dbl(i_slli(i_and(q, i_set1(2)), 62));
+    VT res  = v_or(v_and(odd, pc), v_andnot(odd, ps));
+    return v_xor(res, sign);
+}
+
+// The kernels below compute VN lanes per call; VFN(apply) runs one over
+// an array, sending the last n % VN lanes through a padded copy so every
+// lane gets the same result wherever it sits in the array
+typedef void (*VFN(block_fn))(double *out, const double *a);
+
+static VTARGET void VFN(apply)(VFN(block_fn) blk, double *out, const double *a, size_t n) {
+    size_t i = 0;
+    for (; i + VN <= n; i += VN) blk(out + i, a + i);
+    if (i < n) {
+        double pa[VN], po[VN];
+        for (size_t j = 0; j < VN; j++) pa[j] = a[i + (j < n - i ? j : 0)];
+        blk(po, pa);
+        for (size_t j = 0; j < n - i; j++) out[i + j] = po[j];
+    }
+}
+
+static inline VTARGET void VFN(sincos_block)(double *out, const double *a, int cos_mode) {
+    const VT absmask = v_as_dbl(i_set1(0x7fffffffffffffffLL));
+    const VT limit   = v_set1(VM_SINCOS_MAX);
+    VT x = v_load(a);
+    double xin[VN]; // input lanes, kept since out may alias a
+    v_store(xin, x);
+    VT ok = v_cmple(v_and(x, absmask), limit); // false for NAN/INF
+    v_store(out, VFN(sincos)(x, cos_mode));
+    int bad = v_movemask(ok) ^ ((1 << VN) - 1);
+    for (int j = 0; bad; j++, bad >>= 1) {
+        if (bad & 1) out[j] = cos_mode ? cos(xin[j]) : sin(xin[j]);
+    }
+}
+
+static VTARGET void VFN(sin_block)(double *out, const double *a) { VFN(sincos_block)(out, a, 0); }
+static VTARGET void VFN(cos_block)(double *out, const double *a) { VFN(sincos_block)(out, a, 1); }
+
+static VTARGET void VFN(sin)(double *out, const double *a, size_t n) {
+    VFN(apply)(VFN(sin_block), out, a, n);
+}
+
+static VTARGET void VFN(cos)(double *out, const double *a, size_t n) {
+    VFN(apply)(VFN(cos_block), out, a, n);
+}
+
+static VTARGET void VFN(exp_block)(double *out, const double *a) {
+    const VT magic = v_set1(VM_ROUND_MAGIC);
+    const VT lo    = v_set1(VM_EXP_MIN);
+    const VT hi    = v_set1(VM_EXP_MAX);
+    VT x = v_load(a);
+    double xin[VN]; // input lanes, kept since out may alias a
+    v_store(xin, x);
+    VT ok = v_and(v_cmpge(x, lo), v_cmple(x, hi));
+
+    VT t = v_add(v_mul(x, v_set1(VM_LOG2E)), magic);
+    VT k = v_sub(t, magic);
+    VT r = v_sub(x, v_mul(k, v_set1(VM_LN2_HI)));
+    r = v_sub(r, v_mul(k, v_set1(VM_LN2_LO)));
+
+    // Taylor series 1 + r + r^2/2! + ... + r^13/13!, Horner form
+    VT p = v_set1(1.0 / 6227020800.0);
+    p = v_add(v_set1(1.0 / 479001600.0), v_mul(r, p));
+    p = v_add(v_set1(1.0 / 39916800.0),  v_mul(r, p));
+    p = v_add(v_set1(1.0 / 3628800.0),   v_mul(r, p));
+    p = v_add(v_set1(1.0 / 362880.0),    v_mul(r, p));
+    p = v_add(v_set1(1.0 / 40320.0),     v_mul(r, p));
+    p = v_add(v_set1(1.0 / 5040.0),      v_mul(r, p));
+    p = v_add(v_set1(1.0 / 720.0),       v_mul(r, p));
+    p = v_add(v_set1(1.0 / 120.0),       v_mul(r, p));
+    p = v_add(v_set1(1.0 / 24.0),        v_mul(r, p));
+    p = v_add(v_set1(1.0 / 6.0),         v_mul(r, p));
+    p = v_add(v_set1(0.5),               v_mul(r, p));
+    p = v_add(v_set1(1.0),               v_mul(r, p));
+    p = v_add(v_set1(1.0),               v_mul(r, p));
+
+    // 2^k built directly in the exponent field
+    VT scale = v_as_dbl(i_slli(i_add(v_as_int(t), i_set1(1023)), 52));
+    v_store(out, v_mul(p, scale));
+
+    int bad = v_movemask(ok) ^ ((1 << VN) - 1);
+    for (int j = 0; bad; j++, bad >>= 1) {
+        if (bad & 1) out[j] = exp(xin[j]);
+    }
+}
+
+static VTARGET void VFN(exp)(double *out, const double *a, size_t n) {
+    VFN(apply)(VFN(exp_block), out, a, n);
+}
+
+static VTARGET void VFN(log_block)(double *out, const double *a) {
+    const VT two52   = v_set1(4503599627370496.0);
+    const VT one     = v_set1(1.0);
+    const VT sqrt2   = v_set1(1.41421356237309504880);
+    const VT min_ok  = v_set1(DBL_MIN);
+    const VT inf     = v_set1(INFINITY);
+    const VI mant    = i_set1(0x000fffffffffffffLL);
+    VT x = v_load(a);
+    double xin[VN]; // input lanes, kept since out may alias a
+    v_store(xin, x);
+    VT ok = v_and(v_cmpge(x, min_ok), v_cmplt(x, inf));
+
+    // x = m * 2^e with m in [1, 2); exponent converted via the 2^52 trick
+    VI bits = v_as_int(x);
+    VT e = v_sub(v_as_dbl(i_or(i_srli(bits, 52), v_as_int(two52))), two52);
+    e = v_sub(e, v_set1(1023.0));
+    VT m = v_as_dbl(i_or(i_and(bits, mant), v_as_int(one)));
+
+    // Move m into [sqrt(2)/2, sqrt(2))
+    VT big = v_cmpgt(m, sqrt2);
+    m = v_or(v_and(big, v_mul(m, v_set1(0.5))), v_andnot(big, m));
+    e = v_add(e, v_and(big, one));
+
+    VT f  = v_sub(m, one);
+    VT s  = v_div(f, v_add(v_set1(2.0), f));
+    VT z  = v_mul(s, s);
+    VT w  = v_mul(z, z);
+    VT t1 = v_mul(w, v_add(v_set1(VM_LG2), v_mul(w, v_add(v_set1(VM_LG4), v_mul(w, v_set1(VM_LG6))))));
+    VT t2 = v_mul(z, v_add(v_set1(VM_LG1), v_mul(w, v_add(v_set1(VM_LG3),
+                     v_mul(w, v_add(v_set1(VM_LG5), v_mul(w, v_set1(VM_LG7))))))));
+    VT R    = v_add(t2, t1);
+    VT hfsq = v_mul(v_set1(0.5), v_mul(f, f));
+    VT lo   = v_add(v_mul(s, v_add(hfsq, R)), v_mul(e, v_set1(VM_LN2_LO)));
+    VT res  = v_sub(v_mul(e, v_set1(VM_LN2_HI)), v_sub(v_sub(hfsq, lo), f));
+    v_store(out, res);
+
+    int bad = v_movemask(ok) ^ ((1 << VN) - 1);
+    for (int j = 0; bad; j++, bad >>= 1) {
+        if (bad & 1) out[j] = log(xin[j]);
+    }
+}
+
+static VTARGET void VFN(log)(double *out, const double *a, size_t n) {
+    VFN(apply)(VFN(log_block), out, a, n);
+}
+
+static const VecKernels VFN(kernels) = {
+    VFN(add), VFN(sub), VFN(mul), VFN(div), VFN(neg), VFN(powi),
+    VFN(sin), VFN(cos), VFN(exp), VFN(log),
+};
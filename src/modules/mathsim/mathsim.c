@@ -1,5 +1,7 @@
 #include "mathsim.h"
 #include "../../ui/ui.h"
+#include "../../ui/plotgrid.h"
+#include "../../ui/polyline.h"
 #include "../../ui/theme.h"
 #include <math.h>
 #include <stdio.h>
@@ -44,6 +46,7 @@ static int   math_mode = MATH_PARAM;
 static int   param_idx = 0;
 static int   polar_idx = 0;
 static float zoom = 1.0f;
+static PlotGrid grid;
 
 static void math_layout(Rectangle area, Rectangle *panel, Rectangle *plot, bool *side_by_side) {
     float aspect = (float)GetScreenWidth() / (float)GetScreenHeight();
@@ -70,62 +73,6 @@ static Vector2 math_to_screen(Rectangle area, float scale, float x, float y) {
     };
 }
 
-static float nice_step(float raw) {
-    if (raw <= 0.0f) return 1.0f;
-    float mag = powf(10.0f, floorf(log10f(raw)));
-    float norm = raw / mag;
-    if (norm < 2.0f) return 2.0f * mag;
-    if (norm < 5.0f) return 5.0f * mag;
-    return 10.0f * mag;
-}
-
-static void draw_grid(Rectangle area, float scale) {
-    float raw_step = 60.0f / scale;
-    float step = nice_step(raw_step);
-
-    float x_min = -(area.width / 2.0f) / scale;
-    float x_max =  (area.width / 2.0f) / scale;
-    float y_min = -(area.height / 2.0f) / scale;
-    float y_max =  (area.height / 2.0f) / scale;
-
-    float sub_step = step / 5.0f;
-    Color sub_col = (Color){42, 44, 50, 255};
-
-    float sx_start = floorf(x_min / sub_step) * sub_step;
-    for (float gx = sx_start; gx <= x_max; gx += sub_step) {
-        Vector2 top = math_to_screen(area, scale, gx, y_max);
-        Vector2 bot = math_to_screen(area, scale, gx, y_min);
-        DrawLineV(top, bot, sub_col);
-    }
-    float sy_start = floorf(y_min / sub_step) * sub_step;
-    for (float gy = sy_start; gy <= y_max; gy += sub_step) {
-        Vector2 left  = math_to_screen(area, scale, x_min, gy);
-        Vector2 right = math_to_screen(area, scale, x_max, gy);
-        DrawLineV(left, right, sub_col);
-    }
-
-    float x_start = floorf(x_min / step) * step;
-    for (float gx = x_start; gx <= x_max; gx += step) {
-        Vector2 top = math_to_screen(area, scale, gx, y_max);
-        Vector2 bot = math_to_screen(area, scale, gx, y_min);
-        DrawLineV(top, bot, COL_GRID);
-    }
-    float y_start = floorf(y_min / step) * step;
-    for (float gy = y_start; gy <= y_max; gy += step) {
-        Vector2 left  = math_to_screen(area, scale, x_min, gy);
-        Vector2 right = math_to_screen(area, scale, x_max, gy);
-        DrawLineV(left, right, COL_GRID);
-    }
-
-    // Axes
-    Vector2 ax1 = math_to_screen(area, scale, x_min, 0);
-    Vector2 ax2 = math_to_screen(area, scale, x_max, 0);
-    Vector2 ay1 = math_to_screen(area, scale, 0, y_min);
-    Vector2 ay2 = math_to_screen(area, scale, 0, y_max);
-    DrawLineV(ax1, ax2, COL_AXIS);
-    DrawLineV(ay1, ay2, COL_AXIS);
-}
-
 static void eval_param(int idx, float t, float *x, float *y) {
     switch (idx) {
         case 0: *x = cosf(t); *y = sinf(t); break;
@@ -183,6 +130,7 @@ static void mathsim_init(void) {
     param_idx = 0;
     polar_idx = 0;
     zoom = 1.0f;
+    grid.axis_width = 1.0f;
 }
 
 static void mathsim_update(Rectangle area) {
@@ -287,40 +235,42 @@ static void mathsim_draw(Rectangle area) {
     float base = fminf(plot.width, plot.height) * 0.4f;
     float scale = (base / 5.0f) * zoom;
 
-    draw_grid(plot, scale);
+    ui_plot_grid_draw(&grid, plot, 0.0, 0.0, scale);
 
-    // Draw curve
-    Vector2 prev = {0};
-    bool has_prev = false;
+    // Draw curve as one polyline, as thin as its lines always were, broken
+    // where it is undefined
+    ui_polyline_begin(1.0f, COL_ACCENT2);
     if (math_mode == MATH_PARAM) {
         const ParamPreset *p = &param_presets[param_idx];
         for (float t = p->tmin; t <= p->tmax; t += p->step) {
             float x, y;
             eval_param(param_idx, t, &x, &y);
-            Vector2 sp = math_to_screen(plot, scale, x, y);
-            if (has_prev) DrawLineV(prev, sp, COL_ACCENT2);
-            prev = sp;
-            has_prev = true;
+            if (!isfinite(x) || !isfinite(y)) {
+                ui_polyline_break();
+                continue;
+            }
+            ui_polyline_point(math_to_screen(plot, scale, x, y));
         }
     } else {
         const PolarPreset *p = &polar_presets[polar_idx];
         for (float t = p->tmin; t <= p->tmax; t += p->step) {
             float r = eval_polar(polar_idx, t);
-            if (!isfinite(r)) continue;
+            if (!isfinite(r)) {
+                ui_polyline_break();
+                continue;
+            }
             float x = r * cosf(t);
             float y = r * sinf(t);
-            Vector2 sp = math_to_screen(plot, scale, x, y);
-            if (has_prev) DrawLineV(prev, sp, COL_ACCENT2);
-            prev = sp;
-            has_prev = true;
+            ui_polyline_point(math_to_screen(plot, scale, x, y));
         }
     }
+    ui_polyline_end();
 
     EndScissorMode();
 }
 
 static void mathsim_cleanup(void) {
-    // Nothing to free
+    ui_plot_grid_free(&grid);
 }
 
 static Module mathsim_mod = {
@@ -0,0 +1,207 @@
+#include "arrows.h"
+#include "rlgl.h"
+#include <math.h>
+#include <string.h>
+
+#define SIDES 6 // around a 3D arrow
+
+// The instance transform's m3, row 3 of its first column, holds the
+// magnitude; the shader reads it and puts the 0 back. Surfaces are lit as
+// in the 3D plotter; flat arrows have no normals and are not.
+#if defined(PLATFORM_WEB)
+static const char *ARROW_VS =
+    "#version 100\n"
+    "attribute vec3 vertexPosition;\n"
+    "attribute vec3 vertexNormal;\n"
+    "attribute mat4 instanceTransform;\n"
+    "uniform mat4 mvp;\n"
+    "varying float shade;\n"
+    "void main() {\n"
+    "    mat4 t = instanceTransform;\n"
+    "    float mag = t[0][3];\n"
+    "    t[0][3] = 0.0;\n"
+    "    vec3 n = (t * vec4(vertexNormal, 0.0)).xyz;\n"
+    "    float lit = dot(n, n) > 0.0\n"
+    "        ? 0.35 + 0.65 * abs(dot(normalize(n), vec3(0.40, 0.82, 0.41))) : 1.0;\n"
+    "    shade = lit * (0.35 + 0.65 * mag);\n"
+    "    gl_Position = mvp * t * vec4(vertexPosition, 1.0);\n"
+    "}\n";
+static const char *ARROW_FS =
+    "#version 100\n"
+    "precision mediump float;\n"
+    "varying float shade;\n"
+    "uniform vec4 colDiffuse;\n"
+    "void main() {\n"
+    "    gl_FragColor = vec4(colDiffuse.rgb * shade, colDiffuse.a);\n"
+    "}\n";
+#else
+static const char *ARROW_VS =
+    "#version 330\n"
+    "in vec3 vertexPosition;\n"
+    "in vec3 vertexNormal;\n"
+    "in mat4 instanceTransform;\n"
+    "uniform mat4 mvp;\n"
+    "out float shade;\n"
+    "void main() {\n"
+    "    mat4 t = instanceTransform;\n"
+    "    float mag = t[0][3];\n"
+    "    t[0][3] = 0.0;\n"
+    "    vec3 n = (t * vec4(vertexNormal, 0.0)).xyz;\n"
+    "    float lit = dot(n, n) > 0.0\n"
+    "        ? 0.35 + 0.65 * abs(dot(normalize(n), vec3(0.40, 0.82, 0.41))) : 1.0;\n"
+    "    shade = lit * (0.35 + 0.65 * mag);\n"
+    "    gl_Position = mvp * t * vec4(vertexPosition, 1.0);\n"
+    "}\n";
+static const char *ARROW_FS =
+    "#version 330\n"
+    "in float shade;\n"
+    "uniform vec4 colDiffuse;\n"
+    "out vec4 finalColor;\n"
+    "void main() {\n"
+    "    finalColor = vec4(colDiffuse.rgb * shade, colDiffuse.a);\n"
+    "}\n";
+#endif
+
+static struct {
+    bool     loaded;
+    bool     instanced; // the shader compiled; else one DrawMesh per arrow
+    Material material;
+    Mesh     flat, solid;
+} ar;
+
+Matrix ui_arrow_place(Vector3 at, Vector3 dir, float length, float mag) {
+    float dl = sqrtf(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+    Vector3 d = dl > 0.0f ? (Vector3){ dir.x / dl, dir.y / dl, dir.z / dl } : (Vector3){ 1, 0, 0 };
+    // Across the arrow in the x-y plane, so flat arrows lie in it
+    float sl = sqrtf(d.x * d.x + d.y * d.y);
+    Vector3 s = sl > 1e-6f ? (Vector3){ -d.y / sl, d.x / sl, 0 } : (Vector3){ 1, 0, 0 };
+    Vector3 u = { d.y * s.z - d.z * s.y, d.z * s.x - d.x * s.z, d.x * s.y - d.y * s.x };
+    return (Matrix){
+        .m0 = d.x * length, .m4 = s.x * length, .m8  = u.x * length, .m12 = at.x,
+        .m1 = d.y * length, .m5 = s.y * length, .m9  = u.y * length, .m13 = at.y,
+        .m2 = d.z * length, .m6 = s.z * length, .m10 = u.z * length, .m14 = at.z,
+        .m3 = mag,          .m7 = 0.0f,         .m11 = 0.0f,         .m15 = 1.0f,
+    };
+}
+
+static Mesh alloc_mesh(int vertex_count, int triangle_count) {
+    Mesh m = {0};
+    m.vertexCount   = vertex_count;
+    m.triangleCount = triangle_count;
+    m.vertices = MemAlloc(vertex_count * 3 * sizeof(float));
+    m.normals  = MemAlloc(vertex_count * 3 * sizeof(float));
+    m.indices  = MemAlloc(triangle_count * 3 * sizeof(unsigned short));
+    if (m.normals) memset(m.normals, 0, vertex_count * 3 * sizeof(float));
+    return m;
+}
+
+static void set3(float *dst, int i, float x, float y, float z) {
+    dst[3 * i]     = x;
+    dst[3 * i + 1] = y;
+    dst[3 * i + 2] = z;
+}
+
+// Shaft and head as three triangles, no normals
+static Mesh flat_arrow(void) {
+    static const float V[7][2] = {
+        { -0.5f, -0.06f }, { 0.1f, -0.06f }, { 0.1f, 0.06f }, { -0.5f, 0.06f },
+        { 0.1f, -0.22f }, { 0.5f, 0.0f }, { 0.1f, 0.22f },
+    };
+    static const unsigned short I[9] = { 0, 1, 2, 0, 2, 3, 4, 5, 6 };
+    Mesh m = alloc_mesh(7, 3);
+    if (!m.vertices || !m.normals || !m.indices) return m;
+    for (int i = 0; i < 7; i++) set3(m.vertices, i, V[i][0], V[i][1], 0.0f);
+    memcpy(m.indices, I, sizeof(I));
+    return m;
+}
+
+// A prism shaft and a cone head with its base, smooth around
+static Mesh solid_arrow(void) {
+    const float SHAFT_R = 0.05f, HEAD_R = 0.16f, NECK = 0.1f;
+    // Rings: shaft tail, shaft neck, head base, tips, then the base disk
+    Mesh m = alloc_mesh(5 * SIDES + 1, 4 * SIDES);
+    if (!m.vertices || !m.normals || !m.indices) return m;
+    float nl = sqrtf(HEAD_R * HEAD_R + (0.5f - NECK) * (0.5f - NECK));
+    float cn = HEAD_R / nl, cr = (0.5f - NECK) / nl; // cone normal, along and out
+    for (int s = 0; s < SIDES; s++) {
+        float a = 6.28318531f * s / SIDES, c = cosf(a), sn = sinf(a);
+        float am = 6.28318531f * (s + 0.5f) / SIDES; // tip normals, mid-face
+        set3(m.vertices, s, -0.5f, SHAFT_R * c, SHAFT_R * sn);
+        set3(m.normals, s, 0.0f, c, sn);
+        set3(m.vertices, SIDES + s, NECK, SHAFT_R * c, SHAFT_R * sn);
+        set3(m.normals, SIDES + s, 0.0f, c, sn);
+        set3(m.vertices, 2 * SIDES + s, NECK, HEAD_R * c, HEAD_R * sn);
+        set3(m.normals, 2 * SIDES + s, cn, cr * c, cr * sn);
+        set3(m.vertices, 3 * SIDES + s, 0.5f, 0.0f, 0.0f);
+        set3(m.normals, 3 * SIDES + s, cn, cr * cosf(am), cr * sinf(am));
+        set3(m.vertices, 4 * SIDES + s, NECK, HEAD_R * c, HEAD_R * sn);
+        set3(m.normals, 4 * SIDES + s, -1.0f, 0.0f, 0.0f);
+    }
+    set3(m.vertices, 5 * SIDES, NECK, 0.0f, 0.0f);
+    set3(m.normals, 5 * SIDES, -1.0f, 0.0f, 0.0f);
+
+    unsigned short *ix = m.indices;
+    for (int s = 0; s < SIDES; s++) {
+        unsigned short a = (unsigned short)s, b = (unsigned short)((s + 1) % SIDES);
+        unsigned short t[12] = {
+            a, b, (unsigned short)(SIDES + b), a, (unsigned short)(SIDES + b), (unsigned short)(SIDES + a),
+            (unsigned short)(2 * SIDES + a), (unsigned short)(2 * SIDES + b), (unsigned short)(3 * SIDES + a),
+            (unsigned short)(5 * SIDES), (unsigned short)(4 * SIDES + b), (unsigned short)(4 * SIDES + a),
+        };
+        memcpy(ix, t, sizeof(t));
+        ix += 12;
+    }
+    return m;
+}
+
+static void load(void) {
+    ar.loaded   = true;
+    ar.material = LoadMaterialDefault();
+    Shader sh = LoadShaderFromMemory(ARROW_VS, ARROW_FS);
+    ar.instanced = sh.id != 0 && sh.id != rlGetShaderIdDefault();
+    if (ar.instanced) {
+        sh.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(sh, "instanceTransform");
+        ar.material.shader = sh;
+    }
+    ar.flat  = flat_arrow();
+    ar.solid = solid_arrow();
+    if (ar.flat.indices) UploadMesh(&ar.flat, false);
+    if (ar.solid.indices) UploadMesh(&ar.solid, false);
+}
+
+static void draw(Mesh mesh, const Matrix *arrows, int count, Color color) {
+    if (count <= 0 || !mesh.indices) return;
+    // Meshes skip raylib's batch: send what it holds first, to keep the order
+    rlDrawRenderBatchActive();
+    ar.material.maps[MATERIAL_MAP_DIFFUSE].color = color;
+    rlDisableBackfaceCulling();
+    if (ar.instanced) {
+        DrawMeshInstanced(mesh, ar.material, arrows, count);
+    } else {
+        for (int i = 0; i < count; i++) {
+            Matrix m = arrows[i];
+            m.m3 = 0.0f;
+            DrawMesh(mesh, ar.material, m);
+        }
+    }
+    rlEnableBackfaceCulling();
+}
+
+void ui_arrows_draw_2d(const Matrix *arrows, int count, Color color) {
+    if (!ar.loaded) load();
+    draw(ar.flat, arrows, count, color);
+}
+
+void ui_arrows_draw_3d(const Matrix *arrows, int count, Color color) {
+    if (!ar.loaded) load();
+    draw(ar.solid, arrows, count, color);
+}
+
+void ui_arrows_unload(void) {
+    if (!ar.loaded) return;
+    UnloadMesh(ar.flat);
+    UnloadMesh(ar.solid);
+    // The default material's maps, and the shader unless it is raylib's own
+    UnloadMaterial(ar.material);
+    memset(&ar, 0, sizeof(ar));
+}
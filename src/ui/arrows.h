@@ -0,0 +1,22 @@
+#ifndef ARROWS_H
+#define ARROWS_H
+
+#include "raylib.h"
+
+// Arrows by the thousand, each list drawn in one instanced call. An arrow
+// is a unit arrow along +x, from -0.5 to 0.5 about its middle, placed by
+// the transform ui_arrow_place makes; its magnitude rides along in the
+// transform and dims the arrow's colour from full (1) to a third (0).
+//
+//   arrows[i] = ui_arrow_place(at, dir, len, mag);
+//   ui_arrows_draw_2d(arrows, n, col); // inside BeginMode2D
+Matrix ui_arrow_place(Vector3 at, Vector3 dir, float length, float mag);
+
+// Flat arrows in the x-y plane; dir must lie in it
+void ui_arrows_draw_2d(const Matrix *arrows, int count, Color color);
+// Solid arrows, lit, both faces drawn
+void ui_arrows_draw_3d(const Matrix *arrows, int count, Color color);
+
+void ui_arrows_unload(void);
+
+#endif
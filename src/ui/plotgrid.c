@@ -0,0 +1,161 @@
+#include "plotgrid.h"
+#include "ui.h"
+#include "theme.h"
+#include "rlgl.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LABEL_CACHE_SIZE 128 // direct-mapped by value
+
+// Tick values formatted so far. Panning keeps the step, so most labels of
+// a rebuild were formatted for an earlier one.
+static struct {
+    double value;
+    bool   used;
+    char   text[PLOT_GRID_LABEL_LEN];
+} label_cache[LABEL_CACHE_SIZE];
+
+static const char *format_label(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    int h = (int)((bits * 0x9E3779B97F4A7C15ull) >> 57);
+    if (!label_cache[h].used || label_cache[h].value != v) {
+        snprintf(label_cache[h].text, sizeof(label_cache[h].text), "%.4g", v);
+        label_cache[h].value = v;
+        label_cache[h].used  = true;
+    }
+    return label_cache[h].text;
+}
+
+// Major grid step: 1, 2 or 5 times a power of ten, at least 60 px
+static double grid_step(double scale) {
+    double raw_step = 60.0 / scale;
+    double mag = pow(10.0, floor(log10(raw_step)));
+    double norm = raw_step / mag;
+    if (norm < 2.0) return 2.0 * mag;
+    if (norm < 5.0) return 5.0 * mag;
+    return 10.0 * mag;
+}
+
+static Vector2 to_screen(const PlotGrid *g, double mx, double my) {
+    return (Vector2){
+        (float)(g->area.x + g->area.width  / 2.0 + (mx - g->center_x) * g->scale),
+        (float)(g->area.y + g->area.height / 2.0 - (my - g->center_y) * g->scale)
+    };
+}
+
+// Multiples of step in [lo, hi], with one to spare for rounding
+static int ticks(double lo, double hi, double step) {
+    return (int)(floor(hi / step) - floor(lo / step)) + 2;
+}
+
+// Vertical then horizontal lines every step across the view into the
+// arena; *v is NULL if there is no room
+static int add_lines(PlotGrid *g, Vector2 **v, double step,
+                     double x_min, double x_max, double y_min, double y_max) {
+    int cap = 2 * (ticks(x_min, x_max, step) + ticks(y_min, y_max, step));
+    *v = arena_alloc(&g->arena, (size_t)cap * sizeof(Vector2));
+    if (!*v) return 0;
+    int n = 0;
+    for (long long k = (long long)floor(x_min / step); k * step <= x_max && n < cap; k++) {
+        (*v)[n++] = to_screen(g, k * step, y_max);
+        (*v)[n++] = to_screen(g, k * step, y_min);
+    }
+    for (long long k = (long long)floor(y_min / step); k * step <= y_max && n < cap; k++) {
+        (*v)[n++] = to_screen(g, x_min, k * step);
+        (*v)[n++] = to_screen(g, x_max, k * step);
+    }
+    return n;
+}
+
+static void add_label(PlotGrid *g, int cap, double v, float x, float y) {
+    if (g->label_count >= cap) return;
+    PlotGridLabel *l = &g->label[g->label_count++];
+    l->pos = (Vector2){ x, y };
+    memcpy(l->text, format_label(v), sizeof(l->text));
+}
+
+static void build(PlotGrid *g) {
+    Rectangle area = g->area;
+    double step = grid_step(g->scale);
+    double x_min = g->center_x - (area.width / 2.0) / g->scale;
+    double x_max = g->center_x + (area.width / 2.0) / g->scale;
+    double y_min = g->center_y - (area.height / 2.0) / g->scale;
+    double y_max = g->center_y + (area.height / 2.0) / g->scale;
+
+    // Sized by the view: a wide one has more lines than any fixed count
+    if (!g->arena.stats) g->arena = arena_create_ex(ARENA_DEFAULT_CAP, 0, "grid");
+    arena_reset(&g->arena);
+    g->sub_count   = add_lines(g, &g->sub, step / 5.0, x_min, x_max, y_min, y_max);
+    g->major_count = add_lines(g, &g->major, step, x_min, x_max, y_min, y_max);
+    g->axes[0] = to_screen(g, x_min, 0);
+    g->axes[1] = to_screen(g, x_max, 0);
+    g->axes[2] = to_screen(g, 0, y_max);
+    g->axes[3] = to_screen(g, 0, y_min);
+    g->origin  = to_screen(g, 0, 0);
+
+    g->label_count = 0;
+    if (!g->labels) return;
+    int cap  = ticks(x_min, x_max, step) + ticks(y_min, y_max, step);
+    g->label = arena_alloc(&g->arena, (size_t)cap * sizeof(PlotGridLabel));
+    if (!g->label) return;
+    // x labels under the axis, clamped to the plot area
+    for (long long k = (long long)floor(x_min / step); k * step <= x_max; k++) {
+        Vector2 axis_pos = to_screen(g, k * step, 0);
+        float ly = axis_pos.y + 4;
+        if (ly < area.y + 2) ly = area.y + 2;
+        if (ly > area.y + area.height - 16) ly = area.y + area.height - 16;
+        add_label(g, cap, k * step, axis_pos.x + 4, ly);
+    }
+    // y labels beside it, all but the origin's
+    for (long long k = (long long)floor(y_min / step); k * step <= y_max; k++) {
+        if (k == 0) continue;
+        Vector2 axis_pos = to_screen(g, 0, k * step);
+        float lx = axis_pos.x + 4;
+        if (lx < area.x + 2) lx = area.x + 2;
+        add_label(g, cap, k * step, lx, axis_pos.y - 14);
+    }
+}
+
+static void draw_lines(const Vector2 *v, int n, Color col) {
+    rlBegin(RL_LINES);
+    rlColor4ub(col.r, col.g, col.b, col.a);
+    for (int i = 0; i < n; i++) rlVertex2f(v[i].x, v[i].y);
+    rlEnd();
+}
+
+void ui_plot_grid_draw(PlotGrid *g, Rectangle area, double center_x, double center_y,
+                       double scale) {
+    if (!g->built || g->center_x != center_x || g->center_y != center_y || g->scale != scale ||
+        g->area.x != area.x || g->area.y != area.y ||
+        g->area.width != area.width || g->area.height != area.height) {
+        g->area     = area;
+        g->center_x = center_x;
+        g->center_y = center_y;
+        g->scale    = scale;
+        build(g);
+        g->built = true;
+    }
+
+    draw_lines(g->sub, g->sub_count, (Color){42, 44, 50, 255});
+    draw_lines(g->major, g->major_count, COL_GRID);
+    for (int i = 0; i < g->label_count; i++)
+        ui_draw_text(g->label[i].text, (int)g->label[i].pos.x, (int)g->label[i].pos.y,
+                     FONT_SIZE_TINY, COL_TEXT_DIM);
+
+    if (g->axis_width > 1.0f) {
+        DrawLineEx(g->axes[0], g->axes[1], g->axis_width, COL_AXIS);
+        DrawLineEx(g->axes[2], g->axes[3], g->axis_width, COL_AXIS);
+    } else {
+        DrawLineV(g->axes[0], g->axes[1], COL_AXIS);
+        DrawLineV(g->axes[2], g->axes[3], COL_AXIS);
+    }
+    if (g->labels) DrawCircleV(g->origin, 3.0f, COL_AXIS);
+}
+
+void ui_plot_grid_free(PlotGrid *g) {
+    arena_destroy(&g->arena);
+    g->built = false;
+}
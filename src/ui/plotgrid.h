@@ -0,0 +1,47 @@
+#ifndef PLOTGRID_H
+#define PLOTGRID_H
+
+#include "raylib.h"
+#include "../utils/arena.h"
+#include <stdbool.h>
+
+#define PLOT_GRID_LABEL_LEN 16
+
+typedef struct {
+    Vector2 pos;
+    char    text[PLOT_GRID_LABEL_LEN];
+} PlotGridLabel;
+
+// Grid, axes and tick labels of a 2D plot, kept as ready-to-draw vertices
+// and strings. They are rebuilt only when the view changes, so a still
+// frame does no layout or formatting.
+typedef struct {
+    bool      labels;     // draw tick labels and the origin marker
+    float     axis_width; // px; hairlines at 1 or less
+
+    // View the layer was built for
+    bool      built;
+    Rectangle area;
+    double    center_x, center_y, scale;
+
+    // Line segments as vertex pairs, as many as the view needs
+    Vector2  *sub, *major;
+    int       sub_count, major_count; // vertices
+    Vector2   axes[4];
+    Vector2   origin;
+
+    PlotGridLabel *label;
+    int            label_count;
+
+    Arena     arena; // owns sub, major and label; reset on every rebuild
+} PlotGrid;
+
+// Draw g for a view of area centred on (center_x, center_y) with scale
+// pixels per unit, rebuilding it first if the view changed. Does not
+// scissor; the caller clips to area.
+void ui_plot_grid_draw(PlotGrid *g, Rectangle area, double center_x, double center_y,
+                       double scale);
+// Free g's buffers; it is rebuilt on its next draw
+void ui_plot_grid_free(PlotGrid *g);
+
+#endif
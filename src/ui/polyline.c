@@ -0,0 +1,78 @@
+#include "polyline.h"
+#include <math.h>
+
+#define POLYLINE_MAX_POINTS  4096 // per run; a longer run is split
+#define POLYLINE_MITER_LIMIT 2.0f // longest miter, in half widths
+
+static struct {
+    Vector2 pts[POLYLINE_MAX_POINTS];
+    Vector2 verts[4 * POLYLINE_MAX_POINTS]; // 2 per point, 4 at a bevel
+    int     count;
+    float   half_w;
+    Color   color;
+} pl;
+
+static Vector2 unit_normal(Vector2 a, Vector2 b) {
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float len = sqrtf(dx * dx + dy * dy);
+    return (Vector2){ -dy / len, dx / len };
+}
+
+// Draw the current run as one strip: two vertices per point, either side
+// of the line, in the winding raylib draws front-facing
+static void flush_run(void) {
+    if (pl.count >= 2) {
+        float h = pl.half_w;
+        int nv = 0;
+        Vector2 n_prev = unit_normal(pl.pts[0], pl.pts[1]);
+        for (int i = 0; i < pl.count; i++) {
+            Vector2 p = pl.pts[i];
+            Vector2 n_next = (i + 1 < pl.count) ? unit_normal(p, pl.pts[i + 1]) : n_prev;
+            // m = n_prev + n_next has length 2 cos(turn / 2); the miter is
+            // h / cos(turn / 2) long along it
+            Vector2 m = { n_prev.x + n_next.x, n_prev.y + n_next.y };
+            float mm = m.x * m.x + m.y * m.y;
+            if (mm >= 4.0f / (POLYLINE_MITER_LIMIT * POLYLINE_MITER_LIMIT)) {
+                float s = 2.0f * h / mm;
+                pl.verts[nv++] = (Vector2){ p.x - m.x * s, p.y - m.y * s };
+                pl.verts[nv++] = (Vector2){ p.x + m.x * s, p.y + m.y * s };
+            } else {
+                pl.verts[nv++] = (Vector2){ p.x - n_prev.x * h, p.y - n_prev.y * h };
+                pl.verts[nv++] = (Vector2){ p.x + n_prev.x * h, p.y + n_prev.y * h };
+                pl.verts[nv++] = (Vector2){ p.x - n_next.x * h, p.y - n_next.y * h };
+                pl.verts[nv++] = (Vector2){ p.x + n_next.x * h, p.y + n_next.y * h };
+            }
+            n_prev = n_next;
+        }
+        DrawTriangleStrip(pl.verts, nv, pl.color);
+    }
+    pl.count = 0;
+}
+
+void ui_polyline_begin(float width, Color color) {
+    pl.count  = 0;
+    pl.half_w = width * 0.5f;
+    pl.color  = color;
+}
+
+void ui_polyline_point(Vector2 p) {
+    if (pl.count > 0) {
+        // Repeated points have no direction to offset along
+        Vector2 q = pl.pts[pl.count - 1];
+        if (fabsf(p.x - q.x) < 1e-3f && fabsf(p.y - q.y) < 1e-3f) return;
+    }
+    if (pl.count == POLYLINE_MAX_POINTS) {
+        Vector2 last = pl.pts[pl.count - 1];
+        flush_run();
+        pl.pts[pl.count++] = last;
+    }
+    pl.pts[pl.count++] = p;
+}
+
+void ui_polyline_break(void) {
+    flush_run();
+}
+
+void ui_polyline_end(void) {
+    flush_run();
+}
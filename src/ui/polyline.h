@@ -0,0 +1,18 @@
+#ifndef POLYLINE_H
+#define POLYLINE_H
+
+#include "raylib.h"
+
+// Thick polylines. Each unbroken run of points becomes one triangle strip,
+// mitred at the joins and bevelled where the turn is too sharp for a
+// miter, and goes to raylib's batch in one call when the run ends.
+//
+//   ui_polyline_begin(2.5f, col);
+//   for (...) isnan(y) ? ui_polyline_break() : ui_polyline_point(p);
+//   ui_polyline_end();
+void ui_polyline_begin(float width, Color color);
+void ui_polyline_point(Vector2 p);
+void ui_polyline_break(void); // the next point starts a new run
+void ui_polyline_end(void);
+
+#endif
@@ -1,31 +1,171 @@
 #include "arena.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
-Arena arena_create(size_t cap) {
-    Arena a;
-    a.buf  = malloc(cap);
-    a.cap  = cap;
-    a.used = 0;
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t      cap;
+    size_t      offset; // bytes used in this block
+};
+
+// Block data starts after the header, 16-byte aligned like malloc's
+#define BLOCK_HEADER ((sizeof(ArenaBlock) + 15) & ~(size_t)15)
+
+static char *block_data(ArenaBlock *b) {
+    return (char *)b + BLOCK_HEADER;
+}
+
+// ---- Per-owner statistics ----
+
+// Entries below owner_count are complete and never change owner; adding
+// one takes owners_lock, and publishes it by the store to owner_count
+static ArenaStats  owners[ARENA_MAX_OWNERS];
+static atomic_int  owner_count;
+static atomic_flag owners_lock = ATOMIC_FLAG_INIT;
+
+static ArenaStats *find_owner(const char *owner, int count) {
+    for (int i = 0; i < count; i++)
+        if (strcmp(owners[i].owner, owner) == 0) return &owners[i];
+    return NULL;
+}
+
+// owner must be a string that lives for the whole run (a literal)
+static ArenaStats *owner_stats(const char *owner) {
+    if (!owner) return NULL;
+    ArenaStats *s = find_owner(owner, atomic_load_explicit(&owner_count, memory_order_acquire));
+    if (s) return s;
+
+    while (atomic_flag_test_and_set_explicit(&owners_lock, memory_order_acquire)) {}
+    int count = atomic_load_explicit(&owner_count, memory_order_relaxed);
+    s = find_owner(owner, count);
+    if (!s && count < ARENA_MAX_OWNERS) {
+        s = &owners[count];
+        s->owner = owner;
+        atomic_store_explicit(&owner_count, count + 1, memory_order_release);
+    }
+    atomic_flag_clear_explicit(&owners_lock, memory_order_release);
+    return s;
+}
+
+const ArenaStats *arena_stats(const char *owner) {
+    return find_owner(owner, arena_stats_count());
+}
+
+int arena_stats_count(void) {
+    return atomic_load_explicit(&owner_count, memory_order_acquire);
+}
+
+const ArenaStats *arena_stats_at(int i) {
+    return (i >= 0 && i < arena_stats_count()) ? &owners[i] : NULL;
+}
+
+// Move a's usage to new_used, keeping its owner's counters in step. Other
+// arenas of the owner may be moving them too, so in_use moves by the
+// difference and high_water is raised only past what it holds.
+static void set_used(Arena *a, size_t new_used) {
+    if (a->stats) {
+        size_t in_use = atomic_fetch_add_explicit(&a->stats->in_use, new_used - a->used,
+                                                  memory_order_relaxed) + (new_used - a->used);
+        size_t peak = atomic_load_explicit(&a->stats->high_water, memory_order_relaxed);
+        while (in_use > peak &&
+               !atomic_compare_exchange_weak_explicit(&a->stats->high_water, &peak, in_use,
+                                                      memory_order_relaxed, memory_order_relaxed)) {}
+    }
+    a->used = new_used;
+    if (a->used > a->high_water) a->high_water = a->used;
+}
+
+// ---- Arena ----
+
+Arena arena_create_ex(size_t block_cap, size_t align, const char *owner) {
+    Arena a = {0};
+    a.block_cap = block_cap;
+    a.align     = align;
+    a.stats     = owner_stats(owner);
     return a;
 }
 
+Arena arena_create(size_t cap) {
+    return arena_create_ex(cap, 0, NULL);
+}
+
+void *arena_alloc_aligned(Arena *a, size_t size, size_t align) {
+    if (align == 0) align = a->align ? a->align : ARENA_DEFAULT_ALIGN;
+    if (align & (align - 1)) return NULL;
+
+    // The current block, then the free blocks after it (left over from
+    // before a reset or rewind)
+    ArenaBlock *b = a->cur ? a->cur : a->head;
+    while (b) {
+        uintptr_t base = (uintptr_t)block_data(b);
+        size_t off = (size_t)(((base + b->offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+        if (off <= b->cap && size <= b->cap - off) {
+            set_used(a, a->used + (off + size - b->offset));
+            b->offset = off + size;
+            a->cur = b;
+            if (a->stats) atomic_fetch_add_explicit(&a->stats->allocs, 1, memory_order_relaxed);
+            return block_data(b) + off;
+        }
+        if (!b->next) break;
+        b = b->next;
+        b->offset = 0;
+    }
+
+    // Chain on a new block, big enough for this request
+    size_t cap = a->block_cap ? a->block_cap : ARENA_DEFAULT_CAP;
+    if (size > SIZE_MAX - align - BLOCK_HEADER) return NULL;
+    if (cap < size + align) cap = size + align;
+    ArenaBlock *nb = malloc(BLOCK_HEADER + cap);
+    if (!nb) return NULL;
+    nb->next   = NULL;
+    nb->cap    = cap;
+    nb->offset = 0;
+    if (b) b->next = nb;
+    else   a->head = nb;
+    a->cur = nb;
+    if (a->stats) {
+        atomic_fetch_add_explicit(&a->stats->blocks, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&a->stats->reserved, cap, memory_order_relaxed);
+    }
+    return arena_alloc_aligned(a, size, align);
+}
+
 void *arena_alloc(Arena *a, size_t size) {
-    // align to 8 bytes
-    size_t aligned = (size + 7) & ~(size_t)7;
-    if (a->used + aligned > a->cap) return NULL;
-    void *ptr = a->buf + a->used;
-    a->used += aligned;
-    return ptr;
+    return arena_alloc_aligned(a, size, 0);
 }
 
 void arena_reset(Arena *a) {
-    a->used = 0;
+    a->cur = a->head;
+    if (a->head) a->head->offset = 0;
+    set_used(a, 0);
+}
+
+ArenaMark arena_mark(const Arena *a) {
+    ArenaMark m = { a->cur, a->cur ? a->cur->offset : 0, a->used };
+    return m;
+}
+
+void arena_rewind(Arena *a, ArenaMark m) {
+    if (!m.block) {
+        arena_reset(a);
+        return;
+    }
+    a->cur = m.block;
+    m.block->offset = m.offset;
+    set_used(a, m.used);
 }
 
 void arena_destroy(Arena *a) {
-    free(a->buf);
-    a->buf  = NULL;
-    a->cap  = 0;
-    a->used = 0;
+    set_used(a, 0);
+    ArenaBlock *b = a->head;
+    while (b) {
+        ArenaBlock *next = b->next;
+        if (a->stats) atomic_fetch_sub_explicit(&a->stats->reserved, b->cap, memory_order_relaxed);
+        free(b);
+        b = next;
+    }
+    // Keeps its settings and owner, so it can be used again
+    a->head = NULL;
+    a->cur  = NULL;
 }
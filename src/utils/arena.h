@@ -2,18 +2,65 @@
 #define ARENA_H
 
 #include <stddef.h>
+#include <stdatomic.h>
 
-#define ARENA_DEFAULT_CAP (1024 * 64) // 64 KB
+#define ARENA_DEFAULT_CAP   (1024 * 64) // 64 KB per block
+#define ARENA_DEFAULT_ALIGN 8
+#define ARENA_MAX_OWNERS    16
 
+// Usage counters shared by every arena of one owner (a module name).
+// Entries live for the whole run, so they can be read after the owner's
+// arenas are destroyed. Arenas of one owner may be used on different
+// threads at once (each arena by one thread at a time), so the counters
+// are atomic.
+typedef struct ArenaStats {
+    const char   *owner;
+    atomic_size_t in_use;     // bytes handed out and not yet reset/rewound
+    atomic_size_t high_water; // peak of in_use
+    atomic_size_t reserved;   // bytes of blocks currently held
+    atomic_size_t allocs;     // arena_alloc calls
+    atomic_size_t blocks;     // blocks malloc'd
+} ArenaStats;
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator over a chain of blocks. When the current block is full
+// the next one is used, or a new one of block_cap bytes (more for a large
+// request) is chained on. reset and rewind keep the blocks for reuse;
+// only destroy frees them. A zeroed Arena is valid and uses the defaults.
 typedef struct Arena {
-    char  *buf;
-    size_t cap;
-    size_t used;
+    ArenaBlock *head;       // first block, NULL until the first allocation
+    ArenaBlock *cur;        // block allocations currently come from
+    size_t      block_cap;  // 0 = ARENA_DEFAULT_CAP
+    size_t      align;      // default alignment, power of two; 0 = ARENA_DEFAULT_ALIGN
+    size_t      used;       // bytes in use across all blocks
+    size_t      high_water; // peak of used
+    ArenaStats *stats;      // owner's counters, or NULL
 } Arena;
 
+// Position to rewind to: everything allocated after it is released
+typedef struct {
+    ArenaBlock *block;
+    size_t      offset;
+    size_t      used;
+} ArenaMark;
+
 Arena  arena_create(size_t cap);
+// Arena counted under owner, the module or part that uses it ("plotter",
+// "series", "calc", ...); align 0 = default
+Arena  arena_create_ex(size_t block_cap, size_t align, const char *owner);
 void  *arena_alloc(Arena *a, size_t size);
+void  *arena_alloc_aligned(Arena *a, size_t size, size_t align);
 void   arena_reset(Arena *a);
 void   arena_destroy(Arena *a);
 
+ArenaMark arena_mark(const Arena *a);
+void      arena_rewind(Arena *a, ArenaMark m);
+
+// Counters of one owner (NULL if it never created an arena), and all of
+// them in registration order. Owners may register from any thread.
+const ArenaStats *arena_stats(const char *owner);
+int               arena_stats_count(void);
+const ArenaStats *arena_stats_at(int i);
+
 #endif
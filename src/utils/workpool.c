@@ -0,0 +1,160 @@
+#define _DEFAULT_SOURCE // sysconf core count under -std=c11
+#include "workpool.h"
+#include <stdbool.h>
+
+#if defined(PLATFORM_WEB)
+
+// No threads without SharedArrayBuffer: every job runs inline
+void workpool_init(int threads) { (void)threads; }
+void workpool_shutdown(void) {}
+int  workpool_workers(void) { return 1; }
+
+void workpool_run(WorkFn fn, void *ctx, int count) {
+    for (int i = 0; i < count; i++) fn(ctx, i, 0);
+}
+
+void workpool_post(WorkFn fn, void *ctx, int count) {
+    workpool_run(fn, ctx, count);
+}
+
+void workpool_wait(void) {}
+
+#else
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+static struct {
+    pthread_t       threads[WORKPOOL_MAX_WORKERS - 1];
+    int             count;   // helper threads started
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;    // a job was posted, or quit
+    pthread_cond_t  done;    // pending reached 0
+    unsigned long   job;     // bumped per job, so helpers see each one once
+    int             pending; // helpers not yet done with the current job
+    bool            quit;
+    bool            posted;  // the current job was posted, not yet waited for
+
+    WorkFn          fn;
+    void           *ctx;
+    int             total;
+    atomic_int      next;    // next index to hand out
+} pool;
+
+static void drain(WorkFn fn, void *ctx, int total, int worker) {
+    for (int i; (i = atomic_fetch_add(&pool.next, 1)) < total;)
+        fn(ctx, i, worker);
+}
+
+static void *helper_main(void *arg) {
+    int worker = (int)(size_t)arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (!pool.quit && pool.job == seen) pthread_cond_wait(&pool.wake, &pool.lock);
+        if (pool.quit) break;
+        seen = pool.job;
+        WorkFn fn = pool.fn;
+        void *ctx = pool.ctx;
+        int total = pool.total;
+        pthread_mutex_unlock(&pool.lock);
+
+        drain(fn, ctx, total, worker);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.pending == 0) pthread_cond_signal(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+void workpool_init(int threads) {
+    if (pool.count) return;
+    if (threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (int)cores : 1;
+    }
+    if (threads > WORKPOOL_MAX_WORKERS) threads = WORKPOOL_MAX_WORKERS;
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.wake, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    pool.quit = false;
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&pool.threads[i], NULL, helper_main, (void *)(size_t)(i + 1)) != 0)
+            break;
+        pool.count++;
+    }
+}
+
+void workpool_shutdown(void) {
+    if (!pool.count) return;
+    workpool_wait();
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < pool.count; i++) pthread_join(pool.threads[i], NULL);
+    pool.count = 0;
+    pthread_cond_destroy(&pool.done);
+    pthread_cond_destroy(&pool.wake);
+    pthread_mutex_destroy(&pool.lock);
+}
+
+int workpool_workers(void) {
+    return pool.count + 1;
+}
+
+// Hand fn over 0..count-1 to the helpers
+static void start(WorkFn fn, void *ctx, int count) {
+    pthread_mutex_lock(&pool.lock);
+    pool.fn      = fn;
+    pool.ctx     = ctx;
+    pool.total   = count;
+    pool.pending = pool.count;
+    atomic_store(&pool.next, 0);
+    pool.job++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Every helper checks in, so none is still on this job when the next one
+// is posted
+static void finish(void) {
+    pthread_mutex_lock(&pool.lock);
+    while (pool.pending > 0) pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void workpool_wait(void) {
+    if (!pool.posted) return;
+    pool.posted = false;
+    drain(pool.fn, pool.ctx, pool.total, 0);
+    finish();
+}
+
+void workpool_run(WorkFn fn, void *ctx, int count) {
+    workpool_wait();
+    if (count <= 0) return;
+    if (count == 1 || !pool.count) {
+        for (int i = 0; i < count; i++) fn(ctx, i, 0);
+        return;
+    }
+    start(fn, ctx, count);
+    drain(fn, ctx, count, 0);
+    finish();
+}
+
+void workpool_post(WorkFn fn, void *ctx, int count) {
+    workpool_wait();
+    if (count <= 0) return;
+    if (!pool.count) {
+        for (int i = 0; i < count; i++) fn(ctx, i, 0);
+        return;
+    }
+    start(fn, ctx, count);
+    pool.posted = true;
+}
+
+#endif
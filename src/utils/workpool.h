@@ -0,0 +1,32 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#define WORKPOOL_MAX_WORKERS 16 // including the calling thread
+
+// Task index of a job, run on worker (0 = the calling thread). Tasks of a
+// job run in any order and at the same time, so they must only write state
+// of their own index or of their worker.
+typedef void (*WorkFn)(void *ctx, int index, int worker);
+
+// Start threads - 1 helper threads (0 = one per core, less the caller's).
+// Web builds and a pool of one run every job inline.
+void workpool_init(int threads);
+void workpool_shutdown(void);
+
+// Threads taking part in a job, the caller included; worker ids are below
+int  workpool_workers(void);
+
+// Run fn for every index in 0..count-1 and return once all have finished.
+// The caller works on the job too. Not reentrant: call it from the render
+// thread only, never from inside a task. A posted job is finished first.
+void workpool_run(WorkFn fn, void *ctx, int count);
+
+// Start fn over 0..count-1 on the helper threads and return at once, so
+// the caller can get on with its frame; workpool_wait finishes the job.
+// One job at a time: a posted job is finished before the next starts.
+// Without helpers the job runs inline.
+void workpool_post(WorkFn fn, void *ctx, int count);
+// Finish the posted job, if any, the caller taking the tasks still left
+void workpool_wait(void);
+
+#endif